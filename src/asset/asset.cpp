@@ -1,13 +1,107 @@
 #include "asset.hpp"
 #include "../core/debug.hpp"
 
-// stb_image (needs to be defined here due to memory alloc redefinitions)
-Arena* pArenaImage;
+// stb_image allocations
+// Routed to the calling thread's image arena. Every block starts with a header holding
+// its size, so realloc copies only what the old block held. The block on top of the
+// arena is grown and freed in place, which keeps stb's doubling zlib buffer from
+// leaving copies behind. Anything else is reclaimed when the arena is reset.
+//
+// The threads' own arenas live here rather than in thread local storage, so they can
+// all be released at shutdown, job workers included, whichever thread created them.
+struct alignas(16) ImageBlockHeader     // Keeps blocks 16 byte aligned, as malloc would
+{
+    uint64  mSize       = 0;
+};
+
+Arena   gImageArenas[IMAGE_MAX_THREAD_ARENAS];
+uint32  gImageArenaCount        = 0;
+uint32  gImageArenaGeneration   = 0;    // Bumped by destroyImageArenas
+uint32  gImageArenaLock         = 0;
+
+thread_local Arena* tImageArena             = NULL;     // Created on first use, in gImageArenas
+thread_local uint32 tImageArenaGeneration   = 0;
+thread_local Arena* tArenaImage             = NULL;     // Set with setImageArena, overrides tImageArena
+
+Arena* getImageArena()
+{
+    if(tArenaImage) return tArenaImage;
+    if(!tImageArena || tImageArenaGeneration != atomicLoad(&gImageArenaGeneration))
+    {
+        spinLock(&gImageArenaLock);
+        ASSERTF(gImageArenaCount < IMAGE_MAX_THREAD_ARENAS, "More than %u threads decoding images",
+                IMAGE_MAX_THREAD_ARENAS);
+        tImageArena = &gImageArenas[gImageArenaCount++];
+        tImageArenaGeneration = gImageArenaGeneration;
+        spinUnlock(&gImageArenaLock);
+        initArena(IMAGE_ARENA_SIZE, tImageArena);
+    }
+    return tImageArena;
+}
+
+inline ImageBlockHeader* imageBlockHeader(void* pBlock)
+{
+    return (ImageBlockHeader*)pBlock - 1;
+}
+
+inline bool imageBlockOnTop(Arena* pArena, void* pBlock)
+{
+    return (byte*)pBlock + imageBlockHeader(pBlock)->mSize == arenaGetTop(pArena);
+}
+
+void* imageMalloc(uint64 size)
+{
+    Arena* pArena = getImageArena();
+    ImageBlockHeader* pHeader = (ImageBlockHeader*)arenaPush(pArena, sizeof(ImageBlockHeader) + size, alignof(ImageBlockHeader));
+    pHeader->mSize = size;
+    return pHeader + 1;
+}
+
+void imageFree(void* pBlock)
+{
+    if(!pBlock) return;
+    Arena* pArena = getImageArena();
+    if(imageBlockOnTop(pArena, pBlock))
+    {
+        arenaFallback(pArena, PTR_DIFF(imageBlockHeader(pBlock), pArena->pStart));
+    }
+}
+
+void* imageRealloc(void* pBlock, uint64 newSize)
+{
+    if(!pBlock) return imageMalloc(newSize);
+
+    Arena* pArena = getImageArena();
+    ImageBlockHeader* pHeader = imageBlockHeader(pBlock);
+    uint64 oldSize = pHeader->mSize;
+    if(imageBlockOnTop(pArena, pBlock))
+    {
+        if(newSize > oldSize)
+        {
+            arenaPush(pArena, newSize - oldSize);
+        }
+        else
+        {
+            arenaFallback(pArena, PTR_DIFF(pBlock, pArena->pStart) + newSize);
+        }
+        pHeader->mSize = newSize;
+        return pBlock;
+    }
+    if(newSize <= oldSize)
+    {
+        pHeader->mSize = newSize;
+        return pBlock;
+    }
+
+    void* pNew = imageMalloc(newSize);
+    memcpy(pNew, pBlock, oldSize);
+    return pNew;
+}
 
 #define STB_IMAGE_IMPLEMENTATION
-#define STBI_MALLOC(sz) arenaPush(pArenaImage, sz);
-#define STBI_REALLOC(p, newsz) arenaPushCopy(pArenaImage, newsz, p, newsz);
-#define STBI_FREE(p)
+#define STBI_MALLOC(sz) imageMalloc(sz)
+#define STBI_REALLOC(p, newsz) imageRealloc(p, newsz)
+#define STBI_FREE(p) imageFree(p)
 #define STBI_ASSERT(x) ASSERT(x)
 #include "../third_party/stb_image.h"
 
@@ -18,18 +112,85 @@ void initAssetManager(AssetManagerDesc desc, AssetManager* pAssetManager)
     pAssetManager->mDesc = desc;
     initArena(desc.mPermanentArenaSize, &pAssetManager->mArenaPermanent);
     initArena(desc.mTempArenaSize, &pAssetManager->mArenaTemp);
+    bool io = initAsyncIO(desc.mIO, &pAssetManager->mIO);
+    ASSERT(io);
+    if(desc.mShaderCache.mDir.mLen)
+    {
+        initShaderCache(desc.mShaderCache, &pAssetManager->mShaderCache);
+    }
+    if(desc.mShaderWatch.mEnabled)
+    {
+        bool watch = initShaderWatcher(desc.mShaderWatch, &pAssetManager->mShaderWatcher);
+        ASSERT(watch);
+    }
 
-    pArenaImage = &pAssetManager->mArenaPermanent;
+    pAssetManager->mShaderCompilerCount = desc.pJobs ? desc.pJobs->mWorkerCount : 1;
+    pAssetManager->pShaderCompilers = (ShaderCompiler*)arenaPushZero(&pAssetManager->mArenaPermanent,
+            pAssetManager->mShaderCompilerCount * sizeof(ShaderCompiler), alignof(ShaderCompiler));
 }
 
 void destroyAssetManager(AssetManager* pAssetManager)
 {
     ASSERT(pAssetManager);
 
+    destroyAsyncIO(&pAssetManager->mIO);
+    destroyShaderCompilers(pAssetManager);
+    if(isShaderCacheEnabled(&pAssetManager->mShaderCache))
+    {
+        destroyShaderCache(&pAssetManager->mShaderCache);
+    }
+    if(isShaderWatcherEnabled(&pAssetManager->mShaderWatcher))
+    {
+        destroyShaderWatcher(&pAssetManager->mShaderWatcher);
+    }
     destroyArena(&pAssetManager->mArenaPermanent);
     destroyArena(&pAssetManager->mArenaTemp);
 
     *pAssetManager = {};
 
-    pArenaImage = NULL;
+    destroyImageArenas();
+}
+
+void updateAssetManager(AssetManager* pAssetManager)
+{
+    ASSERT(pAssetManager);
+    updateAsyncIO(&pAssetManager->mIO);
+}
+
+byte* decodeImage(byte* pFile, uint64 fileSize, bool flipVertical, uint32* pWidth, uint32* pHeight)
+{
+    ASSERT(pFile && pWidth && pHeight);
+
+    stbi_set_flip_vertically_on_load_thread(flipVertical);
+    int32 width, height, channels;
+    byte* pPixels = stbi_load_from_memory(pFile, (int32)fileSize, &width, &height, &channels, STBI_rgb_alpha);
+    if(!pPixels) return NULL;
+
+    *pWidth = (uint32)width;
+    *pHeight = (uint32)height;
+    return pPixels;
+}
+
+void resetImageArena()
+{
+    arenaClear(getImageArena());
+}
+
+Arena* setImageArena(Arena* pArena)
+{
+    Arena* pPrevious = tArenaImage;
+    tArenaImage = pArena;
+    return pPrevious;
+}
+
+void destroyImageArenas()
+{
+    spinLock(&gImageArenaLock);
+    for(uint32 i = 0; i < gImageArenaCount; i++)
+    {
+        destroyArena(&gImageArenas[i]);
+    }
+    gImageArenaCount = 0;
+    atomicAdd(&gImageArenaGeneration, 1u);     // Threads still alive create a new one on next use
+    spinUnlock(&gImageArenaLock);
 }
@@ -2,6 +2,10 @@
 #include "../core/base.hpp"
 #include "../core/memory.hpp"
 #include "../core/string.hpp"
+#include "../core/async_io.hpp"
+#include "../core/jobs.hpp"
+#include "shader_cache.hpp"
+#include "shader_watch.hpp"
 
 struct Shader;
 struct Texture;
@@ -14,6 +18,23 @@ struct AssetManagerDesc
     uint64 mPermanentArenaSize = 0;
     uint64 mTempArenaSize = 0;
     uint64 mSTBIArenaSize = 0;
+    AsyncIODesc mIO = {};
+    ShaderCacheDesc mShaderCache = {};     // Disabled when mDir is empty
+    ShaderWatchDesc mShaderWatch = {};     // Records shader dependencies for reloadShaders
+    JobSystem* pJobs = NULL;               // Compiles shader batches, on the calling thread when NULL
+};
+
+// Shader compilers
+// One per job worker (just one without a job system), created on first use by that
+// worker and kept until destroyAssetManager, so shaderc is initialized once per thread
+// and not per shader. Sources and includes go to mArena, rolled back after every shader.
+#define SHADER_COMPILER_ARENA_SIZE MB(64)
+
+struct ShaderCompiler
+{
+    void*   pCompiler   = NULL;     // shaderc_compiler_t
+    Arena   mArena      = {};
+    Arena   mOutput     = {};       // SPIR-V compiled by the worker during a batch
 };
 
 struct AssetManager
@@ -22,15 +43,85 @@ struct AssetManager
 
     Arena mArenaPermanent   = {};
     Arena mArenaTemp        = {};
+
+    // Asset reads in flight, queued with readFileAsync(&mIO, ...)
+    AsyncIO mIO             = {};
+
+    ShaderCache mShaderCache = {};
+    ShaderWatcher mShaderWatcher = {};
+
+    ShaderCompiler* pShaderCompilers    = NULL;     // Indexed by job worker
+    uint32 mShaderCompilerCount         = 0;
 };
 
 void initAssetManager(AssetManagerDesc desc, AssetManager* pAssetManager);
-void destroyAssetManager(AssetManager* pAssetManager);
+void destroyAssetManager(AssetManager* pAssetManager);     // Waits for the reads in flight
+// Once per frame, completes async reads and runs their callbacks.
+void updateAssetManager(AssetManager* pAssetManager);
+
+// Image decoding
+// stb_image allocates from the calling thread's image arena: the one set with
+// setImageArena, or an IMAGE_ARENA_SIZE arena the thread creates on first use.
+// Reset it once the decoded image has been consumed, so memory per decode stays bounded.
+#define IMAGE_ARENA_SIZE        GB(1)
+#define IMAGE_MAX_THREAD_ARENAS 64      // Threads that decode with their own arena
+
+// Returns RGBA8 pixels in the image arena, NULL when the file can't be decoded.
+byte*   decodeImage(byte* pFile, uint64 fileSize, bool flipVertical, uint32* pWidth, uint32* pHeight);
+Arena*  getImageArena();                // Of the calling thread
+void    resetImageArena();
+Arena*  setImageArena(Arena* pArena);   // NULL goes back to the thread's own arena, returns the previous one
+// Releases every thread's own arena, job workers' too. Only once no thread is decoding.
+void    destroyImageArenas();
 
+struct ShaderCompileDesc
+{
+    String  mPath           = {};
+    uint32  mType           = 0;        // ShaderType
+    String* pDefines        = NULL;     // NAME (defined as 1) or NAME=VALUE
+    uint32  mDefinesCount   = 0;
+};
+
+struct ShaderBlob
+{
+    byte*   pSpirv  = NULL;     // NULL if the shader doesn't compile
+    uint64  mSize   = 0;
+};
+
+// Returns the SPIR-V in pArena, from the shader cache when it has it. NULL if the shader doesn't compile.
+// With a job system, call it from one of its threads.
+byte* compileShader(AssetManager* pAssetManager,
+        String path,
+        uint32 shaderType, String* pDefines, uint32 definesCount,
+        Arena* pArena, uint64* pOutSize);
+// Compiles the batch concurrently on the job system, one job per shader, and waits for it.
+// Blobs are returned in pArena, in desc order. One batch at a time per asset manager.
+// Returns the number of shaders that compiled.
+uint32 compileShaders(AssetManager* pAssetManager, ShaderCompileDesc* pDescs, uint32 count,
+        Arena* pArena, ShaderBlob* pOut);
+void destroyShaderCompilers(AssetManager* pAssetManager);
 void loadShader(AssetManager* pAssetManager, Renderer* pRenderer,
         String path, 
         uint32 shaderType, String* pDefines, uint32 definesCount,
         Shader** ppOut);
+// Compiles with compileShaders, then creates the shaders on the calling thread.
+void loadShaders(AssetManager* pAssetManager, Renderer* pRenderer,
+        ShaderCompileDesc* pDescs, uint32 count,
+        Shader** ppOut);
+// Recompiles, as one batch, the shaders affected by files changed since the last call.
+// pOut (count entries) gets the SPIR-V in pArena of those that compiled, pSpirv is NULL for
+// the others. Edits that don't compile are logged. Needs mShaderWatch enabled. Returns the
+// number compiled.
+uint32 recompileChangedShaders(AssetManager* pAssetManager, ShaderCompileDesc* pDescs, uint32 count,
+        Arena* pArena, ShaderBlob* pOut);
+// Recompiles with recompileChangedShaders and replaces the shaders in ppShaders. Shaders
+// whose edit doesn't compile are kept. Returns the number replaced, pOutReloaded (count entries) flags which ones, the
+// pipelines using them have to be rebuilt.
+uint32 reloadShaders(AssetManager* pAssetManager, Renderer* pRenderer,
+        ShaderCompileDesc* pDescs, uint32 count,
+        Shader** ppShaders, bool* pOutReloaded = NULL);
 
+// Cooked texture blobs (see texture_cook.hpp) are recognized by their header, their
+// format, flags and mips are used instead of format and flipVertical.
 void loadTexture(AssetManager* pAssetManager, ResourceManager<Texture>* pResMan,
         String path, uint32 format, bool flipVertical, Texture** ppOut);
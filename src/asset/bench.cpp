@@ -0,0 +1,661 @@
+#include "asset.hpp"
+#include "texture_stream.hpp"
+#include "texture_cook.hpp"
+#include "shader_cache.hpp"
+#include "shader_permutation.hpp"
+#include "../render/shader.hpp"
+#include "../core/app.hpp"
+#include "../core/memory.hpp"
+#include "../core/file.hpp"
+#include "../core/time.hpp"
+#include "../core/debug.hpp"
+#include "../core/thread.hpp"
+#include "../core/jobs.hpp"
+#include "../math/math.hpp"
+
+// Asset benchmarks. Results are only logged, run with an optimized DW_DEBUG build
+// (logging is compiled out otherwise). Test images are written to and removed from
+// ASSET_BENCH_DIR in the working directory.
+
+#define ASSET_BENCH_DIR "asset_bench"
+
+// --------------------------------------
+// PNG writer
+// Stored (uncompressed) deflate blocks and Paeth filtered rows, just enough for
+// stb_image to have real decoding work.
+uint32 benchPngCrc(uint32 crc, byte* pData, uint64 len)
+{
+    crc = ~crc;
+    for(uint64 i = 0; i < len; i++)
+    {
+        crc ^= pData[i];
+        for(uint32 bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+inline byte* benchPngPut32(byte* pOut, uint32 value)
+{
+    pOut[0] = (byte)(value >> 24);
+    pOut[1] = (byte)(value >> 16);
+    pOut[2] = (byte)(value >> 8);
+    pOut[3] = (byte)value;
+    return pOut + 4;
+}
+
+byte* benchPngChunk(byte* pOut, const char* type, byte* pData, uint32 len)
+{
+    pOut = benchPngPut32(pOut, len);
+    byte* pCrcStart = pOut;
+    memcpy(pOut, type, 4);
+    if(len) memmove(pOut + 4, pData, len);
+    pOut += 4 + len;
+    return benchPngPut32(pOut, benchPngCrc(0, pCrcStart, 4 + len));
+}
+
+void writeBenchPng(String path, uint32 width, uint32 height, uint32 seed)
+{
+    ScratchScope scratch;
+    Arena* pArena = scratch.pArena;
+    uint64 rowSize = 1 + (uint64)width * 4;
+    uint64 rawSize = rowSize * height;
+    uint64 blockCount = (rawSize + 65534) / 65535;
+    uint64 idatSize = 2 + rawSize + blockCount * 5 + 4;
+    byte* pFile = (byte*)arenaPush(pArena, 8 + 25 + 12 + idatSize + 12);
+
+    // Raw image, pseudo random pixels
+    byte* pRaw = (byte*)arenaPush(pArena, rawSize);
+    uint32 state = seed * 2654435761u + 1;
+    for(uint64 y = 0; y < height; y++)
+    {
+        byte* pRow = pRaw + y * rowSize;
+        pRow[0] = 4;
+        for(uint64 x = 1; x < rowSize; x++)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            pRow[x] = (byte)state;
+        }
+    }
+
+    // zlib stream
+    byte* pIdat = (byte*)arenaPush(pArena, idatSize);
+    byte* pOut = pIdat;
+    *pOut++ = 0x78;
+    *pOut++ = 0x01;
+    uint32 adlerA = 1, adlerB = 0;
+    for(uint64 offset = 0; offset < rawSize; offset += 65535)
+    {
+        uint32 len = (uint32)MIN(rawSize - offset, (uint64)65535);
+        *pOut++ = offset + len == rawSize ? 1 : 0;
+        *pOut++ = (byte)len;
+        *pOut++ = (byte)(len >> 8);
+        *pOut++ = (byte)~len;
+        *pOut++ = (byte)(~len >> 8);
+        memcpy(pOut, pRaw + offset, len);
+        pOut += len;
+        for(uint32 i = 0; i < len; i++)
+        {
+            adlerA = (adlerA + pRaw[offset + i]) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+        }
+    }
+    pOut = benchPngPut32(pOut, (adlerB << 16) | adlerA);
+    ASSERT((uint64)(pOut - pIdat) == idatSize);
+
+    byte header[13];
+    benchPngPut32(header, width);
+    benchPngPut32(header + 4, height);
+    header[8] = 8;      // Bit depth
+    header[9] = 6;      // RGBA
+    header[10] = 0;
+    header[11] = 0;
+    header[12] = 0;
+
+    static const byte signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    pOut = pFile;
+    memcpy(pOut, signature, 8);
+    pOut = benchPngChunk(pOut + 8, "IHDR", header, 13);
+    pOut = benchPngChunk(pOut, "IDAT", pIdat, (uint32)idatSize);
+    pOut = benchPngChunk(pOut, "IEND", NULL, 0);
+
+    writeFile(path, pFile, (uint64)(pOut - pFile));
+}
+
+// --------------------------------------
+// Texture streaming
+// The sink stands in for the GPU: it reads every staged image back and completes a
+// batch one poll after it was submitted.
+struct AssetBenchSink
+{
+    byte*   pStaging    = NULL;
+    uint64  mChecksum   = 0;
+    uint64  mSubmitted  = 0;
+    uint64  mPolled     = 0;
+};
+
+uint64 assetBenchChecksum(byte* pData, uint64 size)
+{
+    uint64 sum = 0;
+    for(uint64 i = 0; i + 8 <= size; i += 8)
+    {
+        uint64 value;
+        memcpy(&value, pData + i, 8);
+        sum += value;
+    }
+    return sum;
+}
+
+uint64 assetBenchSubmit(void* pUserData, TextureUpload* pUploads, uint32 count)
+{
+    AssetBenchSink* pSink = (AssetBenchSink*)pUserData;
+    for(uint32 i = 0; i < count; i++)
+    {
+        pSink->mChecksum += assetBenchChecksum(pSink->pStaging + pUploads[i].mStagingOffset, pUploads[i].mSize);
+        pUploads[i].pTexture = NULL;
+    }
+    return pSink->mSubmitted++;
+}
+
+bool assetBenchIsComplete(void* pUserData, uint64 batch)
+{
+    AssetBenchSink* pSink = (AssetBenchSink*)pUserData;
+    if(batch < pSink->mPolled) return true;
+    pSink->mPolled = batch + 1;
+    return false;
+}
+
+void benchTextureStreaming(App* pApp)
+{
+    ASSERT(pApp);
+
+    const uint32 imageCount = 64;
+    const uint32 imageSize = 512;
+    const uint64 stagingSize = MB(16);
+    Arena arena = {};
+    initArena(GB(1), &arena);
+
+    createDir(str(ASSET_BENCH_DIR));
+    String* pPaths = (String*)arenaPush(&arena, sizeof(String) * imageCount);
+    for(uint32 i = 0; i < imageCount; i++)
+    {
+        pPaths[i] = strf(&arena, ASSET_BENCH_DIR "/%03u.png", i);
+        writeBenchPng(pPaths[i], imageSize, imageSize, i);
+    }
+    byte* pStaging = (byte*)arenaPush(&arena, stagingSize, 64);
+
+    Timer timer = createTimer(pApp);
+
+    // Baseline, what loadTexture does: read, decode and copy one image at a time
+    Arena arenaLoad = {};
+    initArena(GB(1), &arenaLoad);
+    uint64 expectedChecksum = 0;
+    uint64 peakDecode = 0;
+    startTimer(&timer);
+    for(uint32 i = 0; i < imageCount; i++)
+    {
+        uint64 fileSize = 0;
+        byte* pFile = readFile(&arenaLoad, pPaths[i], &fileSize);
+        uint32 width, height;
+        byte* pPixels = decodeImage(pFile, fileSize, false, &width, &height);
+        ASSERT(pPixels);
+        uint64 size = (uint64)width * height * 4;
+        memcpy(pStaging, pPixels, size);
+        expectedChecksum += assetBenchChecksum(pStaging, size);
+        peakDecode = MAX(peakDecode, getImageArena()->mOffset);
+        resetImageArena();
+        arenaClear(&arenaLoad);
+    }
+    endTimer(&timer);
+    destroyArena(&arenaLoad);
+    double baseMs = getMS(&timer);
+    LOGF("[BENCH-ASSET] Blocking loads: %u images %ux%u %8.2f ms, decode arena peak %.2f MB for %.2f MB of pixels",
+            imageCount, imageSize, imageSize, baseMs, peakDecode / (double)MB(1), imageSize * imageSize * 4 / (double)MB(1));
+
+    // Streamer, the calling thread only updates it. 1, 2, 4... up to all cores decoding
+    uint32 coreCount = getCoreCount();
+    for(uint32 workerCount = 1;; workerCount = MIN(workerCount * 2, coreCount))
+    {
+        JobSystem jobs = {};
+        initJobSystem(workerCount + 1, &jobs);
+
+        AssetBenchSink sink = {};
+        sink.pStaging = pStaging;
+
+        TextureStreamerDesc desc = {};
+        desc.pJobs = &jobs;
+        desc.mSink.pUserData = &sink;
+        desc.mSink.pfnSubmit = assetBenchSubmit;
+        desc.mSink.pfnIsComplete = assetBenchIsComplete;
+        desc.pStaging = pStaging;
+        desc.mStagingSize = stagingSize;
+        desc.mMaxDecodes = MIN(workerCount * 2, (uint32)TEXTURE_STREAM_MAX_DECODES);
+        TextureStreamer* pStreamer = (TextureStreamer*)arenaPush(&arena, sizeof(TextureStreamer));
+        initTextureStreamer(desc, pStreamer);
+
+        TextureTicket tickets[imageCount + 1];
+        uint64 updates = 0;
+        startTimer(&timer);
+        for(uint32 i = 0; i < imageCount; i++)
+        {
+            tickets[i] = requestTexture(pStreamer, pPaths[i], 0, false);
+        }
+        tickets[imageCount] = requestTexture(pStreamer, str(ASSET_BENCH_DIR "/missing.png"), 0, false);
+        while(!isTextureStreamerIdle(pStreamer))
+        {
+            updateTextureStreamer(pStreamer);
+            updates++;
+            yieldThread();
+        }
+        endTimer(&timer);
+        double streamMs = getMS(&timer);
+
+        uint32 ready = 0, failed = 0;
+        for(uint32 i = 0; i <= imageCount; i++)
+        {
+            Texture* pTexture = NULL;
+            TextureStreamStatus status = pollTexture(pStreamer, tickets[i], &pTexture);
+            if(status == TEXTURE_STREAM_READY) ready++;
+            if(status == TEXTURE_STREAM_FAILED) failed++;
+        }
+        ASSERT(ready == imageCount && failed == 1);
+        ASSERT(sink.mChecksum == expectedChecksum);
+
+        TextureStreamerStats* pStats = &pStreamer->mStats;
+        LOGF("[BENCH-ASSET] Streaming %2u workers, %2u decodes: %8.2f ms (%.2fx), %llu updates, %llu batches, %llu staging stalls",
+                workerCount, desc.mMaxDecodes, streamMs, baseMs / streamMs,
+                updates, pStats->mBatches, pStats->mStagingStalls);
+
+        destroyTextureStreamer(pStreamer);
+        destroyJobSystem(&jobs);
+        if(workerCount == coreCount) break;
+    }
+
+    for(uint32 i = 0; i < imageCount; i++)
+    {
+        deleteFile(pPaths[i]);
+    }
+    deleteDir(str(ASSET_BENCH_DIR));
+    destroyArena(&arena);
+}
+
+// --------------------------------------
+// Texture cooking
+void benchTextureCook(App* pApp)
+{
+    ASSERT(pApp);
+
+    const uint32 imageSize = 1024;
+    Arena arena = {};
+    initArena(GB(1), &arena);
+
+    byte* pPixels = (byte*)arenaPush(&arena, imageSize * imageSize * 4);
+    for(uint32 y = 0; y < imageSize; y++)
+    {
+        for(uint32 x = 0; x < imageSize; x++)
+        {
+            byte* pTexel = pPixels + ((uint64)y * imageSize + x) * 4;
+            pTexel[0] = (byte)x;
+            pTexel[1] = (byte)(128 + 127 * sinf(y * 0.05f));
+            pTexel[2] = (byte)((x ^ y) & 0xF0);
+            pTexel[3] = (byte)(y >> 2);
+        }
+    }
+
+    static const char* formatNames[TEXTURE_BLOB_FORMAT_COUNT] = { "RGBA8", "BC1", "BC3", "BC5", "BC7" };
+    Timer timer = createTimer(pApp);
+    uint32 coreCount = getCoreCount();
+    for(uint32 format = 0; format < TEXTURE_BLOB_FORMAT_COUNT; format++)
+    {
+        double baseMs = 0.0;
+        for(uint32 threadCount = 1;; threadCount = MIN(threadCount * 2, coreCount))
+        {
+            JobSystem jobs = {};
+            initJobSystem(threadCount, &jobs);
+
+            TextureCookDesc desc = {};
+            desc.mFormat = (TextureBlobFormat)format;
+            desc.pJobs = &jobs;
+            uint64 size = 0;
+            ARENA_SCOPE(&arena);
+            startTimer(&timer);
+            cookTexture(desc, pPixels, imageSize, imageSize, &arena, &size);
+            endTimer(&timer);
+            double cookMs = getMS(&timer);
+            if(threadCount == 1) baseMs = cookMs;
+
+            LOGF("[BENCH-ASSET] Cook %ux%u %-5s %2u threads: %8.2f ms (%.2fx), blob %.2f MB",
+                    imageSize, imageSize, formatNames[format], threadCount, cookMs, baseMs / cookMs, size / (double)MB(1));
+
+            destroyJobSystem(&jobs);
+            if(threadCount == coreCount) break;
+        }
+    }
+
+    destroyArena(&arena);
+}
+
+// --------------------------------------
+// Shader cache
+// Headless, compileShader doesn't need a renderer. Cold runs start from an empty cache
+// and pay for shaderc and the stores, warm runs reload the index like a new session.
+#define SHADER_BENCH_DIR        ASSET_BENCH_DIR "/shaders"
+#define SHADER_BENCH_CACHE_DIR  ASSET_BENCH_DIR "/shader_cache"
+#define SHADER_BENCH_SHADERS    16
+
+double compileBenchShaders(App* pApp, AssetManager* pAssetManager, String* pPaths, Arena* pArena)
+{
+    String defines[] = { str("USE_FOG"), str("USE_SHADOWS") };
+    Timer timer = createTimer(pApp);
+    startTimer(&timer);
+    for(uint32 i = 0; i < SHADER_BENCH_SHADERS; i++)
+    {
+        // Two permutations each
+        for(uint32 definesCount = 0; definesCount <= 2; definesCount += 2)
+        {
+            ARENA_SCOPE(pArena);
+            uint64 size = 0;
+            byte* pSpirv = compileShader(pAssetManager, pPaths[i], SHADER_TYPE_FRAG, defines, definesCount, pArena, &size);
+            ASSERT(pSpirv);
+        }
+    }
+    endTimer(&timer);
+    return getMS(&timer);
+}
+
+// Returns the paths of SHADER_BENCH_SHADERS fragment shaders sharing an include
+String* writeBenchShaders(Arena* pArena)
+{
+    createDir(str(ASSET_BENCH_DIR));
+    createDir(str(SHADER_BENCH_DIR));
+
+    const char* common =
+        "vec3 shade(vec3 n, vec3 l, vec3 albedo)\n"
+        "{\n"
+        "    vec3 color = albedo * max(dot(n, l), 0.0);\n"
+        "#ifdef USE_FOG\n"
+        "    color = mix(color, vec3(0.5), 0.1);\n"
+        "#endif\n"
+        "    return color;\n"
+        "}\n";
+    writeFile(str(SHADER_BENCH_DIR "/common.glsl"), (byte*)common, strlen(common));
+
+    String* pPaths = (String*)arenaPush(pArena, SHADER_BENCH_SHADERS * sizeof(String));
+    for(uint32 i = 0; i < SHADER_BENCH_SHADERS; i++)
+    {
+        pPaths[i] = strf(pArena, SHADER_BENCH_DIR "/%02u.frag", i);
+        String source = strf(pArena,
+                "#version 450\n"
+                "#include \"common.glsl\"\n"
+                "layout(location = 0) in vec3 inNormal;\n"
+                "layout(location = 0) out vec4 outColor;\n"
+                "void main()\n"
+                "{\n"
+                "    vec3 color = vec3(0.0);\n"
+                "    for(int i = 0; i < %u; i++)\n"
+                "    {\n"
+                "        color += shade(normalize(inNormal), normalize(vec3(i, 1.0, 0.5)), vec3(0.%u));\n"
+                "    }\n"
+                "#ifdef USE_SHADOWS\n"
+                "    color *= 0.5;\n"
+                "#endif\n"
+                "    outColor = vec4(color, 1.0);\n"
+                "}\n", i + 1, i % 10);
+        writeFile(pPaths[i], source.mData, source.mLen);
+    }
+    return pPaths;
+}
+
+void deleteBenchShaders(String* pPaths)
+{
+    for(uint32 i = 0; i < SHADER_BENCH_SHADERS; i++)
+    {
+        deleteFile(pPaths[i]);
+    }
+    deleteFile(str(SHADER_BENCH_DIR "/common.glsl"));
+    deleteDir(str(SHADER_BENCH_DIR));
+    deleteDir(str(ASSET_BENCH_DIR));
+}
+
+void benchShaderCache(App* pApp)
+{
+    ASSERT(pApp);
+
+    Arena arena = {};
+    initArena(MB(64), &arena);
+    String* pPaths = writeBenchShaders(&arena);
+
+    AssetManagerDesc desc = {};
+    desc.mPermanentArenaSize = MB(1);
+    desc.mTempArenaSize = MB(1);
+    desc.mShaderCache.mDir = str(SHADER_BENCH_CACHE_DIR);
+    AssetManager assetManager = {};
+    initAssetManager(desc, &assetManager);
+    clearShaderCache(&assetManager.mShaderCache);
+    double coldMs = compileBenchShaders(pApp, &assetManager, pPaths, &arena);
+    ShaderCacheStats cold = assetManager.mShaderCache.mStats;
+    destroyAssetManager(&assetManager);
+
+    initAssetManager(desc, &assetManager);
+    double warmMs = compileBenchShaders(pApp, &assetManager, pPaths, &arena);
+    ShaderCacheStats warm = assetManager.mShaderCache.mStats;
+    uint32 variants = SHADER_BENCH_SHADERS * 2;
+    LOGF("[BENCH-ASSET] Shaders %u variants: cold %8.2f ms (%llu misses), warm %8.2f ms (%llu hits), %.1fx, cache %.1f KB",
+            variants, coldMs, cold.mMisses, warmMs, warm.mHits, coldMs / warmMs,
+            assetManager.mShaderCache.mTotalSize / (double)KB(1));
+
+    clearShaderCache(&assetManager.mShaderCache);
+    destroyAssetManager(&assetManager);
+    deleteFile(str(SHADER_BENCH_CACHE_DIR "/index.bin"));
+    deleteDir(str(SHADER_BENCH_CACHE_DIR));
+    deleteBenchShaders(pPaths);
+    destroyArena(&arena);
+}
+
+// --------------------------------------
+// Shader compilation
+// Without the cache, every variant goes through shaderc. Serial compiles reuse the
+// calling thread's compiler, batches run one job per variant.
+void benchShaderCompile(App* pApp)
+{
+    ASSERT(pApp);
+
+    Arena arena = {};
+    initArena(MB(64), &arena);
+    String* pPaths = writeBenchShaders(&arena);
+
+    String defines[] = { str("USE_FOG"), str("USE_SHADOWS") };
+    const uint32 variants = SHADER_BENCH_SHADERS * 2;
+    ShaderCompileDesc* pDescs = (ShaderCompileDesc*)arenaPush(&arena, variants * sizeof(ShaderCompileDesc));
+    for(uint32 i = 0; i < variants; i++)
+    {
+        pDescs[i] = {};
+        pDescs[i].mPath = pPaths[i / 2];
+        pDescs[i].mType = SHADER_TYPE_FRAG;
+        pDescs[i].pDefines = defines;
+        pDescs[i].mDefinesCount = (i % 2) * 2;
+    }
+    ShaderBlob* pBlobs = (ShaderBlob*)arenaPush(&arena, variants * sizeof(ShaderBlob));
+
+    AssetManagerDesc desc = {};
+    desc.mPermanentArenaSize = MB(1);
+    desc.mTempArenaSize = MB(1);
+    AssetManager assetManager = {};
+    initAssetManager(desc, &assetManager);
+    Timer timer = createTimer(pApp);
+    startTimer(&timer);
+    {
+        ARENA_SCOPE(&arena);
+        uint32 compiled = compileShaders(&assetManager, pDescs, variants, &arena, pBlobs);
+        ASSERT(compiled == variants);
+    }
+    endTimer(&timer);
+    double serialMs = getMS(&timer);
+    destroyAssetManager(&assetManager);
+
+    uint32 coreCount = getCoreCount();
+    for(uint32 threadCount = 2; threadCount <= coreCount; threadCount *= 2)
+    {
+        JobSystem jobs = {};
+        initJobSystem(threadCount, &jobs);
+        desc.pJobs = &jobs;
+        initAssetManager(desc, &assetManager);
+        startTimer(&timer);
+        {
+            ARENA_SCOPE(&arena);
+            uint32 compiled = compileShaders(&assetManager, pDescs, variants, &arena, pBlobs);
+            ASSERT(compiled == variants);
+        }
+        endTimer(&timer);
+        double parallelMs = getMS(&timer);
+        LOGF("[BENCH-ASSET] Compile %u variants: serial %8.2f ms, %2u threads %8.2f ms, %.1fx",
+                variants, serialMs, threadCount, parallelMs, serialMs / parallelMs);
+        destroyAssetManager(&assetManager);
+        destroyJobSystem(&jobs);
+    }
+    if(coreCount < 2)
+    {
+        LOGF("[BENCH-ASSET] Compile %u variants: serial %8.2f ms", variants, serialMs);
+    }
+
+    deleteBenchShaders(pPaths);
+    destroyArena(&arena);
+}
+
+// --------------------------------------
+// Shader permutations
+// Headless like the above: startup cost of the whole variant domain against only the
+// variants in use, then the draw time lookup by ID against building a define string
+// key every draw.
+#define SHADER_BENCH_LOOKUPS 1000000
+
+void benchShaderPermutation(App* pApp)
+{
+    ASSERT(pApp);
+
+    Arena arena = {};
+    initArena(MB(64), &arena);
+    String* pPaths = writeBenchShaders(&arena);
+
+    ShaderPermutationKey keys[3] = {};
+    keys[0].mName = str("USE_FOG");
+    keys[1].mName = str("USE_SHADOWS");
+    keys[2].mName = str("LIGHT_COUNT");
+    keys[2].mValueCount = 4;
+    ShaderPermutationDesc desc = {};
+    desc.mPath = pPaths[0];
+    desc.mType = SHADER_TYPE_FRAG;
+    desc.pKeys = keys;
+    desc.mKeyCount = 3;
+    ShaderPermutation permutation = {};
+    initShaderPermutation(desc, &permutation);
+
+    // A scene using a quarter of the domain, the first IDs listed
+    uint32 variantCount = (uint32)permutation.mVariantCount;
+    ShaderVariantId* pIds = (ShaderVariantId*)arenaPush(&arena, variantCount * sizeof(ShaderVariantId), alignof(ShaderVariantId));
+    ShaderCompileDesc* pDescs = (ShaderCompileDesc*)arenaPush(&arena, variantCount * sizeof(ShaderCompileDesc), alignof(ShaderCompileDesc));
+    for(uint32 i = 0; i < variantCount; i++)
+    {
+        uint32 values[] = { i & 1, (i >> 1) & 1, (i >> 2) & 3 };
+        pIds[i] = shaderVariantId(&permutation, values);
+        pDescs[i] = {};
+        pDescs[i].mPath = desc.mPath;
+        pDescs[i].mType = desc.mType;
+        pDescs[i].mDefinesCount = getShaderVariantDefines(&permutation, pIds[i], &arena, &pDescs[i].pDefines);
+    }
+    uint32 usedCount = variantCount / 4;
+
+    // A new manager each run, both pay for creating the compiler like a startup would
+    AssetManagerDesc assetDesc = {};
+    assetDesc.mPermanentArenaSize = MB(1);
+    assetDesc.mTempArenaSize = MB(1);
+    AssetManager assetManager = {};
+    ShaderBlob* pBlobs = (ShaderBlob*)arenaPush(&arena, variantCount * sizeof(ShaderBlob), alignof(ShaderBlob));
+    Timer timer = createTimer(pApp);
+    double ms[2] = {};
+    uint32 counts[2] = { variantCount, usedCount };
+    for(uint32 i = 0; i < 2; i++)
+    {
+        ARENA_SCOPE(&arena);
+        initAssetManager(assetDesc, &assetManager);
+        startTimer(&timer);
+        uint32 compiled = compileShaders(&assetManager, pDescs, counts[i], &arena, pBlobs);
+        endTimer(&timer);
+        ASSERT(compiled == counts[i]);
+        ms[i] = getMS(&timer);
+        destroyAssetManager(&assetManager);
+    }
+    LOGF("[BENCH-ASSET] Permutation startup: %u variants %8.2f ms, %u used %8.2f ms",
+            variantCount, ms[0], usedCount, ms[1]);
+
+    // Variants stand in for shaders, only pointers are compared
+    HashMap<String, Shader*> byDefines = hashmap<String, Shader*>(&arena, variantCount);
+    for(uint32 i = 0; i < variantCount; i++)
+    {
+        Shader* pShader = (Shader*)(uint64)(i + 1);
+        permutation.mVariants.insert(pIds[i], pShader);
+        String key = {};
+        for(uint32 j = 0; j < pDescs[i].mDefinesCount; j++)
+        {
+            key = strf(&arena, "%.*s%.*s;", (int32)key.mLen, cstr(key), (int32)pDescs[i].pDefines[j].mLen, cstr(pDescs[i].pDefines[j]));
+        }
+        byDefines.insert(key, pShader);
+    }
+
+    uint64 checksum = 0;
+    startTimer(&timer);
+    for(uint32 i = 0; i < SHADER_BENCH_LOOKUPS; i++)
+    {
+        checksum += (uint64)findShaderVariant(&permutation, pIds[i % variantCount]);
+    }
+    endTimer(&timer);
+    double idNs = getNS(&timer) / SHADER_BENCH_LOOKUPS;
+    startTimer(&timer);
+    for(uint32 i = 0; i < SHADER_BENCH_LOOKUPS; i++)
+    {
+        ARENA_SCOPE(&arena);
+        ShaderCompileDesc* pDesc = &pDescs[i % variantCount];
+        String key = {};
+        for(uint32 j = 0; j < pDesc->mDefinesCount; j++)
+        {
+            key = strf(&arena, "%.*s%.*s;", (int32)key.mLen, cstr(key), (int32)pDesc->pDefines[j].mLen, cstr(pDesc->pDefines[j]));
+        }
+        Shader** ppShader = byDefines.find(key);
+        checksum -= ppShader ? (uint64)*ppShader : 0;
+    }
+    endTimer(&timer);
+    double definesNs = getNS(&timer) / SHADER_BENCH_LOOKUPS;
+    ASSERT(checksum == 0);
+    LOGF("[BENCH-ASSET] Permutation lookup: id %6.2f ns, define strings %6.2f ns, %.1fx",
+            idNs, definesNs, definesNs / idNs);
+
+    permutation.mVariants.clear();
+    destroyShaderPermutation(NULL, &permutation);
+    deleteBenchShaders(pPaths);
+    destroyArena(&arena);
+}
+
+void benchAssets(App* pApp)
+{
+    ASSERT(pApp);
+    LOG("[BENCH-ASSET] Benchmarking texture streaming...");
+    benchTextureStreaming(pApp);
+
+    LOG("[BENCH-ASSET] Benchmarking texture cooking...");
+    benchTextureCook(pApp);
+
+    LOG("[BENCH-ASSET] Benchmarking shader cache...");
+    benchShaderCache(pApp);
+
+    LOG("[BENCH-ASSET] Benchmarking shader compilation...");
+    benchShaderCompile(pApp);
+
+    LOG("[BENCH-ASSET] Benchmarking shader permutations...");
+    benchShaderPermutation(pApp);
+
+    LOG("[BENCH-ASSET] All asset benchmarks done.");
+}
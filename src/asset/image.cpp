@@ -1,28 +1,88 @@
 #include "asset.hpp"
+#include "texture_stream.hpp"
+#include "texture_cook.hpp"
 #include "../core/file.hpp"
 #include "../render/buffer.hpp"
-#undef STB_IMAGE_IMPLEMENTATION
-#include "../third_party/stb_image.h"
 #include "../core/debug.hpp"
 #include "../render/texture.hpp"
 #include "../render/render.hpp"
 #include "../render/resource_manager.hpp"
 
+ImageFormat getTextureBlobImageFormat(TextureBlobHeader* pBlob)
+{
+    bool srgb = pBlob->mFlags & TEXTURE_BLOB_FLAG_SRGB;
+    switch(pBlob->mFormat)
+    {
+        case TEXTURE_BLOB_RGBA8:    return srgb ? FORMAT_RGBA8_SRGB : FORMAT_RGBA8_UNORM;
+        case TEXTURE_BLOB_BC1:      return srgb ? FORMAT_BC1_RGB_SRGB : FORMAT_BC1_RGB_UNORM;
+        case TEXTURE_BLOB_BC3:      return srgb ? FORMAT_BC3_SRGB : FORMAT_BC3_UNORM;
+        case TEXTURE_BLOB_BC5:      return FORMAT_BC5_UNORM;
+        case TEXTURE_BLOB_BC7:      return srgb ? FORMAT_BC7_SRGB : FORMAT_BC7_UNORM;
+        default: return FORMAT_UNDEFINED;
+    }
+}
+
+// Cooked blobs already hold every mip, they're copied level by level
+void loadTextureBlob(ResourceManager<Texture>* pResMan, TextureBlobHeader* pBlob, Texture** ppOut)
+{
+    TextureDesc desc = {};
+    desc.mWidth = pBlob->mWidth;
+    desc.mHeight = pBlob->mHeight;
+    desc.mDepth = 1;
+    desc.mSamples = 1;
+    desc.mMipCount = pBlob->mMipCount;
+    desc.mType = TEXTURE_TYPE_2D;
+    desc.mFormat = getTextureBlobImageFormat(pBlob);
+    desc.mBaseLayout = IMAGE_LAYOUT_UNDEFINED;
+    desc.mUsage = TEXTURE_USAGE_SAMPLED
+        | TEXTURE_USAGE_TRANSFER_DST;
+
+    initTexture(pResMan, desc, ppOut);
+
+    Renderer* pRenderer = pResMan->pRenderer;
+    uint64 dataStart = pBlob->mMips[0].mOffset;
+    TextureBlobMip* pLastMip = &pBlob->mMips[pBlob->mMipCount - 1];
+    uint64 dataSize = pLastMip->mOffset + pLastMip->mSize - dataStart;
+    ASSERT(dataSize <= pRenderer->pStagingBuffer->mDesc.mSize);
+    copyToBuffer(pRenderer, pRenderer->pStagingBuffer, 0, (byte*)pBlob + dataStart, dataSize);
+
+    CommandBuffer* pCmd = getCmd(pRenderer, true);
+    beginCmd(pCmd);
+    TextureBarrier barrier = { *ppOut, IMAGE_LAYOUT_UNDEFINED, IMAGE_LAYOUT_TRANSFER_DST };
+    cmdTextureBarrier(pCmd, 1, &barrier);
+    for(uint32 i = 0; i < pBlob->mMipCount; i++)
+    {
+        cmdCopyToTexture(pCmd, *ppOut, pRenderer->pStagingBuffer, pBlob->mMips[i].mOffset - dataStart, i);
+    }
+    barrier = { *ppOut, IMAGE_LAYOUT_TRANSFER_DST, IMAGE_LAYOUT_SHADER_READ_ONLY };
+    cmdTextureBarrier(pCmd, 1, &barrier);
+    endCmd(pCmd);
+    submitImmediateCmd(pRenderer, pCmd);
+}
+
 void loadTexture(AssetManager* pAssetManager, ResourceManager<Texture>* pResMan, String path, 
         uint32 format, bool flipVertical, Texture** ppOut)
 {
     ASSERT(pAssetManager && pResMan && ppOut);
     ASSERT(*ppOut == NULL);
-    uint64 fileSize = 0;
-    byte* fileData = readFile(&pAssetManager->mArenaTemp, path, &fileSize);
+    // Parsing straight from the page cache, the file is never copied
+    FileView file = {};
+    bool mapped = mapFile(path, &file);
+    ASSERT(mapped);
 
-    stbi_set_flip_vertically_on_load(flipVertical);
-    int32 width, height, channels;
-    byte* imageData = stbi_load_from_memory(
-            fileData,
-            fileSize,
-            &width, &height, &channels, STBI_rgb_alpha);
-    uint64 imageSize = width * height * STBI_rgb_alpha;
+    TextureBlobHeader* pBlob = getTextureBlob(file.pData, file.mSize);
+    if(pBlob)
+    {
+        loadTextureBlob(pResMan, pBlob, ppOut);
+        unmapFile(&file);
+        return;
+    }
+
+    uint32 width, height;
+    byte* imageData = decodeImage(file.pData, file.mSize, flipVertical, &width, &height);
+    ASSERT(imageData);
+    unmapFile(&file);
+    uint64 imageSize = (uint64)width * height * 4;
 
     TextureDesc desc = {};
     desc.mWidth = width;
@@ -57,5 +117,144 @@ void loadTexture(AssetManager* pAssetManager, ResourceManager<Texture>* pResMan,
     endCmd(pCmd);
     submitImmediateCmd(pRenderer, pCmd);
 
-    arenaClear(&pAssetManager->mArenaTemp);
+    resetImageArena();
+}
+
+// --------------------------------------
+// Renderer texture sink
+uint64 rendererSinkSubmit(void* pUserData, TextureUpload* pUploads, uint32 count)
+{
+    RendererTextureSink* pSink = (RendererTextureSink*)pUserData;
+    ResourceManager<Texture>* pResMan = pSink->pResMan;
+    Renderer* pRenderer = pResMan->pRenderer;
+
+    // The streamer keeps at most TEXTURE_STREAM_MAX_BATCHES in flight, so this one is done
+    uint64 batch = pSink->mSubmitted++;
+    CommandBuffer* pCmd = &pSink->pCmds[batch % TEXTURE_STREAM_MAX_BATCHES];
+    ASSERT(vkGetFenceStatus(pRenderer->mVkDevice, pCmd->mVkFence) == VK_SUCCESS);
+    VkResult ret = vkResetFences(pRenderer->mVkDevice, 1, &pCmd->mVkFence);
+    ASSERTVK(ret);
+    ret = vkResetCommandBuffer(pCmd->mVkCmd, 0);
+    ASSERTVK(ret);
+    pCmd->mState = COMMAND_BUFFER_IDLE;
+
+    beginCmd(pCmd);
+    for(uint32 i = 0; i < count; i++)
+    {
+        TextureUpload* pUpload = &pUploads[i];
+
+        TextureDesc desc = {};
+        desc.mWidth = pUpload->mWidth;
+        desc.mHeight = pUpload->mHeight;
+        desc.mDepth = 1;
+        desc.mSamples = 1;
+        desc.mMipCount = getMaxMipCount(pUpload->mWidth, pUpload->mHeight);
+        desc.mType = TEXTURE_TYPE_2D;
+        desc.mFormat = (ImageFormat)pUpload->mFormat;
+        desc.mBaseLayout = IMAGE_LAYOUT_UNDEFINED;
+        desc.mUsage = TEXTURE_USAGE_SAMPLED
+            | TEXTURE_USAGE_TRANSFER_SRC
+            | TEXTURE_USAGE_TRANSFER_DST;
+        initTexture(pResMan, desc, &pUpload->pTexture);
+
+        TextureBarrier barrier = { pUpload->pTexture, IMAGE_LAYOUT_UNDEFINED, IMAGE_LAYOUT_TRANSFER_DST };
+        cmdTextureBarrier(pCmd, 1, &barrier);
+        cmdCopyToTexture(pCmd, pUpload->pTexture, pSink->pStaging, pUpload->mStagingOffset);
+        cmdGenerateMipmap(pCmd, pUpload->pTexture, SAMPLER_FILTER_LINEAR);
+        barrier = { pUpload->pTexture, IMAGE_LAYOUT_TRANSFER_SRC, IMAGE_LAYOUT_SHADER_READ_ONLY };
+        cmdTextureBarrier(pCmd, 1, &barrier);
+    }
+    endCmd(pCmd);
+    submitCmd(pRenderer, pCmd);
+
+    return batch;
+}
+
+bool rendererSinkIsComplete(void* pUserData, uint64 batch)
+{
+    RendererTextureSink* pSink = (RendererTextureSink*)pUserData;
+    if(batch + TEXTURE_STREAM_MAX_BATCHES < pSink->mSubmitted) return true;
+
+    CommandBuffer* pCmd = &pSink->pCmds[batch % TEXTURE_STREAM_MAX_BATCHES];
+    return vkGetFenceStatus(pSink->pResMan->pRenderer->mVkDevice, pCmd->mVkFence) == VK_SUCCESS;
+}
+
+void initRendererTextureSink(ResourceManager<Texture>* pResMan, uint64 stagingSize, Arena* pArena, RendererTextureSink* pSink)
+{
+    ASSERT(pResMan && pArena && pSink);
+    Renderer* pRenderer = pResMan->pRenderer;
+
+    *pSink = {};
+    pSink->pResMan = pResMan;
+
+    BufferDesc bufferDesc = {};
+    bufferDesc.mType = BUFFER_TYPE_TRANSFER_SRC;
+    bufferDesc.mSize = stagingSize;
+    bufferDesc.mStride = stagingSize;
+    bufferDesc.mCount = 1;
+    addBuffer(pRenderer, bufferDesc, &pSink->pStaging);
+
+    // Buffers stay mapped, the streamer's copy jobs write straight into it
+    pSink->pMapped = (byte*)pSink->pStaging->pMapped;
+
+    VkCommandBuffer vkCommandBuffers[TEXTURE_STREAM_MAX_BATCHES];
+    VkCommandBufferAllocateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    info.commandPool = pRenderer->mVkCommandPool;
+    info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    info.commandBufferCount = TEXTURE_STREAM_MAX_BATCHES;
+    VkResult ret = vkAllocateCommandBuffers(pRenderer->mVkDevice, &info, vkCommandBuffers);
+    ASSERTVK(ret);
+
+    pSink->pCmds = (CommandBuffer*)arenaPushZero(pArena, sizeof(CommandBuffer) * TEXTURE_STREAM_MAX_BATCHES);
+    for(uint32 i = 0; i < TEXTURE_STREAM_MAX_BATCHES; i++)
+    {
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        ret = vkCreateFence(pRenderer->mVkDevice, &fenceInfo, NULL, &pSink->pCmds[i].mVkFence);
+        ASSERTVK(ret);
+        pSink->pCmds[i].mVkCmd = vkCommandBuffers[i];
+        pSink->pCmds[i].mState = COMMAND_BUFFER_IDLE;
+    }
+}
+
+void destroyRendererTextureSink(RendererTextureSink* pSink)
+{
+    ASSERT(pSink && pSink->pResMan);
+    Renderer* pRenderer = pSink->pResMan->pRenderer;
+
+    VkCommandBuffer vkCommandBuffers[TEXTURE_STREAM_MAX_BATCHES];
+    VkFence vkFences[TEXTURE_STREAM_MAX_BATCHES];
+    for(uint32 i = 0; i < TEXTURE_STREAM_MAX_BATCHES; i++)
+    {
+        vkCommandBuffers[i] = pSink->pCmds[i].mVkCmd;
+        vkFences[i] = pSink->pCmds[i].mVkFence;
+    }
+    VkResult ret = vkWaitForFences(pRenderer->mVkDevice, TEXTURE_STREAM_MAX_BATCHES, vkFences, VK_TRUE, MAX_UINT64);
+    ASSERTVK(ret);
+
+    for(uint32 i = 0; i < TEXTURE_STREAM_MAX_BATCHES; i++)
+    {
+        vkDestroyFence(pRenderer->mVkDevice, vkFences[i], NULL);
+    }
+    vkFreeCommandBuffers(pRenderer->mVkDevice, pRenderer->mVkCommandPool, TEXTURE_STREAM_MAX_BATCHES, vkCommandBuffers);
+
+    removeBuffer(pRenderer, &pSink->pStaging);
+    *pSink = {};
+}
+
+TextureStreamerDesc textureStreamerDesc(RendererTextureSink* pSink, JobSystem* pJobs, uint32 maxDecodes)
+{
+    ASSERT(pSink && pSink->pMapped);
+
+    TextureStreamerDesc desc = {};
+    desc.pJobs = pJobs;
+    desc.mSink.pUserData = pSink;
+    desc.mSink.pfnSubmit = rendererSinkSubmit;
+    desc.mSink.pfnIsComplete = rendererSinkIsComplete;
+    desc.pStaging = pSink->pMapped;
+    desc.mStagingSize = pSink->pStaging->mDesc.mSize;
+    desc.mMaxDecodes = maxDecodes;
+    return desc;
 }
@@ -6,16 +6,31 @@
 
 #include "shaderc/shaderc.h"
 #include "../core/memory.hpp"
+#include "../core/jobs.hpp"
+
+// In compileShader's cache key flags, above the shaderc optimization level
+#define SHADER_COMPILE_DEBUG_INFO BIT(16)
+
+struct ShaderIncludeContext
+{
+    Arena*          pArena      = NULL;
+    ShaderWatcher*  pWatcher    = NULL;     // Records the include edges when set
+};
 
 shaderc_include_result* resolveInclude(void* pUserData, const char* requested, int32 requestType,
         const char* requesting, size_t includeDepth)
 {
     ASSERT(requestType == shaderc_include_type_relative);
-    Arena* pArena = (Arena*)pUserData;
+    ShaderIncludeContext* pContext = (ShaderIncludeContext*)pUserData;
+    Arena* pArena = pContext->pArena;
 
     String assetDir = getFileDir(str(requesting), true);
     String assetName = join(pArena, assetDir, str(requested));
     String assetStr = readFileStr(pArena, assetName);
+    if(pContext->pWatcher)
+    {
+        addShaderDependency(pContext->pWatcher, assetName, str(requesting));
+    }
 
     shaderc_include_result result = {};
     result.source_name = cstr(assetName);
@@ -33,17 +48,83 @@ void releaseInclude(void* pUserData, shaderc_include_result* pResult)
 {
 }
 
-void loadShader(AssetManager* pAssetManager, Renderer* pRenderer, 
+void recordShaderInclude(void* pUserData, String file, String includer)
+{
+    addShaderDependency((ShaderWatcher*)pUserData, file, includer);
+}
+
+// --------------------------------------
+// Compilers
+ShaderCompiler* getShaderCompiler(AssetManager* pAssetManager)
+{
+    JobSystem* pJobs = pAssetManager->mDesc.pJobs;
+    uint32 index = pJobs ? getJobWorkerIndex(pJobs) : 0;
+    ASSERT(index < pAssetManager->mShaderCompilerCount);
+
+    // Only touched by its own worker, no lock needed
+    ShaderCompiler* pCompiler = &pAssetManager->pShaderCompilers[index];
+    if(!pCompiler->pCompiler)
+    {
+        pCompiler->pCompiler = shaderc_compiler_initialize();
+        initArena(SHADER_COMPILER_ARENA_SIZE, &pCompiler->mArena);
+        initArena(SHADER_COMPILER_ARENA_SIZE, &pCompiler->mOutput);
+    }
+    return pCompiler;
+}
+
+void destroyShaderCompilers(AssetManager* pAssetManager)
+{
+    ASSERT(pAssetManager);
+
+    for(uint32 i = 0; i < pAssetManager->mShaderCompilerCount; i++)
+    {
+        ShaderCompiler* pCompiler = &pAssetManager->pShaderCompilers[i];
+        if(!pCompiler->pCompiler) continue;
+        shaderc_compiler_release((shaderc_compiler_t)pCompiler->pCompiler);
+        destroyArena(&pCompiler->mArena);
+        destroyArena(&pCompiler->mOutput);
+        *pCompiler = {};
+    }
+}
+
+// --------------------------------------
+byte* compileShader(AssetManager* pAssetManager, 
         String path, 
         uint32 shaderType, String* pDefines, uint32 definesCount, 
-        Shader** ppOut)
+        Arena* pArena, uint64* pOutSize)
 {
-    ASSERT(pAssetManager && pRenderer && ppOut);
-    ASSERT(*ppOut == NULL);
+    ASSERT(pAssetManager && pArena && pOutSize);
     ASSERT(pathExists(path));
 
-    // Shader bytecode doesn't need to persist, using temp arena.
-    String code = readFileStr(&pAssetManager->mArenaTemp, path);
+#if DW_DEBUG
+    shaderc_optimization_level optimization = shaderc_optimization_level_zero;
+    uint32 compileFlags = (uint32)optimization | SHADER_COMPILE_DEBUG_INFO;
+#else
+    shaderc_optimization_level optimization = shaderc_optimization_level_performance;
+    uint32 compileFlags = (uint32)optimization;
+#endif
+
+    // Cache hits don't touch shaderc at all, the key's include scan records the
+    // dependencies instead of resolveInclude
+    ShaderWatcher* pWatcher = isShaderWatcherEnabled(&pAssetManager->mShaderWatcher)
+        ? &pAssetManager->mShaderWatcher
+        : NULL;
+    if(pWatcher) watchShaderSource(pWatcher, path);
+    ShaderCache* pCache = &pAssetManager->mShaderCache;
+    Hash128 key = {};
+    if(isShaderCacheEnabled(pCache))
+    {
+        key = computeShaderKey(path, shaderType, pDefines, definesCount, compileFlags,
+                pWatcher ? recordShaderInclude : NULL, pWatcher);
+        byte* pCached = lookupShaderCache(pCache, key, pArena, pOutSize);
+        if(pCached) return pCached;
+    }
+
+    // Shader source and includes don't need to persist, they go to the compiler's
+    // arena and are rolled back when the scope ends.
+    ShaderCompiler* pCompiler = getShaderCompiler(pAssetManager);
+    ARENA_SCOPE(&pCompiler->mArena);
+    String code = readFileStr(&pCompiler->mArena, path);
 
     ShaderType type = (ShaderType)shaderType;
     shaderc_shader_kind kind;
@@ -64,20 +145,20 @@ void loadShader(AssetManager* pAssetManager, Renderer* pRenderer,
         ASSERTF(0, "Unsupported shader type for shader %s", cstr(path));
     }
 
-    shaderc_compiler_t compiler = shaderc_compiler_initialize();
     shaderc_compile_options_t options = shaderc_compile_options_initialize();
-#if DW_DEBUG
-    shaderc_compile_options_set_generate_debug_info(options);
-    shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_zero);
-#else
-    shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);
-#endif
+    if(compileFlags & SHADER_COMPILE_DEBUG_INFO)
+    {
+        shaderc_compile_options_set_generate_debug_info(options);
+    }
+    shaderc_compile_options_set_optimization_level(options, optimization);
+    ShaderIncludeContext includeContext = {};
+    includeContext.pArena = &pCompiler->mArena;
+    includeContext.pWatcher = pWatcher;
     shaderc_compile_options_set_include_callbacks(
             options, 
             resolveInclude, 
             releaseInclude, 
-            &pAssetManager->mArenaTemp);
-
+            &includeContext);
     // Defining type of shader
     String typeStr = {};
     if(type == SHADER_TYPE_VERT)
@@ -98,19 +179,26 @@ void loadShader(AssetManager* pAssetManager, Renderer* pRenderer,
             typeStr.mLen, 
             "1", 1);
 
-    // Add user defined precompilation options
-    // TODO(caio): Add support for custom preprocessor macros
+    // Add user defined precompilation options, NAME=VALUE or just NAME (defined as 1)
     for(uint32 i = 0; i < definesCount; i++)
     {
+        String name = pDefines[i];
+        String value = str("1");
+        int64 equals = find(pDefines[i], '=');
+        if(equals != -1)
+        {
+            name = substr(pDefines[i], 0, equals);
+            value = substr(pDefines[i], equals + 1, pDefines[i].mLen - equals - 1);
+        }
         shaderc_compile_options_add_macro_definition(
                 options, 
-                cstr(pDefines[i]), 
-                pDefines[i].mLen, 
-                "1", 1);
+                cstr(name), 
+                name.mLen, 
+                cstr(value), value.mLen);
     }
 
     shaderc_compilation_result_t compiled = shaderc_compile_into_spv(
-            compiler,
+            (shaderc_compiler_t)pCompiler->pCompiler,
             cstr(code),
             code.mLen,
             kind,
@@ -120,23 +208,210 @@ void loadShader(AssetManager* pAssetManager, Renderer* pRenderer,
     uint64 errorCount = shaderc_result_get_num_errors(compiled);
     if(errorCount)
     {
+        // Not fatal, hot reload keeps the previous shader. First loads assert on NULL.
         LOGLF("SHADER COMPILE", "%s", shaderc_result_get_error_message(compiled));
-        ASSERT(0);
+        shaderc_result_release(compiled);
+        shaderc_compile_options_release(options);
+        return NULL;
     }
 
     // TODO_DW: Is there a way to hook arena with shaderc?
     uint64 bytecodeLen = shaderc_result_get_length(compiled);
     byte* bytecode = (byte*)shaderc_result_get_bytes(compiled);
 
+    byte* pBytecode = (byte*)arenaPushCopy(pArena, bytecodeLen, bytecode, bytecodeLen);
+    *pOutSize = bytecodeLen;
+
+    shaderc_result_release(compiled);
+    shaderc_compile_options_release(options);
+
+    if(isShaderCacheEnabled(pCache))
+    {
+        storeShaderCache(pCache, key, pBytecode, bytecodeLen);
+    }
+    return pBytecode;
+}
+
+struct ShaderCompileJob
+{
+    AssetManager*       pAssetManager   = NULL;
+    ShaderCompileDesc   mDesc           = {};
+    ShaderBlob          mBlob           = {};   // In the worker's output arena
+};
+
+void shaderCompileProc(void* pData)
+{
+    ShaderCompileJob* pJob = (ShaderCompileJob*)pData;
+    ShaderCompiler* pCompiler = getShaderCompiler(pJob->pAssetManager);
+    ShaderCompileDesc* pDesc = &pJob->mDesc;
+    pJob->mBlob.pSpirv = compileShader(pJob->pAssetManager,
+            pDesc->mPath,
+            pDesc->mType, pDesc->pDefines, pDesc->mDefinesCount,
+            &pCompiler->mOutput, &pJob->mBlob.mSize);
+}
+
+uint32 compileShaders(AssetManager* pAssetManager, ShaderCompileDesc* pDescs, uint32 count,
+        Arena* pArena, ShaderBlob* pOut)
+{
+    ASSERT(pAssetManager && pArena && pOut);
+    ASSERT(pDescs || !count);
+    if(!count) return 0;
+
+    JobSystem* pJobs = pAssetManager->mDesc.pJobs;
+    ScratchScope scratch(pArena);
+    ShaderCompileJob* pCompileJobs = (ShaderCompileJob*)arenaPush(scratch.pArena, count * sizeof(ShaderCompileJob),
+            alignof(ShaderCompileJob));
+    JobCounter counter = {};
+    for(uint32 i = 0; i < count; i++)
+    {
+        pCompileJobs[i] = {};
+        pCompileJobs[i].pAssetManager = pAssetManager;
+        pCompileJobs[i].mDesc = pDescs[i];
+        if(pJobs)
+        {
+            runJob(pJobs, shaderCompileProc, &pCompileJobs[i], &counter);
+        }
+        else
+        {
+            shaderCompileProc(&pCompileJobs[i]);
+        }
+    }
+    if(pJobs) waitJobs(pJobs, &counter);
+
+    // Workers compiled into their own arenas, the blobs are gathered in pArena and
+    // the worker arenas emptied for the next batch
+    uint32 compiled = 0;
+    for(uint32 i = 0; i < count; i++)
+    {
+        ShaderBlob blob = pCompileJobs[i].mBlob;
+        pOut[i] = {};
+        if(!blob.pSpirv) continue;
+        pOut[i].pSpirv = (byte*)arenaPush(pArena, blob.mSize, alignof(uint32));
+        memcpy(pOut[i].pSpirv, blob.pSpirv, blob.mSize);
+        pOut[i].mSize = blob.mSize;
+        compiled++;
+    }
+    for(uint32 i = 0; i < pAssetManager->mShaderCompilerCount; i++)
+    {
+        ShaderCompiler* pCompiler = &pAssetManager->pShaderCompilers[i];
+        if(pCompiler->pCompiler) arenaClear(&pCompiler->mOutput);
+    }
+    return compiled;
+}
+
+void loadShader(AssetManager* pAssetManager, Renderer* pRenderer, 
+        String path, 
+        uint32 shaderType, String* pDefines, uint32 definesCount, 
+        Shader** ppOut)
+{
+    ASSERT(pAssetManager && pRenderer && ppOut);
+    ASSERT(*ppOut == NULL);
+
+    ScratchScope scratch;
+    uint64 bytecodeLen = 0;
+    byte* bytecode = compileShader(pAssetManager, path, shaderType, pDefines, definesCount, scratch.pArena, &bytecodeLen);
+    ASSERT(bytecode);
+
     ShaderDesc desc = {};
-    desc.mType = type;
+    desc.mType = (ShaderType)shaderType;
     desc.mBytecodeSize = bytecodeLen;
     desc.pBytecode = (uint32*)bytecode;
     addShader(pRenderer, desc, ppOut);
+}
 
-    shaderc_result_release(compiled);
-    shaderc_compile_options_release(options);
-    shaderc_compiler_release(compiler);
+void loadShaders(AssetManager* pAssetManager, Renderer* pRenderer,
+        ShaderCompileDesc* pDescs, uint32 count,
+        Shader** ppOut)
+{
+    ASSERT(pAssetManager && pRenderer && ppOut);
+    if(!count) return;
+
+    ScratchScope scratch;
+    ShaderBlob* pBlobs = (ShaderBlob*)arenaPush(scratch.pArena, count * sizeof(ShaderBlob), alignof(ShaderBlob));
+    uint32 compiled = compileShaders(pAssetManager, pDescs, count, scratch.pArena, pBlobs);
+    ASSERT(compiled == count);
+
+    for(uint32 i = 0; i < count; i++)
+    {
+        ASSERT(ppOut[i] == NULL);
+        ShaderDesc desc = {};
+        desc.mType = (ShaderType)pDescs[i].mType;
+        desc.mBytecodeSize = pBlobs[i].mSize;
+        desc.pBytecode = (uint32*)pBlobs[i].pSpirv;
+        addShader(pRenderer, desc, &ppOut[i]);
+    }
+}
+
+uint32 recompileChangedShaders(AssetManager* pAssetManager, ShaderCompileDesc* pDescs, uint32 count,
+        Arena* pArena, ShaderBlob* pOut)
+{
+    ASSERT(pAssetManager && pArena && pOut);
+    ASSERT(pDescs || !count);
+    ASSERT(isShaderWatcherEnabled(&pAssetManager->mShaderWatcher));
+
+    for(uint32 i = 0; i < count; i++)
+    {
+        pOut[i] = {};
+    }
+    ScratchScope scratch(pArena);
+    String* pChanged = NULL;
+    uint32 changedCount = updateShaderWatcher(&pAssetManager->mShaderWatcher, scratch.pArena, &pChanged);
+    if(!changedCount || !count) return 0;
+
+    // Every permutation of a changed source is recompiled
+    ShaderCompileDesc* pBatch = (ShaderCompileDesc*)arenaPush(scratch.pArena, count * sizeof(ShaderCompileDesc), alignof(ShaderCompileDesc));
+    uint32* pIndices = (uint32*)arenaPush(scratch.pArena, count * sizeof(uint32), alignof(uint32));
+    uint32 batchCount = 0;
+    for(uint32 i = 0; i < count; i++)
+    {
+        for(uint32 j = 0; j < changedCount; j++)
+        {
+            if(pDescs[i].mPath != pChanged[j]) continue;
+            pBatch[batchCount] = pDescs[i];
+            pIndices[batchCount++] = i;
+            break;
+        }
+    }
+    if(!batchCount) return 0;
+
+    ShaderBlob* pBlobs = (ShaderBlob*)arenaPush(scratch.pArena, batchCount * sizeof(ShaderBlob), alignof(ShaderBlob));
+    uint32 compiled = compileShaders(pAssetManager, pBatch, batchCount, pArena, pBlobs);
+    for(uint32 i = 0; i < batchCount; i++)
+    {
+        if(!pBlobs[i].pSpirv)
+        {
+            LOGLF("SHADER RELOAD", "%.*s doesn't compile, keeping the previous shader",
+                    (int32)pBatch[i].mPath.mLen, pBatch[i].mPath.mData);
+            continue;
+        }
+        pOut[pIndices[i]] = pBlobs[i];
+    }
+    return compiled;
+}
 
-    arenaClear(&pAssetManager->mArenaTemp);
+uint32 reloadShaders(AssetManager* pAssetManager, Renderer* pRenderer,
+        ShaderCompileDesc* pDescs, uint32 count,
+        Shader** ppShaders, bool* pOutReloaded)
+{
+    ASSERT(pAssetManager && pRenderer && ppShaders);
+
+    if(pOutReloaded) memset(pOutReloaded, 0, count * sizeof(bool));
+    if(!count) return 0;
+
+    ScratchScope scratch;
+    ShaderBlob* pBlobs = (ShaderBlob*)arenaPush(scratch.pArena, count * sizeof(ShaderBlob), alignof(ShaderBlob));
+    uint32 reloaded = recompileChangedShaders(pAssetManager, pDescs, count, scratch.pArena, pBlobs);
+    for(uint32 i = 0; reloaded && i < count; i++)
+    {
+        if(!pBlobs[i].pSpirv) continue;
+        if(ppShaders[i]) removeShader(pRenderer, &ppShaders[i]);
+
+        ShaderDesc desc = {};
+        desc.mType = (ShaderType)pDescs[i].mType;
+        desc.mBytecodeSize = pBlobs[i].mSize;
+        desc.pBytecode = (uint32*)pBlobs[i].pSpirv;
+        addShader(pRenderer, desc, &ppShaders[i]);
+        if(pOutReloaded) pOutReloaded[i] = true;
+    }
+    return reloaded;
 }
@@ -0,0 +1,353 @@
+#include "shader_cache.hpp"
+#include "../core/array.hpp"
+#include "../core/file.hpp"
+#include "../core/thread.hpp"
+#include "../core/debug.hpp"
+
+struct ShaderCacheIndexHeader
+{
+    uint32  mMagic      = SHADER_CACHE_INDEX_MAGIC;
+    uint32  mVersion    = SHADER_CACHE_VERSION;
+    uint32  mCount      = 0;
+    uint32  mPadding    = 0;
+    uint64  mClock      = 0;
+};
+
+// --------------------------------------
+// Keys
+// Every part is hashed on its own and the digests are hashed together, so part
+// boundaries are part of the key and files don't need to be copied into one buffer.
+// A full digest buffer is folded into its first slot.
+#define SHADER_KEY_PARTS 64
+
+struct ShaderKeyHasher
+{
+    Hash128 mParts[SHADER_KEY_PARTS];
+    uint32  mCount  = 0;
+
+    ShaderIncludeCallback   pfnInclude  = NULL;
+    void*                   pUserData   = NULL;
+};
+
+void addShaderKeyPart(ShaderKeyHasher* pHasher, void* pData, uint64 size)
+{
+    if(pHasher->mCount == SHADER_KEY_PARTS)
+    {
+        pHasher->mParts[0] = hash128((byte*)pHasher->mParts, sizeof(pHasher->mParts));
+        pHasher->mCount = 1;
+    }
+    pHasher->mParts[pHasher->mCount++] = hash128((byte*)pData, size);
+}
+
+// Returns the quoted name of an #include directive starting at pLine, an empty string otherwise
+String parseShaderInclude(byte* pLine, byte* pEnd)
+{
+    byte* p = pLine;
+    while(p < pEnd && (*p == ' ' || *p == '\t')) p++;
+    if(p == pEnd || *p != '#') return {};
+    p++;
+    while(p < pEnd && (*p == ' ' || *p == '\t')) p++;
+    const uint64 directiveLen = sizeof("include") - 1;
+    if((uint64)(pEnd - p) < directiveLen || memcmp(p, "include", directiveLen) != 0) return {};
+    p += directiveLen;
+    while(p < pEnd && (*p == ' ' || *p == '\t')) p++;
+    if(p == pEnd || *p != '"') return {};
+    byte* pName = ++p;
+    while(p < pEnd && *p != '"' && *p != '\n') p++;
+    if(p == pEnd || *p != '"') return {};
+    return str(pName, p - pName);
+}
+
+// Adds the file and, depth first, every file it includes, resolved like the compiler
+// does (relative to the including file). Includes inside comments or disabled #if
+// blocks are hashed too, which can only cause extra misses. Files already hashed are
+// skipped, that also ends include cycles. There's no limit on the files, a file left
+// out would turn its edits into stale hits.
+void addShaderKeyFile(ShaderKeyHasher* pHasher, Arena* pArena, String path, DynArray<String>* pVisited)
+{
+    for(uint64 i = 0; i < pVisited->mCount; i++)
+    {
+        if((*pVisited)[i] == path) return;
+    }
+    addShaderKeyPart(pHasher, path.mData, path.mLen);
+    pVisited->push(path);
+
+    if(!pathExists(path))
+    {
+        // Can't be compiled either, but may be created later
+        uint32 missing = MAX_UINT32;
+        addShaderKeyPart(pHasher, &missing, sizeof(missing));
+        return;
+    }
+
+    FileView file = {};
+    bool mapped = mapFile(path, &file);
+    ASSERT(mapped);
+    if(file.mSize) addShaderKeyPart(pHasher, file.pData, file.mSize);
+
+    String dir = getFileDir(path, true);
+    byte* pEnd = file.pData + file.mSize;
+    for(byte* pLine = file.pData; pLine < pEnd;)
+    {
+        String name = parseShaderInclude(pLine, pEnd);
+        if(name.mLen)
+        {
+            String includePath = join(pArena, dir, name);
+            if(pHasher->pfnInclude) pHasher->pfnInclude(pHasher->pUserData, includePath, path);
+            addShaderKeyFile(pHasher, pArena, includePath, pVisited);
+        }
+        while(pLine < pEnd && *pLine != '\n') pLine++;
+        pLine++;
+    }
+    unmapFile(&file);
+}
+
+Hash128 computeShaderKey(String path, uint32 shaderType, String* pDefines, uint32 definesCount, uint32 compileFlags,
+        ShaderIncludeCallback pfnInclude, void* pUserData)
+{
+    ScratchScope scratch;
+    ShaderKeyHasher hasher = {};
+    hasher.pfnInclude = pfnInclude;
+    hasher.pUserData = pUserData;
+
+    uint32 header[] = { SHADER_CACHE_VERSION, shaderType, compileFlags, definesCount };
+    addShaderKeyPart(&hasher, header, sizeof(header));
+    for(uint32 i = 0; i < definesCount; i++)
+    {
+        addShaderKeyPart(&hasher, pDefines[i].mData, pDefines[i].mLen);
+    }
+
+    DynArray<String> visited = dynArray<String>(scratch.pArena);
+    addShaderKeyFile(&hasher, scratch.pArena, path, &visited);
+
+    return hash128((byte*)hasher.mParts, hasher.mCount * sizeof(Hash128));
+}
+
+// --------------------------------------
+// Entries
+String getShaderCachePath(ShaderCache* pCache, Hash128 key, Arena* pArena)
+{
+    return strf(pArena, "%.*s/%016llx%016llx.spv", (int32)pCache->mDirLen, pCache->mDir, key.mHigh, key.mLow);
+}
+
+String getShaderCacheIndexPath(ShaderCache* pCache, Arena* pArena)
+{
+    return strf(pArena, "%.*s/index.bin", (int32)pCache->mDirLen, pCache->mDir);
+}
+
+ShaderCacheEntry* findShaderCacheEntry(ShaderCache* pCache, Hash128 key)
+{
+    for(uint32 i = 0; i < pCache->mEntryCount; i++)
+    {
+        if(pCache->pEntries[i].mKey == key) return &pCache->pEntries[i];
+    }
+    return NULL;
+}
+
+void removeShaderCacheEntry(ShaderCache* pCache, ShaderCacheEntry* pEntry, bool deleteEntryFile)
+{
+    if(deleteEntryFile)
+    {
+        ScratchScope scratch;
+        String path = getShaderCachePath(pCache, pEntry->mKey, scratch.pArena);
+        if(pathExists(path)) deleteFile(path);
+    }
+    pCache->mTotalSize -= pEntry->mSize;
+    *pEntry = pCache->pEntries[--pCache->mEntryCount];
+}
+
+void touchShaderCacheEntry(ShaderCache* pCache, Hash128 key, uint64 fileSize)
+{
+    ShaderCacheEntry* pEntry = findShaderCacheEntry(pCache, key);
+    if(!pEntry)
+    {
+        ASSERT(pCache->mEntryCount < SHADER_CACHE_MAX_ENTRIES);
+        pEntry = &pCache->pEntries[pCache->mEntryCount++];
+        pEntry->mKey = key;
+        pEntry->mSize = 0;
+    }
+    pCache->mTotalSize += fileSize - pEntry->mSize;
+    pEntry->mSize = fileSize;
+    pEntry->mLastUsed = ++pCache->mClock;
+}
+
+// Deletes least recently used entries until the cache fits in mMaxSize and has room
+// for one more entry. The entry for keep stays, even alone over the limit.
+void pruneShaderCache(ShaderCache* pCache, Hash128 keep)
+{
+    while(pCache->mTotalSize > pCache->mMaxSize || pCache->mEntryCount == SHADER_CACHE_MAX_ENTRIES)
+    {
+        ShaderCacheEntry* pOldest = NULL;
+        for(uint32 i = 0; i < pCache->mEntryCount; i++)
+        {
+            ShaderCacheEntry* pEntry = &pCache->pEntries[i];
+            if(pEntry->mKey == keep) continue;
+            if(!pOldest || pEntry->mLastUsed < pOldest->mLastUsed) pOldest = pEntry;
+        }
+        if(!pOldest) break;
+        removeShaderCacheEntry(pCache, pOldest, true);
+        pCache->mStats.mEvictions++;
+    }
+}
+
+// --------------------------------------
+void initShaderCache(ShaderCacheDesc desc, ShaderCache* pCache)
+{
+    ASSERT(pCache);
+    ASSERT(desc.mDir.mLen > 0 && desc.mDir.mLen < SHADER_CACHE_MAX_PATH);
+
+    *pCache = {};
+    memcpy(pCache->mDir, desc.mDir.mData, desc.mDir.mLen);
+    pCache->mDir[desc.mDir.mLen] = 0;
+    pCache->mDirLen = (uint32)desc.mDir.mLen;
+    pCache->mMaxSize = desc.mMaxSize;
+    initArena(SHADER_CACHE_MAX_ENTRIES * sizeof(ShaderCacheEntry), &pCache->mArena);
+    pCache->pEntries = (ShaderCacheEntry*)arenaPushZero(&pCache->mArena, SHADER_CACHE_MAX_ENTRIES * sizeof(ShaderCacheEntry),
+            alignof(ShaderCacheEntry));
+
+    String dir = str(pCache->mDir);
+    if(!pathExists(dir))
+    {
+        createDir(dir);
+        return;
+    }
+
+    ScratchScope scratch;
+    FileView index = {};
+    if(!mapFile(getShaderCacheIndexPath(pCache, scratch.pArena), &index)) return;
+
+    ShaderCacheIndexHeader* pHeader = (ShaderCacheIndexHeader*)index.pData;
+    if(index.mSize >= sizeof(ShaderCacheIndexHeader)
+            && pHeader->mMagic == SHADER_CACHE_INDEX_MAGIC
+            && pHeader->mVersion == SHADER_CACHE_VERSION
+            && pHeader->mCount <= SHADER_CACHE_MAX_ENTRIES
+            && index.mSize == sizeof(ShaderCacheIndexHeader) + pHeader->mCount * sizeof(ShaderCacheEntry))
+    {
+        memcpy(pCache->pEntries, index.pData + sizeof(ShaderCacheIndexHeader), pHeader->mCount * sizeof(ShaderCacheEntry));
+        pCache->mEntryCount = pHeader->mCount;
+        pCache->mClock = pHeader->mClock;
+        for(uint32 i = 0; i < pCache->mEntryCount; i++)
+        {
+            pCache->mTotalSize += pCache->pEntries[i].mSize;
+        }
+    }
+    unmapFile(&index);
+}
+
+void destroyShaderCache(ShaderCache* pCache)
+{
+    ASSERT(pCache);
+    ASSERT(isShaderCacheEnabled(pCache));
+
+    // Written aside and moved over the old index, a crash leaves one of the two whole
+    ScratchScope scratch;
+    uint64 size = sizeof(ShaderCacheIndexHeader) + pCache->mEntryCount * sizeof(ShaderCacheEntry);
+    byte* pIndex = (byte*)arenaPush(scratch.pArena, size);
+    ShaderCacheIndexHeader header = {};
+    header.mCount = pCache->mEntryCount;
+    header.mClock = pCache->mClock;
+    memcpy(pIndex, &header, sizeof(header));
+    memcpy(pIndex + sizeof(header), pCache->pEntries, pCache->mEntryCount * sizeof(ShaderCacheEntry));
+
+    String indexPath = getShaderCacheIndexPath(pCache, scratch.pArena);
+    String tempPath = join(scratch.pArena, indexPath, str(".tmp"));
+    if(writeFile(tempPath, pIndex, size) == size) moveFile(tempPath, indexPath);
+
+    destroyArena(&pCache->mArena);
+    *pCache = {};
+}
+
+bool isShaderCacheEnabled(ShaderCache* pCache)
+{
+    ASSERT(pCache);
+    return pCache->pEntries != NULL;
+}
+
+byte* lookupShaderCache(ShaderCache* pCache, Hash128 key, Arena* pArena, uint64* pOutSize)
+{
+    ASSERT(pCache && pArena && pOutSize);
+    ASSERT(isShaderCacheEnabled(pCache));
+
+    // The file is read and checked outside the lock, only the index is shared
+    ScratchScope scratch(pArena);
+    String path = getShaderCachePath(pCache, key, scratch.pArena);
+    FileView file = {};
+    bool mapped = pathExists(path) && mapFile(path, &file, FILE_ACCESS_RANDOM);
+    ShaderCacheFileHeader* pHeader = (ShaderCacheFileHeader*)file.pData;
+    byte* pSpirv = file.pData + sizeof(ShaderCacheFileHeader);
+    bool valid = mapped
+        && file.mSize > sizeof(ShaderCacheFileHeader)
+        && pHeader->mMagic == SHADER_CACHE_MAGIC
+        && pHeader->mVersion == SHADER_CACHE_VERSION
+        && pHeader->mKey == key
+        && pHeader->mSize == file.mSize - sizeof(ShaderCacheFileHeader)
+        && pHeader->mChecksum == hash128(pSpirv, pHeader->mSize).mLow;
+
+    byte* pOut = NULL;
+    uint64 fileSize = file.mSize;
+    if(valid)
+    {
+        pOut = (byte*)arenaPushCopy(pArena, pHeader->mSize, pSpirv, pHeader->mSize);
+        *pOutSize = pHeader->mSize;
+    }
+    if(mapped) unmapFile(&file);
+    if(mapped && !valid) deleteFile(path);
+
+    spinLock(&pCache->mLock);
+    ShaderCacheEntry* pEntry = findShaderCacheEntry(pCache, key);
+    if(valid)
+    {
+        // Files the index lost track of are picked up again here
+        touchShaderCacheEntry(pCache, key, fileSize);
+        pCache->mStats.mHits++;
+    }
+    else
+    {
+        if(pEntry) removeShaderCacheEntry(pCache, pEntry, false);
+        if(mapped) pCache->mStats.mRejected++;
+        pCache->mStats.mMisses++;
+    }
+    spinUnlock(&pCache->mLock);
+    return pOut;
+}
+
+void storeShaderCache(ShaderCache* pCache, Hash128 key, byte* pSpirv, uint64 size)
+{
+    ASSERT(pCache && pSpirv && size > 0);
+    ASSERT(isShaderCacheEnabled(pCache));
+
+    ScratchScope scratch;
+    uint64 fileSize = sizeof(ShaderCacheFileHeader) + size;
+    byte* pFile = (byte*)arenaPush(scratch.pArena, fileSize);
+    ShaderCacheFileHeader header = {};
+    header.mKey = key;
+    header.mSize = size;
+    header.mChecksum = hash128(pSpirv, size).mLow;
+    memcpy(pFile, &header, sizeof(header));
+    memcpy(pFile + sizeof(header), pSpirv, size);
+
+    // Written aside and moved in place, so readers never see a partial file
+    String path = getShaderCachePath(pCache, key, scratch.pArena);
+    uint32 tempIndex = atomicAdd(&pCache->mTempCount, 1u);
+    String tempPath = strf(scratch.pArena, "%.*s.%u.tmp", (int32)path.mLen, cstr(path), tempIndex);
+    if(writeFile(tempPath, pFile, fileSize) != fileSize || !moveFile(tempPath, path)) return;
+
+    spinLock(&pCache->mLock);
+    pruneShaderCache(pCache, key);     // Room for the entry
+    touchShaderCacheEntry(pCache, key, fileSize);
+    pruneShaderCache(pCache, key);
+    pCache->mStats.mStores++;
+    spinUnlock(&pCache->mLock);
+}
+
+void clearShaderCache(ShaderCache* pCache)
+{
+    ASSERT(pCache);
+    ASSERT(isShaderCacheEnabled(pCache));
+
+    while(pCache->mEntryCount)
+    {
+        removeShaderCacheEntry(pCache, &pCache->pEntries[pCache->mEntryCount - 1], true);
+    }
+    ASSERT(pCache->mTotalSize == 0);
+}
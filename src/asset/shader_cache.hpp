@@ -0,0 +1,89 @@
+#pragma once
+#include "../core/base.hpp"
+#include "../core/memory.hpp"
+#include "../core/string.hpp"
+
+// SPIR-V shader cache
+// Compiled shaders stored on disk, one file per key. Keys hash everything the compile
+// depends on: the source and every file it #includes (found by scanning, recursively),
+// the defines, the shader type and the compile options. Editing any of them gives a new
+// key, so stale entries are never returned, they just age out. Files are checked against
+// their header and checksum when read, damaged ones are deleted and count as misses.
+//
+// An index of entries by last use is kept in the directory, once the cache holds more
+// than mMaxSize the least recently used entries are deleted. Bump SHADER_CACHE_VERSION
+// when the compiler or the key layout changes, it's part of every key.
+// Lookups and stores can run on any thread, init, destroy and clear can't.
+#define SHADER_CACHE_MAGIC          0x43535744      // "DWSC"
+#define SHADER_CACHE_INDEX_MAGIC    0x49535744      // "DWSI"
+#define SHADER_CACHE_VERSION        1
+#define SHADER_CACHE_MAX_ENTRIES    4096
+#define SHADER_CACHE_MAX_PATH       260
+
+struct ShaderCacheFileHeader
+{
+    uint32  mMagic      = SHADER_CACHE_MAGIC;
+    uint32  mVersion    = SHADER_CACHE_VERSION;
+    Hash128 mKey        = {};
+    uint64  mSize       = 0;
+    uint64  mChecksum   = 0;    // Of the SPIR-V following the header
+};
+
+struct ShaderCacheEntry
+{
+    Hash128 mKey        = {};
+    uint64  mSize       = 0;    // Of the file
+    uint64  mLastUsed   = 0;    // Cache clock
+};
+
+struct ShaderCacheDesc
+{
+    String  mDir        = {};           // Created if missing, not nested
+    uint64  mMaxSize    = MB(64);
+};
+
+struct ShaderCacheStats
+{
+    uint64  mHits       = 0;
+    uint64  mMisses     = 0;
+    uint64  mStores     = 0;
+    uint64  mEvictions  = 0;
+    uint64  mRejected   = 0;    // Damaged files
+};
+
+struct ShaderCache
+{
+    char    mDir[SHADER_CACHE_MAX_PATH];
+    uint32  mDirLen         = 0;
+    uint64  mMaxSize        = 0;
+
+    // Looked up linearly, a project has a few hundred shader variants at most
+    ShaderCacheEntry*   pEntries    = NULL;     // SHADER_CACHE_MAX_ENTRIES
+    uint32  mEntryCount     = 0;
+    uint64  mTotalSize      = 0;
+    uint64  mClock          = 0;
+    Arena   mArena          = {};
+
+    ShaderCacheStats mStats = {};
+
+    uint32  mLock           = 0;    // Guards the entries, clock and stats
+    uint32  mTempCount      = 0;    // Names temp files, concurrent stores of one key don't share one
+};
+
+// Loads the index from desc.mDir, starting empty when it's missing or invalid.
+void    initShaderCache(ShaderCacheDesc desc, ShaderCache* pCache);
+void    destroyShaderCache(ShaderCache* pCache);    // Writes the index
+bool    isShaderCacheEnabled(ShaderCache* pCache);
+
+// Called for every #include found while computing a key, with the resolved path of the
+// included file and the path of the file including it.
+typedef void (*ShaderIncludeCallback)(void* pUserData, String file, String includer);
+
+// compileFlags holds anything else that changes the output, like optimization level.
+Hash128 computeShaderKey(String path, uint32 shaderType, String* pDefines, uint32 definesCount, uint32 compileFlags,
+        ShaderIncludeCallback pfnInclude = NULL, void* pUserData = NULL);
+
+// Returns the SPIR-V in pArena, NULL on a miss.
+byte*   lookupShaderCache(ShaderCache* pCache, Hash128 key, Arena* pArena, uint64* pOutSize);
+void    storeShaderCache(ShaderCache* pCache, Hash128 key, byte* pSpirv, uint64 size);
+void    clearShaderCache(ShaderCache* pCache);      // Deletes every entry
@@ -0,0 +1,226 @@
+#include "shader_permutation.hpp"
+#include "asset.hpp"
+#include "../render/shader.hpp"
+#include "../render/render.hpp"
+#include "../core/debug.hpp"
+
+uint32 getShaderKeyBits(uint32 valueCount)
+{
+    return 32 - __builtin_clz(valueCount - 1);
+}
+
+void initShaderPermutation(ShaderPermutationDesc desc, ShaderPermutation* pPermutation)
+{
+    ASSERT(pPermutation);
+    ASSERT(desc.mPath.mLen);
+    ASSERT(desc.mKeyCount <= SHADER_PERMUTATION_MAX_KEYS);
+    ASSERT(desc.pKeys || !desc.mKeyCount);
+
+    *pPermutation = {};
+    initArena(MB(1), &pPermutation->mArena);
+    Arena* pArena = &pPermutation->mArena;
+    pPermutation->mDesc = desc;
+    pPermutation->mDesc.mPath = str(pArena, desc.mPath);
+    if(desc.mKeyCount)
+    {
+        pPermutation->mDesc.pKeys = (ShaderPermutationKey*)arenaPush(pArena,
+                desc.mKeyCount * sizeof(ShaderPermutationKey), alignof(ShaderPermutationKey));
+    }
+
+    uint32 shift = 0;
+    uint64 variantCount = 1;
+    for(uint32 i = 0; i < desc.mKeyCount; i++)
+    {
+        ShaderPermutationKey* pKey = &pPermutation->mDesc.pKeys[i];
+        ASSERT(desc.pKeys[i].mName.mLen && desc.pKeys[i].mValueCount >= 2);
+        pKey->mName = str(pArena, desc.pKeys[i].mName);
+        pKey->mValueCount = desc.pKeys[i].mValueCount;
+        pPermutation->mShifts[i] = shift;
+        shift += getShaderKeyBits(pKey->mValueCount);
+        variantCount *= pKey->mValueCount;
+    }
+    ASSERTF(shift <= SHADER_VARIANT_MAX_BITS, "Too many permutation keys for %s", cstr(pPermutation->mDesc.mPath));
+    pPermutation->mIdBits = shift;
+    pPermutation->mVariantCount = variantCount;
+
+    pPermutation->mVariants = hashmap<ShaderVariantId, Shader*>(pArena, 64);
+    pPermutation->pCompiled = (ShaderVariantId*)arenaPush(pArena,
+            SHADER_VARIANT_MAX_COUNT * sizeof(ShaderVariantId), alignof(ShaderVariantId));
+}
+
+void destroyShaderPermutation(Renderer* pRenderer, ShaderPermutation* pPermutation)
+{
+    ASSERT(pPermutation);
+    ASSERT(pRenderer || !pPermutation->mCompiledCount);
+
+    for(uint32 i = 0; i < pPermutation->mCompiledCount; i++)
+    {
+        Shader* pShader = pPermutation->mVariants[pPermutation->pCompiled[i]];
+        removeShader(pRenderer, &pShader);
+    }
+    destroyArena(&pPermutation->mArena);
+    *pPermutation = {};
+}
+
+ShaderVariantId shaderVariantId(ShaderPermutation* pPermutation, uint32* pValues)
+{
+    ASSERT(pPermutation);
+    ASSERT(pValues || !pPermutation->mDesc.mKeyCount);
+
+    ShaderVariantId id = 0;
+    for(uint32 i = 0; i < pPermutation->mDesc.mKeyCount; i++)
+    {
+        id = setShaderVariantKey(pPermutation, id, i, pValues[i]);
+    }
+    return id;
+}
+
+ShaderVariantId setShaderVariantKey(ShaderPermutation* pPermutation, ShaderVariantId id, uint32 key, uint32 value)
+{
+    ASSERT(pPermutation);
+    ASSERT(key < pPermutation->mDesc.mKeyCount);
+    ASSERT(value < pPermutation->mDesc.pKeys[key].mValueCount);
+
+    uint32 shift = pPermutation->mShifts[key];
+    uint32 mask = ((1u << getShaderKeyBits(pPermutation->mDesc.pKeys[key].mValueCount)) - 1) << shift;
+    return (id & ~mask) | (value << shift);
+}
+
+uint32 getShaderVariantKey(ShaderPermutation* pPermutation, ShaderVariantId id, uint32 key)
+{
+    ASSERT(pPermutation);
+    ASSERT(key < pPermutation->mDesc.mKeyCount);
+
+    uint32 mask = (1u << getShaderKeyBits(pPermutation->mDesc.pKeys[key].mValueCount)) - 1;
+    return (id >> pPermutation->mShifts[key]) & mask;
+}
+
+uint32 getShaderVariantDefines(ShaderPermutation* pPermutation, ShaderVariantId id, Arena* pArena, String** ppOut)
+{
+    ASSERT(pPermutation && pArena && ppOut);
+
+    uint32 keyCount = pPermutation->mDesc.mKeyCount;
+    String* pDefines = (String*)arenaPush(pArena, (keyCount + 1) * sizeof(String), alignof(String));
+    uint32 count = 0;
+    for(uint32 i = 0; i < keyCount; i++)
+    {
+        ShaderPermutationKey* pKey = &pPermutation->mDesc.pKeys[i];
+        uint32 value = getShaderVariantKey(pPermutation, id, i);
+        ASSERT(value < pKey->mValueCount);
+        if(pKey->mValueCount == 2)
+        {
+            if(value) pDefines[count++] = pKey->mName;
+            continue;
+        }
+        pDefines[count++] = strf(pArena, "%.*s=%u", (int32)pKey->mName.mLen, cstr(pKey->mName), value);
+    }
+    *ppOut = pDefines;
+    return count;
+}
+
+bool isShaderVariantValid(ShaderPermutation* pPermutation, ShaderVariantId id)
+{
+    ASSERT(pPermutation);
+    if(id >> pPermutation->mIdBits) return false;
+    for(uint32 i = 0; i < pPermutation->mDesc.mKeyCount; i++)
+    {
+        if(getShaderVariantKey(pPermutation, id, i) >= pPermutation->mDesc.pKeys[i].mValueCount) return false;
+    }
+    return true;
+}
+
+void addShaderVariant(ShaderPermutation* pPermutation, ShaderVariantId id, Shader* pShader)
+{
+    ASSERTF(pPermutation->mCompiledCount < SHADER_VARIANT_MAX_COUNT, "Too many variants of %s", cstr(pPermutation->mDesc.mPath));
+    pPermutation->mVariants.insert(id, pShader);
+    pPermutation->pCompiled[pPermutation->mCompiledCount++] = id;
+}
+
+void compileShaderVariants(AssetManager* pAssetManager, Renderer* pRenderer, ShaderPermutation* pPermutation,
+        ShaderVariantId* pIds, uint32 count)
+{
+    ASSERT(pAssetManager && pRenderer && pPermutation);
+
+    ScratchScope scratch;
+    if(!pIds)
+    {
+        // Every ID of the domain, values counted like digits of a mixed radix number
+        ASSERT(pPermutation->mVariantCount <= SHADER_VARIANT_MAX_COUNT);
+        count = (uint32)pPermutation->mVariantCount;
+        pIds = (ShaderVariantId*)arenaPush(scratch.pArena, count * sizeof(ShaderVariantId), alignof(ShaderVariantId));
+        uint32 values[SHADER_PERMUTATION_MAX_KEYS] = {};
+        for(uint32 i = 0; i < count; i++)
+        {
+            pIds[i] = shaderVariantId(pPermutation, values);
+            for(uint32 key = 0; key < pPermutation->mDesc.mKeyCount; key++)
+            {
+                if(++values[key] < pPermutation->mDesc.pKeys[key].mValueCount) break;
+                values[key] = 0;
+            }
+        }
+    }
+    if(!count) return;
+
+    ShaderCompileDesc* pDescs = (ShaderCompileDesc*)arenaPush(scratch.pArena,
+            count * sizeof(ShaderCompileDesc), alignof(ShaderCompileDesc));
+    ShaderVariantId* pBatchIds = (ShaderVariantId*)arenaPush(scratch.pArena,
+            count * sizeof(ShaderVariantId), alignof(ShaderVariantId));
+    uint32 batchCount = 0;
+    for(uint32 i = 0; i < count; i++)
+    {
+        ShaderVariantId id = pIds[i];
+        ASSERT(isShaderVariantValid(pPermutation, id));
+        if(pPermutation->mVariants.contains(id)) continue;
+
+        // The same ID listed twice is compiled once
+        bool listed = false;
+        for(uint32 j = 0; j < batchCount && !listed; j++)
+        {
+            listed = pBatchIds[j] == id;
+        }
+        if(listed) continue;
+
+        ShaderCompileDesc* pDesc = &pDescs[batchCount];
+        *pDesc = {};
+        pDesc->mPath = pPermutation->mDesc.mPath;
+        pDesc->mType = pPermutation->mDesc.mType;
+        pDesc->mDefinesCount = getShaderVariantDefines(pPermutation, id, scratch.pArena, &pDesc->pDefines);
+        pBatchIds[batchCount++] = id;
+    }
+    if(!batchCount) return;
+
+    Shader** ppShaders = (Shader**)arenaPushZero(scratch.pArena, batchCount * sizeof(Shader*), alignof(Shader*));
+    loadShaders(pAssetManager, pRenderer, pDescs, batchCount, ppShaders);
+    for(uint32 i = 0; i < batchCount; i++)
+    {
+        addShaderVariant(pPermutation, pBatchIds[i], ppShaders[i]);
+    }
+}
+
+Shader* findShaderVariant(ShaderPermutation* pPermutation, ShaderVariantId id)
+{
+    ASSERT(pPermutation);
+    Shader** ppShader = pPermutation->mVariants.find(id);
+    return ppShader ? *ppShader : NULL;
+}
+
+Shader* getShaderVariant(AssetManager* pAssetManager, Renderer* pRenderer, ShaderPermutation* pPermutation,
+        ShaderVariantId id)
+{
+    ASSERT(pAssetManager && pRenderer && pPermutation);
+
+    Shader** ppShader = pPermutation->mVariants.find(id);
+    if(ppShader) return *ppShader;
+
+    ASSERT(isShaderVariantValid(pPermutation, id));
+    ScratchScope scratch;
+    String* pDefines = NULL;
+    uint32 definesCount = getShaderVariantDefines(pPermutation, id, scratch.pArena, &pDefines);
+    Shader* pShader = NULL;
+    loadShader(pAssetManager, pRenderer,
+            pPermutation->mDesc.mPath,
+            pPermutation->mDesc.mType, pDefines, definesCount,
+            &pShader);
+    addShaderVariant(pPermutation, id, pShader);
+    return pShader;
+}
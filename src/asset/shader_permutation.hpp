@@ -0,0 +1,84 @@
+#pragma once
+#include "../core/base.hpp"
+#include "../core/memory.hpp"
+#include "../core/string.hpp"
+#include "../core/hash_map.hpp"
+
+struct AssetManager;
+struct Renderer;
+struct Shader;
+
+// Shader permutations
+// One shader source compiled for combinations of a few keys, each key a define with a
+// small domain of values. A variant is named by an ID where every key owns a bitfield,
+// built once with shaderVariantId/setShaderVariantKey and looked up in a hash map when
+// drawing, so no define strings are touched on the hot path. Variants compile ahead of
+// time, all of them or only a list of the IDs in use, and lazily on first lookup.
+//
+// Keys with two values are switches: 0 leaves the define out, so #ifdef keeps working,
+// 1 defines it. Wider keys always define NAME=value.
+//
+//  ShaderPermutationKey keys[] = { { str("USE_FOG"), 2 }, { str("LIGHT_COUNT"), 4 } };
+//  ShaderPermutationDesc desc = {};
+//  desc.mPath = str("shaders/lit.frag");
+//  ...
+//  initShaderPermutation(desc, &permutation);
+//  uint32 values[] = { 1, 3 };
+//  ShaderVariantId id = shaderVariantId(&permutation, values);   // Once, at setup
+//  ...every draw
+//  Shader* pShader = getShaderVariant(pAssetManager, pRenderer, &permutation, id);
+#define SHADER_PERMUTATION_MAX_KEYS     8
+#define SHADER_VARIANT_MAX_BITS         16
+#define SHADER_VARIANT_MAX_COUNT        4096    // Compiled at once per permutation
+
+typedef uint32 ShaderVariantId;
+
+struct ShaderPermutationKey
+{
+    String  mName       = {};
+    uint32  mValueCount = 2;        // Values are [0, mValueCount)
+};
+
+struct ShaderPermutationDesc
+{
+    String                  mPath       = {};
+    uint32                  mType       = 0;        // ShaderType
+    ShaderPermutationKey*   pKeys       = NULL;
+    uint32                  mKeyCount   = 0;
+};
+
+// Must not move once initialized, the variant map grows in mArena
+struct ShaderPermutation
+{
+    ShaderPermutationDesc   mDesc       = {};       // Path and keys copied to mArena
+    uint32  mShifts[SHADER_PERMUTATION_MAX_KEYS] = {};
+    uint32  mIdBits     = 0;
+    uint64  mVariantCount = 0;                      // Of the whole domain
+
+    HashMap<ShaderVariantId, Shader*> mVariants = {};
+    ShaderVariantId*    pCompiled       = NULL;     // IDs in mVariants, SHADER_VARIANT_MAX_COUNT
+    uint32              mCompiledCount  = 0;
+    Arena               mArena          = {};
+};
+
+void    initShaderPermutation(ShaderPermutationDesc desc, ShaderPermutation* pPermutation);
+void    destroyShaderPermutation(Renderer* pRenderer, ShaderPermutation* pPermutation);   // Removes the variants, pRenderer may be NULL without any
+
+// pValues holds one value per key, in desc order.
+ShaderVariantId shaderVariantId(ShaderPermutation* pPermutation, uint32* pValues);
+ShaderVariantId setShaderVariantKey(ShaderPermutation* pPermutation, ShaderVariantId id, uint32 key, uint32 value);
+uint32          getShaderVariantKey(ShaderPermutation* pPermutation, ShaderVariantId id, uint32 key);
+// False when a key's value is outside of its domain.
+bool            isShaderVariantValid(ShaderPermutation* pPermutation, ShaderVariantId id);
+
+// Compiles the variants not compiled yet as one batch (see loadShaders), the whole domain
+// when pIds is NULL.
+void    compileShaderVariants(AssetManager* pAssetManager, Renderer* pRenderer, ShaderPermutation* pPermutation,
+        ShaderVariantId* pIds, uint32 count);
+// NULL when the variant isn't compiled.
+Shader* findShaderVariant(ShaderPermutation* pPermutation, ShaderVariantId id);
+// Compiles the variant on the calling thread the first time it's asked for.
+Shader* getShaderVariant(AssetManager* pAssetManager, Renderer* pRenderer, ShaderPermutation* pPermutation,
+        ShaderVariantId id);
+// Returns the define strings of the variant in pArena.
+uint32  getShaderVariantDefines(ShaderPermutation* pPermutation, ShaderVariantId id, Arena* pArena, String** ppOut);
@@ -0,0 +1,258 @@
+#include "shader_watch.hpp"
+#include "../core/file.hpp"
+#include "../core/thread.hpp"
+#include "../core/debug.hpp"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// --------------------------------------
+// Files
+uint32 findShaderWatchFile(ShaderWatcher* pWatcher, String path)
+{
+    for(uint32 i = 0; i < pWatcher->mFileCount; i++)
+    {
+        ShaderWatchFile* pFile = &pWatcher->pFiles[i];
+        if(pFile->mPathLen == path.mLen && memcmp(pFile->mPath, path.mData, path.mLen) == 0) return i;
+    }
+    return MAX_UINT32;
+}
+
+// Returns MAX_UINT32 when the watcher is full
+uint32 addShaderWatchFile(ShaderWatcher* pWatcher, String path)
+{
+    uint32 index = findShaderWatchFile(pWatcher, path);
+    if(index != MAX_UINT32) return index;
+    ASSERTF(pWatcher->mFileCount < SHADER_WATCH_MAX_FILES && path.mLen < SHADER_WATCH_MAX_PATH,
+            "Can't watch shader file %.*s", (int32)path.mLen, cstr(path));
+    if(pWatcher->mFileCount == SHADER_WATCH_MAX_FILES || path.mLen >= SHADER_WATCH_MAX_PATH) return MAX_UINT32;
+
+    index = pWatcher->mFileCount++;
+    ShaderWatchFile* pFile = &pWatcher->pFiles[index];
+    *pFile = {};
+    memcpy(pFile->mPath, path.mData, path.mLen);
+    pFile->mPath[path.mLen] = 0;
+    pFile->mPathLen = (uint32)path.mLen;
+    pFile->mTime = getFileTime(path);
+
+    uint64 lastSlash = rfind(path, '\\');
+    if(lastSlash == -1) lastSlash = rfind(path, '/');
+    pFile->mNameOffset = lastSlash == -1 ? 0 : (uint32)lastSlash + 1;
+
+#ifdef __linux__
+    if(pWatcher->mBackend == SHADER_WATCH_INOTIFY)
+    {
+        // Watching a directory twice gives back the same descriptor, however it's spelled
+        char dir[SHADER_WATCH_MAX_PATH] = ".";
+        if(pFile->mNameOffset)
+        {
+            memcpy(dir, pFile->mPath, pFile->mNameOffset - 1);
+            dir[pFile->mNameOffset - 1] = 0;
+        }
+        pFile->mDir = inotify_add_watch(pWatcher->mInotifyFd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+    }
+#endif
+    return index;
+}
+
+void markShaderWatchFiles(ShaderWatcher* pWatcher, int32 dir, const char* name)
+{
+    uint64 nameLen = strlen(name);
+    for(uint32 i = 0; i < pWatcher->mFileCount; i++)
+    {
+        ShaderWatchFile* pFile = &pWatcher->pFiles[i];
+        if(pFile->mDir == dir
+                && pFile->mPathLen - pFile->mNameOffset == nameLen
+                && memcmp(pFile->mPath + pFile->mNameOffset, name, nameLen) == 0)
+        {
+            pFile->mChanged = true;
+        }
+    }
+}
+
+void pollShaderWatchFiles(ShaderWatcher* pWatcher)
+{
+    for(uint32 i = 0; i < pWatcher->mFileCount; i++)
+    {
+        ShaderWatchFile* pFile = &pWatcher->pFiles[i];
+        uint64 time = getFileTime(str(pFile->mPath));
+        if(time == pFile->mTime) continue;
+        pFile->mTime = time;
+        pFile->mChanged = true;
+    }
+}
+
+#ifdef __linux__
+void readShaderWatchEvents(ShaderWatcher* pWatcher)
+{
+    alignas(struct inotify_event) byte buffer[4096];
+    while(true)
+    {
+        // Non blocking, fails with EAGAIN once there's nothing left
+        int64 len = read(pWatcher->mInotifyFd, buffer, sizeof(buffer));
+        if(len <= 0) break;
+        for(byte* p = buffer; p < buffer + len;)
+        {
+            struct inotify_event* pEvent = (struct inotify_event*)p;
+            if(pEvent->len) markShaderWatchFiles(pWatcher, pEvent->wd, pEvent->name);
+            p += sizeof(struct inotify_event) + pEvent->len;
+        }
+    }
+}
+#endif
+
+// --------------------------------------
+bool initShaderWatcher(ShaderWatchDesc desc, ShaderWatcher* pWatcher)
+{
+    ASSERT(pWatcher);
+
+    *pWatcher = {};
+    pWatcher->mDesc = desc;
+    ShaderWatchBackend backend = desc.mBackend;
+#ifdef __linux__
+    if(backend != SHADER_WATCH_POLL)
+    {
+        pWatcher->mInotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if(pWatcher->mInotifyFd >= 0) backend = SHADER_WATCH_INOTIFY;
+    }
+#endif
+    if(backend == SHADER_WATCH_INOTIFY && pWatcher->mInotifyFd < 0) return false;
+    if(backend == SHADER_WATCH_AUTO) backend = SHADER_WATCH_POLL;
+    pWatcher->mBackend = backend;
+
+    uint64 filesSize = SHADER_WATCH_MAX_FILES * sizeof(ShaderWatchFile);
+    uint64 edgesSize = SHADER_WATCH_MAX_EDGES * sizeof(ShaderWatchEdge);
+    initArena(filesSize + edgesSize + KB(4), &pWatcher->mArena);
+    pWatcher->pFiles = (ShaderWatchFile*)arenaPushZero(&pWatcher->mArena, filesSize, alignof(ShaderWatchFile));
+    pWatcher->pEdges = (ShaderWatchEdge*)arenaPushZero(&pWatcher->mArena, edgesSize, alignof(ShaderWatchEdge));
+    return true;
+}
+
+void destroyShaderWatcher(ShaderWatcher* pWatcher)
+{
+    ASSERT(pWatcher);
+    ASSERT(isShaderWatcherEnabled(pWatcher));
+
+#ifdef __linux__
+    if(pWatcher->mInotifyFd >= 0) close(pWatcher->mInotifyFd);
+#endif
+    destroyArena(&pWatcher->mArena);
+    *pWatcher = {};
+}
+
+bool isShaderWatcherEnabled(ShaderWatcher* pWatcher)
+{
+    ASSERT(pWatcher);
+    return pWatcher->pFiles != NULL;
+}
+
+void watchShaderSource(ShaderWatcher* pWatcher, String path)
+{
+    ASSERT(pWatcher);
+    ASSERT(isShaderWatcherEnabled(pWatcher));
+
+    spinLock(&pWatcher->mLock);
+    uint32 index = addShaderWatchFile(pWatcher, path);
+    if(index != MAX_UINT32) pWatcher->pFiles[index].mShader = true;
+    spinUnlock(&pWatcher->mLock);
+}
+
+void addShaderDependency(ShaderWatcher* pWatcher, String file, String dependent)
+{
+    ASSERT(pWatcher);
+    ASSERT(isShaderWatcherEnabled(pWatcher));
+
+    spinLock(&pWatcher->mLock);
+    uint32 fileIndex = addShaderWatchFile(pWatcher, file);
+    uint32 dependentIndex = addShaderWatchFile(pWatcher, dependent);
+    bool found = fileIndex == MAX_UINT32 || dependentIndex == MAX_UINT32;
+    for(uint32 i = 0; i < pWatcher->mEdgeCount && !found; i++)
+    {
+        ShaderWatchEdge* pEdge = &pWatcher->pEdges[i];
+        found = pEdge->mFile == fileIndex && pEdge->mDependent == dependentIndex;
+    }
+    if(!found)
+    {
+        ASSERTF(pWatcher->mEdgeCount < SHADER_WATCH_MAX_EDGES, "Can't watch shader include %.*s", (int32)file.mLen, cstr(file));
+        if(pWatcher->mEdgeCount < SHADER_WATCH_MAX_EDGES)
+        {
+            ShaderWatchEdge* pEdge = &pWatcher->pEdges[pWatcher->mEdgeCount++];
+            pEdge->mFile = fileIndex;
+            pEdge->mDependent = dependentIndex;
+        }
+    }
+    spinUnlock(&pWatcher->mLock);
+}
+
+uint32 updateShaderWatcher(ShaderWatcher* pWatcher, Arena* pArena, String** ppOut)
+{
+    ASSERT(pWatcher && pArena && ppOut);
+    ASSERT(isShaderWatcherEnabled(pWatcher));
+
+    *ppOut = NULL;
+    spinLock(&pWatcher->mLock);
+#ifdef __linux__
+    if(pWatcher->mBackend == SHADER_WATCH_INOTIFY) readShaderWatchEvents(pWatcher);
+#endif
+    if(pWatcher->mBackend == SHADER_WATCH_POLL && ++pWatcher->mUpdates >= pWatcher->mDesc.mPollInterval)
+    {
+        pWatcher->mUpdates = 0;
+        pollShaderWatchFiles(pWatcher);
+    }
+
+    // Changed files start the walk, their own includes are recorded again on recompile
+    ScratchScope scratch(pArena);
+    uint32 fileCount = pWatcher->mFileCount;
+    uint32* pStack = (uint32*)arenaPush(scratch.pArena, (fileCount + 1) * sizeof(uint32), alignof(uint32));
+    bool* pReached = (bool*)arenaPushZero(scratch.pArena, fileCount + 1);
+    uint32 stackCount = 0;
+    for(uint32 i = 0; i < fileCount; i++)
+    {
+        if(!pWatcher->pFiles[i].mChanged) continue;
+        pWatcher->pFiles[i].mChanged = false;
+        pReached[i] = true;
+        pStack[stackCount++] = i;
+    }
+    for(uint32 i = 0; i < pWatcher->mEdgeCount;)
+    {
+        if(pReached[pWatcher->pEdges[i].mDependent])
+        {
+            pWatcher->pEdges[i] = pWatcher->pEdges[--pWatcher->mEdgeCount];
+            continue;
+        }
+        i++;
+    }
+
+    // Every file reached has been pushed once, the shaders among them are reported
+    uint32 shaderCount = 0;
+    while(stackCount)
+    {
+        uint32 file = pStack[--stackCount];
+        if(pWatcher->pFiles[file].mShader) shaderCount++;
+        for(uint32 i = 0; i < pWatcher->mEdgeCount; i++)
+        {
+            ShaderWatchEdge* pEdge = &pWatcher->pEdges[i];
+            if(pEdge->mFile != file || pReached[pEdge->mDependent]) continue;
+            pReached[pEdge->mDependent] = true;
+            pStack[stackCount++] = pEdge->mDependent;
+        }
+    }
+
+    if(shaderCount)
+    {
+        String* pOut = (String*)arenaPush(pArena, shaderCount * sizeof(String), alignof(String));
+        uint32 outCount = 0;
+        for(uint32 i = 0; i < fileCount; i++)
+        {
+            ShaderWatchFile* pFile = &pWatcher->pFiles[i];
+            if(!pReached[i] || !pFile->mShader) continue;
+            pOut[outCount++] = str(pArena, str((byte*)pFile->mPath, pFile->mPathLen));
+        }
+        ASSERT(outCount == shaderCount);
+        *ppOut = pOut;
+    }
+    spinUnlock(&pWatcher->mLock);
+    return shaderCount;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "../core/base.hpp"
+#include "../core/memory.hpp"
+#include "../core/string.hpp"
+
+// Shader dependency graph
+// Every compile records the shader source and each #include it resolves as an edge
+// from the included file to the file including it. When a file changes, the edges
+// are walked from it to every shader source that reaches it, so only those shaders
+// are reported for reload. Stale edges (an #include that was removed) can only cause
+// extra reloads, the changed file's own edges are dropped and recorded again when
+// its dependents are recompiled.
+//
+// Changes are found with inotify on Linux, one watch per directory holding a
+// watched file, and elsewhere by comparing file write times every mPollInterval
+// updates. Recording and updates can run on any thread.
+#define SHADER_WATCH_MAX_FILES      1024
+#define SHADER_WATCH_MAX_EDGES      4096
+#define SHADER_WATCH_MAX_PATH       260
+
+enum ShaderWatchBackend : uint32
+{
+    SHADER_WATCH_AUTO = 0,      // inotify when available, polling otherwise
+    SHADER_WATCH_POLL,
+    SHADER_WATCH_INOTIFY,
+};
+
+struct ShaderWatchDesc
+{
+    bool                mEnabled        = false;
+    ShaderWatchBackend  mBackend        = SHADER_WATCH_AUTO;
+    uint32              mPollInterval   = 30;       // Updates between write time checks
+};
+
+struct ShaderWatchFile
+{
+    char    mPath[SHADER_WATCH_MAX_PATH];
+    uint32  mPathLen    = 0;
+    uint32  mNameOffset = 0;        // Of the file name in mPath
+    int32   mDir        = -1;       // inotify watch descriptor of its directory
+    uint64  mTime       = 0;        // Write time when last checked
+    bool    mShader     = false;    // Compiled directly, reported on changes
+    bool    mChanged    = false;
+};
+
+// mDependent includes mFile, both are file indices
+struct ShaderWatchEdge
+{
+    uint32  mFile       = 0;
+    uint32  mDependent  = 0;
+};
+
+struct ShaderWatcher
+{
+    ShaderWatchDesc     mDesc       = {};
+    ShaderWatchBackend  mBackend    = SHADER_WATCH_AUTO;    // The one in use
+    Arena               mArena      = {};
+
+    ShaderWatchFile*    pFiles      = NULL;     // SHADER_WATCH_MAX_FILES
+    uint32              mFileCount  = 0;
+    ShaderWatchEdge*    pEdges      = NULL;     // SHADER_WATCH_MAX_EDGES
+    uint32              mEdgeCount  = 0;
+
+    int32               mInotifyFd  = -1;
+    uint32              mUpdates    = 0;
+    uint32              mLock       = 0;        // Guards the files and edges
+};
+
+// Returns false when the requested backend isn't available.
+bool    initShaderWatcher(ShaderWatchDesc desc, ShaderWatcher* pWatcher);
+void    destroyShaderWatcher(ShaderWatcher* pWatcher);
+bool    isShaderWatcherEnabled(ShaderWatcher* pWatcher);
+
+void    watchShaderSource(ShaderWatcher* pWatcher, String path);
+// dependent #includes file, either may be a shader source or another include.
+void    addShaderDependency(ShaderWatcher* pWatcher, String file, String dependent);
+// Returns the number of shader sources affected by changes since the last update,
+// their paths in pArena.
+uint32  updateShaderWatcher(ShaderWatcher* pWatcher, Arena* pArena, String** ppOut);
@@ -0,0 +1,775 @@
+#include "asset.hpp"
+#include "texture_cook.hpp"
+#include "shader_cache.hpp"
+#include "shader_permutation.hpp"
+#include "../render/shader.hpp"
+#include "../core/memory.hpp"
+#include "../core/debug.hpp"
+#include "../core/file.hpp"
+#include "../core/jobs.hpp"
+#include "../core/time.hpp"
+#include "../math/math.hpp"
+
+// Smooth gradients with a hard edged disc, so both flat and contrasted blocks show up
+void fillCookTestImage(byte* pPixels, uint32 width, uint32 height)
+{
+    for(uint32 y = 0; y < height; y++)
+    {
+        for(uint32 x = 0; x < width; x++)
+        {
+            byte* pTexel = pPixels + ((uint64)y * width + x) * 4;
+            float u = (float)x / width;
+            float v = (float)y / height;
+            float dx = u - 0.5f, dy = v - 0.5f;
+            bool disc = dx * dx + dy * dy < 0.06f;
+            pTexel[0] = (byte)(disc ? 230 : 255 * u);
+            pTexel[1] = (byte)(disc ? 40 : 255 * v);
+            pTexel[2] = (byte)(disc ? 60 : 128 + 100 * sinf(u * 6.f));
+            pTexel[3] = (byte)(255 * (0.5f + 0.5f * cosf(v * 4.f)));
+        }
+    }
+}
+
+// Over the channels set in mask (bit 0 = red)
+double computePSNR(byte* pA, byte* pB, uint64 texelCount, uint32 mask)
+{
+    double error = 0.0;
+    uint64 count = 0;
+    for(uint64 i = 0; i < texelCount; i++)
+    {
+        for(uint32 c = 0; c < 4; c++)
+        {
+            if(!(mask & (1 << c))) continue;
+            double d = (double)pA[i * 4 + c] - pB[i * 4 + c];
+            error += d * d;
+            count++;
+        }
+    }
+    if(error == 0.0) return 999.0;
+    return 10.0 * log10(255.0 * 255.0 / (error / count));
+}
+
+bool testTextureCook()
+{
+    Arena arena = {};
+    initArena(MB(64), &arena);
+
+    // Mip chain layout
+    {
+        ASSERT(getTextureBlobMipCount(1, 1) == 1);
+        ASSERT(getTextureBlobMipCount(128, 96) == 8);
+        ASSERT(getTextureBlobMipCount(5, 3) == 3);
+        ASSERT(getTextureBlobMipSize(TEXTURE_BLOB_RGBA8, 5, 3) == 60);
+        ASSERT(getTextureBlobMipSize(TEXTURE_BLOB_BC1, 5, 3) == 2 * 8);
+        ASSERT(getTextureBlobMipSize(TEXTURE_BLOB_BC7, 1, 1) == 16);
+    }
+
+    // Block compression round trip
+    {
+        const uint32 width = 130;
+        const uint32 height = 66;
+        byte* pSource = (byte*)arenaPush(&arena, width * height * 4);
+        byte* pBlocks = (byte*)arenaPush(&arena, getTextureBlobMipSize(TEXTURE_BLOB_BC7, width, height));
+        byte* pDecoded = (byte*)arenaPush(&arena, width * height * 4);
+        fillCookTestImage(pSource, width, height);
+
+        struct { TextureBlobFormat mFormat; uint32 mMask; double mMinPSNR; } cases[] =
+        {
+            { TEXTURE_BLOB_BC1, 0x7, 37.0 },
+            { TEXTURE_BLOB_BC3, 0xF, 38.0 },
+            { TEXTURE_BLOB_BC5, 0x3, 45.0 },
+            { TEXTURE_BLOB_BC7, 0xF, 40.0 },
+        };
+        for(uint32 i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+        {
+            encodeTextureBlocks(cases[i].mFormat, pSource, width, height, pBlocks, NULL);
+            decodeTextureBlocks(cases[i].mFormat, pBlocks, width, height, pDecoded);
+            double psnr = computePSNR(pSource, pDecoded, width * height, cases[i].mMask);
+            ASSERT(psnr >= cases[i].mMinPSNR);
+        }
+
+        // Flat blocks are exact where the endpoints can represent the color
+        memset(pSource, 0, width * height * 4);
+        encodeTextureBlocks(TEXTURE_BLOB_BC1, pSource, width, height, pBlocks, NULL);
+        decodeTextureBlocks(TEXTURE_BLOB_BC1, pBlocks, width, height, pDecoded);
+        ASSERT(computePSNR(pSource, pDecoded, width * height, 0x7) == 999.0);
+    }
+
+    // Blob layout and box filtered mips
+    {
+        // 4x4 checker of black and white texels, every 2x2 average is mid grey
+        byte pixels[4 * 4 * 4];
+        for(uint32 i = 0; i < 16; i++)
+        {
+            byte value = ((i & 1) ^ ((i >> 2) & 1)) ? 255 : 0;
+            memset(pixels + i * 4, value, 4);
+        }
+
+        TextureCookDesc desc = {};
+        desc.mFormat = TEXTURE_BLOB_RGBA8;
+        desc.mMipFilter = TEXTURE_MIP_FILTER_BOX;
+        desc.mSrgb = false;
+        uint64 size = 0;
+        byte* pBlob = cookTexture(desc, pixels, 4, 4, &arena, &size);
+
+        TextureBlobHeader* pHeader = getTextureBlob(pBlob, size);
+        ASSERT(pHeader);
+        ASSERT(pHeader->mMipCount == 3);
+        ASSERT(pHeader->mMips[2].mWidth == 1 && pHeader->mMips[2].mHeight == 1);
+        ASSERT(memcmp(pBlob + pHeader->mMips[0].mOffset, pixels, sizeof(pixels)) == 0);
+        for(uint32 mip = 1; mip < 3; mip++)
+        {
+            byte* pMip = pBlob + pHeader->mMips[mip].mOffset;
+            ASSERT(pHeader->mMips[mip].mOffset % TEXTURE_BLOB_ALIGN == 0);
+            for(uint64 i = 0; i < pHeader->mMips[mip].mSize; i++)
+            {
+                ASSERT(pMip[i] == 128);
+            }
+        }
+
+        // Only complete blobs of the current version are accepted
+        TextureBlobMip* pLastMip = &pHeader->mMips[pHeader->mMipCount - 1];
+        ASSERT(getTextureBlob(pBlob, pLastMip->mOffset + pLastMip->mSize) == pHeader);
+        ASSERT(getTextureBlob(pBlob, pLastMip->mOffset + pLastMip->mSize - 1) == NULL);
+        pHeader->mVersion++;
+        ASSERT(getTextureBlob(pBlob, size) == NULL);
+        pHeader->mVersion--;
+        pHeader->mMagic = 0;
+        ASSERT(getTextureBlob(pBlob, size) == NULL);
+        pHeader->mMagic = TEXTURE_BLOB_MAGIC;
+        ASSERT(getTextureBlob(pBlob, size) == pHeader);
+
+        // Mips must match the halved chain and stay in bounds, whatever the header says
+        TextureBlobHeader saved = *pHeader;
+        pHeader->mMips[1].mSize -= 4;
+        ASSERT(getTextureBlob(pBlob, size) == NULL);
+        *pHeader = saved;
+        pHeader->mMips[1].mWidth = 1;
+        ASSERT(getTextureBlob(pBlob, size) == NULL);
+        *pHeader = saved;
+        pHeader->mWidth = 8;
+        ASSERT(getTextureBlob(pBlob, size) == NULL);
+        *pHeader = saved;
+        pHeader->mMipCount = 4;
+        ASSERT(getTextureBlob(pBlob, size) == NULL);
+        *pHeader = saved;
+        pHeader->mMips[2].mOffset = MAX_UINT64 & ~(uint64)(TEXTURE_BLOB_ALIGN - 1);
+        ASSERT(getTextureBlob(pBlob, size) == NULL);
+        *pHeader = saved;
+        pHeader->mMips[2].mOffset = pHeader->mMips[0].mOffset;
+        ASSERT(getTextureBlob(pBlob, size) == NULL);
+        *pHeader = saved;
+        ASSERT(getTextureBlob(pBlob, size) == pHeader);
+    }
+
+    // Filters keep flat images flat, in sRGB too
+    {
+        const uint32 width = 37;
+        const uint32 height = 21;
+        byte* pSource = (byte*)arenaPush(&arena, width * height * 4);
+        for(uint32 i = 0; i < width * height; i++)
+        {
+            pSource[i * 4 + 0] = 200;
+            pSource[i * 4 + 1] = 100;
+            pSource[i * 4 + 2] = 10;
+            pSource[i * 4 + 3] = 50;
+        }
+
+        TextureCookDesc desc = {};
+        desc.mMipFilter = TEXTURE_MIP_FILTER_KAISER;
+        desc.mSrgb = true;
+        uint64 size = 0;
+        byte* pBlob = cookTexture(desc, pSource, width, height, &arena, &size);
+        TextureBlobHeader* pHeader = getTextureBlob(pBlob, size);
+        ASSERT(pHeader && pHeader->mMipCount == 6);
+        for(uint32 mip = 1; mip < pHeader->mMipCount; mip++)
+        {
+            byte* pMip = pBlob + pHeader->mMips[mip].mOffset;
+            for(uint64 i = 0; i < pHeader->mMips[mip].mSize; i++)
+            {
+                ASSERT(ABS((int32)pMip[i] - pSource[i & 3]) <= 1);
+            }
+        }
+    }
+
+    // Cooking on the job system gives the same blob
+    {
+        const uint32 width = 256;
+        const uint32 height = 200;
+        byte* pSource = (byte*)arenaPush(&arena, width * height * 4);
+        fillCookTestImage(pSource, width, height);
+
+        JobSystem jobs = {};
+        initJobSystem(4, &jobs);
+
+        TextureCookDesc desc = {};
+        desc.mFormat = TEXTURE_BLOB_BC7;
+        uint64 size = 0, sizeJobs = 0;
+        byte* pBlob = cookTexture(desc, pSource, width, height, &arena, &size);
+        desc.pJobs = &jobs;
+        byte* pBlobJobs = cookTexture(desc, pSource, width, height, &arena, &sizeJobs);
+        ASSERT(size == sizeJobs);
+        ASSERT(memcmp(pBlob, pBlobJobs, size) == 0);
+
+        destroyJobSystem(&jobs);
+    }
+
+    destroyArena(&arena);
+    return true;
+}
+
+bool testShaderCache()
+{
+    Arena arena = {};
+    initArena(MB(1), &arena);
+
+    String srcDir = str("test_shader_src");
+    String cacheDir = str("test_shader_cache");
+    String shaderPath = str("test_shader_src/test.frag");
+    String commonPath = str("test_shader_src/common.glsl");
+    String innerPath = str("test_shader_src/inner.glsl");
+    const char* shader = "#version 450\n  #  include \"common.glsl\"\nvoid main() {}\n";
+    const char* common = "#include \"inner.glsl\"\nfloat common() { return 1.0; }\n";
+    const char* inner = "#include \"common.glsl\"\nfloat inner() { return 2.0; }\n";
+    createDir(srcDir);
+    writeFile(shaderPath, (byte*)shader, strlen(shader));
+    writeFile(commonPath, (byte*)common, strlen(common));
+    writeFile(innerPath, (byte*)inner, strlen(inner));
+
+    // Keys cover the defines, type, flags and every included file, cycles included
+    {
+        String defines[] = { str("USE_A"), str("USE_B") };
+        Hash128 key = computeShaderKey(shaderPath, 1, defines, 2, 0);
+        ASSERT(key == computeShaderKey(shaderPath, 1, defines, 2, 0));
+        ASSERT(key != computeShaderKey(shaderPath, 1, defines, 1, 0));
+        ASSERT(key != computeShaderKey(shaderPath, 2, defines, 2, 0));
+        ASSERT(key != computeShaderKey(shaderPath, 1, defines, 2, 1));
+
+        const char* innerEdited = "#include \"common.glsl\"\nfloat inner() { return 3.0; }\n";
+        writeFile(innerPath, (byte*)innerEdited, strlen(innerEdited));
+        ASSERT(key != computeShaderKey(shaderPath, 1, defines, 2, 0));
+        writeFile(innerPath, (byte*)inner, strlen(inner));
+        ASSERT(key == computeShaderKey(shaderPath, 1, defines, 2, 0));
+    }
+
+    // However deep the include tree, the last file counts
+    {
+        const uint32 chainLength = 80;
+        for(uint32 i = 0; i < chainLength; i++)
+        {
+            String chainPath = strf(&arena, "test_shader_src/chain%u.glsl", i);
+            String chain = i + 1 < chainLength ? strf(&arena, "#include \"chain%u.glsl\"\n", i + 1) : str("float last;\n");
+            writeFile(chainPath, chain.mData, chain.mLen);
+        }
+        String rootPath = str("test_shader_src/chain0.glsl");
+        String lastPath = strf(&arena, "test_shader_src/chain%u.glsl", chainLength - 1);
+        Hash128 key = computeShaderKey(rootPath, 1, NULL, 0, 0);
+        const char* lastEdited = "float last = 1.0;\n";
+        writeFile(lastPath, (byte*)lastEdited, strlen(lastEdited));
+        ASSERT(key != computeShaderKey(rootPath, 1, NULL, 0, 0));
+
+        for(uint32 i = 0; i < chainLength; i++)
+        {
+            deleteFile(strf(&arena, "test_shader_src/chain%u.glsl", i));
+        }
+    }
+
+    ShaderCacheDesc desc = {};
+    desc.mDir = cacheDir;
+    desc.mMaxSize = 3 * (sizeof(ShaderCacheFileHeader) + 100);
+    byte spirv[100];
+    for(uint32 i = 0; i < sizeof(spirv); i++) spirv[i] = (byte)i;
+    Hash128 keys[4] = {};
+    for(uint32 i = 0; i < 4; i++)
+    {
+        keys[i] = computeShaderKey(shaderPath, 1, NULL, 0, i);
+    }
+
+    // Round trip, the index persists between runs
+    {
+        ShaderCache cache = {};
+        initShaderCache(desc, &cache);
+        uint64 size = 0;
+        ASSERT(!lookupShaderCache(&cache, keys[0], &arena, &size));
+        storeShaderCache(&cache, keys[0], spirv, sizeof(spirv));
+        byte* pData = lookupShaderCache(&cache, keys[0], &arena, &size);
+        ASSERT(pData && size == sizeof(spirv) && memcmp(pData, spirv, size) == 0);
+        ASSERT(cache.mStats.mHits == 1 && cache.mStats.mMisses == 1 && cache.mStats.mStores == 1);
+        destroyShaderCache(&cache);
+
+        initShaderCache(desc, &cache);
+        ASSERT(cache.mEntryCount == 1);
+        ASSERT(cache.mTotalSize == sizeof(ShaderCacheFileHeader) + sizeof(spirv));
+        ASSERT(lookupShaderCache(&cache, keys[0], &arena, &size));
+        destroyShaderCache(&cache);
+    }
+
+    // Least recently used entries go first once over the size limit
+    {
+        ShaderCache cache = {};
+        initShaderCache(desc, &cache);
+        uint64 size = 0;
+        storeShaderCache(&cache, keys[1], spirv, sizeof(spirv));
+        storeShaderCache(&cache, keys[2], spirv, sizeof(spirv));
+        ASSERT(lookupShaderCache(&cache, keys[0], &arena, &size));
+        storeShaderCache(&cache, keys[3], spirv, sizeof(spirv));
+        ASSERT(cache.mStats.mEvictions == 1);
+        ASSERT(cache.mEntryCount == 3 && cache.mTotalSize <= desc.mMaxSize);
+        ASSERT(!lookupShaderCache(&cache, keys[1], &arena, &size));
+        ASSERT(!pathExists(getShaderCachePath(&cache, keys[1], &arena)));
+        ASSERT(lookupShaderCache(&cache, keys[0], &arena, &size));
+
+        // Damaged files are rejected and deleted
+        String path = getShaderCachePath(&cache, keys[2], &arena);
+        byte* pFile = readFile(&arena, path, &size);
+        pFile[size - 1] ^= 0xFF;
+        writeFile(path, pFile, size);
+        ASSERT(!lookupShaderCache(&cache, keys[2], &arena, &size));
+        ASSERT(cache.mStats.mRejected == 1);
+        ASSERT(!pathExists(path));
+        ASSERT(cache.mEntryCount == 2);
+
+        clearShaderCache(&cache);
+        ASSERT(cache.mEntryCount == 0);
+        ASSERT(!pathExists(getShaderCachePath(&cache, keys[0], &arena)));
+        destroyShaderCache(&cache);
+    }
+
+    // Lookups and stores from several workers at once, the same keys included
+    {
+        ShaderCache cache = {};
+        desc.mMaxSize = MB(1);
+        initShaderCache(desc, &cache);
+        JobSystem jobs = {};
+        initJobSystem(4, &jobs);
+        parallelFor(&jobs, 0, 64, 1, [&](uint32 begin, uint32 end)
+        {
+            ScratchScope scratch;
+            for(uint32 i = begin; i < end; i++)
+            {
+                uint64 size = 0;
+                Hash128 key = keys[i % 4];
+                byte* pData = lookupShaderCache(&cache, key, scratch.pArena, &size);
+                if(!pData)
+                {
+                    storeShaderCache(&cache, key, spirv, sizeof(spirv));
+                    continue;
+                }
+                ASSERT(size == sizeof(spirv) && memcmp(pData, spirv, size) == 0);
+            }
+        });
+        destroyJobSystem(&jobs);
+        ASSERT(cache.mEntryCount == 4);
+        ASSERT(cache.mStats.mHits + cache.mStats.mMisses == 64);
+        ASSERT(cache.mStats.mRejected == 0);
+
+        clearShaderCache(&cache);
+        destroyShaderCache(&cache);
+    }
+
+    deleteFile(str("test_shader_cache/index.bin"));
+    deleteDir(cacheDir);
+    deleteFile(shaderPath);
+    deleteFile(commonPath);
+    deleteFile(innerPath);
+    deleteDir(srcDir);
+    destroyArena(&arena);
+    return true;
+}
+
+bool hasShaderPath(String* pPaths, uint32 count, String path)
+{
+    for(uint32 i = 0; i < count; i++)
+    {
+        if(pPaths[i] == path) return true;
+    }
+    return false;
+}
+
+bool testShaderWatch()
+{
+    Arena arena = {};
+    initArena(MB(1), &arena);
+
+    // a includes common, which includes inner. b includes inner, c nothing
+    String dir = str("test_shader_watch");
+    String aPath = str("test_shader_watch/a.frag");
+    String bPath = str("test_shader_watch/b.frag");
+    String cPath = str("test_shader_watch/c.frag");
+    String commonPath = str("test_shader_watch/common.glsl");
+    String innerPath = str("test_shader_watch/inner.glsl");
+    const char* a = "#version 450\n#include \"common.glsl\"\nvoid main() {}\n";
+    const char* b = "#version 450\n#include \"inner.glsl\"\nvoid main() {}\n";
+    const char* c = "#version 450\nvoid main() {}\n";
+    const char* common = "#include \"inner.glsl\"\n";
+    const char* inner = "float inner() { return 1.0; }\n";
+    createDir(dir);
+    writeFile(aPath, (byte*)a, strlen(a));
+    writeFile(bPath, (byte*)b, strlen(b));
+    writeFile(cPath, (byte*)c, strlen(c));
+    writeFile(commonPath, (byte*)common, strlen(common));
+    writeFile(innerPath, (byte*)inner, strlen(inner));
+    String shaders[] = { aPath, bPath, cPath };
+
+    // Polling everywhere, inotify on Linux
+    ShaderWatchBackend backends[] = { SHADER_WATCH_POLL, SHADER_WATCH_AUTO };
+    for(uint32 i = 0; i < 2; i++)
+    {
+        ShaderWatchDesc desc = {};
+        desc.mEnabled = true;
+        desc.mBackend = backends[i];
+        desc.mPollInterval = 1;
+        ShaderWatcher watcher = {};
+        bool init = initShaderWatcher(desc, &watcher);
+        ASSERT(init);
+
+        // Recorded the way compiles do, from the key's include scan
+        ShaderIncludeCallback pfnRecord = [](void* pUserData, String file, String includer)
+        {
+            addShaderDependency((ShaderWatcher*)pUserData, file, includer);
+        };
+        for(uint32 j = 0; j < 3; j++)
+        {
+            watchShaderSource(&watcher, shaders[j]);
+            computeShaderKey(shaders[j], 0, NULL, 0, 0, pfnRecord, &watcher);
+        }
+        String* pChanged = NULL;
+        ASSERT(updateShaderWatcher(&watcher, &arena, &pChanged) == 0);
+
+        // Write times can be coarse, edits wait for them to move
+        const char* innerEdited = "float inner() { return 2.0; }\n";
+        sleepMS(20);
+        writeFile(innerPath, (byte*)innerEdited, strlen(innerEdited));
+        uint32 count = updateShaderWatcher(&watcher, &arena, &pChanged);
+        ASSERT(count == 2);
+        ASSERT(hasShaderPath(pChanged, count, aPath) && hasShaderPath(pChanged, count, bPath));
+        ASSERT(updateShaderWatcher(&watcher, &arena, &pChanged) == 0);
+
+        // A changed file's includes are dropped until its dependents recompile
+        const char* commonEdited = "#include \"inner.glsl\"\n\n";
+        sleepMS(20);
+        writeFile(commonPath, (byte*)commonEdited, strlen(commonEdited));
+        count = updateShaderWatcher(&watcher, &arena, &pChanged);
+        ASSERT(count == 1 && pChanged[0] == aPath);
+        sleepMS(20);
+        writeFile(innerPath, (byte*)inner, strlen(inner));
+        count = updateShaderWatcher(&watcher, &arena, &pChanged);
+        ASSERT(count == 1 && pChanged[0] == bPath);
+
+        computeShaderKey(aPath, 0, NULL, 0, 0, pfnRecord, &watcher);
+        sleepMS(20);
+        writeFile(innerPath, (byte*)innerEdited, strlen(innerEdited));
+        count = updateShaderWatcher(&watcher, &arena, &pChanged);
+        ASSERT(count == 2);
+
+        sleepMS(20);
+        writeFile(cPath, (byte*)c, strlen(c));
+        count = updateShaderWatcher(&watcher, &arena, &pChanged);
+        ASSERT(count == 1 && pChanged[0] == cPath);
+
+        destroyShaderWatcher(&watcher);
+        writeFile(commonPath, (byte*)common, strlen(common));
+        writeFile(innerPath, (byte*)inner, strlen(inner));
+    }
+
+    // An include edit that doesn't compile is logged, the shaders using it keep their
+    // SPIR-V and recompile once the include is fixed
+    {
+        AssetManagerDesc desc = {};
+        desc.mPermanentArenaSize = MB(1);
+        desc.mTempArenaSize = MB(1);
+        desc.mShaderWatch.mEnabled = true;
+        desc.mShaderWatch.mBackend = SHADER_WATCH_POLL;
+        desc.mShaderWatch.mPollInterval = 1;
+        AssetManager assetManager = {};
+        initAssetManager(desc, &assetManager);
+
+        ShaderCompileDesc descs[2] = {};
+        descs[0].mPath = aPath;
+        descs[0].mType = SHADER_TYPE_FRAG;
+        descs[1].mPath = cPath;
+        descs[1].mType = SHADER_TYPE_FRAG;
+        ShaderBlob previous[2];
+        ASSERT(compileShaders(&assetManager, descs, 2, &arena, previous) == 2);
+        ShaderBlob blobs[2];
+        ASSERT(recompileChangedShaders(&assetManager, descs, 2, &arena, blobs) == 0);
+
+        const char* commonBroken = "#error broken\n#include \"inner.glsl\"\n";
+        sleepMS(20);
+        writeFile(commonPath, (byte*)commonBroken, strlen(commonBroken));
+        ASSERT(recompileChangedShaders(&assetManager, descs, 2, &arena, blobs) == 0);
+        ASSERT(!blobs[0].pSpirv && !blobs[1].pSpirv);
+        ASSERT(previous[0].pSpirv && previous[1].pSpirv);
+
+        sleepMS(20);
+        writeFile(commonPath, (byte*)common, strlen(common));
+        ASSERT(recompileChangedShaders(&assetManager, descs, 2, &arena, blobs) == 1);
+        ASSERT(blobs[0].pSpirv && !blobs[1].pSpirv);
+        ASSERT(blobs[0].mSize == previous[0].mSize && memcmp(blobs[0].pSpirv, previous[0].pSpirv, blobs[0].mSize) == 0);
+
+        destroyAssetManager(&assetManager);
+    }
+
+    for(uint32 i = 0; i < 3; i++)
+    {
+        deleteFile(shaders[i]);
+    }
+    deleteFile(commonPath);
+    deleteFile(innerPath);
+    deleteDir(dir);
+    destroyArena(&arena);
+    return true;
+}
+
+bool testShaderCompile()
+{
+    Arena arena = {};
+    initArena(MB(4), &arena);
+
+    String srcDir = str("test_shader_compile");
+    String commonPath = str("test_shader_compile/common.glsl");
+    const char* common = "vec4 tint(vec4 color)\n{\n#ifdef USE_TINT\n    color.rgb *= 0.5;\n#endif\n    return color;\n}\n";
+    createDir(srcDir);
+    writeFile(commonPath, (byte*)common, strlen(common));
+
+    // 4 shaders, with and without a define
+    const uint32 shaderCount = 4;
+    String define = str("USE_TINT");
+    String paths[shaderCount];
+    ShaderCompileDesc descs[shaderCount * 2];
+    for(uint32 i = 0; i < shaderCount; i++)
+    {
+        paths[i] = strf(&arena, "test_shader_compile/%u.frag", i);
+        String source = strf(&arena,
+                "#version 450\n"
+                "#include \"common.glsl\"\n"
+                "layout(location = 0) out vec4 outColor;\n"
+                "void main() { outColor = tint(vec4(%u.0)); }\n", i);
+        writeFile(paths[i], source.mData, source.mLen);
+        for(uint32 j = 0; j < 2; j++)
+        {
+            ShaderCompileDesc* pDesc = &descs[i * 2 + j];
+            *pDesc = {};
+            pDesc->mPath = paths[i];
+            pDesc->mType = SHADER_TYPE_FRAG;
+            pDesc->pDefines = &define;
+            pDesc->mDefinesCount = j;
+        }
+    }
+
+    AssetManagerDesc desc = {};
+    desc.mPermanentArenaSize = MB(1);
+    desc.mTempArenaSize = MB(1);
+
+    // On the calling thread, one compiler for every shader
+    AssetManager serial = {};
+    initAssetManager(desc, &serial);
+    ShaderBlob serialBlobs[shaderCount * 2];
+    ASSERT(compileShaders(&serial, descs, shaderCount * 2, &arena, serialBlobs) == shaderCount * 2);
+    ASSERT(serial.mShaderCompilerCount == 1 && serial.pShaderCompilers[0].pCompiler);
+    ASSERT(serialBlobs[0].mSize != serialBlobs[1].mSize || memcmp(serialBlobs[0].pSpirv, serialBlobs[1].pSpirv, serialBlobs[0].mSize) != 0);
+    destroyAssetManager(&serial);
+
+    // Compiling on workers gives the same SPIR-V, in desc order
+    {
+        JobSystem jobs = {};
+        initJobSystem(4, &jobs);
+        desc.pJobs = &jobs;
+        AssetManager parallel = {};
+        initAssetManager(desc, &parallel);
+        ShaderBlob blobs[shaderCount * 2];
+        ASSERT(compileShaders(&parallel, descs, shaderCount * 2, &arena, blobs) == shaderCount * 2);
+        for(uint32 i = 0; i < shaderCount * 2; i++)
+        {
+            ASSERT(((uint64)blobs[i].pSpirv & 3) == 0);
+            ASSERT(blobs[i].mSize == serialBlobs[i].mSize);
+            ASSERT(memcmp(blobs[i].pSpirv, serialBlobs[i].pSpirv, blobs[i].mSize) == 0);
+        }
+
+        // Single shaders use the calling worker's compiler
+        uint64 size = 0;
+        byte* pSpirv = compileShader(&parallel, descs[3].mPath, descs[3].mType, descs[3].pDefines, descs[3].mDefinesCount, &arena, &size);
+        ASSERT(size == serialBlobs[3].mSize && memcmp(pSpirv, serialBlobs[3].pSpirv, size) == 0);
+
+        destroyAssetManager(&parallel);
+        destroyJobSystem(&jobs);
+    }
+
+    for(uint32 i = 0; i < shaderCount; i++)
+    {
+        deleteFile(paths[i]);
+    }
+    deleteFile(commonPath);
+    deleteDir(srcDir);
+    destroyArena(&arena);
+    return true;
+}
+
+bool testShaderPermutation()
+{
+    Arena arena = {};
+    initArena(MB(1), &arena);
+
+    // Bitfields of 1, 2 and 2 bits
+    ShaderPermutationKey keys[3] = {};
+    keys[0].mName = str("USE_FOG");
+    keys[0].mValueCount = 2;
+    keys[1].mName = str("LIGHT_COUNT");
+    keys[1].mValueCount = 4;
+    keys[2].mName = str("QUALITY");
+    keys[2].mValueCount = 3;
+    ShaderPermutationDesc desc = {};
+    desc.mPath = str("test_shader_permutation/lit.frag");
+    desc.mType = SHADER_TYPE_FRAG;
+    desc.pKeys = keys;
+    desc.mKeyCount = 3;
+    ShaderPermutation permutation = {};
+    initShaderPermutation(desc, &permutation);
+    ASSERT(permutation.mIdBits == 5);
+    ASSERT(permutation.mVariantCount == 24);
+
+    // IDs pack and unpack every key
+    {
+        uint32 values[] = { 1, 3, 2 };
+        ShaderVariantId id = shaderVariantId(&permutation, values);
+        ASSERT(id == (1 | 3 << 1 | 2 << 3));
+        for(uint32 i = 0; i < 3; i++)
+        {
+            ASSERT(getShaderVariantKey(&permutation, id, i) == values[i]);
+        }
+        ShaderVariantId other = setShaderVariantKey(&permutation, id, 1, 0);
+        ASSERT(getShaderVariantKey(&permutation, other, 0) == 1);
+        ASSERT(getShaderVariantKey(&permutation, other, 1) == 0);
+        ASSERT(getShaderVariantKey(&permutation, other, 2) == 2);
+        ASSERT(isShaderVariantValid(&permutation, id));
+        ASSERT(!isShaderVariantValid(&permutation, 3 << 3));
+        ASSERT(!isShaderVariantValid(&permutation, 1 << 5));
+    }
+
+    // Switches are left out when off, other keys carry their value
+    {
+        uint32 values[] = { 1, 3, 2 };
+        String* pDefines = NULL;
+        uint32 count = getShaderVariantDefines(&permutation, shaderVariantId(&permutation, values), &arena, &pDefines);
+        ASSERT(count == 3);
+        ASSERT(pDefines[0] == "USE_FOG" && pDefines[1] == "LIGHT_COUNT=3" && pDefines[2] == "QUALITY=2");
+        count = getShaderVariantDefines(&permutation, 0, &arena, &pDefines);
+        ASSERT(count == 2);
+        ASSERT(pDefines[0] == "LIGHT_COUNT=0" && pDefines[1] == "QUALITY=0");
+        ASSERT(!findShaderVariant(&permutation, 0));
+    }
+
+    // Define values reach the compiler
+    {
+        String dir = str("test_shader_permutation");
+        const char* lit =
+            "#version 450\n"
+            "layout(location = 0) out vec4 outColor;\n"
+            "void main()\n"
+            "{\n"
+            "    outColor = vec4(0.0);\n"
+            "    for(int i = 0; i < LIGHT_COUNT; i++) outColor += vec4(0.1 * QUALITY);\n"
+            "#ifdef USE_FOG\n"
+            "    outColor *= 0.5;\n"
+            "#endif\n"
+            "}\n";
+        createDir(dir);
+        writeFile(desc.mPath, (byte*)lit, strlen(lit));
+
+        AssetManagerDesc assetDesc = {};
+        assetDesc.mPermanentArenaSize = MB(1);
+        assetDesc.mTempArenaSize = MB(1);
+        AssetManager assetManager = {};
+        initAssetManager(assetDesc, &assetManager);
+        uint32 valuesA[] = { 0, 1, 2 };
+        uint32 valuesB[] = { 0, 3, 2 };
+        String* pDefinesA = NULL;
+        String* pDefinesB = NULL;
+        uint32 countA = getShaderVariantDefines(&permutation, shaderVariantId(&permutation, valuesA), &arena, &pDefinesA);
+        uint32 countB = getShaderVariantDefines(&permutation, shaderVariantId(&permutation, valuesB), &arena, &pDefinesB);
+        uint64 sizeA = 0, sizeB = 0;
+        byte* pSpirvA = compileShader(&assetManager, desc.mPath, desc.mType, pDefinesA, countA, &arena, &sizeA);
+        byte* pSpirvB = compileShader(&assetManager, desc.mPath, desc.mType, pDefinesB, countB, &arena, &sizeB);
+        ASSERT(pSpirvA && pSpirvB);
+        ASSERT(sizeA != sizeB || memcmp(pSpirvA, pSpirvB, sizeA) != 0);
+        destroyAssetManager(&assetManager);
+
+        deleteFile(desc.mPath);
+        deleteDir(dir);
+    }
+
+    destroyShaderPermutation(NULL, &permutation);
+    destroyArena(&arena);
+    return true;
+}
+
+// Decodes on job workers, each in its own arena, all released by destroyImageArenas
+bool testImageArenas()
+{
+    // 4x4 binary PPM, stb_image reads it without any compression in the way
+    const char* pHeader = "P6\n4 4\n255\n";
+    uint32 header = (uint32)strlen(pHeader);
+    uint64 fileSize = header + 4 * 4 * 3;
+    byte file[64];
+    memcpy(file, pHeader, header);
+    for(uint32 i = header; i < fileSize; i++)
+    {
+        file[i] = (byte)i;
+    }
+
+    Arena* pArenas[64] = {};
+    JobSystem jobs = {};
+    initJobSystem(4, &jobs);
+    parallelFor(&jobs, 0, 64, 1, [&](uint32 begin, uint32 end)
+    {
+        for(uint32 i = begin; i < end; i++)
+        {
+            uint32 width, height;
+            byte* pPixels = decodeImage(file, fileSize, false, &width, &height);
+            ASSERT(pPixels && width == 4 && height == 4);
+            ASSERT(((uint64)pPixels & 15) == 0);
+            ASSERT(pPixels[0] == file[header] && pPixels[3] == 255);
+            pArenas[i] = getImageArena();
+            ASSERT(pArenas[i]->mOffset);
+            resetImageArena();
+        }
+    });
+    destroyJobSystem(&jobs);
+
+    // Workers are gone, their arenas aren't until released
+    destroyImageArenas();
+    for(uint32 i = 0; i < 64; i++)
+    {
+        ASSERT(pArenas[i] && !pArenas[i]->pStart);
+    }
+
+    // The calling thread gets a new one
+    Arena* pArena = getImageArena();
+    ASSERT(pArena->pStart);
+    destroyImageArenas();
+    return true;
+}
+
+bool testAssets()
+{
+    LOG("[TEST-ASSET] Testing image arenas...");
+    testImageArenas();
+
+    LOG("[TEST-ASSET] Testing texture cooking...");
+    testTextureCook();
+
+    LOG("[TEST-ASSET] Testing shader cache...");
+    testShaderCache();
+
+    LOG("[TEST-ASSET] Testing shader compilation...");
+    testShaderCompile();
+
+    LOG("[TEST-ASSET] Testing shader hot reload...");
+    testShaderWatch();
+
+    LOG("[TEST-ASSET] Testing shader permutations...");
+    testShaderPermutation();
+
+    LOG("[TEST-ASSET] All asset tests passed.");
+    return true;
+}
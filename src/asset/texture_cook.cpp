@@ -0,0 +1,974 @@
+#include "texture_cook.hpp"
+#include "asset.hpp"
+#include "../core/file.hpp"
+#include "../core/debug.hpp"
+#include "../math/math.hpp"
+
+#define TEXTURE_COOK_KAISER_SUPPORT 3.f     // In destination pixels
+#define TEXTURE_COOK_KAISER_ALPHA   4.f
+#define TEXTURE_COOK_ROW_GRAIN      16      // Rows (or block rows) per job
+#define TEXTURE_COOK_REFINE_STEPS   2       // Least squares endpoint refinements per block
+
+// --------------------------------------
+// Helpers
+void cookParallelFor(JobSystem* pJobs, uint32 count, ParallelForProc proc, void* pData)
+{
+    if(pJobs)
+    {
+        parallelFor(pJobs, 0, count, TEXTURE_COOK_ROW_GRAIN, proc, pData);
+    }
+    else
+    {
+        proc(0, count, pData);
+    }
+}
+
+inline float srgbToLinear(float c)
+{
+    return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+inline float linearToSrgb(float c)
+{
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.f / 2.4f) - 0.055f;
+}
+
+inline byte cookToByte(float c)
+{
+    return (byte)(CLAMP(c, 0.f, 1.f) * 255.f + 0.5f);
+}
+
+uint32 getTextureBlobMipCount(uint32 width, uint32 height)
+{
+    uint32 count = 1;
+    uint32 size = MAX(width, height);
+    while(size > 1 && count < TEXTURE_BLOB_MAX_MIPS)
+    {
+        size >>= 1;
+        count++;
+    }
+    return count;
+}
+
+uint64 getTextureBlobMipSize(TextureBlobFormat format, uint32 width, uint32 height)
+{
+    uint64 blocks = (uint64)((width + 3) / 4) * ((height + 3) / 4);
+    switch(format)
+    {
+        case TEXTURE_BLOB_RGBA8:    return (uint64)width * height * 4;
+        case TEXTURE_BLOB_BC1:      return blocks * 8;
+        case TEXTURE_BLOB_BC3:
+        case TEXTURE_BLOB_BC5:
+        case TEXTURE_BLOB_BC7:      return blocks * 16;
+        default: ASSERT(!"Unknown texture blob format"); return 0;
+    }
+}
+
+// --------------------------------------
+// Mip filtering
+// Separable resampling of linear RGBA float images. Each destination pixel gathers the
+// source pixels under the kernel scaled to the footprint of one destination pixel, so
+// odd sizes are handled the same way as even ones. Edges are clamped.
+float cookBesselI0(float x)
+{
+    float sum = 1.f;
+    float term = 1.f;
+    float halfX = x * 0.5f;
+    for(uint32 k = 1; k < 32; k++)
+    {
+        term *= halfX / k;
+        sum += term * term;
+        if(term * term < sum * 1e-8f) break;
+    }
+    return sum;
+}
+
+float cookKernel(TextureMipFilter filter, float x)
+{
+    x = ABS(x);
+    if(filter == TEXTURE_MIP_FILTER_BOX)
+    {
+        return x < 0.5f ? 1.f : 0.f;
+    }
+
+    if(x >= TEXTURE_COOK_KAISER_SUPPORT) return 0.f;
+    float sinc = x < 1e-5f ? 1.f : sinf((float)PI * x) / ((float)PI * x);
+    float t = x / TEXTURE_COOK_KAISER_SUPPORT;
+    float window = cookBesselI0(TEXTURE_COOK_KAISER_ALPHA * sqrtf(1.f - t * t)) / cookBesselI0(TEXTURE_COOK_KAISER_ALPHA);
+    return sinc * window;
+}
+
+// Taps of every destination pixel along one axis
+struct CookTaps
+{
+    int32*  pFirst      = NULL;
+    float*  pWeights    = NULL;     // mMaxTaps per destination pixel
+    uint32  mMaxTaps    = 0;
+};
+
+void initCookTaps(TextureMipFilter filter, uint32 srcSize, uint32 dstSize, Arena* pArena, CookTaps* pTaps)
+{
+    float scale = (float)srcSize / dstSize;
+    float support = (filter == TEXTURE_MIP_FILTER_BOX ? 0.5f : TEXTURE_COOK_KAISER_SUPPORT) * scale;
+
+    pTaps->mMaxTaps = (uint32)ceilf(support * 2.f) + 1;
+    pTaps->pFirst = (int32*)arenaPush(pArena, sizeof(int32) * dstSize, alignof(int32));
+    pTaps->pWeights = (float*)arenaPushZero(pArena, sizeof(float) * dstSize * pTaps->mMaxTaps, alignof(float));
+    for(uint32 i = 0; i < dstSize; i++)
+    {
+        float center = (i + 0.5f) * scale - 0.5f;
+        int32 first = (int32)ceilf(center - support);
+        float* pWeights = pTaps->pWeights + i * pTaps->mMaxTaps;
+        float sum = 0.f;
+        for(uint32 k = 0; k < pTaps->mMaxTaps; k++)
+        {
+            pWeights[k] = cookKernel(filter, (first + (int32)k - center) / scale);
+            sum += pWeights[k];
+        }
+        ASSERT(sum > 0.f);
+        for(uint32 k = 0; k < pTaps->mMaxTaps; k++)
+        {
+            pWeights[k] /= sum;
+        }
+        pTaps->pFirst[i] = first;
+    }
+}
+
+struct CookResample
+{
+    float*      pSrc        = NULL;
+    float*      pDst        = NULL;
+    uint32      mSrcWidth   = 0;
+    uint32      mSrcHeight  = 0;
+    uint32      mDstWidth   = 0;
+    uint32      mDstHeight  = 0;
+    CookTaps    mTaps       = {};
+};
+
+// pSrc is mSrcWidth x mSrcHeight, pDst is mDstWidth x mSrcHeight
+void cookResampleRowsProc(uint32 begin, uint32 end, void* pData)
+{
+    CookResample* pResample = (CookResample*)pData;
+    CookTaps* pTaps = &pResample->mTaps;
+    int32 lastX = (int32)pResample->mSrcWidth - 1;
+    for(uint32 y = begin; y < end; y++)
+    {
+        float* pSrcRow = pResample->pSrc + (uint64)y * pResample->mSrcWidth * 4;
+        float* pDstRow = pResample->pDst + (uint64)y * pResample->mDstWidth * 4;
+        for(uint32 x = 0; x < pResample->mDstWidth; x++)
+        {
+            float* pWeights = pTaps->pWeights + x * pTaps->mMaxTaps;
+            float sum[4] = {};
+            for(uint32 k = 0; k < pTaps->mMaxTaps; k++)
+            {
+                float* pTexel = pSrcRow + CLAMP(pTaps->pFirst[x] + (int32)k, 0, lastX) * 4;
+                sum[0] += pTexel[0] * pWeights[k];
+                sum[1] += pTexel[1] * pWeights[k];
+                sum[2] += pTexel[2] * pWeights[k];
+                sum[3] += pTexel[3] * pWeights[k];
+            }
+            memcpy(pDstRow + x * 4, sum, sizeof(sum));
+        }
+    }
+}
+
+// pSrc is mDstWidth x mSrcHeight, pDst is mDstWidth x mDstHeight
+void cookResampleColumnsProc(uint32 begin, uint32 end, void* pData)
+{
+    CookResample* pResample = (CookResample*)pData;
+    CookTaps* pTaps = &pResample->mTaps;
+    int32 lastY = (int32)pResample->mSrcHeight - 1;
+    uint64 rowFloats = (uint64)pResample->mDstWidth * 4;
+    for(uint32 y = begin; y < end; y++)
+    {
+        float* pDstRow = pResample->pDst + y * rowFloats;
+        memset(pDstRow, 0, rowFloats * sizeof(float));
+        float* pWeights = pTaps->pWeights + y * pTaps->mMaxTaps;
+        for(uint32 k = 0; k < pTaps->mMaxTaps; k++)
+        {
+            if(pWeights[k] == 0.f) continue;
+            float* pSrcRow = pResample->pSrc + CLAMP(pTaps->pFirst[y] + (int32)k, 0, lastY) * rowFloats;
+            for(uint64 i = 0; i < rowFloats; i++)
+            {
+                pDstRow[i] += pSrcRow[i] * pWeights[k];
+            }
+        }
+    }
+}
+
+// Returns the next level, allocated from pArena.
+float* cookDownsample(TextureMipFilter filter, float* pSrc, uint32 srcWidth, uint32 srcHeight,
+        uint32 dstWidth, uint32 dstHeight, Arena* pArena, JobSystem* pJobs)
+{
+    float* pTemp = (float*)arenaPush(pArena, sizeof(float) * 4 * dstWidth * srcHeight, 64);
+    float* pDst = (float*)arenaPush(pArena, sizeof(float) * 4 * dstWidth * dstHeight, 64);
+
+    CookResample resample = {};
+    resample.mSrcWidth = srcWidth;
+    resample.mSrcHeight = srcHeight;
+    resample.mDstWidth = dstWidth;
+    resample.mDstHeight = dstHeight;
+
+    resample.pSrc = pSrc;
+    resample.pDst = pTemp;
+    initCookTaps(filter, srcWidth, dstWidth, pArena, &resample.mTaps);
+    cookParallelFor(pJobs, srcHeight, cookResampleRowsProc, &resample);
+
+    resample.pSrc = pTemp;
+    resample.pDst = pDst;
+    initCookTaps(filter, srcHeight, dstHeight, pArena, &resample.mTaps);
+    cookParallelFor(pJobs, dstHeight, cookResampleColumnsProc, &resample);
+
+    return pDst;
+}
+
+struct CookConvert
+{
+    byte*   pBytes      = NULL;
+    float*  pFloats     = NULL;
+    uint32  mWidth      = 0;
+    bool    mSrgb       = false;
+};
+
+void cookToFloatProc(uint32 begin, uint32 end, void* pData)
+{
+    CookConvert* pConvert = (CookConvert*)pData;
+    float toLinear[256];
+    for(uint32 i = 0; i < 256; i++)
+    {
+        toLinear[i] = pConvert->mSrgb ? srgbToLinear(i / 255.f) : i / 255.f;
+    }
+
+    for(uint64 i = (uint64)begin * pConvert->mWidth * 4; i < (uint64)end * pConvert->mWidth * 4; i++)
+    {
+        bool color = (i & 3) != 3;
+        pConvert->pFloats[i] = color ? toLinear[pConvert->pBytes[i]] : pConvert->pBytes[i] / 255.f;
+    }
+}
+
+void cookToBytesProc(uint32 begin, uint32 end, void* pData)
+{
+    CookConvert* pConvert = (CookConvert*)pData;
+    for(uint64 i = (uint64)begin * pConvert->mWidth * 4; i < (uint64)end * pConvert->mWidth * 4; i++)
+    {
+        float c = pConvert->pFloats[i];
+        bool color = (i & 3) != 3;
+        pConvert->pBytes[i] = cookToByte(pConvert->mSrgb && color ? linearToSrgb(CLAMP(c, 0.f, 1.f)) : c);
+    }
+}
+
+// --------------------------------------
+// Block compression
+// Endpoints come from the principal axis of the block's colors, then a few least
+// squares passes refit them to the chosen indices. Every candidate is measured
+// against the quantized palette the decoder will actually produce.
+static const uint32 sBC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct BcBits
+{
+    uint64  mData[2]    = {};
+    uint32  mPos        = 0;
+};
+
+inline void bcWriteBits(BcBits* pBits, uint32 value, uint32 count)
+{
+    for(uint32 i = 0; i < count; i++, pBits->mPos++)
+    {
+        pBits->mData[pBits->mPos >> 6] |= (uint64)((value >> i) & 1) << (pBits->mPos & 63);
+    }
+}
+
+inline uint32 bcReadBits(BcBits* pBits, uint32 count)
+{
+    uint32 value = 0;
+    for(uint32 i = 0; i < count; i++, pBits->mPos++)
+    {
+        value |= (uint32)((pBits->mData[pBits->mPos >> 6] >> (pBits->mPos & 63)) & 1) << i;
+    }
+    return value;
+}
+
+// Mean and dominant direction of the block's points (3 or 4 channels), axis is zero for flat blocks.
+void bcPrincipalAxis(float pPoints[16][4], uint32 channels, float* pMean, float* pAxis)
+{
+    for(uint32 c = 0; c < 4; c++)
+    {
+        pMean[c] = 0.f;
+        pAxis[c] = 0.f;
+    }
+    for(uint32 i = 0; i < 16; i++)
+    {
+        for(uint32 c = 0; c < channels; c++) pMean[c] += pPoints[i][c] / 16.f;
+    }
+
+    float cov[4][4] = {};
+    for(uint32 i = 0; i < 16; i++)
+    {
+        for(uint32 a = 0; a < channels; a++)
+        {
+            for(uint32 b = 0; b < channels; b++)
+            {
+                cov[a][b] += (pPoints[i][a] - pMean[a]) * (pPoints[i][b] - pMean[b]);
+            }
+        }
+    }
+
+    // Power iteration, starting from the channel with the largest variance
+    uint32 start = 0;
+    for(uint32 c = 1; c < channels; c++)
+    {
+        if(cov[c][c] > cov[start][start]) start = c;
+    }
+    if(cov[start][start] < 1e-3f) return;
+
+    float axis[4] = {};
+    for(uint32 c = 0; c < channels; c++) axis[c] = cov[start][c];
+    for(uint32 iter = 0; iter < 8; iter++)
+    {
+        float next[4] = {};
+        float length = 0.f;
+        for(uint32 a = 0; a < channels; a++)
+        {
+            for(uint32 b = 0; b < channels; b++) next[a] += cov[a][b] * axis[b];
+            length += next[a] * next[a];
+        }
+        if(length < 1e-12f) return;
+        length = 1.f / sqrtf(length);
+        for(uint32 c = 0; c < channels; c++) axis[c] = next[c] * length;
+    }
+    memcpy(pAxis, axis, sizeof(axis));
+}
+
+// Endpoints at the extremes of the points' projections on the axis
+void bcAxisEndpoints(float pPoints[16][4], uint32 channels, float* pMean, float* pAxis, float* pE0, float* pE1)
+{
+    float tMin = MAX_FLOAT, tMax = -MAX_FLOAT;
+    for(uint32 i = 0; i < 16; i++)
+    {
+        float t = 0.f;
+        for(uint32 c = 0; c < channels; c++) t += (pPoints[i][c] - pMean[c]) * pAxis[c];
+        tMin = MIN(tMin, t);
+        tMax = MAX(tMax, t);
+    }
+    if(tMin > tMax) tMin = tMax = 0.f;
+    for(uint32 c = 0; c < 4; c++)
+    {
+        pE0[c] = CLAMP(pMean[c] + pAxis[c] * tMax, 0.f, 255.f);
+        pE1[c] = CLAMP(pMean[c] + pAxis[c] * tMin, 0.f, 255.f);
+    }
+}
+
+// Least squares endpoints for the given index weights (on pE0), false when degenerate.
+bool bcRefitEndpoints(float pPoints[16][4], uint32 channels, float* pWeights, float* pE0, float* pE1)
+{
+    float aa = 0.f, ab = 0.f, bb = 0.f;
+    float ax[4] = {}, bx[4] = {};
+    for(uint32 i = 0; i < 16; i++)
+    {
+        float a = pWeights[i];
+        float b = 1.f - a;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for(uint32 c = 0; c < channels; c++)
+        {
+            ax[c] += a * pPoints[i][c];
+            bx[c] += b * pPoints[i][c];
+        }
+    }
+    float det = aa * bb - ab * ab;
+    if(ABS(det) < 1e-6f) return false;
+
+    det = 1.f / det;
+    for(uint32 c = 0; c < channels; c++)
+    {
+        pE0[c] = CLAMP((bb * ax[c] - ab * bx[c]) * det, 0.f, 255.f);
+        pE1[c] = CLAMP((aa * bx[c] - ab * ax[c]) * det, 0.f, 255.f);
+    }
+    return true;
+}
+
+inline uint16 bcPack565(float* pColor)
+{
+    uint32 r = (uint32)(CLAMP(pColor[0], 0.f, 255.f) * 31.f / 255.f + 0.5f);
+    uint32 g = (uint32)(CLAMP(pColor[1], 0.f, 255.f) * 63.f / 255.f + 0.5f);
+    uint32 b = (uint32)(CLAMP(pColor[2], 0.f, 255.f) * 31.f / 255.f + 0.5f);
+    return (uint16)((r << 11) | (g << 5) | b);
+}
+
+inline void bcUnpack565(uint16 color, int32* pOut)
+{
+    int32 r = color >> 11, g = (color >> 5) & 63, b = color & 31;
+    pOut[0] = (r << 3) | (r >> 2);
+    pOut[1] = (g << 2) | (g >> 4);
+    pOut[2] = (b << 3) | (b >> 2);
+}
+
+// 4 color palette, 3 color + black when c0 <= c1 unless forced (BC3 color blocks)
+void bcColorPalette(uint16 c0, uint16 c1, bool force4, int32 pPalette[4][4])
+{
+    bcUnpack565(c0, pPalette[0]);
+    bcUnpack565(c1, pPalette[1]);
+    pPalette[0][3] = pPalette[1][3] = 255;
+    for(uint32 c = 0; c < 3; c++)
+    {
+        if(c0 > c1 || force4)
+        {
+            pPalette[2][c] = (2 * pPalette[0][c] + pPalette[1][c]) / 3;
+            pPalette[3][c] = (pPalette[0][c] + 2 * pPalette[1][c]) / 3;
+        }
+        else
+        {
+            pPalette[2][c] = (pPalette[0][c] + pPalette[1][c]) / 2;
+            pPalette[3][c] = 0;
+        }
+    }
+    pPalette[2][3] = 255;
+    pPalette[3][3] = c0 > c1 || force4 ? 255 : 0;
+}
+
+void encodeBC1Block(byte pBlock[16][4], byte* pOut)
+{
+    static const float weights[4] = { 1.f, 0.f, 2.f / 3.f, 1.f / 3.f };
+
+    float points[16][4];
+    for(uint32 i = 0; i < 16; i++)
+    {
+        for(uint32 c = 0; c < 4; c++) points[i][c] = pBlock[i][c];
+    }
+
+    float mean[4], axis[4], e0[4], e1[4];
+    bcPrincipalAxis(points, 3, mean, axis);
+    bcAxisEndpoints(points, 3, mean, axis, e0, e1);
+
+    uint16 bestC0 = 0, bestC1 = 0;
+    uint32 bestIndices = 0;
+    int32 bestError = INT32_MAX;
+    for(uint32 step = 0; step <= TEXTURE_COOK_REFINE_STEPS; step++)
+    {
+        uint16 c0 = bcPack565(e0);
+        uint16 c1 = bcPack565(e1);
+        int32 palette[4][4];
+        bcColorPalette(c0, c1, true, palette);
+
+        uint32 indices = 0;
+        int32 error = 0;
+        float indexWeights[16];
+        for(uint32 i = 0; i < 16; i++)
+        {
+            int32 best = INT32_MAX;
+            uint32 bestIndex = 0;
+            for(uint32 j = 0; j < 4; j++)
+            {
+                int32 dr = pBlock[i][0] - palette[j][0];
+                int32 dg = pBlock[i][1] - palette[j][1];
+                int32 db = pBlock[i][2] - palette[j][2];
+                int32 d = dr * dr + dg * dg + db * db;
+                if(d < best)
+                {
+                    best = d;
+                    bestIndex = j;
+                }
+            }
+            indices |= bestIndex << (i * 2);
+            indexWeights[i] = weights[bestIndex];
+            error += best;
+        }
+
+        if(error < bestError)
+        {
+            bestError = error;
+            bestC0 = c0;
+            bestC1 = c1;
+            bestIndices = indices;
+        }
+        if(bestError == 0 || !bcRefitEndpoints(points, 3, indexWeights, e0, e1)) break;
+    }
+
+    // c0 > c1 selects the 4 color palette, swapping the endpoints swaps indices 0/1 and 2/3
+    if(bestC0 < bestC1)
+    {
+        uint16 temp = bestC0;
+        bestC0 = bestC1;
+        bestC1 = temp;
+        bestIndices ^= 0x55555555;
+    }
+    else if(bestC0 == bestC1)
+    {
+        bestIndices = 0;
+    }
+
+    pOut[0] = (byte)bestC0;
+    pOut[1] = (byte)(bestC0 >> 8);
+    pOut[2] = (byte)bestC1;
+    pOut[3] = (byte)(bestC1 >> 8);
+    memcpy(pOut + 4, &bestIndices, 4);
+}
+
+void decodeBC1Block(byte* pBlock, bool force4, byte pOut[16][4])
+{
+    uint16 c0 = (uint16)(pBlock[0] | (pBlock[1] << 8));
+    uint16 c1 = (uint16)(pBlock[2] | (pBlock[3] << 8));
+    uint32 indices;
+    memcpy(&indices, pBlock + 4, 4);
+
+    int32 palette[4][4];
+    bcColorPalette(c0, c1, force4, palette);
+    for(uint32 i = 0; i < 16; i++)
+    {
+        uint32 index = (indices >> (i * 2)) & 3;
+        for(uint32 c = 0; c < 4; c++) pOut[i][c] = (byte)palette[index][c];
+    }
+}
+
+void bcChannelPalette(uint32 a0, uint32 a1, int32 pPalette[8])
+{
+    pPalette[0] = a0;
+    pPalette[1] = a1;
+    if(a0 > a1)
+    {
+        for(uint32 i = 2; i < 8; i++) pPalette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+    }
+    else
+    {
+        for(uint32 i = 2; i < 6; i++) pPalette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+        pPalette[6] = 0;
+        pPalette[7] = 255;
+    }
+}
+
+// Single channel block (BC3 alpha, BC5 red/green), channel picks the byte of each texel
+void encodeBC4Block(byte pBlock[16][4], uint32 channel, byte* pOut)
+{
+    uint32 lo = 255, hi = 0;
+    for(uint32 i = 0; i < 16; i++)
+    {
+        lo = MIN(lo, (uint32)pBlock[i][channel]);
+        hi = MAX(hi, (uint32)pBlock[i][channel]);
+    }
+
+    uint64 indices = 0;
+    if(lo != hi)
+    {
+        int32 palette[8];
+        bcChannelPalette(hi, lo, palette);
+        for(uint32 i = 0; i < 16; i++)
+        {
+            int32 best = INT32_MAX;
+            uint64 bestIndex = 0;
+            for(uint32 j = 0; j < 8; j++)
+            {
+                int32 d = ABS((int32)pBlock[i][channel] - palette[j]);
+                if(d < best)
+                {
+                    best = d;
+                    bestIndex = j;
+                }
+            }
+            indices |= bestIndex << (i * 3);
+        }
+    }
+
+    pOut[0] = (byte)hi;
+    pOut[1] = (byte)lo;
+    for(uint32 i = 0; i < 6; i++) pOut[2 + i] = (byte)(indices >> (i * 8));
+}
+
+void decodeBC4Block(byte* pBlock, uint32 channel, byte pOut[16][4])
+{
+    int32 palette[8];
+    bcChannelPalette(pBlock[0], pBlock[1], palette);
+    uint64 indices = 0;
+    for(uint32 i = 0; i < 6; i++) indices |= (uint64)pBlock[2 + i] << (i * 8);
+    for(uint32 i = 0; i < 16; i++)
+    {
+        pOut[i][channel] = (byte)palette[(indices >> (i * 3)) & 7];
+    }
+}
+
+// 7 bit endpoint plus the p-bit shared by its channels, returns the 8 bit endpoint in pOut
+void bc7QuantizeEndpoint(float* pEndpoint, uint32* pCodes, uint32* pPBit, int32* pOut)
+{
+    float bestError = MAX_FLOAT;
+    for(uint32 p = 0; p < 2; p++)
+    {
+        uint32 codes[4];
+        float error = 0.f;
+        for(uint32 c = 0; c < 4; c++)
+        {
+            int32 code = (int32)((pEndpoint[c] - p) * 0.5f + 0.5f);
+            codes[c] = (uint32)CLAMP(code, 0, 127);
+            float d = (float)((codes[c] << 1) | p) - pEndpoint[c];
+            error += d * d;
+        }
+        if(error < bestError)
+        {
+            bestError = error;
+            *pPBit = p;
+            for(uint32 c = 0; c < 4; c++)
+            {
+                pCodes[c] = codes[c];
+                pOut[c] = (int32)((codes[c] << 1) | p);
+            }
+        }
+    }
+}
+
+// Mode 6: one subset, RGBA 7.7.7.7 endpoints with p-bits, 4 bit indices
+void encodeBC7Block(byte pBlock[16][4], byte* pOut)
+{
+    float points[16][4];
+    for(uint32 i = 0; i < 16; i++)
+    {
+        for(uint32 c = 0; c < 4; c++) points[i][c] = pBlock[i][c];
+    }
+
+    float mean[4], axis[4], e0[4], e1[4];
+    bcPrincipalAxis(points, 4, mean, axis);
+    bcAxisEndpoints(points, 4, mean, axis, e0, e1);
+
+    uint32 bestCodes[2][4] = {}, bestPBits[2] = {}, bestIndices[16] = {};
+    int32 bestError = INT32_MAX;
+    for(uint32 step = 0; step <= TEXTURE_COOK_REFINE_STEPS; step++)
+    {
+        uint32 codes[2][4], pBits[2];
+        int32 q0[4], q1[4];
+        bc7QuantizeEndpoint(e0, codes[0], &pBits[0], q0);
+        bc7QuantizeEndpoint(e1, codes[1], &pBits[1], q1);
+
+        int32 palette[16][4];
+        for(uint32 j = 0; j < 16; j++)
+        {
+            for(uint32 c = 0; c < 4; c++)
+            {
+                palette[j][c] = ((64 - sBC7Weights[j]) * q0[c] + sBC7Weights[j] * q1[c] + 32) >> 6;
+            }
+        }
+
+        uint32 indices[16];
+        float indexWeights[16];
+        int32 error = 0;
+        for(uint32 i = 0; i < 16; i++)
+        {
+            int32 best = INT32_MAX;
+            for(uint32 j = 0; j < 16; j++)
+            {
+                int32 d = 0;
+                for(uint32 c = 0; c < 4; c++)
+                {
+                    int32 diff = pBlock[i][c] - palette[j][c];
+                    d += diff * diff;
+                }
+                if(d < best)
+                {
+                    best = d;
+                    indices[i] = j;
+                }
+            }
+            indexWeights[i] = 1.f - sBC7Weights[indices[i]] / 64.f;
+            error += best;
+        }
+
+        if(error < bestError)
+        {
+            bestError = error;
+            memcpy(bestCodes, codes, sizeof(codes));
+            memcpy(bestPBits, pBits, sizeof(pBits));
+            memcpy(bestIndices, indices, sizeof(indices));
+        }
+        if(bestError == 0 || !bcRefitEndpoints(points, 4, indexWeights, e0, e1)) break;
+    }
+
+    // The anchor (first) index is stored without its top bit, swapping the endpoints clears it
+    uint32 first = 0, second = 1;
+    if(bestIndices[0] & 8)
+    {
+        first = 1;
+        second = 0;
+        for(uint32 i = 0; i < 16; i++) bestIndices[i] = 15 - bestIndices[i];
+    }
+
+    BcBits bits = {};
+    bcWriteBits(&bits, 1 << 6, 7);
+    for(uint32 c = 0; c < 4; c++)
+    {
+        bcWriteBits(&bits, bestCodes[first][c], 7);
+        bcWriteBits(&bits, bestCodes[second][c], 7);
+    }
+    bcWriteBits(&bits, bestPBits[first], 1);
+    bcWriteBits(&bits, bestPBits[second], 1);
+    bcWriteBits(&bits, bestIndices[0], 3);
+    for(uint32 i = 1; i < 16; i++) bcWriteBits(&bits, bestIndices[i], 4);
+    ASSERT(bits.mPos == 128);
+    memcpy(pOut, bits.mData, 16);
+}
+
+void decodeBC7Block(byte* pBlock, byte pOut[16][4])
+{
+    BcBits bits = {};
+    memcpy(bits.mData, pBlock, 16);
+    if(bcReadBits(&bits, 7) != 1 << 6)
+    {
+        // Only mode 6 is produced by the encoder
+        memset(pOut, 0, 16 * 4);
+        return;
+    }
+
+    uint32 codes[2][4];
+    for(uint32 c = 0; c < 4; c++)
+    {
+        codes[0][c] = bcReadBits(&bits, 7);
+        codes[1][c] = bcReadBits(&bits, 7);
+    }
+    uint32 p0 = bcReadBits(&bits, 1);
+    uint32 p1 = bcReadBits(&bits, 1);
+    for(uint32 i = 0; i < 16; i++)
+    {
+        uint32 index = bcReadBits(&bits, i == 0 ? 3 : 4);
+        for(uint32 c = 0; c < 4; c++)
+        {
+            uint32 e0 = (codes[0][c] << 1) | p0;
+            uint32 e1 = (codes[1][c] << 1) | p1;
+            pOut[i][c] = (byte)(((64 - sBC7Weights[index]) * e0 + sBC7Weights[index] * e1 + 32) >> 6);
+        }
+    }
+}
+
+struct CookBlocks
+{
+    TextureBlobFormat   mFormat     = TEXTURE_BLOB_RGBA8;
+    byte*               pPixels     = NULL;
+    byte*               pBlocks     = NULL;
+    uint32              mWidth      = 0;
+    uint32              mHeight     = 0;
+};
+
+inline uint32 getCookBlockSize(TextureBlobFormat format)
+{
+    return format == TEXTURE_BLOB_BC1 ? 8 : 16;
+}
+
+void cookEncodeProc(uint32 begin, uint32 end, void* pData)
+{
+    CookBlocks* pCook = (CookBlocks*)pData;
+    uint32 blocksX = (pCook->mWidth + 3) / 4;
+    uint32 blockSize = getCookBlockSize(pCook->mFormat);
+    for(uint32 by = begin; by < end; by++)
+    {
+        for(uint32 bx = 0; bx < blocksX; bx++)
+        {
+            // Partial blocks repeat the edge texels
+            byte block[16][4];
+            for(uint32 i = 0; i < 16; i++)
+            {
+                uint32 x = MIN(bx * 4 + (i & 3), pCook->mWidth - 1);
+                uint32 y = MIN(by * 4 + (i >> 2), pCook->mHeight - 1);
+                memcpy(block[i], pCook->pPixels + ((uint64)y * pCook->mWidth + x) * 4, 4);
+            }
+
+            byte* pOut = pCook->pBlocks + ((uint64)by * blocksX + bx) * blockSize;
+            switch(pCook->mFormat)
+            {
+                case TEXTURE_BLOB_BC1:
+                    encodeBC1Block(block, pOut);
+                    break;
+                case TEXTURE_BLOB_BC3:
+                    encodeBC4Block(block, 3, pOut);
+                    encodeBC1Block(block, pOut + 8);
+                    break;
+                case TEXTURE_BLOB_BC5:
+                    encodeBC4Block(block, 0, pOut);
+                    encodeBC4Block(block, 1, pOut + 8);
+                    break;
+                case TEXTURE_BLOB_BC7:
+                    encodeBC7Block(block, pOut);
+                    break;
+                default: ASSERT(!"Not a block compressed format");
+            }
+        }
+    }
+}
+
+void encodeTextureBlocks(TextureBlobFormat format, byte* pPixels, uint32 width, uint32 height, byte* pOut, JobSystem* pJobs)
+{
+    ASSERT(pPixels && pOut);
+    ASSERT(format != TEXTURE_BLOB_RGBA8 && format < TEXTURE_BLOB_FORMAT_COUNT);
+
+    CookBlocks cook = {};
+    cook.mFormat = format;
+    cook.pPixels = pPixels;
+    cook.pBlocks = pOut;
+    cook.mWidth = width;
+    cook.mHeight = height;
+    cookParallelFor(pJobs, (height + 3) / 4, cookEncodeProc, &cook);
+}
+
+void decodeTextureBlocks(TextureBlobFormat format, byte* pBlocks, uint32 width, uint32 height, byte* pOut)
+{
+    ASSERT(pBlocks && pOut);
+    ASSERT(format != TEXTURE_BLOB_RGBA8 && format < TEXTURE_BLOB_FORMAT_COUNT);
+
+    uint32 blocksX = (width + 3) / 4;
+    uint32 blockSize = getCookBlockSize(format);
+    for(uint32 by = 0; by < (height + 3) / 4; by++)
+    {
+        for(uint32 bx = 0; bx < blocksX; bx++)
+        {
+            byte* pBlock = pBlocks + ((uint64)by * blocksX + bx) * blockSize;
+            byte block[16][4];
+            switch(format)
+            {
+                case TEXTURE_BLOB_BC1:
+                    decodeBC1Block(pBlock, false, block);
+                    break;
+                case TEXTURE_BLOB_BC3:
+                    decodeBC1Block(pBlock + 8, true, block);
+                    decodeBC4Block(pBlock, 3, block);
+                    break;
+                case TEXTURE_BLOB_BC5:
+                    for(uint32 i = 0; i < 16; i++)
+                    {
+                        block[i][2] = 0;
+                        block[i][3] = 255;
+                    }
+                    decodeBC4Block(pBlock, 0, block);
+                    decodeBC4Block(pBlock + 8, 1, block);
+                    break;
+                case TEXTURE_BLOB_BC7:
+                    decodeBC7Block(pBlock, block);
+                    break;
+                default: break;
+            }
+
+            for(uint32 i = 0; i < 16; i++)
+            {
+                uint32 x = bx * 4 + (i & 3);
+                uint32 y = by * 4 + (i >> 2);
+                if(x >= width || y >= height) continue;
+                memcpy(pOut + ((uint64)y * width + x) * 4, block[i], 4);
+            }
+        }
+    }
+}
+
+// --------------------------------------
+// Blob
+void cookMip(TextureBlobFormat format, byte* pPixels, uint32 width, uint32 height, byte* pOut, JobSystem* pJobs)
+{
+    if(format == TEXTURE_BLOB_RGBA8)
+    {
+        memcpy(pOut, pPixels, (uint64)width * height * 4);
+    }
+    else
+    {
+        encodeTextureBlocks(format, pPixels, width, height, pOut, pJobs);
+    }
+}
+
+byte* cookTexture(TextureCookDesc desc, byte* pPixels, uint32 width, uint32 height, Arena* pArena, uint64* pOutSize)
+{
+    ASSERT(pPixels && pArena && pOutSize);
+    ASSERT(width > 0 && height > 0);
+    ASSERT(width <= TEXTURE_BLOB_MAX_SIZE && height <= TEXTURE_BLOB_MAX_SIZE);
+    ASSERT(desc.mFormat < TEXTURE_BLOB_FORMAT_COUNT);
+
+    TextureBlobHeader header = {};
+    header.mFormat = desc.mFormat;
+    header.mFlags = desc.mSrgb ? TEXTURE_BLOB_FLAG_SRGB : 0;
+    header.mWidth = width;
+    header.mHeight = height;
+    header.mMipCount = desc.mMips ? getTextureBlobMipCount(width, height) : 1;
+
+    uint64 offset = ALIGN_TO(sizeof(TextureBlobHeader), TEXTURE_BLOB_ALIGN);
+    for(uint32 i = 0; i < header.mMipCount; i++)
+    {
+        TextureBlobMip* pMip = &header.mMips[i];
+        pMip->mWidth = MAX(width >> i, 1u);
+        pMip->mHeight = MAX(height >> i, 1u);
+        pMip->mOffset = offset;
+        pMip->mSize = getTextureBlobMipSize(desc.mFormat, pMip->mWidth, pMip->mHeight);
+        offset += ALIGN_TO(pMip->mSize, TEXTURE_BLOB_ALIGN);
+    }
+
+    byte* pBlob = (byte*)arenaPushZero(pArena, offset, TEXTURE_BLOB_ALIGN);
+    memcpy(pBlob, &header, sizeof(header));
+    *pOutSize = offset;
+
+    cookMip(desc.mFormat, pPixels, width, height, pBlob + header.mMips[0].mOffset, desc.pJobs);
+    if(header.mMipCount == 1) return pBlob;
+
+    // Every level is filtered from the previous one, kept as linear floats
+    ScratchScope scratch(pArena);
+    CookConvert convert = {};
+    convert.pBytes = pPixels;
+    convert.pFloats = (float*)arenaPush(scratch.pArena, sizeof(float) * 4 * width * height, 64);
+    convert.mWidth = width;
+    convert.mSrgb = desc.mSrgb;
+    cookParallelFor(desc.pJobs, height, cookToFloatProc, &convert);
+
+    byte* pMipPixels = (byte*)arenaPush(scratch.pArena, (uint64)header.mMips[1].mWidth * header.mMips[1].mHeight * 4);
+    for(uint32 i = 1; i < header.mMipCount; i++)
+    {
+        TextureBlobMip* pPrev = &header.mMips[i - 1];
+        TextureBlobMip* pMip = &header.mMips[i];
+        convert.pFloats = cookDownsample(desc.mMipFilter, convert.pFloats, pPrev->mWidth, pPrev->mHeight,
+                pMip->mWidth, pMip->mHeight, scratch.pArena, desc.pJobs);
+        convert.pBytes = pMipPixels;
+        convert.mWidth = pMip->mWidth;
+        cookParallelFor(desc.pJobs, pMip->mHeight, cookToBytesProc, &convert);
+
+        cookMip(desc.mFormat, pMipPixels, pMip->mWidth, pMip->mHeight, pBlob + pMip->mOffset, desc.pJobs);
+    }
+
+    return pBlob;
+}
+
+bool cookTextureFile(TextureCookDesc desc, String srcPath, String dstPath)
+{
+    FileView file = {};
+    if(!mapFile(srcPath, &file)) return false;
+
+    uint32 width, height;
+    byte* pPixels = decodeImage(file.pData, file.mSize, desc.mFlipVertical, &width, &height);
+    unmapFile(&file);
+    if(!pPixels)
+    {
+        resetImageArena();
+        return false;
+    }
+
+    ScratchScope scratch;
+    uint64 blobSize = 0;
+    byte* pBlob = cookTexture(desc, pPixels, width, height, scratch.pArena, &blobSize);
+    resetImageArena();
+    return writeFile(dstPath, pBlob, blobSize) == blobSize;
+}
+
+TextureBlobHeader* getTextureBlob(byte* pData, uint64 size)
+{
+    if(!pData || size < sizeof(TextureBlobHeader)) return NULL;
+
+    TextureBlobHeader* pHeader = (TextureBlobHeader*)pData;
+    if(pHeader->mMagic != TEXTURE_BLOB_MAGIC || pHeader->mVersion != TEXTURE_BLOB_VERSION) return NULL;
+    if(pHeader->mFormat >= TEXTURE_BLOB_FORMAT_COUNT) return NULL;
+    if(pHeader->mWidth == 0 || pHeader->mWidth > TEXTURE_BLOB_MAX_SIZE) return NULL;
+    if(pHeader->mHeight == 0 || pHeader->mHeight > TEXTURE_BLOB_MAX_SIZE) return NULL;
+    uint32 maxMips = getTextureBlobMipCount(pHeader->mWidth, pHeader->mHeight);
+    if(pHeader->mMipCount == 0 || pHeader->mMipCount > maxMips) return NULL;
+
+    // Uploads copy each mip by its dimensions, so a mip must be the level it claims to be,
+    // hold as much data as that level needs and lie whole in the blob after the previous one
+    uint64 end = sizeof(TextureBlobHeader);
+    for(uint32 i = 0; i < pHeader->mMipCount; i++)
+    {
+        TextureBlobMip* pMip = &pHeader->mMips[i];
+        uint32 width = MAX(pHeader->mWidth >> i, 1u);
+        uint32 height = MAX(pHeader->mHeight >> i, 1u);
+        if(pMip->mWidth != width || pMip->mHeight != height) return NULL;
+        if(pMip->mSize != getTextureBlobMipSize(pHeader->mFormat, width, height)) return NULL;
+        if(pMip->mOffset % TEXTURE_BLOB_ALIGN || pMip->mOffset < end) return NULL;
+        if(pMip->mOffset > size || pMip->mSize > size - pMip->mOffset) return NULL;
+        end = pMip->mOffset + pMip->mSize;
+    }
+    return pHeader;
+}
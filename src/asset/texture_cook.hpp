@@ -0,0 +1,90 @@
+#pragma once
+#include "../core/base.hpp"
+#include "../core/memory.hpp"
+#include "../core/string.hpp"
+#include "../core/jobs.hpp"
+
+// Texture cooking
+// Offline step turning RGBA8 images into texture blobs: a versioned header followed by
+// the whole mip chain, filtered on the CPU and optionally block compressed. loadTexture
+// recognizes blobs by their header and uploads them as they are, without decoding or
+// generating mips on the GPU.
+//
+//  TextureCookDesc desc = {};
+//  desc.mFormat = TEXTURE_BLOB_BC7;
+//  desc.pJobs = &jobs;
+//  cookTextureFile(desc, str("assets/albedo.png"), str("assets/albedo.dwtex"));
+#define TEXTURE_BLOB_MAGIC      0x58545744      // "DWTX"
+#define TEXTURE_BLOB_VERSION    1
+#define TEXTURE_BLOB_MAX_MIPS   16
+#define TEXTURE_BLOB_MAX_SIZE   65536           // Of either side, keeps mip sizes from overflowing
+#define TEXTURE_BLOB_ALIGN      16              // Of each mip's data, multiple of every block size
+
+enum TextureBlobFormat : uint32
+{
+    TEXTURE_BLOB_RGBA8 = 0,
+    TEXTURE_BLOB_BC1,           // RGB, opaque
+    TEXTURE_BLOB_BC3,           // RGBA
+    TEXTURE_BLOB_BC5,           // RG, for normal maps
+    TEXTURE_BLOB_BC7,           // RGBA, mode 6 only
+    TEXTURE_BLOB_FORMAT_COUNT,
+};
+
+enum TextureMipFilter : uint32
+{
+    TEXTURE_MIP_FILTER_BOX = 0,
+    TEXTURE_MIP_FILTER_KAISER,  // Kaiser windowed sinc, sharper than box without ringing much
+};
+
+enum TextureBlobFlags : uint32
+{
+    TEXTURE_BLOB_FLAG_SRGB = 1 << 0,    // Color data, mips are filtered in linear space
+};
+
+struct TextureBlobMip
+{
+    uint64  mOffset     = 0;    // From the start of the blob
+    uint64  mSize       = 0;
+    uint32  mWidth      = 0;
+    uint32  mHeight     = 0;
+};
+
+struct TextureBlobHeader
+{
+    uint32              mMagic      = TEXTURE_BLOB_MAGIC;
+    uint32              mVersion    = TEXTURE_BLOB_VERSION;
+    TextureBlobFormat   mFormat     = TEXTURE_BLOB_RGBA8;
+    uint32              mFlags      = 0;
+    uint32              mWidth      = 0;
+    uint32              mHeight     = 0;
+    uint32              mMipCount   = 0;
+    uint32              mPadding    = 0;
+    TextureBlobMip      mMips[TEXTURE_BLOB_MAX_MIPS];
+};
+
+struct TextureCookDesc
+{
+    TextureBlobFormat   mFormat         = TEXTURE_BLOB_RGBA8;
+    TextureMipFilter    mMipFilter      = TEXTURE_MIP_FILTER_KAISER;
+    bool                mSrgb           = true;
+    bool                mMips           = true;     // Full chain down to 1x1, only the base level otherwise
+    bool                mFlipVertical   = false;    // Only used by cookTextureFile
+    JobSystem*          pJobs           = NULL;     // Cooks on the calling thread when NULL
+};
+
+// Returns the blob, allocated from pArena.
+byte*   cookTexture(TextureCookDesc desc, byte* pPixels, uint32 width, uint32 height, Arena* pArena, uint64* pOutSize);
+// Decodes srcPath with stb_image and writes the blob to dstPath.
+bool    cookTextureFile(TextureCookDesc desc, String srcPath, String dstPath);
+
+// Returns NULL unless pData holds a complete blob of the current version, with every mip
+// of the halved chain in bounds and of the size its format needs.
+TextureBlobHeader*  getTextureBlob(byte* pData, uint64 size);
+
+uint32  getTextureBlobMipCount(uint32 width, uint32 height);
+uint64  getTextureBlobMipSize(TextureBlobFormat format, uint32 width, uint32 height);
+
+// Block compression of a whole RGBA8 image, width x height rounded up to 4x4 blocks.
+// Decoding writes RGBA8 again (BC5 as RG, B = 0, A = 255), used to measure the encoders.
+void    encodeTextureBlocks(TextureBlobFormat format, byte* pPixels, uint32 width, uint32 height, byte* pOut, JobSystem* pJobs);
+void    decodeTextureBlocks(TextureBlobFormat format, byte* pBlocks, uint32 width, uint32 height, byte* pOut);
@@ -0,0 +1,333 @@
+#include "texture_stream.hpp"
+#include "asset.hpp"
+#include "../core/file.hpp"
+#include "../core/debug.hpp"
+
+enum TextureRequestState : uint32
+{
+    TEXTURE_REQUEST_QUEUED = 0,
+    TEXTURE_REQUEST_DECODING,       // Decode job running
+    TEXTURE_REQUEST_DECODED,
+    TEXTURE_REQUEST_DECODE_FAILED,
+    TEXTURE_REQUEST_STAGING,        // Copy job running
+    TEXTURE_REQUEST_STAGED,
+    TEXTURE_REQUEST_SUBMITTED,
+    TEXTURE_REQUEST_READY,
+    TEXTURE_REQUEST_FAILED,
+};
+
+struct TextureRequest
+{
+    TextureStreamer*    pStreamer       = NULL;
+    char                mPath[TEXTURE_STREAM_MAX_PATH];
+    uint32              mPathLen        = 0;
+    uint32              mFormat         = 0;
+    bool                mFlip           = false;
+    uint32              mState          = TEXTURE_REQUEST_QUEUED;   // Written by jobs, atomic
+
+    // Decoded image, in the decoder's arena
+    uint32              mDecoder        = 0;
+    byte*               pPixels         = NULL;
+    uint32              mWidth          = 0;
+    uint32              mHeight         = 0;
+    uint64              mSize           = 0;
+    uint64              mFileSize       = 0;
+
+    uint64              mStagingOffset  = 0;
+    uint64              mStagingEnd     = 0;    // Ring head right after the allocation
+    Texture*            pTexture        = NULL;
+};
+
+bool stagingRingAlloc(StagingRing* pRing, uint64 size, uint64 alignment, uint64* pOffset)
+{
+    ASSERT(pRing && pOffset);
+    ASSERT(pRing->mSize % alignment == 0);
+    if(size > pRing->mSize) return false;
+
+    uint64 start = pRing->mHead;
+    uint64 wrapped = start % pRing->mSize;
+    uint64 offset = ALIGN_TO(wrapped, alignment);
+    if(offset + size > pRing->mSize)
+    {
+        // Not enough room before the end, skipping to the start of the ring
+        start += pRing->mSize - wrapped;
+        offset = 0;
+    }
+    else
+    {
+        start += offset - wrapped;
+    }
+
+    uint64 end = start + size;
+    if(end - pRing->mTail > pRing->mSize) return false;
+
+    pRing->mHead = end;
+    *pOffset = offset;
+    return true;
+}
+
+void stagingRingRelease(StagingRing* pRing, uint64 end)
+{
+    ASSERT(pRing);
+    ASSERT(end >= pRing->mTail && end <= pRing->mHead);
+    pRing->mTail = end;
+}
+
+void textureDecodeProc(void* pData)
+{
+    TextureRequest* pRequest = (TextureRequest*)pData;
+    Arena* pArena = &pRequest->pStreamer->mDecoders[pRequest->mDecoder].mArena;
+    String path = str((byte*)pRequest->mPath, pRequest->mPathLen);
+
+    uint32 state = TEXTURE_REQUEST_DECODE_FAILED;
+    FileView file = {};
+    if(mapFile(path, &file))
+    {
+        // Decoding into the decoder arena, the pixels stay there until staged. The
+        // compressed file is read from the mapping and never copied.
+        Arena* pPrevious = setImageArena(pArena);
+        uint32 width, height;
+        byte* pPixels = decodeImage(file.pData, file.mSize, pRequest->mFlip, &width, &height);
+        setImageArena(pPrevious);
+        uint64 fileSize = file.mSize;
+        unmapFile(&file);
+
+        if(pPixels)
+        {
+            pRequest->pPixels = pPixels;
+            pRequest->mWidth = width;
+            pRequest->mHeight = height;
+            pRequest->mSize = (uint64)width * height * 4;
+            pRequest->mFileSize = fileSize;
+            state = TEXTURE_REQUEST_DECODED;
+        }
+    }
+    atomicStore(&pRequest->mState, state);
+}
+
+void textureStageProc(void* pData)
+{
+    TextureRequest* pRequest = (TextureRequest*)pData;
+    TextureStreamer* pStreamer = pRequest->pStreamer;
+    memcpy(pStreamer->mDesc.pStaging + pRequest->mStagingOffset, pRequest->pPixels, pRequest->mSize);
+    atomicStore(&pRequest->mState, (uint32)TEXTURE_REQUEST_STAGED);
+}
+
+void initTextureStreamer(TextureStreamerDesc desc, TextureStreamer* pStreamer)
+{
+    ASSERT(pStreamer);
+    ASSERT(desc.pJobs && desc.mSink.pfnSubmit && desc.mSink.pfnIsComplete);
+    ASSERT(desc.pStaging && desc.mStagingSize % TEXTURE_STREAM_STAGING_ALIGN == 0);
+    ASSERT(desc.mMaxDecodes > 0 && desc.mMaxDecodes <= TEXTURE_STREAM_MAX_DECODES);
+
+    *pStreamer = {};
+    pStreamer->mDesc = desc;
+    pStreamer->mRing.mSize = desc.mStagingSize;
+    initPool(sizeof(TextureRequest), TEXTURE_STREAM_MAX_REQUESTS, &pStreamer->mRequests);
+    for(uint32 i = 0; i < desc.mMaxDecodes; i++)
+    {
+        initArena(TEXTURE_STREAM_DECODER_ARENA, &pStreamer->mDecoders[i].mArena);
+    }
+}
+
+void destroyTextureStreamer(TextureStreamer* pStreamer)
+{
+    ASSERT(pStreamer);
+
+    waitJobs(pStreamer->mDesc.pJobs, &pStreamer->mJobCounter);
+    TextureUploadSink* pSink = &pStreamer->mDesc.mSink;
+    for(uint32 i = pStreamer->mBatchTail; i != pStreamer->mBatchHead; i++)
+    {
+        TextureStreamer::Batch* pBatch = &pStreamer->mBatches[i % TEXTURE_STREAM_MAX_BATCHES];
+        while(!pSink->pfnIsComplete(pSink->pUserData, pBatch->mSinkId))
+        {
+            yieldThread();
+        }
+    }
+
+    for(uint32 i = 0; i < pStreamer->mDesc.mMaxDecodes; i++)
+    {
+        destroyArena(&pStreamer->mDecoders[i].mArena);
+    }
+    destroyPool(&pStreamer->mRequests);
+    *pStreamer = {};
+}
+
+TextureTicket requestTexture(TextureStreamer* pStreamer, String path, uint32 format, bool flipVertical)
+{
+    ASSERT(pStreamer);
+    ASSERT(path.mLen < TEXTURE_STREAM_MAX_PATH);
+
+    TextureTicket ticket = poolAllocHandle(&pStreamer->mRequests);
+    if(ticket == HND_INVALID) return HND_INVALID;
+
+    TextureRequest* pRequest = (TextureRequest*)poolGet(&pStreamer->mRequests, ticket);
+    *pRequest = {};
+    pRequest->pStreamer = pStreamer;
+    memcpy(pRequest->mPath, path.mData, path.mLen);
+    pRequest->mPath[path.mLen] = 0;
+    pRequest->mPathLen = (uint32)path.mLen;
+    pRequest->mFormat = format;
+    pRequest->mFlip = flipVertical;
+
+    pStreamer->mQueue[pStreamer->mQueueHead++ % TEXTURE_STREAM_MAX_REQUESTS] = ticket;
+    pStreamer->mStats.mRequested++;
+    return ticket;
+}
+
+inline TextureRequest* getTextureRequest(TextureStreamer* pStreamer, TextureTicket ticket)
+{
+    TextureRequest* pRequest = (TextureRequest*)poolGet(&pStreamer->mRequests, ticket);
+    ASSERT(pRequest);
+    return pRequest;
+}
+
+void freeTextureDecoder(TextureStreamer* pStreamer, TextureRequest* pRequest)
+{
+    TextureStreamer::Decoder* pDecoder = &pStreamer->mDecoders[pRequest->mDecoder];
+    arenaClear(&pDecoder->mArena);
+    pDecoder->mRequest = HND_INVALID;
+    pRequest->pPixels = NULL;
+}
+
+void updateTextureStreamer(TextureStreamer* pStreamer)
+{
+    ASSERT(pStreamer);
+    TextureStreamerDesc* pDesc = &pStreamer->mDesc;
+    TextureUploadSink* pSink = &pDesc->mSink;
+
+    // Retiring complete batches, in order since they free the ring in order
+    while(pStreamer->mBatchTail != pStreamer->mBatchHead)
+    {
+        TextureStreamer::Batch* pBatch = &pStreamer->mBatches[pStreamer->mBatchTail % TEXTURE_STREAM_MAX_BATCHES];
+        if(!pSink->pfnIsComplete(pSink->pUserData, pBatch->mSinkId)) break;
+
+        stagingRingRelease(&pStreamer->mRing, pBatch->mStagingEnd);
+        for(uint32 i = 0; i < pBatch->mCount; i++)
+        {
+            TextureRequest* pRequest = getTextureRequest(pStreamer, pBatch->mRequests[i]);
+            atomicStore(&pRequest->mState, (uint32)TEXTURE_REQUEST_READY);
+        }
+        pStreamer->mStats.mReady += pBatch->mCount;
+        pStreamer->mBatchTail++;
+    }
+
+    // Finished decodes get staging space, the copy runs as a job
+    for(uint32 i = 0; i < pDesc->mMaxDecodes; i++)
+    {
+        TextureStreamer::Decoder* pDecoder = &pStreamer->mDecoders[i];
+        if(pDecoder->mRequest == HND_INVALID) continue;
+
+        TextureRequest* pRequest = getTextureRequest(pStreamer, pDecoder->mRequest);
+        uint32 state = atomicLoad(&pRequest->mState);
+        if(state == TEXTURE_REQUEST_DECODE_FAILED || (state == TEXTURE_REQUEST_DECODED && pRequest->mSize > pStreamer->mRing.mSize))
+        {
+            freeTextureDecoder(pStreamer, pRequest);
+            atomicStore(&pRequest->mState, (uint32)TEXTURE_REQUEST_FAILED);
+            pStreamer->mStats.mFailed++;
+        }
+        else if(state == TEXTURE_REQUEST_DECODED)
+        {
+            if(!stagingRingAlloc(&pStreamer->mRing, pRequest->mSize, TEXTURE_STREAM_STAGING_ALIGN, &pRequest->mStagingOffset))
+            {
+                pStreamer->mStats.mStagingStalls++;
+                continue;
+            }
+            pRequest->mStagingEnd = pStreamer->mRing.mHead;
+            pStreamer->mStaged[pStreamer->mStagedHead++ % TEXTURE_STREAM_MAX_DECODES] = pDecoder->mRequest;
+            pStreamer->mStats.mBytesRead += pRequest->mFileSize;
+            pStreamer->mStats.mBytesStaged += pRequest->mSize;
+
+            atomicStore(&pRequest->mState, (uint32)TEXTURE_REQUEST_STAGING);
+            runJob(pDesc->pJobs, textureStageProc, pRequest, &pStreamer->mJobCounter);
+        }
+    }
+
+    // Batching staged requests in ring order, stopping at the first copy still running
+    uint32 batchCount = pStreamer->mBatchHead - pStreamer->mBatchTail;
+    if(pStreamer->mStagedTail != pStreamer->mStagedHead && batchCount < TEXTURE_STREAM_MAX_BATCHES)
+    {
+        TextureStreamer::Batch* pBatch = &pStreamer->mBatches[pStreamer->mBatchHead % TEXTURE_STREAM_MAX_BATCHES];
+        TextureUpload uploads[TEXTURE_STREAM_MAX_DECODES];
+        pBatch->mCount = 0;
+        while(pStreamer->mStagedTail != pStreamer->mStagedHead)
+        {
+            TextureTicket ticket = pStreamer->mStaged[pStreamer->mStagedTail % TEXTURE_STREAM_MAX_DECODES];
+            TextureRequest* pRequest = getTextureRequest(pStreamer, ticket);
+            if(atomicLoad(&pRequest->mState) != TEXTURE_REQUEST_STAGED) break;
+
+            TextureUpload* pUpload = &uploads[pBatch->mCount];
+            *pUpload = {};
+            pUpload->mStagingOffset = pRequest->mStagingOffset;
+            pUpload->mSize = pRequest->mSize;
+            pUpload->mWidth = pRequest->mWidth;
+            pUpload->mHeight = pRequest->mHeight;
+            pUpload->mFormat = pRequest->mFormat;
+            pBatch->mRequests[pBatch->mCount++] = ticket;
+            pBatch->mStagingEnd = pRequest->mStagingEnd;
+
+            freeTextureDecoder(pStreamer, pRequest);
+            atomicStore(&pRequest->mState, (uint32)TEXTURE_REQUEST_SUBMITTED);
+            pStreamer->mStagedTail++;
+        }
+
+        if(pBatch->mCount)
+        {
+            pBatch->mSinkId = pSink->pfnSubmit(pSink->pUserData, uploads, pBatch->mCount);
+            for(uint32 i = 0; i < pBatch->mCount; i++)
+            {
+                getTextureRequest(pStreamer, pBatch->mRequests[i])->pTexture = uploads[i].pTexture;
+            }
+            pStreamer->mBatchHead++;
+            pStreamer->mStats.mBatches++;
+        }
+    }
+
+    // Starting decodes for queued requests
+    for(uint32 i = 0; i < pDesc->mMaxDecodes && pStreamer->mQueueTail != pStreamer->mQueueHead; i++)
+    {
+        TextureStreamer::Decoder* pDecoder = &pStreamer->mDecoders[i];
+        if(pDecoder->mRequest != HND_INVALID) continue;
+
+        TextureTicket ticket = pStreamer->mQueue[pStreamer->mQueueTail++ % TEXTURE_STREAM_MAX_REQUESTS];
+        TextureRequest* pRequest = getTextureRequest(pStreamer, ticket);
+        pRequest->mDecoder = i;
+        pDecoder->mRequest = ticket;
+        atomicStore(&pRequest->mState, (uint32)TEXTURE_REQUEST_DECODING);
+        runJob(pDesc->pJobs, textureDecodeProc, pRequest, &pStreamer->mJobCounter);
+    }
+}
+
+TextureStreamStatus pollTexture(TextureStreamer* pStreamer, TextureTicket ticket, Texture** ppOut)
+{
+    ASSERT(pStreamer && ppOut);
+
+    TextureRequest* pRequest = (TextureRequest*)poolGet(&pStreamer->mRequests, ticket);
+    if(!pRequest) return TEXTURE_STREAM_INVALID;
+
+    uint32 state = atomicLoad(&pRequest->mState);
+    if(state == TEXTURE_REQUEST_READY)
+    {
+        *ppOut = pRequest->pTexture;
+        poolFreeHandle(&pStreamer->mRequests, ticket);
+        return TEXTURE_STREAM_READY;
+    }
+    if(state == TEXTURE_REQUEST_FAILED)
+    {
+        poolFreeHandle(&pStreamer->mRequests, ticket);
+        return TEXTURE_STREAM_FAILED;
+    }
+    return TEXTURE_STREAM_PENDING;
+}
+
+bool isTextureStreamerIdle(TextureStreamer* pStreamer)
+{
+    ASSERT(pStreamer);
+    if(pStreamer->mQueueTail != pStreamer->mQueueHead) return false;
+    if(pStreamer->mBatchTail != pStreamer->mBatchHead) return false;
+    for(uint32 i = 0; i < pStreamer->mDesc.mMaxDecodes; i++)
+    {
+        if(pStreamer->mDecoders[i].mRequest != HND_INVALID) return false;
+    }
+    return true;
+}
@@ -0,0 +1,158 @@
+#pragma once
+#include "../core/base.hpp"
+#include "../core/memory.hpp"
+#include "../core/string.hpp"
+#include "../core/jobs.hpp"
+
+struct Texture;
+struct Buffer;
+struct CommandBuffer;
+template<typename T>
+struct ResourceManager;
+
+// Texture streaming
+// Asynchronous counterpart of loadTexture. Files are read and decoded on the job
+// system, each request in flight owns a decoder arena. Decoded images get a region
+// of the staging ring and are copied there by another job. Staged images are handed
+// to the upload sink in ring order, one batch per update, and their ring space is
+// reused once the sink reports the batch complete. Everything but the copy jobs
+// runs on the thread calling updateTextureStreamer.
+//
+//  TextureTicket ticket = requestTexture(&streamer, str("assets/albedo.png"), FORMAT_RGBA8_SRGB, true);
+//  ...every frame
+//  updateTextureStreamer(&streamer);
+//  if(pollTexture(&streamer, ticket, &pTexture) == TEXTURE_STREAM_READY) ...
+#define TEXTURE_STREAM_MAX_REQUESTS     4096
+#define TEXTURE_STREAM_MAX_DECODES      16      // Requests being decoded/staged at once
+#define TEXTURE_STREAM_MAX_BATCHES      4       // Batches submitted to the sink and not complete yet
+#define TEXTURE_STREAM_MAX_PATH         260
+#define TEXTURE_STREAM_DECODER_ARENA    GB(1)
+#define TEXTURE_STREAM_STAGING_ALIGN    16
+
+typedef HND TextureTicket;
+
+enum TextureStreamStatus : uint32
+{
+    TEXTURE_STREAM_INVALID = 0,     // Unknown or already consumed ticket
+    TEXTURE_STREAM_PENDING,
+    TEXTURE_STREAM_READY,
+    TEXTURE_STREAM_FAILED,
+};
+
+struct TextureUpload
+{
+    uint64      mStagingOffset  = 0;
+    uint64      mSize           = 0;
+    uint32      mWidth          = 0;
+    uint32      mHeight         = 0;
+    uint32      mFormat         = 0;    // ImageFormat, RGBA8 data
+    Texture*    pTexture        = NULL; // Set by the sink
+};
+
+// Receives the staged images. submit creates the textures and records the copies
+// from the staging memory, returning an id that isComplete is polled with.
+struct TextureUploadSink
+{
+    void*   pUserData                                                           = NULL;
+    uint64  (*pfnSubmit)(void* pUserData, TextureUpload* pUploads, uint32 count) = NULL;
+    bool    (*pfnIsComplete)(void* pUserData, uint64 batch)                     = NULL;
+};
+
+// Ring over the staging memory. Offsets are monotonic, wrapped when used, so
+// mHead - mTail is the space in use.
+struct StagingRing
+{
+    uint64  mSize   = 0;
+    uint64  mHead   = 0;
+    uint64  mTail   = 0;
+};
+
+// Returns false when there's no contiguous room for size bytes. Allocations are
+// released in order, by passing mHead as it was right after the allocation.
+bool    stagingRingAlloc(StagingRing* pRing, uint64 size, uint64 alignment, uint64* pOffset);
+void    stagingRingRelease(StagingRing* pRing, uint64 end);
+
+struct TextureStreamerDesc
+{
+    JobSystem*          pJobs           = NULL;
+    TextureUploadSink   mSink           = {};
+    byte*               pStaging        = NULL;     // CPU view of the memory the sink copies from
+    uint64              mStagingSize    = 0;
+    uint32              mMaxDecodes     = 4;        // Up to TEXTURE_STREAM_MAX_DECODES
+};
+
+struct TextureStreamerStats
+{
+    uint64  mRequested      = 0;
+    uint64  mReady          = 0;
+    uint64  mFailed         = 0;
+    uint64  mBytesRead      = 0;
+    uint64  mBytesStaged    = 0;
+    uint64  mBatches        = 0;
+    uint64  mStagingStalls  = 0;    // Decoded images that had to wait for ring space
+};
+
+struct TextureStreamer
+{
+    struct Decoder
+    {
+        Arena           mArena      = {};
+        TextureTicket   mRequest    = HND_INVALID;
+    };
+
+    struct Batch
+    {
+        uint64          mSinkId     = 0;
+        uint64          mStagingEnd = 0;
+        uint32          mCount      = 0;
+        TextureTicket   mRequests[TEXTURE_STREAM_MAX_DECODES];
+    };
+
+    TextureStreamerDesc mDesc   = {};
+    Pool        mRequests       = {};
+    JobCounter  mJobCounter     = {};
+
+    // Requests waiting for a decoder
+    TextureTicket mQueue[TEXTURE_STREAM_MAX_REQUESTS];
+    uint32      mQueueHead      = 0;
+    uint32      mQueueTail      = 0;
+
+    Decoder     mDecoders[TEXTURE_STREAM_MAX_DECODES];
+
+    // Requests with staging space, in ring order
+    TextureTicket mStaged[TEXTURE_STREAM_MAX_DECODES];
+    uint32      mStagedHead     = 0;
+    uint32      mStagedTail     = 0;
+
+    StagingRing mRing           = {};
+    Batch       mBatches[TEXTURE_STREAM_MAX_BATCHES];
+    uint32      mBatchHead      = 0;
+    uint32      mBatchTail      = 0;
+
+    TextureStreamerStats mStats = {};
+};
+
+void initTextureStreamer(TextureStreamerDesc desc, TextureStreamer* pStreamer);
+void destroyTextureStreamer(TextureStreamer* pStreamer);    // Waits for the jobs and the sink
+
+// Returns HND_INVALID when TEXTURE_STREAM_MAX_REQUESTS are pending.
+TextureTicket       requestTexture(TextureStreamer* pStreamer, String path, uint32 format, bool flipVertical);
+void                updateTextureStreamer(TextureStreamer* pStreamer);
+// READY and FAILED consume the ticket.
+TextureStreamStatus pollTexture(TextureStreamer* pStreamer, TextureTicket ticket, Texture** ppOut);
+bool                isTextureStreamerIdle(TextureStreamer* pStreamer);
+
+// Sink uploading through the renderer: its own persistently mapped staging buffer,
+// one command buffer and fence per batch.
+struct RendererTextureSink
+{
+    ResourceManager<Texture>* pResMan   = NULL;
+    Buffer*         pStaging            = NULL;
+    byte*           pMapped             = NULL;
+    CommandBuffer*  pCmds               = NULL;     // TEXTURE_STREAM_MAX_BATCHES
+    uint64          mSubmitted          = 0;
+};
+
+void initRendererTextureSink(ResourceManager<Texture>* pResMan, uint64 stagingSize, Arena* pArena, RendererTextureSink* pSink);
+void destroyRendererTextureSink(RendererTextureSink* pSink);
+TextureStreamerDesc textureStreamerDesc(RendererTextureSink* pSink, JobSystem* pJobs, uint32 maxDecodes = 4);
@@ -52,7 +52,7 @@ Array<T> array(Arena* pArena, uint64 capacity)
 {
     Array<T> result = {};
     result.mCount = 0;
-    result.mData = (T*)arenaPush(pArena, capacity * sizeof(T));
+    result.mData = (T*)arenaPush(pArena, capacity * sizeof(T), alignof(T));
     result.mCapacity = capacity;
     return result;
 }
@@ -90,3 +90,183 @@ Array<T> arrayAlign(Arena* pArena, uint64 capacity, uint64 alignment, uint64 ini
     }
     return result;
 }
+
+// Dynamic array (geometric growth, no fixed capacity)
+// Either lives in a shared arena (dynArray) or owns a virtual memory reservation
+// (dynArrayVirtual). Growth extends the block in place while it's the top of its
+// arena, which is always the case for an owned reservation, so those never copy.
+// Otherwise the elements move to a bigger block at the arena top and the old
+// block stays behind in the arena.
+#define DYN_ARRAY_MIN_CAPACITY 16
+
+template <typename T>
+void dynArrayMove(T* pDst, const T* pSrc, uint64 count)
+{
+    if(!count || pDst == pSrc) return;
+    if(__is_trivially_copyable(T))
+    {
+        memmove(pDst, pSrc, count * sizeof(T));
+    }
+    else if(pDst < pSrc)
+    {
+        for(uint64 i = 0; i < count; i++) pDst[i] = pSrc[i];
+    }
+    else
+    {
+        for(uint64 i = count; i > 0; i--) pDst[i - 1] = pSrc[i - 1];
+    }
+}
+
+template <typename T>
+struct DynArray
+{
+    uint64 mCapacity = 0;
+    uint64 mCount = 0;
+    T* mData = NULL;
+    Arena* pArena = NULL;       // Shared arena to grow in, NULL when using mArena
+    Arena mArena = {};          // Owned reservation
+
+    T& operator[](uint64 index)
+    {
+        ASSERT(index < mCount);
+        return mData[index];
+    }
+
+    const T& operator[](uint64 index) const
+    {
+        ASSERT(index < mCount);
+        return mData[index];
+    }
+
+    Arena* getArena()
+    {
+        return pArena ? pArena : &mArena;
+    }
+
+    void reserve(uint64 capacity)
+    {
+        if(capacity <= mCapacity) return;
+
+        Arena* pGrowArena = getArena();
+        ASSERT(pGrowArena->pStart);
+        uint64 newCapacity = MAX(capacity, MAX(mCapacity * 2, (uint64)DYN_ARRAY_MIN_CAPACITY));
+        if(!pArena)
+        {
+            // Owned reservations can't grow past their size
+            uint64 maxCapacity = mArena.mCapacity / sizeof(T);
+            ASSERT(capacity <= maxCapacity);
+            newCapacity = MIN(newCapacity, maxCapacity);
+        }
+
+        if(mData && (byte*)(mData + mCapacity) == arenaGetTop(pGrowArena))
+        {
+            arenaPush(pGrowArena, (newCapacity - mCapacity) * sizeof(T));
+        }
+        else
+        {
+            T* pNewData = (T*)arenaPush(pGrowArena, newCapacity * sizeof(T), alignof(T));
+            dynArrayMove(pNewData, mData, mCount);
+            mData = pNewData;
+        }
+        mCapacity = newCapacity;
+    }
+
+    void resize(uint64 count, const T& value = T{})
+    {
+        reserve(count);
+        for(uint64 i = mCount; i < count; i++)
+        {
+            mData[i] = value;
+        }
+        mCount = count;
+    }
+
+    void push(const T& value)
+    {
+        if(mCount == mCapacity) reserve(mCount + 1);
+        mData[mCount++] = value;
+    }
+
+    void append(const T* pValues, uint64 count)
+    {
+        ASSERT(pValues || !count);
+        reserve(mCount + count);
+        dynArrayMove(mData + mCount, pValues, count);
+        mCount += count;
+    }
+
+    // Keeps the order, shifting everything after index up by one.
+    void insert(uint64 index, const T& value)
+    {
+        ASSERT(index <= mCount);
+        if(mCount == mCapacity) reserve(mCount + 1);
+        dynArrayMove(mData + index + 1, mData + index, mCount - index);
+        mData[index] = value;
+        mCount++;
+    }
+
+    // Keeps the order, shifting everything after index down by one.
+    void remove(uint64 index)
+    {
+        ASSERT(index < mCount);
+        dynArrayMove(mData + index, mData + index + 1, mCount - index - 1);
+        mCount--;
+    }
+
+    // O(1), moves the last element into the removed slot.
+    void removeSwap(uint64 index)
+    {
+        ASSERT(index < mCount);
+        mData[index] = mData[mCount - 1];
+        mCount--;
+    }
+
+    void pop()
+    {
+        ASSERT(mCount > 0);
+        mCount--;
+    }
+
+    void clear()
+    {
+        mCount = 0;
+    }
+
+    T& top()
+    {
+        ASSERT(mCount > 0);
+        return mData[mCount - 1];
+    }
+};
+
+template <typename T>
+DynArray<T> dynArray(Arena* pArena, uint64 initialCapacity = 0)
+{
+    ASSERT(pArena);
+    DynArray<T> result = {};
+    result.pArena = pArena;
+    if(initialCapacity) result.reserve(initialCapacity);
+    return result;
+}
+
+// Reserves address space for maxCapacity elements, pages are committed as it grows.
+template <typename T>
+DynArray<T> dynArrayVirtual(uint64 maxCapacity, uint64 initialCapacity = 0)
+{
+    ASSERT(maxCapacity > 0);
+    DynArray<T> result = {};
+    initArena(maxCapacity * sizeof(T), &result.mArena);
+    if(initialCapacity) result.reserve(initialCapacity);
+    return result;
+}
+
+template <typename T>
+void destroyDynArray(DynArray<T>* pArray)
+{
+    ASSERT(pArray);
+    if(!pArray->pArena && pArray->mArena.pStart)
+    {
+        destroyArena(&pArray->mArena);
+    }
+    *pArray = {};
+}
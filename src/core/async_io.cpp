@@ -0,0 +1,450 @@
+#include "async_io.hpp"
+#include "debug.hpp"
+#include "thread.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#endif
+
+enum IORequestState : uint32
+{
+    IO_REQUEST_QUEUED = 0,
+    IO_REQUEST_OPENING,
+    IO_REQUEST_READING,
+    IO_REQUEST_DONE,
+    IO_REQUEST_FAILED,
+};
+
+struct IORequest
+{
+    AsyncIO*    pIO         = NULL;
+    IORead      mRead       = {};       // mPath is cleared, the copy below is used
+    char        mPath[ASYNC_IO_MAX_PATH];
+    uint64      mBytesRead  = 0;
+    int32       mFd         = -1;       // io_uring only
+    uint32      mState      = IO_REQUEST_QUEUED;
+};
+
+// --------------------------------------
+// Jobs backend
+// Blocking open and positioned reads, one job per request.
+bool readFileRange(const char* path, uint64 offset, uint64 size, byte* pDst, uint64* pBytesRead)
+{
+    *pBytesRead = 0;
+    bool result = true;
+#ifdef _WIN32
+    HANDLE hFile = CreateFile(
+            path,
+            GENERIC_READ,
+            FILE_SHARE_READ,
+            NULL,
+            OPEN_EXISTING,
+            FILE_FLAG_SEQUENTIAL_SCAN,
+            NULL);
+    if(hFile == INVALID_HANDLE_VALUE) return false;
+
+    while(*pBytesRead < size)
+    {
+        uint64 position = offset + *pBytesRead;
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = (DWORD)position;
+        overlapped.OffsetHigh = (DWORD)(position >> 32);
+        DWORD chunk = (DWORD)MIN(size - *pBytesRead, ASYNC_IO_CHUNK_SIZE);
+        DWORD bytesRead = 0;
+        if(!ReadFile(hFile, pDst + *pBytesRead, chunk, &bytesRead, &overlapped))
+        {
+            result = GetLastError() == ERROR_HANDLE_EOF;
+            break;
+        }
+        if(bytesRead == 0) break;
+        *pBytesRead += bytesRead;
+    }
+    CloseHandle(hFile);
+#else
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return false;
+
+    while(*pBytesRead < size)
+    {
+        size_t chunk = (size_t)MIN(size - *pBytesRead, ASYNC_IO_CHUNK_SIZE);
+        ssize_t bytesRead = pread(fd, pDst + *pBytesRead, chunk, (off_t)(offset + *pBytesRead));
+        if(bytesRead < 0 && errno == EINTR) continue;
+        if(bytesRead <= 0)
+        {
+            result = bytesRead == 0;
+            break;
+        }
+        *pBytesRead += (uint64)bytesRead;
+    }
+    close(fd);
+#endif
+    return result;
+}
+
+void ioReadProc(void* pData)
+{
+    IORequest* pRequest = (IORequest*)pData;
+    uint64 bytesRead = 0;
+    bool success = readFileRange(pRequest->mPath, pRequest->mRead.mOffset, pRequest->mRead.mSize, pRequest->mRead.pDst, &bytesRead);
+    pRequest->mBytesRead = bytesRead;
+    atomicStore(&pRequest->mState, (uint32)(success ? IO_REQUEST_DONE : IO_REQUEST_FAILED));
+}
+
+// --------------------------------------
+// io_uring backend
+// Raw syscalls, no liburing. A request is an OPENAT followed by READs until it has
+// all its bytes or hits the end of the file, the descriptor is closed when it's done.
+// Each request has at most one entry in the rings at a time, so with queue depth
+// entries neither ring can overflow.
+#ifdef __linux__
+
+bool initUring(uint32 depth, IOUring* pUring)
+{
+    io_uring_params params = {};
+    int32 fd = (int32)syscall(__NR_io_uring_setup, depth, &params);
+    if(fd < 0) return false;
+
+    // OPENAT and READ came with 5.6, as did RW_CUR_POS
+    if(!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_RW_CUR_POS))
+    {
+        close(fd);
+        return false;
+    }
+
+    uint64 sqSize = params.sq_off.array + params.sq_entries * sizeof(uint32);
+    uint64 cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    uint64 ringSize = MAX(sqSize, cqSize);
+    byte* pRing = (byte*)mmap(NULL, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(pRing == MAP_FAILED)
+    {
+        close(fd);
+        return false;
+    }
+    uint64 sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* pSqes = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(pSqes == MAP_FAILED)
+    {
+        munmap(pRing, ringSize);
+        close(fd);
+        return false;
+    }
+
+    pUring->mFd = fd;
+    pUring->pSqHead = (uint32*)(pRing + params.sq_off.head);
+    pUring->pSqTail = (uint32*)(pRing + params.sq_off.tail);
+    pUring->pSqArray = (uint32*)(pRing + params.sq_off.array);
+    pUring->mSqMask = *(uint32*)(pRing + params.sq_off.ring_mask);
+    pUring->pSqes = pSqes;
+    pUring->pCqHead = (uint32*)(pRing + params.cq_off.head);
+    pUring->pCqTail = (uint32*)(pRing + params.cq_off.tail);
+    pUring->mCqMask = *(uint32*)(pRing + params.cq_off.ring_mask);
+    pUring->pCqes = pRing + params.cq_off.cqes;
+    pUring->pRingMemory = pRing;
+    pUring->mRingSize = ringSize;
+    pUring->mSqesSize = sqesSize;
+    return true;
+}
+
+void destroyUring(IOUring* pUring)
+{
+    munmap(pUring->pSqes, pUring->mSqesSize);
+    munmap(pUring->pRingMemory, pUring->mRingSize);
+    close(pUring->mFd);
+    *pUring = {};
+}
+
+io_uring_sqe* getUringSqe(IOUring* pUring, IOTicket ticket)
+{
+    uint32 tail = *pUring->pSqTail + pUring->mSqPending;
+    ASSERT(tail - atomicLoad(pUring->pSqHead) <= pUring->mSqMask);
+    uint32 index = tail & pUring->mSqMask;
+    pUring->pSqArray[index] = index;
+    pUring->mSqPending++;
+
+    io_uring_sqe* pSqe = (io_uring_sqe*)pUring->pSqes + index;
+    memset(pSqe, 0, sizeof(io_uring_sqe));
+    pSqe->user_data = (uint64)ticket;
+    return pSqe;
+}
+
+// Publishes the entries written since the last call and submits every entry the kernel
+// hasn't consumed yet. Blocks until waitCount completions are available.
+void enterUring(IOUring* pUring, uint32 waitCount)
+{
+    if(pUring->mSqPending)
+    {
+        atomicStore(pUring->pSqTail, *pUring->pSqTail + pUring->mSqPending);
+        pUring->mSqPending = 0;
+    }
+    uint32 submitCount = *pUring->pSqTail - atomicLoad(pUring->pSqHead);
+    if(!submitCount && !waitCount) return;
+
+    uint32 flags = waitCount ? IORING_ENTER_GETEVENTS : 0;
+    while(syscall(__NR_io_uring_enter, pUring->mFd, submitCount, waitCount, flags, NULL, 0) < 0)
+    {
+        ASSERT(errno == EINTR || errno == EAGAIN || errno == EBUSY);
+        submitCount = *pUring->pSqTail - atomicLoad(pUring->pSqHead);
+    }
+}
+
+void prepUringOpen(IOUring* pUring, IOTicket ticket, IORequest* pRequest)
+{
+    io_uring_sqe* pSqe = getUringSqe(pUring, ticket);
+    pSqe->opcode = IORING_OP_OPENAT;
+    pSqe->fd = AT_FDCWD;
+    pSqe->addr = (uint64)pRequest->mPath;
+    pSqe->open_flags = O_RDONLY | O_CLOEXEC;
+    pRequest->mState = IO_REQUEST_OPENING;
+}
+
+void prepUringRead(IOUring* pUring, IOTicket ticket, IORequest* pRequest)
+{
+    io_uring_sqe* pSqe = getUringSqe(pUring, ticket);
+    pSqe->opcode = IORING_OP_READ;
+    pSqe->fd = pRequest->mFd;
+    pSqe->addr = (uint64)(pRequest->mRead.pDst + pRequest->mBytesRead);
+    pSqe->len = (uint32)MIN(pRequest->mRead.mSize - pRequest->mBytesRead, ASYNC_IO_CHUNK_SIZE);
+    pSqe->off = pRequest->mRead.mOffset + pRequest->mBytesRead;
+    pRequest->mState = IO_REQUEST_READING;
+}
+
+void finishUringRequest(IORequest* pRequest, IORequestState state)
+{
+    if(pRequest->mFd >= 0) close(pRequest->mFd);
+    pRequest->mFd = -1;
+    pRequest->mState = state;
+}
+
+// Advances every request with a completion, queueing its next read
+void reapUring(AsyncIO* pIO)
+{
+    IOUring* pUring = &pIO->mUring;
+    uint32 head = *pUring->pCqHead;
+    uint32 tail = atomicLoad(pUring->pCqTail);
+    for(; head != tail; head++)
+    {
+        io_uring_cqe* pCqe = (io_uring_cqe*)pUring->pCqes + (head & pUring->mCqMask);
+        IOTicket ticket = (IOTicket)pCqe->user_data;
+        IORequest* pRequest = (IORequest*)poolGet(&pIO->mRequests, ticket);
+        ASSERT(pRequest);
+
+        int32 result = pCqe->res;
+        if(result == -EINTR || result == -EAGAIN)
+        {
+            if(pRequest->mState == IO_REQUEST_OPENING) prepUringOpen(pUring, ticket, pRequest);
+            else prepUringRead(pUring, ticket, pRequest);
+            continue;
+        }
+        if(result < 0)
+        {
+            finishUringRequest(pRequest, IO_REQUEST_FAILED);
+            continue;
+        }
+
+        if(pRequest->mState == IO_REQUEST_OPENING)
+        {
+            pRequest->mFd = result;
+        }
+        else
+        {
+            pRequest->mBytesRead += (uint64)result;
+            if(result == 0) pRequest->mRead.mSize = pRequest->mBytesRead;     // End of file
+        }
+
+        if(pRequest->mBytesRead == pRequest->mRead.mSize)
+        {
+            finishUringRequest(pRequest, IO_REQUEST_DONE);
+        }
+        else
+        {
+            prepUringRead(pUring, ticket, pRequest);
+        }
+    }
+    atomicStore(pUring->pCqHead, head);
+}
+
+#endif
+
+// --------------------------------------
+bool initAsyncIO(AsyncIODesc desc, AsyncIO* pIO)
+{
+    ASSERT(pIO);
+    ASSERT(desc.mQueueDepth > 0 && desc.mQueueDepth <= ASYNC_IO_MAX_DEPTH);
+
+    *pIO = {};
+    pIO->mDesc = desc;
+
+    bool uring = false;
+#ifdef __linux__
+    if(desc.mBackend != IO_BACKEND_JOBS) uring = initUring(desc.mQueueDepth, &pIO->mUring);
+#endif
+    if(desc.mBackend == IO_BACKEND_URING && !uring) return false;
+
+    pIO->mBackend = uring ? IO_BACKEND_URING : IO_BACKEND_JOBS;
+    initPool(sizeof(IORequest), ASYNC_IO_MAX_REQUESTS, &pIO->mRequests);
+    return true;
+}
+
+void destroyAsyncIO(AsyncIO* pIO)
+{
+    ASSERT(pIO);
+
+    waitAsyncIO(pIO);
+#ifdef __linux__
+    if(pIO->mBackend == IO_BACKEND_URING) destroyUring(&pIO->mUring);
+#endif
+    destroyPool(&pIO->mRequests);
+    *pIO = {};
+}
+
+IOTicket readFileAsync(AsyncIO* pIO, IORead read)
+{
+    ASSERT(pIO);
+    ASSERT(read.mPath.mLen < ASYNC_IO_MAX_PATH);
+    ASSERT(read.pDst || read.mSize == 0);
+
+    IOTicket ticket = poolAllocHandle(&pIO->mRequests);
+    if(ticket == HND_INVALID) return HND_INVALID;
+
+    IORequest* pRequest = (IORequest*)poolGet(&pIO->mRequests, ticket);
+    *pRequest = {};
+    pRequest->pIO = pIO;
+    pRequest->mRead = read;
+    pRequest->mRead.mPath = {};
+    memcpy(pRequest->mPath, read.mPath.mData, read.mPath.mLen);
+    pRequest->mPath[read.mPath.mLen] = 0;
+
+    pIO->mQueue[pIO->mQueueHead++ % ASYNC_IO_MAX_REQUESTS] = ticket;
+    pIO->mStats.mRequested++;
+    return ticket;
+}
+
+uint32 updateAsyncIO(AsyncIO* pIO)
+{
+    ASSERT(pIO);
+
+#ifdef __linux__
+    if(pIO->mBackend == IO_BACKEND_URING) reapUring(pIO);
+#endif
+
+    uint32 completed = 0;
+    for(uint32 i = 0; i < pIO->mInFlightCount;)
+    {
+        IOTicket ticket = pIO->mInFlight[i];
+        IORequest* pRequest = (IORequest*)poolGet(&pIO->mRequests, ticket);
+        uint32 state = atomicLoad(&pRequest->mState);
+        if(state != IO_REQUEST_DONE && state != IO_REQUEST_FAILED)
+        {
+            i++;
+            continue;
+        }
+
+        pIO->mInFlight[i] = pIO->mInFlight[--pIO->mInFlightCount];
+        completed++;
+        if(state == IO_REQUEST_DONE)
+        {
+            pIO->mStats.mCompleted++;
+            pIO->mStats.mBytesRead += pRequest->mBytesRead;
+        }
+        else
+        {
+            pIO->mStats.mFailed++;
+        }
+
+        if(pRequest->mRead.pfnComplete)
+        {
+            // Freed before the callback, which may queue more reads
+            IORead read = pRequest->mRead;
+            uint64 bytesRead = pRequest->mBytesRead;
+            poolFreeHandle(&pIO->mRequests, ticket);
+            read.pfnComplete(read.pUserData, ticket, state == IO_REQUEST_DONE ? IO_DONE : IO_FAILED, bytesRead);
+        }
+    }
+
+    // Topping up the requests in flight, as one batch
+    uint32 started = 0;
+    while(pIO->mQueueTail != pIO->mQueueHead && pIO->mInFlightCount < pIO->mDesc.mQueueDepth)
+    {
+        IOTicket ticket = pIO->mQueue[pIO->mQueueTail++ % ASYNC_IO_MAX_REQUESTS];
+        IORequest* pRequest = (IORequest*)poolGet(&pIO->mRequests, ticket);
+        pIO->mInFlight[pIO->mInFlightCount++] = ticket;
+        started++;
+
+#ifdef __linux__
+        if(pIO->mBackend == IO_BACKEND_URING)
+        {
+            prepUringOpen(&pIO->mUring, ticket, pRequest);
+            continue;
+        }
+#endif
+        if(pIO->mDesc.pJobs)
+        {
+            runJob(pIO->mDesc.pJobs, ioReadProc, pRequest, &pIO->mJobCounter);
+        }
+        else
+        {
+            ioReadProc(pRequest);
+        }
+    }
+    if(started) pIO->mStats.mSubmits++;
+
+#ifdef __linux__
+    // Also submits the reads queued while reaping
+    if(pIO->mBackend == IO_BACKEND_URING) enterUring(&pIO->mUring, 0);
+#endif
+    return completed;
+}
+
+IOStatus pollAsyncIO(AsyncIO* pIO, IOTicket ticket, uint64* pBytesRead)
+{
+    ASSERT(pIO);
+
+    IORequest* pRequest = (IORequest*)poolGet(&pIO->mRequests, ticket);
+    if(!pRequest) return IO_INVALID;
+
+    // Completed requests only count once updateAsyncIO has seen them
+    for(uint32 i = 0; i < pIO->mInFlightCount; i++)
+    {
+        if(pIO->mInFlight[i] == ticket) return IO_PENDING;
+    }
+
+    uint32 state = atomicLoad(&pRequest->mState);
+    if(state == IO_REQUEST_DONE || state == IO_REQUEST_FAILED)
+    {
+        if(pBytesRead) *pBytesRead = pRequest->mBytesRead;
+        poolFreeHandle(&pIO->mRequests, ticket);
+        return state == IO_REQUEST_DONE ? IO_DONE : IO_FAILED;
+    }
+    return IO_PENDING;
+}
+
+void waitAsyncIO(AsyncIO* pIO)
+{
+    ASSERT(pIO);
+
+    updateAsyncIO(pIO);
+    while(!isAsyncIOIdle(pIO))
+    {
+#ifdef __linux__
+        if(pIO->mBackend == IO_BACKEND_URING) enterUring(&pIO->mUring, 1);
+#endif
+        if(pIO->mBackend == IO_BACKEND_JOBS && pIO->mDesc.pJobs)
+        {
+            waitJobs(pIO->mDesc.pJobs, &pIO->mJobCounter);
+        }
+        updateAsyncIO(pIO);
+    }
+}
+
+bool isAsyncIOIdle(AsyncIO* pIO)
+{
+    ASSERT(pIO);
+    return pIO->mQueueTail == pIO->mQueueHead && pIO->mInFlightCount == 0;
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include "base.hpp"
+#include "memory.hpp"
+#include "string.hpp"
+#include "jobs.hpp"
+
+// Asynchronous file reads
+// Reads are queued with readFileAsync and handed to the backend in batches by
+// updateAsyncIO, at most mQueueDepth at a time. On Linux the backend is io_uring:
+// the open and the reads of every request are chained through the ring, and each
+// update is a single io_uring_enter for the whole batch. Elsewhere, or when the
+// kernel lacks io_uring, every read is a blocking job on the job system.
+// Everything but the jobs runs on the thread calling updateAsyncIO, callbacks too.
+//
+//  IORead read = {};
+//  read.mPath = str("assets/level.bin");
+//  read.pDst = pBuffer;
+//  read.mSize = size;
+//  IOTicket ticket = readFileAsync(&io, read);
+//  ...every frame
+//  updateAsyncIO(&io);
+//  if(pollAsyncIO(&io, ticket) == IO_DONE) ...
+#define ASYNC_IO_MAX_REQUESTS   4096
+#define ASYNC_IO_MAX_DEPTH      256         // Requests in flight at once
+#define ASYNC_IO_MAX_PATH       260
+#define ASYNC_IO_CHUNK_SIZE     GB(1)       // Largest single read, bigger requests are split
+
+typedef HND IOTicket;
+
+enum IOStatus : uint32
+{
+    IO_INVALID = 0,     // Unknown or already consumed ticket
+    IO_PENDING,
+    IO_DONE,
+    IO_FAILED,
+};
+
+enum IOBackend : uint32
+{
+    IO_BACKEND_AUTO = 0,    // io_uring when available, jobs otherwise
+    IO_BACKEND_URING,
+    IO_BACKEND_JOBS,
+};
+
+typedef void (*IOCallback)(void* pUserData, IOTicket ticket, IOStatus status, uint64 bytesRead);
+
+struct IORead
+{
+    String      mPath       = {};
+    uint64      mOffset     = 0;
+    uint64      mSize       = 0;        // Stops early at the end of the file
+    byte*       pDst        = NULL;
+    IOCallback  pfnComplete = NULL;     // Consumes the ticket, poll it otherwise
+    void*       pUserData   = NULL;
+};
+
+struct AsyncIODesc
+{
+    IOBackend   mBackend    = IO_BACKEND_AUTO;
+    uint32      mQueueDepth = 64;       // Up to ASYNC_IO_MAX_DEPTH
+    JobSystem*  pJobs       = NULL;     // For the jobs backend, reads block the updating thread when NULL
+};
+
+struct AsyncIOStats
+{
+    uint64  mRequested  = 0;
+    uint64  mCompleted  = 0;
+    uint64  mFailed     = 0;
+    uint64  mBytesRead  = 0;
+    uint64  mSubmits    = 0;    // Batches handed to the backend
+};
+
+// Rings shared with the kernel, only used by the io_uring backend
+struct IOUring
+{
+    int32   mFd             = -1;
+    uint32* pSqHead         = NULL;
+    uint32* pSqTail         = NULL;
+    uint32* pSqArray        = NULL;
+    uint32  mSqMask         = 0;
+    uint32  mSqPending      = 0;    // Entries written since the last submit
+    void*   pSqes           = NULL;
+    uint32* pCqHead         = NULL;
+    uint32* pCqTail         = NULL;
+    uint32  mCqMask         = 0;
+    void*   pCqes           = NULL;
+    void*   pRingMemory     = NULL;
+    uint64  mRingSize       = 0;
+    uint64  mSqesSize       = 0;
+};
+
+struct AsyncIO
+{
+    AsyncIODesc mDesc           = {};
+    IOBackend   mBackend        = IO_BACKEND_AUTO;  // The one in use
+    Pool        mRequests       = {};
+    JobCounter  mJobCounter     = {};
+    IOUring     mUring          = {};
+
+    // Requests waiting for a slot in flight
+    IOTicket    mQueue[ASYNC_IO_MAX_REQUESTS];
+    uint32      mQueueHead      = 0;
+    uint32      mQueueTail      = 0;
+
+    IOTicket    mInFlight[ASYNC_IO_MAX_DEPTH];
+    uint32      mInFlightCount  = 0;
+
+    AsyncIOStats mStats         = {};
+};
+
+// Returns false when the requested backend isn't available.
+bool    initAsyncIO(AsyncIODesc desc, AsyncIO* pIO);
+void    destroyAsyncIO(AsyncIO* pIO);   // Waits for the reads in flight
+
+// Returns HND_INVALID when ASYNC_IO_MAX_REQUESTS are pending. pDst must stay valid until
+// the read completes, the path is copied.
+IOTicket    readFileAsync(AsyncIO* pIO, IORead read);
+// Completes finished reads and submits queued ones, returns the number completed.
+uint32      updateAsyncIO(AsyncIO* pIO);
+// DONE and FAILED consume the ticket.
+IOStatus    pollAsyncIO(AsyncIO* pIO, IOTicket ticket, uint64* pBytesRead = NULL);
+void        waitAsyncIO(AsyncIO* pIO);  // Updates until every read has completed
+bool        isAsyncIOIdle(AsyncIO* pIO);
@@ -1,9 +1,13 @@
 #pragma once
 
 // Base includes
+#ifdef _WIN32
 #include <windows.h>    // TODO_DW: MULTIPLATFORM
+#endif
 #include <stdint.h>
 #include <float.h>
+#include <string.h>
+#include <stdarg.h>
 
 // Base types
 typedef int8_t      int8;
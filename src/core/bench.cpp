@@ -0,0 +1,546 @@
+#include "app.hpp"
+#include "memory.hpp"
+#include "time.hpp"
+#include "debug.hpp"
+#include "thread.hpp"
+#include "array.hpp"
+#include "hash_map.hpp"
+#include "jobs.hpp"
+#include "file.hpp"
+#include "async_io.hpp"
+
+// Core benchmarks. Results are only logged, run with an optimized DW_DEBUG build
+// (logging is compiled out otherwise).
+
+#define POOL_BENCH_BURST 8
+
+struct PoolBenchThread
+{
+    Thread  mThread     = {};
+    Pool*   pPool       = NULL;
+    uint32* pStartFlag  = NULL;
+    uint32  mIterations = 0;
+    bool    mCached     = false;
+};
+
+void poolBenchThreadProc(void* pData)
+{
+    PoolBenchThread* pBench = (PoolBenchThread*)pData;
+    PoolCache cache = {};
+    initPoolCache(pBench->pPool, &cache);
+
+    while(!atomicLoad(pBench->pStartFlag))
+    {
+        yieldThread();
+    }
+
+    // Allocating in small bursts, like resources created/destroyed per frame
+    void* held[POOL_BENCH_BURST];
+    for(uint32 iter = 0; iter < pBench->mIterations; iter++)
+    {
+        uint32 count = 0;
+        for(uint32 i = 0; i < POOL_BENCH_BURST; i++)
+        {
+            void* pBlock = pBench->mCached ? poolAlloc(&cache) : poolAlloc(pBench->pPool);
+            if(!pBlock) break;
+            held[count++] = pBlock;
+        }
+        for(uint32 i = 0; i < count; i++)
+        {
+            if(pBench->mCached) poolFree(&cache, held[i]);
+            else poolFree(pBench->pPool, held[i]);
+        }
+    }
+    flushPoolCache(&cache);
+}
+
+void benchPool(App* pApp)
+{
+    ASSERT(pApp);
+
+    const uint32 maxThreads = 32;
+    const uint32 iterations = 100000;
+    PoolBenchThread threads[maxThreads];
+
+    Pool pool = {};
+    initPool(64, maxThreads * POOL_CACHE_CAPACITY * 2, &pool);
+
+    for(uint32 cached = 0; cached < 2; cached++)
+    {
+        for(uint32 threadCount = 1; threadCount <= maxThreads; threadCount *= 2)
+        {
+            uint32 startFlag = 0;
+            for(uint32 t = 0; t < threadCount; t++)
+            {
+                threads[t] = {};
+                threads[t].pPool = &pool;
+                threads[t].pStartFlag = &startFlag;
+                threads[t].mIterations = iterations;
+                threads[t].mCached = cached;
+                createThread(poolBenchThreadProc, &threads[t], &threads[t].mThread);
+            }
+
+            Timer timer = createTimer(pApp);
+            startTimer(&timer);
+            atomicStore(&startFlag, 1u);
+            for(uint32 t = 0; t < threadCount; t++)
+            {
+                joinThread(&threads[t].mThread);
+            }
+            endTimer(&timer);
+
+            double ms = getMS(&timer);
+            double ops = (double)threadCount * iterations * POOL_BENCH_BURST * 2;    // Allocs + frees
+            LOGF("[BENCH-CORE] Pool %-6s %2u threads: %8.2f ms, %7.2f Mops/s",
+                    cached ? "cached" : "global", threadCount, ms, ops / (ms * 1e3));
+        }
+    }
+
+    destroyPool(&pool);
+}
+
+// Per draw uniform blocks written to a frame ring every frame, as the renderer's upload
+// ring does. The range is plain memory here, standing in for a mapped buffer.
+#define FRAME_RING_BENCH_FRAMES     1000
+#define FRAME_RING_BENCH_DRAWS      4096
+#define FRAME_RING_BENCH_BLOCK      192     // Pushed at 256 alignment, like uniform offsets
+
+void benchFrameRing(App* pApp)
+{
+    ASSERT(pApp);
+
+    const uint64 regionSize = FRAME_RING_BENCH_DRAWS * 256;
+    const uint32 frameCount = 2;
+    Arena arena = {};
+    initArena(regionSize * frameCount, &arena);
+    byte* pRange = (byte*)arenaPushZero(&arena, regionSize * frameCount);
+    byte block[FRAME_RING_BENCH_BLOCK];
+    memset(block, 1, sizeof(block));
+
+    FrameRing ring = {};
+    initFrameRing(regionSize, frameCount, &ring);
+    Timer timer = createTimer(pApp);
+    startTimer(&timer);
+    uint64 checksum = 0;
+    for(uint32 frame = 0; frame < FRAME_RING_BENCH_FRAMES; frame++)
+    {
+        beginRingFrame(&ring, frame);
+        for(uint32 i = 0; i < FRAME_RING_BENCH_DRAWS; i++)
+        {
+            block[0] = (byte)i;
+            uint64 offset = frameRingPush(&ring, sizeof(block), 256);
+            memcpy(pRange + offset, block, sizeof(block));
+            checksum += offset;
+        }
+    }
+    endTimer(&timer);
+    double pushMs = getMS(&timer);
+
+    // Bump pointer only, the cost of the ring itself
+    startTimer(&timer);
+    for(uint32 frame = 0; frame < FRAME_RING_BENCH_FRAMES; frame++)
+    {
+        beginRingFrame(&ring, frame);
+        for(uint32 i = 0; i < FRAME_RING_BENCH_DRAWS; i++)
+        {
+            checksum -= frameRingPush(&ring, sizeof(block), 256);
+        }
+    }
+    endTimer(&timer);
+    double allocMs = getMS(&timer);
+    ASSERT(checksum == 0);
+
+    double pushes = (double)FRAME_RING_BENCH_FRAMES * FRAME_RING_BENCH_DRAWS;
+    LOGF("[BENCH-CORE] Frame ring %u draws/frame: push+copy %6.2f ns, push %6.2f ns, %7.2f GB/s, peak %llu KB",
+            FRAME_RING_BENCH_DRAWS, pushMs * 1e6 / pushes, allocMs * 1e6 / pushes,
+            pushes * FRAME_RING_BENCH_BLOCK / (pushMs * 1e6), ring.mPeak / KB(1));
+    destroyArena(&arena);
+}
+
+// Previous hash map implementation, kept as the benchmark baseline. Note that
+// insert/remove probe from slot 0 instead of the key's home slot.
+template <typename Tk, typename Tv>
+struct LegacyHashMap
+{
+    struct Bucket
+    {
+        bool valid = false;
+        Tk key;
+        Tv value;
+    };
+
+    Array<Bucket> mBuckets;
+
+    bool contains(Tk key)
+    {
+        uint64 keyHash = HASH(key);
+        for(uint64 i = 0; i < mBuckets.mCount; i++)
+        {
+            uint64 pos = (keyHash + i) % mBuckets.mCount;
+            Bucket& bucket = mBuckets[pos];
+            if(bucket.valid && bucket.key == key) return true;
+        }
+        return false;
+    }
+
+    bool insert(const Tk& key, const Tv& value)
+    {
+        for(uint64 i = 0; i < mBuckets.mCount; i++)
+        {
+            if(mBuckets[i].valid && key == mBuckets[i].key) return false;
+            if(!mBuckets[i].valid)
+            {
+                mBuckets[i] = { true, key, value };
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+#define HASH_MAP_BENCH_LEGACY_MAX_KEYS 20000     // Legacy inserts are O(n), larger sizes take minutes
+
+void benchHashMap(App* pApp)
+{
+    ASSERT(pApp);
+
+    Arena arena = {};
+    initArena(GB(4), &arena);
+
+    for(uint64 keyCount = 1000; keyCount <= 10000000; keyCount *= 10)
+    {
+        // Spreading keys over the whole range, misses use odd keys
+        uint64* keys = (uint64*)arenaPush(&arena, keyCount * sizeof(uint64));
+        for(uint64 i = 0; i < keyCount; i++)
+        {
+            keys[i] = (i * 0x9E3779B97F4A7C15ULL) & ~1ULL;
+        }
+
+        uint64 found = 0;
+        Timer timer = createTimer(pApp);
+
+        // Growing from a small map, like callers that don't know their size up front
+        HashMap<uint64, uint64> map = hashmap<uint64, uint64>(&arena, 16);
+        startTimer(&timer);
+        for(uint64 i = 0; i < keyCount; i++) map.insert(keys[i], i);
+        endTimer(&timer);
+        double insertMs = getMS(&timer);
+
+        startTimer(&timer);
+        for(uint64 i = 0; i < keyCount; i++) found += map.contains(keys[i]);
+        endTimer(&timer);
+        double hitMs = getMS(&timer);
+
+        startTimer(&timer);
+        for(uint64 i = 0; i < keyCount; i++) found += map.contains(keys[i] | 1);
+        endTimer(&timer);
+        double missMs = getMS(&timer);
+        ASSERT(found == keyCount);
+
+        LOGF("[BENCH-CORE] HashMap %8llu keys: insert %7.2f ns/op, hit %6.2f ns/op, miss %6.2f ns/op",
+                (unsigned long long)keyCount, insertMs * 1e6 / keyCount, hitMs * 1e6 / keyCount, missMs * 1e6 / keyCount);
+
+        if(keyCount <= HASH_MAP_BENCH_LEGACY_MAX_KEYS)
+        {
+            // Legacy map needs its full size up front, sized for a 50% load
+            LegacyHashMap<uint64, uint64> legacy = {};
+            legacy.mBuckets = array<LegacyHashMap<uint64, uint64>::Bucket>(&arena, keyCount * 2,
+                    keyCount * 2, LegacyHashMap<uint64, uint64>::Bucket{});
+
+            found = 0;
+            startTimer(&timer);
+            for(uint64 i = 0; i < keyCount; i++) legacy.insert(keys[i], i);
+            endTimer(&timer);
+            insertMs = getMS(&timer);
+
+            startTimer(&timer);
+            for(uint64 i = 0; i < keyCount; i++) found += legacy.contains(keys[i]);
+            endTimer(&timer);
+            hitMs = getMS(&timer);
+
+            startTimer(&timer);
+            for(uint64 i = 0; i < keyCount; i++) found += legacy.contains(keys[i] | 1);
+            endTimer(&timer);
+            missMs = getMS(&timer);
+            ASSERT(found == keyCount);
+
+            LOGF("[BENCH-CORE] Legacy  %8llu keys: insert %7.2f ns/op, hit %6.2f ns/op, miss %6.2f ns/op",
+                    (unsigned long long)keyCount, insertMs * 1e6 / keyCount, hitMs * 1e6 / keyCount, missMs * 1e6 / keyCount);
+        }
+
+        arenaClear(&arena);
+    }
+
+    destroyArena(&arena);
+}
+
+void jobBenchEmptyProc(void* pData)
+{
+}
+
+void jobBenchComputeProc(uint32 begin, uint32 end, void* pData)
+{
+    float* pValues = (float*)pData;
+    for(uint32 i = begin; i < end; i++)
+    {
+        // A few dependent ops per element, compute bound rather than memory bound
+        float x = (float)i * 0.001f;
+        for(uint32 j = 0; j < 16; j++)
+        {
+            x = x * 0.999f + 0.5f / (1.f + x * x);
+        }
+        pValues[i] = x;
+    }
+}
+
+void benchJobs(App* pApp)
+{
+    ASSERT(pApp);
+
+    const uint32 jobCount = 100000;
+    const uint32 elementCount = 1 << 22;
+    Arena arena = {};
+    initArena(elementCount * sizeof(float) + MB(1), &arena);
+    float* pValues = (float*)arenaPush(&arena, elementCount * sizeof(float), 64);
+
+    Timer timer = createTimer(pApp);
+    uint32 coreCount = getCoreCount();
+    double baseMs = 0.0;
+    // 1, 2, 4... up to all cores
+    for(uint32 threadCount = 1;; threadCount = MIN(threadCount * 2, coreCount))
+    {
+        JobSystem jobs = {};
+        initJobSystem(threadCount, &jobs);
+
+        // Scheduling overhead, every job pushed from the main thread and mostly stolen
+        JobCounter counter = {};
+        startTimer(&timer);
+        for(uint32 i = 0; i < jobCount; i++)
+        {
+            runJob(&jobs, jobBenchEmptyProc, NULL, &counter);
+        }
+        waitJobs(&jobs, &counter);
+        endTimer(&timer);
+        double emptyMs = getMS(&timer);
+
+        uint64 stolen = 0;
+        for(uint32 i = 0; i < threadCount; i++)
+        {
+            stolen += jobs.pWorkers[i].mStolen;
+        }
+
+        startTimer(&timer);
+        parallelFor(&jobs, 0, elementCount, 16384, jobBenchComputeProc, pValues);
+        endTimer(&timer);
+        double computeMs = getMS(&timer);
+        if(threadCount == 1) baseMs = computeMs;
+
+        LOGF("[BENCH-CORE] Jobs %2u threads: empty jobs %7.1f ns/job (%5.1f%% stolen), parallelFor %4uM elements %8.2f ms (%.2fx)",
+                threadCount, emptyMs * 1e6 / jobCount, 100.0 * stolen / jobCount, elementCount >> 20, computeMs, baseMs / computeMs);
+
+        destroyJobSystem(&jobs);
+        if(threadCount == coreCount) break;
+    }
+
+    destroyArena(&arena);
+}
+
+// Touches every byte so both paths pay for getting the data into memory
+uint64 checksumFileBench(byte* pData, uint64 size)
+{
+    uint64 sum = 0;
+    uint64* pWords = (uint64*)pData;
+    for(uint64 i = 0; i < size / sizeof(uint64); i++)
+    {
+        sum += pWords[i];
+    }
+    return sum;
+}
+
+#define FILE_BENCH_PATH         "file_bench.bin"
+#define FILE_BENCH_MAX_SIZE     GB(2)
+#define FILE_BENCH_BYTES        GB(1)       // Read per size, small files are read many times
+
+void benchFileRead(App* pApp)
+{
+    ASSERT(pApp);
+
+    // Backs both the written contents and the copies read back
+    Arena arena = {};
+    initArena(FILE_BENCH_MAX_SIZE + MB(1), &arena);
+    String path = str(FILE_BENCH_PATH);
+    Timer timer = createTimer(pApp);
+
+    const uint64 sizes[] = { KB(1), KB(16), KB(256), MB(4), MB(64), MB(512), FILE_BENCH_MAX_SIZE };
+    for(uint32 i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        uint64 size = sizes[i];
+        uint64* pWords = (uint64*)arenaPush(&arena, size, 64);
+        for(uint64 w = 0; w < size / sizeof(uint64); w++)
+        {
+            pWords[w] = w * 0x9E3779B97F4A7C15ULL;
+        }
+        uint64 expected = checksumFileBench((byte*)pWords, size);
+        uint64 written = writeFile(path, (byte*)pWords, size);
+        ASSERT(written == size);
+        arenaClear(&arena);
+
+        // Files were just written so both paths read from a warm page cache, the
+        // difference is the copy into the arena versus faulting in shared pages
+        uint32 iterations = (uint32)CLAMP(FILE_BENCH_BYTES / size, 1, 100000);
+        startTimer(&timer);
+        for(uint32 iter = 0; iter < iterations; iter++)
+        {
+            uint64 readSize = 0;
+            byte* pData = readFile(&arena, path, &readSize);
+            uint64 sum = checksumFileBench(pData, readSize);
+            ASSERT(sum == expected);
+            arenaClear(&arena);
+        }
+        endTimer(&timer);
+        double copyMs = getMS(&timer) / iterations;
+
+        startTimer(&timer);
+        for(uint32 iter = 0; iter < iterations; iter++)
+        {
+            FileView view = {};
+            bool mapped = mapFile(path, &view);
+            ASSERT(mapped);
+            uint64 sum = checksumFileBench(view.pData, view.mSize);
+            ASSERT(sum == expected);
+            unmapFile(&view);
+        }
+        endTimer(&timer);
+        double mapMs = getMS(&timer) / iterations;
+
+        double gb = (double)size / GB(1);
+        LOGF("[BENCH-CORE] File %8llu KB: readFile %10.3f ms (%5.2f GB/s), mapFile %10.3f ms (%5.2f GB/s)",
+                size / KB(1), copyMs, gb / (copyMs / 1000.0), mapMs, gb / (mapMs / 1000.0));
+    }
+
+    deleteFile(path);
+    destroyArena(&arena);
+}
+
+#define ASYNC_IO_BENCH_DIR      "io_bench"
+#define ASYNC_IO_BENCH_FILES    2000
+
+// Small files of 4 to 64 KB, like shaders, materials and small textures
+void benchAsyncIO(App* pApp)
+{
+    ASSERT(pApp);
+
+    Arena arena = {};
+    initArena(ASYNC_IO_BENCH_FILES * KB(64) * 2 + MB(1), &arena);
+    String* pPaths = (String*)arenaPush(&arena, ASYNC_IO_BENCH_FILES * sizeof(String));
+    uint64* pSizes = (uint64*)arenaPush(&arena, ASYNC_IO_BENCH_FILES * sizeof(uint64));
+    byte* pContent = (byte*)arenaPush(&arena, KB(64));
+    for(uint64 i = 0; i < KB(64); i++)
+    {
+        pContent[i] = (byte)(i * 31);
+    }
+
+    uint64 totalSize = 0;
+    createDir(str(ASYNC_IO_BENCH_DIR));
+    for(uint32 i = 0; i < ASYNC_IO_BENCH_FILES; i++)
+    {
+        pPaths[i] = strf(&arena, ASYNC_IO_BENCH_DIR "/%04u.bin", i);
+        pSizes[i] = KB(4) << (i % 5);
+        writeFile(pPaths[i], pContent, pSizes[i]);
+        totalSize += pSizes[i];
+    }
+    byte* pData = (byte*)arenaPush(&arena, totalSize);
+    ARENA_CHECKPOINT_SET(&arena, reads);
+
+    // All files were just written, so this measures the per file overhead (open, read,
+    // close syscalls and their latency) more than the disk
+    Timer timer = createTimer(pApp);
+    startTimer(&timer);
+    for(uint32 i = 0; i < ASYNC_IO_BENCH_FILES; i++)
+    {
+        readFile(&arena, pPaths[i], NULL);
+    }
+    endTimer(&timer);
+    double baseMs = getMS(&timer);
+    ARENA_CHECKPOINT_RESET(&arena, reads);
+    double totalMB = (double)totalSize / MB(1);
+    LOGF("[BENCH-CORE] AsyncIO readFile sequential:   %8.2f ms, %8.0f files/s, %7.1f MB/s",
+            baseMs, ASYNC_IO_BENCH_FILES / (baseMs / 1000.0), totalMB / (baseMs / 1000.0));
+
+    JobSystem jobs = {};
+    initJobSystem(getCoreCount(), &jobs);
+
+    struct { const char* mName; IOBackend mBackend; JobSystem* pJobs; uint32 mDepth; } configs[] =
+    {
+        { "io_uring", IO_BACKEND_URING, NULL, 16 },
+        { "io_uring", IO_BACKEND_URING, NULL, 128 },
+        { "jobs    ", IO_BACKEND_JOBS, &jobs, 16 },
+        { "jobs    ", IO_BACKEND_JOBS, &jobs, 128 },
+    };
+    for(uint32 c = 0; c < sizeof(configs) / sizeof(configs[0]); c++)
+    {
+        AsyncIODesc desc = {};
+        desc.mBackend = configs[c].mBackend;
+        desc.pJobs = configs[c].pJobs;
+        desc.mQueueDepth = configs[c].mDepth;
+        AsyncIO io = {};
+        if(!initAsyncIO(desc, &io))
+        {
+            LOGF("[BENCH-CORE] AsyncIO %s unavailable", configs[c].mName);
+            continue;
+        }
+
+        startTimer(&timer);
+        uint64 offset = 0;
+        for(uint32 i = 0; i < ASYNC_IO_BENCH_FILES; i++)
+        {
+            IORead read = {};
+            read.mPath = pPaths[i];
+            read.mSize = pSizes[i];
+            read.pDst = pData + offset;
+            readFileAsync(&io, read);
+            offset += pSizes[i];
+        }
+        waitAsyncIO(&io);
+        endTimer(&timer);
+        double ms = getMS(&timer);
+        ASSERT(io.mStats.mCompleted == ASYNC_IO_BENCH_FILES && io.mStats.mBytesRead == totalSize);
+
+        LOGF("[BENCH-CORE] AsyncIO %s depth %3u: %8.2f ms, %8.0f files/s, %7.1f MB/s (%.2fx), %llu submits",
+                configs[c].mName, configs[c].mDepth, ms, ASYNC_IO_BENCH_FILES / (ms / 1000.0),
+                totalMB / (ms / 1000.0), baseMs / ms, io.mStats.mSubmits);
+        destroyAsyncIO(&io);
+    }
+
+    destroyJobSystem(&jobs);
+    for(uint32 i = 0; i < ASYNC_IO_BENCH_FILES; i++)
+    {
+        deleteFile(pPaths[i]);
+    }
+    deleteDir(str(ASYNC_IO_BENCH_DIR));
+    destroyArena(&arena);
+}
+
+void benchCore(App* pApp)
+{
+    ASSERT(pApp);
+    LOG("[BENCH-CORE] Benchmarking pool allocator...");
+    benchPool(pApp);
+
+    LOG("[BENCH-CORE] Benchmarking frame ring allocator...");
+    benchFrameRing(pApp);
+
+    LOG("[BENCH-CORE] Benchmarking hash map...");
+    benchHashMap(pApp);
+
+    LOG("[BENCH-CORE] Benchmarking job system...");
+    benchJobs(pApp);
+
+    LOG("[BENCH-CORE] Benchmarking file reads...");
+    benchFileRead(pApp);
+
+    LOG("[BENCH-CORE] Benchmarking async file reads...");
+    benchAsyncIO(pApp);
+
+    LOG("[BENCH-CORE] All core benchmarks done.");
+}
@@ -2,8 +2,53 @@
 #include "debug.hpp"
 #include "string.hpp"
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 // TODO_DW: MULTIPLATFORM
 
+// ReadFile/WriteFile take 32-bit sizes, larger files go through in chunks
+#define FILE_IO_CHUNK_SIZE GB(1)
+
+HANDLE openFileRead(String path, DWORD flags = FILE_ATTRIBUTE_NORMAL)
+{
+    return CreateFile(
+            cstr(path),
+            GENERIC_READ,
+            FILE_SHARE_READ,
+            NULL,
+            OPEN_EXISTING,
+            flags,
+            NULL);
+}
+
+uint64 getHandleSize(HANDLE hFile)
+{
+    LARGE_INTEGER size = {};
+    BOOL ret = GetFileSizeEx(hFile, &size);
+    ASSERT(ret);
+    return (uint64)size.QuadPart;
+}
+
+uint64 readHandle(HANDLE hFile, byte* pOut, uint64 size)
+{
+    uint64 total = 0;
+    while(total < size)
+    {
+        DWORD chunk = (DWORD)MIN(size - total, FILE_IO_CHUNK_SIZE);
+        DWORD bytesRead = 0;
+        BOOL ret = ReadFile(hFile, pOut + total, chunk, &bytesRead, NULL);
+        ASSERT(ret);
+        if(!ret || bytesRead == 0) break;
+        total += bytesRead;
+    }
+    return total;
+}
+
 bool pathExists(String path)
 {
     DWORD fileAttributes = GetFileAttributes(cstr(path));
@@ -73,19 +118,21 @@ uint64 getFileSize(String path)
     ASSERT(pathExists(path));
     ASSERT(!pathIsDir(path));
 
-    HANDLE hFile = CreateFile(
-            cstr(path),
-            GENERIC_READ,
-            FILE_SHARE_READ,
-            NULL,
-            OPEN_EXISTING,
-            FILE_ATTRIBUTE_NORMAL,
-            NULL);
+    HANDLE hFile = openFileRead(path);
     ASSERT(hFile != INVALID_HANDLE_VALUE);
-    DWORD fSize = ::GetFileSize(hFile, NULL);
-    ASSERT(fSize != INVALID_FILE_SIZE);
+    uint64 fSize = getHandleSize(hFile);
     CloseHandle(hFile);
-    return (uint64)fSize;
+    return fSize;
+}
+
+uint64 getFileTime(String path)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data = {};
+    if(!GetFileAttributesEx(cstr(path), GetFileExInfoStandard, &data)) return 0;
+    ULARGE_INTEGER time = {};
+    time.LowPart = data.ftLastWriteTime.dwLowDateTime;
+    time.HighPart = data.ftLastWriteTime.dwHighDateTime;
+    return time.QuadPart;
 }
 
 bool createFile(String path)
@@ -126,74 +173,193 @@ bool deleteDir(String path)
     return true;
 }
 
+bool moveFile(String src, String dst)
+{
+    BOOL ret = MoveFileEx(cstr(src), cstr(dst), MOVEFILE_REPLACE_EXISTING);
+    return ret != 0;
+}
+
 uint64 readFile(String path, byte* pOut)
 {
-    HANDLE hFile = CreateFile(
-            cstr(path),
-            GENERIC_READ,
-            FILE_SHARE_READ,
-            NULL,
-            OPEN_EXISTING,
-            FILE_ATTRIBUTE_NORMAL,
-            NULL);
+    HANDLE hFile = openFileRead(path, FILE_FLAG_SEQUENTIAL_SCAN);
     ASSERT(hFile != INVALID_HANDLE_VALUE);
-    DWORD fSize = GetFileSize(hFile, NULL);
-    ASSERT(fSize != INVALID_FILE_SIZE);
-    DWORD bytesRead = 0;
-    BOOL ret = ReadFile(
-            hFile,
-            pOut,
-            fSize,
-            &bytesRead,
-            NULL);
-    ASSERT(ret);
-
+    uint64 bytesRead = readHandle(hFile, pOut, getHandleSize(hFile));
     CloseHandle(hFile);
-    return (uint64)bytesRead;
+    return bytesRead;
 }
 
+// Opening once for both the size and the read
 byte* readFile(Arena* pArena, String path, uint64* pOutSize)
 {
-    uint64 fSize = getFileSize(path);
+    HANDLE hFile = openFileRead(path, FILE_FLAG_SEQUENTIAL_SCAN);
+    ASSERT(hFile != INVALID_HANDLE_VALUE);
+    uint64 fSize = getHandleSize(hFile);
     byte* result = (byte*)arenaPush(pArena, fSize);
-    uint64 bytesRead = readFile(path, result);
+    uint64 bytesRead = readHandle(hFile, result, fSize);
     ASSERT(bytesRead == fSize);
+    CloseHandle(hFile);
     if(pOutSize) *pOutSize = fSize;
     return result;
 }
 
 String readFileStr(Arena* pArena, String path)
 {
-    uint64 fSize = getFileSize(path);
+    HANDLE hFile = openFileRead(path, FILE_FLAG_SEQUENTIAL_SCAN);
+    ASSERT(hFile != INVALID_HANDLE_VALUE);
+    uint64 fSize = getHandleSize(hFile);
     byte* buf = (byte*)arenaPush(pArena, fSize + 1);
-    uint64 len = readFile(path, buf);
+    uint64 len = readHandle(hFile, buf, fSize);
     ASSERT(len == fSize);
+    CloseHandle(hFile);
     buf[len] = 0;   // Null terminator for c-string compatibility.
     return str(buf, len);
 }
 
+// Replaces the file, creating it if needed
 uint64 writeFile(String path, byte* pSrc, uint64 len)
 {
     HANDLE hFile = CreateFile(
             cstr(path),
             GENERIC_WRITE,
-            FILE_SHARE_WRITE,
+            0,
             NULL,
-            OPEN_EXISTING,
+            CREATE_ALWAYS,
             FILE_ATTRIBUTE_NORMAL,
             NULL);
     ASSERT(hFile != INVALID_HANDLE_VALUE);
-    DWORD fSize = ::GetFileSize(hFile, NULL);
-    ASSERT(fSize != INVALID_FILE_SIZE);
-    DWORD bytesWritten = 0;
-    BOOL ret = WriteFile(
-            hFile,
-            pSrc,
-            len,
-            &bytesWritten,
-            NULL);
-    ASSERT(ret);
+    uint64 total = 0;
+    while(total < len)
+    {
+        DWORD chunk = (DWORD)MIN(len - total, FILE_IO_CHUNK_SIZE);
+        DWORD bytesWritten = 0;
+        BOOL ret = WriteFile(
+                hFile,
+                pSrc + total,
+                chunk,
+                &bytesWritten,
+                NULL);
+        ASSERT(ret);
+        if(!ret || bytesWritten == 0) break;
+        total += bytesWritten;
+    }
 
     CloseHandle(hFile);
-    return (uint64)bytesWritten;
+    return total;
 }
+
+// Memory mapped files. Neither platform needs the file handle once the view exists,
+// the view keeps the file referenced until it is unmapped.
+#ifdef _WIN32
+
+bool mapFile(String path, FileView* pOut, FileAccess access)
+{
+    ASSERT(pOut);
+    *pOut = {};
+    HANDLE hFile = openFileRead(path, 
+            access == FILE_ACCESS_SEQUENTIAL ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS);
+    if(hFile == INVALID_HANDLE_VALUE) return false;
+
+    uint64 size = getHandleSize(hFile);
+    if(size == 0)
+    {
+        // Empty files can't be mapped, an empty view is still valid
+        CloseHandle(hFile);
+        return true;
+    }
+
+    HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(hFile);
+    if(!hMapping) return false;
+    void* pData = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(hMapping);
+    if(!pData) return false;
+
+    pOut->pData = (byte*)pData;
+    pOut->mSize = size;
+    if(access == FILE_ACCESS_SEQUENTIAL)
+    {
+        prefetchFile(pOut, 0, FILE_VIEW_PREFETCH_SIZE);
+    }
+    return true;
+}
+
+void unmapFile(FileView* pView)
+{
+    ASSERT(pView);
+    if(pView->pData)
+    {
+        BOOL ret = UnmapViewOfFile(pView->pData);
+        ASSERT(ret);
+    }
+    *pView = {};
+}
+
+void prefetchFile(FileView* pView, uint64 offset, uint64 size)
+{
+    ASSERT(pView);
+    if(offset >= pView->mSize) return;
+    WIN32_MEMORY_RANGE_ENTRY range = {};
+    range.VirtualAddress = pView->pData + offset;
+    range.NumberOfBytes = (SIZE_T)MIN(size, pView->mSize - offset);
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#else
+
+bool mapFile(String path, FileView* pOut, FileAccess access)
+{
+    ASSERT(pOut);
+    *pOut = {};
+    int fd = open(cstr(path), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return false;
+
+    struct stat info = {};
+    if(fstat(fd, &info) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    if(info.st_size == 0)
+    {
+        // Empty files can't be mapped, an empty view is still valid
+        close(fd);
+        return true;
+    }
+
+    uint64 size = (uint64)info.st_size;
+    void* pData = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(pData == MAP_FAILED) return false;
+    madvise(pData, (size_t)size, access == FILE_ACCESS_SEQUENTIAL ? MADV_SEQUENTIAL : MADV_RANDOM);
+
+    pOut->pData = (byte*)pData;
+    pOut->mSize = size;
+    if(access == FILE_ACCESS_SEQUENTIAL)
+    {
+        prefetchFile(pOut, 0, FILE_VIEW_PREFETCH_SIZE);
+    }
+    return true;
+}
+
+void unmapFile(FileView* pView)
+{
+    ASSERT(pView);
+    if(pView->pData)
+    {
+        int ret = munmap(pView->pData, (size_t)pView->mSize);
+        ASSERT(ret == 0);
+    }
+    *pView = {};
+}
+
+void prefetchFile(FileView* pView, uint64 offset, uint64 size)
+{
+    ASSERT(pView);
+    if(offset >= pView->mSize) return;
+    // madvise wants a page aligned start
+    uint64 start = offset & ~(getPageSize() - 1);
+    uint64 end = offset + MIN(size, pView->mSize - offset);
+    madvise(pView->pData + start, (size_t)(end - start), MADV_WILLNEED);
+}
+
+#endif
@@ -11,14 +11,48 @@ String getNoExt(String path);
 String getFileName(String path, bool ext = false);
 String getFileDir(String path, bool trailingSlash = false);
 uint64 getFileSize(String path);
+uint64 getFileTime(String path);    // Last write, only meaningful compared to other times. 0 if missing
 
 bool createFile(String path);
 bool createDir(String path);
 bool deleteFile(String path);
 bool deleteDir(String path);
+bool moveFile(String src, String dst);  // Replaces dst, atomically within a volume
 
 uint64  readFile(String path, byte* pOut);
 byte*   readFile(Arena* pArena, String path, uint64* pOutSize = NULL);
 String  readFileStr(Arena* pArena, String path);
 
 uint64  writeFile(String path, byte* pSrc, uint64 len);
+
+// Memory mapped files
+// Read-only view of a whole file, pages are faulted in straight from the OS page cache
+// instead of being copied into an arena. The view stays valid until unmapFile, the file
+// itself may be closed or deleted meanwhile. Setting up a mapping costs more than a
+// small read, files of a few KB are cheaper to read with readFile.
+//
+//  FileView view = {};
+//  if(mapFile(path, &view))
+//  {
+//      parse(view.pData, view.mSize);
+//      unmapFile(&view);
+//  }
+#define FILE_VIEW_PREFETCH_SIZE MB(8)   // Paged in ahead on sequential maps
+
+enum FileAccess : uint32
+{
+    FILE_ACCESS_SEQUENTIAL = 0,     // Parsers reading front to back, aggressive read-ahead
+    FILE_ACCESS_RANDOM,             // Sparse lookups into large files, no read-ahead
+};
+
+struct FileView
+{
+    byte*   pData   = NULL;     // NULL for empty files
+    uint64  mSize   = 0;
+};
+
+// Returns false if the file can't be opened or mapped.
+bool    mapFile(String path, FileView* pOut, FileAccess access = FILE_ACCESS_SEQUENTIAL);
+void    unmapFile(FileView* pView);
+// Starts paging in a range asynchronously, ahead of reading it.
+void    prefetchFile(FileView* pView, uint64 offset, uint64 size);
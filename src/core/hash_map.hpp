@@ -1,13 +1,17 @@
 #pragma once
 #include "base.hpp"
-#include "array.hpp"
+#include "memory.hpp"
+#include "debug.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HASH_MAP_SSE2
+#endif
 
 #define HASH(x) hash((x))
 
-inline uint64 hash(void* p)
+inline uint64 hash(uint64 x)
 {
-    uint64 x = (uint64)p;
-
     // Mix bits: variant of splitmix64 finalizer
     x ^= x >> 33;
     x *= 0xff51afd7ed558ccdULL;
@@ -18,107 +22,252 @@ inline uint64 hash(void* p)
     return x;
 }
 
+inline uint64 hash(void* p)     { return hash((uint64)p); }
+inline uint64 hash(int64 x)     { return hash((uint64)x); }
+inline uint64 hash(uint32 x)    { return hash((uint64)x); }
+inline uint64 hash(int32 x)     { return hash((uint64)(int64)x); }
+
 // Hash map
+// Open addressing in the style of Swiss tables. One control byte per slot, kept
+// apart from the slots, holds either EMPTY, DELETED or the low 7 bits of the
+// key's hash (H2). Probing walks 16 slot groups (triangular sequence over the
+// groups) and matches H2 against a whole group at once, only comparing keys on
+// H2 hits. Removal leaves a tombstone unless the group still has an empty slot.
+// When out of room the map rehashes: into a table twice as big when it has an
+// arena to grow in, otherwise in place to purge tombstones.
+#define HASH_MAP_GROUP_WIDTH    16
+#define HASH_MAP_CTRL_EMPTY     ((int8)0x80)
+#define HASH_MAP_CTRL_DELETED   ((int8)0xFE)
+#define HASH_MAP_H1(H)          ((H) >> 7)
+#define HASH_MAP_H2(H)          ((int8)((H) & 0x7F))
+#define HASH_MAP_MAX_LOAD(CAP)  ((CAP) - (CAP) / 8)     // 7/8 max load factor
+
+// Bitmask of the slots within a group whose control byte equals ctrl.
+inline uint32 hashMapMatch(const int8* pGroup, int8 ctrl)
+{
+#ifdef HASH_MAP_SSE2
+    __m128i group = _mm_load_si128((const __m128i*)pGroup);
+    return (uint32)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(ctrl)));
+#else
+    uint32 mask = 0;
+    for(uint32 i = 0; i < HASH_MAP_GROUP_WIDTH; i++)
+    {
+        if(pGroup[i] == ctrl) mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+// Bitmask of the slots within a group that are either empty or deleted.
+inline uint32 hashMapMatchFree(const int8* pGroup)
+{
+#ifdef HASH_MAP_SSE2
+    __m128i group = _mm_load_si128((const __m128i*)pGroup);
+    return (uint32)_mm_movemask_epi8(group);     // Only EMPTY/DELETED have the sign bit set
+#else
+    uint32 mask = 0;
+    for(uint32 i = 0; i < HASH_MAP_GROUP_WIDTH; i++)
+    {
+        if(pGroup[i] < 0) mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+inline uint32 hashMapFirstBit(uint32 mask)
+{
+    ASSERT(mask);
+    return (uint32)__builtin_ctz(mask);
+}
+
 template <typename Tk, typename Tv>
 struct HashMap
 {
-    struct Bucket
+    struct Slot
     {
-        bool valid = false;
         Tk key;
         Tv value;
     };
 
-    Array<Bucket> mBuckets;
+    int8*   pCtrl       = NULL;
+    Slot*   pSlots      = NULL;
+    uint64  mCapacity   = 0;        // Power of 2, multiple of HASH_MAP_GROUP_WIDTH
+    uint64  mCount      = 0;
+    uint64  mGrowthLeft = 0;        // Empty slots that can still be filled before rehashing
+    Arena*  pArena      = NULL;     // Arena to grow in, NULL for fixed capacity
 
-    Tv& operator[](Tk key)
+    // Returns the slot index of key or MAX_UINT64.
+    uint64 findIndex(const Tk& key) const
     {
+        if(!mCapacity) return MAX_UINT64;
+
         uint64 keyHash = HASH(key);
-        for(uint64 i = 0; i < mBuckets.mCount; i++)
+        int8 h2 = HASH_MAP_H2(keyHash);
+        uint64 groupMask = mCapacity / HASH_MAP_GROUP_WIDTH - 1;
+        uint64 group = HASH_MAP_H1(keyHash) & groupMask;
+        for(uint64 probe = 1; probe <= groupMask + 1; probe++)
         {
-            uint64 pos = (keyHash + i) % mBuckets.mCount;
-            Bucket& bucket = mBuckets[pos];
-            if(bucket.valid && bucket.key == key) return bucket.value;
+            const int8* pGroup = pCtrl + group * HASH_MAP_GROUP_WIDTH;
+            uint32 match = hashMapMatch(pGroup, h2);
+            while(match)
+            {
+                uint64 index = group * HASH_MAP_GROUP_WIDTH + hashMapFirstBit(match);
+                if(pSlots[index].key == key) return index;
+                match &= match - 1;
+            }
+            if(hashMapMatch(pGroup, HASH_MAP_CTRL_EMPTY)) return MAX_UINT64;
+            group = (group + probe) & groupMask;
         }
-        ASSERT(0);      // Linear probing failed, hash map too small.
-        return mBuckets[0].value;
+        return MAX_UINT64;
+    }
+
+    Tv* find(const Tk& key)
+    {
+        uint64 index = findIndex(key);
+        return index == MAX_UINT64 ? NULL : &pSlots[index].value;
+    }
+
+    Tv& operator[](const Tk& key)
+    {
+        uint64 index = findIndex(key);
+        ASSERT(index != MAX_UINT64);      // Key not present in the hash map.
+        return pSlots[index].value;
     };
 
-    const Tv& operator[](Tk key) const
+    const Tv& operator[](const Tk& key) const
     {
+        uint64 index = findIndex(key);
+        ASSERT(index != MAX_UINT64);      // Key not present in the hash map.
+        return pSlots[index].value;
+    };
+
+    bool contains(const Tk& key) const
+    {
+        return findIndex(key) != MAX_UINT64;
+    }
+
+    // Returns false (and keeps the old value) if the key was already present.
+    bool insert(const Tk& key, const Tv& value)
+    {
+        if(findIndex(key) != MAX_UINT64) return false;
 
         uint64 keyHash = HASH(key);
-        for(uint64 i = 0; i < mBuckets.mCount; i++)
+        uint64 index = findFree(keyHash);
+        if(pCtrl[index] == HASH_MAP_CTRL_EMPTY && !mGrowthLeft)
         {
-            uint64 pos = (keyHash + i) % mBuckets.mCount;
-            Bucket& bucket = mBuckets[pos];
-            if(bucket.valid && bucket.key == key) return bucket.value;
+            rehash();
+            index = findFree(keyHash);
         }
-        ASSERT(0);      // Linear probing failed, hash map too small.
-        return mBuckets[0].value;
-    };
 
-    bool contains(Tk key)
+        if(pCtrl[index] == HASH_MAP_CTRL_EMPTY) mGrowthLeft--;
+        pCtrl[index] = HASH_MAP_H2(keyHash);
+        pSlots[index].key = key;
+        pSlots[index].value = value;
+        mCount++;
+        return true;
+    }
+
+    void remove(const Tk& key)
     {
-        uint64 keyHash = HASH(key);
-        for(uint64 i = 0; i < mBuckets.mCount; i++)
+        uint64 index = findIndex(key);
+        ASSERT(index != MAX_UINT64);      // Key not present in the hash map, invalid op.
+
+        // Probes stop at the first group with an empty slot, so if this group
+        // still has one no probe sequence runs through it and no tombstone is needed.
+        const int8* pGroup = pCtrl + (index & ~(uint64)(HASH_MAP_GROUP_WIDTH - 1));
+        if(hashMapMatch(pGroup, HASH_MAP_CTRL_EMPTY))
         {
-            uint64 pos = (keyHash + i) % mBuckets.mCount;
-            Bucket& bucket = mBuckets[pos];
-            if(bucket.valid && bucket.key == key) return true;
+            pCtrl[index] = HASH_MAP_CTRL_EMPTY;
+            mGrowthLeft++;
         }
-        return false;
+        else
+        {
+            pCtrl[index] = HASH_MAP_CTRL_DELETED;
+        }
+        mCount--;
     }
 
-    bool insert(const Tk& key, const Tv& value)
+    void clear()
     {
-        uint64 keyHash = HASH(key);
-        for(uint64 i = 0; i < mBuckets.mCount; i++)
-        {
-            uint64 pos = (keyHash + i) % mBuckets.mCount;
-            if(mBuckets[i].valid)
-            {
-                if(key == mBuckets[i].key)
-                {
-                    return false;
-                }
-            }
+        memset(pCtrl, (uint8)HASH_MAP_CTRL_EMPTY, mCapacity);
+        mCount = 0;
+        mGrowthLeft = HASH_MAP_MAX_LOAD(mCapacity);
+    }
 
-            if(!mBuckets[i].valid)
-            {
-                mBuckets[i] = { true, key, value };
-                return true;
-            }
+    // First empty or deleted slot on the probe sequence of the hash.
+    uint64 findFree(uint64 keyHash) const
+    {
+        uint64 groupMask = mCapacity / HASH_MAP_GROUP_WIDTH - 1;
+        uint64 group = HASH_MAP_H1(keyHash) & groupMask;
+        for(uint64 probe = 1; probe <= groupMask + 1; probe++)
+        {
+            uint32 match = hashMapMatchFree(pCtrl + group * HASH_MAP_GROUP_WIDTH);
+            if(match) return group * HASH_MAP_GROUP_WIDTH + hashMapFirstBit(match);
+            group = (group + probe) & groupMask;
         }
-        ASSERT(0);      // Linear probing failed, hash map too small.
-        return false;
+        ASSERT(0);      // Unreachable, the max load factor keeps free slots around.
+        return 0;
     }
 
-    void remove(const Tk& key)
+    void allocate(Arena* pAllocArena, uint64 capacity)
     {
-        uint64 keyHash = HASH(key);
-        for(uint64 i = 0; i < mBuckets.mCount; i++)
+        pCtrl = (int8*)arenaPush(pAllocArena, capacity, HASH_MAP_GROUP_WIDTH);
+        pSlots = (Slot*)arenaPush(pAllocArena, capacity * sizeof(Slot), alignof(Slot));
+        mCapacity = capacity;
+        clear();
+    }
+
+    // Grows (with an arena) or purges tombstones, reinserting every live slot.
+    // The old table is left behind in the arena.
+    void rehash()
+    {
+        int8* pOldCtrl = pCtrl;
+        Slot* pOldSlots = pSlots;
+        uint64 oldCapacity = mCapacity;
+
+        ScratchScope scratch(pArena);
+        if(pArena)
         {
-            uint64 pos = (keyHash + i) % mBuckets.mCount;
-            if(mBuckets[i].valid && mBuckets[i].key == key)
-            {
-                mBuckets[i].valid = false;
-                return;
-            }
+            allocate(pArena, oldCapacity * 2);
+        }
+        else
+        {
+            ASSERT(mCount < HASH_MAP_MAX_LOAD(mCapacity));      // Fixed capacity hash map is full.
+
+            // Rehashing in place through a scratch copy of the live slots
+            pOldCtrl = (int8*)arenaPushCopy(scratch.pArena, oldCapacity, pCtrl, oldCapacity);
+            pOldSlots = (Slot*)arenaPushCopy(scratch.pArena, oldCapacity * sizeof(Slot), pSlots, oldCapacity * sizeof(Slot), alignof(Slot));
+            clear();
+        }
+
+        mCount = 0;
+        for(uint64 i = 0; i < oldCapacity; i++)
+        {
+            if(pOldCtrl[i] < 0) continue;
+            uint64 keyHash = HASH(pOldSlots[i].key);
+            uint64 index = findFree(keyHash);
+            pCtrl[index] = HASH_MAP_H2(keyHash);
+            pSlots[index] = pOldSlots[i];
+            mGrowthLeft--;
+            mCount++;
         }
-        ASSERT(0);      // Key not present in the hash map, invalid op.
     }
 };
 
+// Capacity is the number of entries that fit without rehashing. Unless growable
+// is false, the map doubles in size in pArena when it runs out of room.
 template <typename Tk, typename Tv>
-HashMap<Tk, Tv> hashmap(Arena* pArena, uint64 capacity)
+HashMap<Tk, Tv> hashmap(Arena* pArena, uint64 capacity, bool growable = true)
 {
-    HashMap<Tk, Tv> result = {};
-    result.mBuckets = array<typename HashMap<Tk, Tv>::Bucket>(pArena, capacity);
-    typename HashMap<Tk, Tv>::Bucket empty = {};
-    for(uint64 i = 0; i < capacity; i++)
+    ASSERT(pArena);
+    uint64 slotCount = HASH_MAP_GROUP_WIDTH;
+    while(HASH_MAP_MAX_LOAD(slotCount) < capacity)
     {
-        result.mBuckets.push(empty);
+        slotCount *= 2;
     }
+
+    HashMap<Tk, Tv> result = {};
+    result.pArena = growable ? pArena : NULL;
+    result.allocate(pArena, slotCount);
     return result;
 }
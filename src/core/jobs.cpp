@@ -0,0 +1,398 @@
+#include "jobs.hpp"
+#include "debug.hpp"
+
+#define JOB_DEQUE_MASK (JOB_DEQUE_SIZE - 1)
+
+thread_local JobWorker* tJobWorker = NULL;
+
+inline JobWorker* jobGetWorker(JobSystem* pJobs)
+{
+    ASSERT(tJobWorker && tJobWorker->pJobs == pJobs);     // Not a thread of this job system
+    return tJobWorker;
+}
+
+// Chase-Lev deque (fixed size, "Correct and Efficient Work-Stealing for Weak Memory Models")
+bool jobDequePush(JobDeque* pDeque, Job* pJob)
+{
+    int64 bottom = atomicLoadRelaxed(&pDeque->mBottom);
+    int64 top = atomicLoad(&pDeque->mTop);
+    if(bottom - top >= JOB_DEQUE_SIZE) return false;
+
+    atomicStoreRelaxed(&pDeque->pJobs[bottom & JOB_DEQUE_MASK], pJob);
+    atomicStore(&pDeque->mBottom, bottom + 1);      // Publishes the job to thieves
+    return true;
+}
+
+Job* jobDequePop(JobDeque* pDeque)
+{
+    int64 bottom = atomicLoadRelaxed(&pDeque->mBottom) - 1;
+    atomicStoreRelaxed(&pDeque->mBottom, bottom);
+    atomicFence();
+    int64 top = atomicLoadRelaxed(&pDeque->mTop);
+    if(top > bottom)
+    {
+        atomicStoreRelaxed(&pDeque->mBottom, bottom + 1);
+        return NULL;
+    }
+
+    Job* pJob = atomicLoadRelaxed(&pDeque->pJobs[bottom & JOB_DEQUE_MASK]);
+    if(top == bottom)
+    {
+        // Last job, racing the thieves for it
+        if(!atomicCompareExchange(&pDeque->mTop, &top, top + 1)) pJob = NULL;
+        atomicStoreRelaxed(&pDeque->mBottom, bottom + 1);
+    }
+    return pJob;
+}
+
+Job* jobDequeSteal(JobDeque* pDeque)
+{
+    int64 top = atomicLoad(&pDeque->mTop);
+    atomicFence();
+    int64 bottom = atomicLoad(&pDeque->mBottom);
+    if(top >= bottom) return NULL;
+
+    Job* pJob = atomicLoadRelaxed(&pDeque->pJobs[top & JOB_DEQUE_MASK]);
+    if(!atomicCompareExchange(&pDeque->mTop, &top, top + 1)) return NULL;
+    return pJob;
+}
+
+Job* jobFind(JobSystem* pJobs, JobWorker* pWorker)
+{
+    Job* pJob = jobDequePop(&pWorker->mDeque);
+    if(pJob) return pJob;
+
+    // Stealing, starting from a random victim so thieves spread out
+    uint32 count = pJobs->mWorkerCount;
+    pWorker->mRandom ^= pWorker->mRandom << 13;
+    pWorker->mRandom ^= pWorker->mRandom >> 17;
+    pWorker->mRandom ^= pWorker->mRandom << 5;
+    uint32 start = pWorker->mRandom % count;
+    for(uint32 i = 0; i < count; i++)
+    {
+        uint32 victim = (start + i) % count;
+        if(victim == pWorker->mIndex) continue;
+        pJob = jobDequeSteal(&pJobs->pWorkers[victim].mDeque);
+        if(pJob)
+        {
+            pWorker->mStolen++;
+            return pJob;
+        }
+    }
+    return NULL;
+}
+
+void jobExecute(JobSystem* pJobs, JobWorker* pWorker, Job* pJob);
+
+void jobSubmit(JobSystem* pJobs, JobWorker* pWorker, Job* pJob)
+{
+    if(!jobDequePush(&pWorker->mDeque, pJob))
+    {
+        // Deque full, running it here keeps the producer from outrunning the workers
+        jobExecute(pJobs, pWorker, pJob);
+        return;
+    }
+
+    // Waking one sleeper, the fence pairs with the one in jobSleep so either the
+    // sleeper sees the job or we see the sleeper
+    atomicFence();
+    uint32 sleeping = atomicLoad(&pJobs->mSleeping);
+    while(sleeping)
+    {
+        if(atomicCompareExchange(&pJobs->mSleeping, &sleeping, sleeping - 1))
+        {
+            signalSemaphore(&pJobs->mWakeup);
+            break;
+        }
+    }
+}
+
+void jobFinish(JobSystem* pJobs, JobWorker* pWorker, JobCounter* pCounter)
+{
+    // The lock is held across the decrement so a waiter can't see the counter done
+    // (and free it) while we still touch it
+    Job* pWaiting = NULL;
+    spinLock(&pCounter->mLock);
+    if(atomicSub(&pCounter->mValue, 1u) == 1)
+    {
+        pWaiting = pCounter->pWaiting;
+        pCounter->pWaiting = NULL;
+    }
+    spinUnlock(&pCounter->mLock);
+
+    while(pWaiting)
+    {
+        Job* pNext = pWaiting->pNext;
+        pWaiting->pNext = NULL;
+        jobSubmit(pJobs, pWorker, pWaiting);
+        pWaiting = pNext;
+    }
+}
+
+void jobExecute(JobSystem* pJobs, JobWorker* pWorker, Job* pJob)
+{
+    Job job = *pJob;
+    poolFree(&pWorker->mJobCache, pJob);
+    job.pProc(job.pData);
+    pWorker->mExecuted++;
+    if(job.pCounter) jobFinish(pJobs, pWorker, job.pCounter);
+}
+
+void jobSleep(JobSystem* pJobs, JobWorker* pWorker)
+{
+    atomicAdd(&pJobs->mSleeping, 1u);
+    atomicFence();
+
+    // Checking once more, a job pushed before we registered wouldn't wake us
+    Job* pJob = jobFind(pJobs, pWorker);
+    if(!pJob)
+    {
+        waitSemaphore(&pJobs->mWakeup);
+        return;
+    }
+
+    uint32 sleeping = atomicLoad(&pJobs->mSleeping);
+    bool registered = true;
+    while(sleeping)
+    {
+        if(atomicCompareExchange(&pJobs->mSleeping, &sleeping, sleeping - 1))
+        {
+            registered = false;
+            break;
+        }
+    }
+    // A producer already took our registration, its wakeup is ours to consume
+    if(registered) waitSemaphore(&pJobs->mWakeup);
+    jobExecute(pJobs, pWorker, pJob);
+}
+
+void jobWorkerProc(void* pData)
+{
+    JobWorker* pWorker = (JobWorker*)pData;
+    JobSystem* pJobs = pWorker->pJobs;
+    tJobWorker = pWorker;
+    pinThread(pWorker->mIndex % getCoreCount());
+
+    uint32 idle = 0;
+    while(!atomicLoad(&pJobs->mQuit))
+    {
+        Job* pJob = jobFind(pJobs, pWorker);
+        if(pJob)
+        {
+            jobExecute(pJobs, pWorker, pJob);
+            idle = 0;
+        }
+        else if(++idle < JOB_SPIN_COUNT)
+        {
+            yieldThread();
+        }
+        else
+        {
+            jobSleep(pJobs, pWorker);
+            idle = 0;
+        }
+    }
+
+    flushPoolCache(&pWorker->mJobCache);
+    destroyScratchArenas();
+    tJobWorker = NULL;
+}
+
+void initJobSystem(uint32 workerCount, JobSystem* pJobs)
+{
+    ASSERT(pJobs);
+    ASSERT(!tJobWorker);    // The calling thread already belongs to a job system
+
+    if(!workerCount) workerCount = getCoreCount();
+    workerCount = MIN(workerCount, JOB_MAX_WORKERS);
+
+    *pJobs = {};
+    initArena(ALIGN_TO(workerCount * sizeof(JobWorker) + alignof(JobWorker), getPageSize()), &pJobs->mArena);
+    initPool(sizeof(Job), JOB_MAX_JOBS, &pJobs->mJobPool);
+    initSemaphore(0, &pJobs->mWakeup);
+
+    pJobs->mWorkerCount = workerCount;
+    pJobs->pWorkers = (JobWorker*)arenaPushZero(&pJobs->mArena, workerCount * sizeof(JobWorker), alignof(JobWorker));
+    for(uint32 i = 0; i < workerCount; i++)
+    {
+        JobWorker* pWorker = &pJobs->pWorkers[i];
+        pWorker->pJobs = pJobs;
+        pWorker->mIndex = i;
+        pWorker->mRandom = 0x9E3779B9u * (i + 1);
+        initPoolCache(&pJobs->mJobPool, &pWorker->mJobCache);
+        initArena(JOB_ARENA_SIZE, &pWorker->mArena);
+    }
+
+    tJobWorker = &pJobs->pWorkers[0];
+    for(uint32 i = 1; i < workerCount; i++)
+    {
+        createThread(jobWorkerProc, &pJobs->pWorkers[i], &pJobs->pWorkers[i].mThread);
+    }
+}
+
+void destroyJobSystem(JobSystem* pJobs)
+{
+    ASSERT(pJobs);
+    jobGetWorker(pJobs);
+
+    atomicStore(&pJobs->mQuit, (uint32)true);
+    signalSemaphore(&pJobs->mWakeup, pJobs->mWorkerCount);
+    for(uint32 i = 1; i < pJobs->mWorkerCount; i++)
+    {
+        joinThread(&pJobs->pWorkers[i].mThread);
+    }
+
+    flushPoolCache(&pJobs->pWorkers[0].mJobCache);
+    for(uint32 i = 0; i < pJobs->mWorkerCount; i++)
+    {
+        destroyArena(&pJobs->pWorkers[i].mArena);
+    }
+    tJobWorker = NULL;
+
+    destroySemaphore(&pJobs->mWakeup);
+    destroyPool(&pJobs->mJobPool);
+    destroyArena(&pJobs->mArena);
+    *pJobs = {};
+}
+
+// Returns NULL when the job pool is exhausted, the caller then runs the job itself.
+Job* jobCreate(JobWorker* pWorker, JobProc proc, void* pData, JobCounter* pCounter)
+{
+    Job* pJob = (Job*)poolAlloc(&pWorker->mJobCache);
+    if(!pJob) return NULL;
+
+    *pJob = {};
+    pJob->pProc = proc;
+    pJob->pData = pData;
+    pJob->pCounter = pCounter;
+    if(pCounter) atomicAdd(&pCounter->mValue, 1u);
+    return pJob;
+}
+
+void runJob(JobSystem* pJobs, JobProc proc, void* pData, JobCounter* pCounter)
+{
+    ASSERT(pJobs && proc);
+    JobWorker* pWorker = jobGetWorker(pJobs);
+
+    Job* pJob = jobCreate(pWorker, proc, pData, pCounter);
+    if(!pJob)
+    {
+        proc(pData);
+        return;
+    }
+    jobSubmit(pJobs, pWorker, pJob);
+}
+
+void runJobAfter(JobSystem* pJobs, JobProc proc, void* pData, JobCounter* pDependency, JobCounter* pCounter)
+{
+    ASSERT(pJobs && proc && pDependency);
+    JobWorker* pWorker = jobGetWorker(pJobs);
+
+    Job* pJob = jobCreate(pWorker, proc, pData, pCounter);
+    if(!pJob)
+    {
+        waitJobs(pJobs, pDependency);
+        proc(pData);
+        return;
+    }
+
+    spinLock(&pDependency->mLock);
+    if(atomicLoad(&pDependency->mValue))
+    {
+        pJob->pNext = pDependency->pWaiting;
+        pDependency->pWaiting = pJob;
+        spinUnlock(&pDependency->mLock);
+        return;
+    }
+    spinUnlock(&pDependency->mLock);
+    jobSubmit(pJobs, pWorker, pJob);
+}
+
+bool jobsDone(JobCounter* pCounter)
+{
+    ASSERT(pCounter);
+    return !atomicLoad(&pCounter->mValue) && !atomicLoad(&pCounter->mLock);
+}
+
+void waitJobs(JobSystem* pJobs, JobCounter* pCounter)
+{
+    ASSERT(pJobs && pCounter);
+    JobWorker* pWorker = jobGetWorker(pJobs);
+    while(!jobsDone(pCounter))
+    {
+        Job* pJob = jobFind(pJobs, pWorker);
+        if(pJob) jobExecute(pJobs, pWorker, pJob);
+        else yieldThread();
+    }
+}
+
+struct ParallelForRange
+{
+    ParallelForProc pProc   = NULL;
+    void*           pData   = NULL;
+    uint32          mBegin  = 0;
+    uint32          mEnd    = 0;
+};
+
+void parallelForProc(void* pData)
+{
+    ParallelForRange* pRange = (ParallelForRange*)pData;
+    pRange->pProc(pRange->mBegin, pRange->mEnd, pRange->pData);
+}
+
+void parallelFor(JobSystem* pJobs, uint32 begin, uint32 end, uint32 grain, ParallelForProc proc, void* pData)
+{
+    ASSERT(pJobs && proc);
+    ASSERT(begin <= end);
+
+    uint32 count = end - begin;
+    if(!count) return;
+    if(!grain)
+    {
+        // A few ranges per worker, so stealing can even out uneven ranges
+        grain = MAX(1u, count / (pJobs->mWorkerCount * 4));
+    }
+    uint32 rangeCount = (uint32)(((uint64)count + grain - 1) / grain);
+    if(rangeCount == 1)
+    {
+        proc(begin, end, pData);
+        return;
+    }
+
+    ScratchScope scratch;
+    ParallelForRange* pRanges = (ParallelForRange*)arenaPush(scratch.pArena,
+            rangeCount * sizeof(ParallelForRange), alignof(ParallelForRange));
+    JobCounter counter = {};
+    for(uint32 i = 0; i < rangeCount; i++)
+    {
+        ParallelForRange* pRange = &pRanges[i];
+        pRange->pProc = proc;
+        pRange->pData = pData;
+        pRange->mBegin = begin + i * grain;
+        pRange->mEnd = (uint32)MIN((uint64)end, (uint64)pRange->mBegin + grain);
+        if(i > 0) runJob(pJobs, parallelForProc, pRange, &counter);
+    }
+
+    // The first range runs here while the workers steal the rest
+    parallelForProc(&pRanges[0]);
+    waitJobs(pJobs, &counter);
+}
+
+uint32 getJobWorkerIndex(JobSystem* pJobs)
+{
+    return jobGetWorker(pJobs)->mIndex;
+}
+
+Arena* getJobArena(JobSystem* pJobs)
+{
+    return &jobGetWorker(pJobs)->mArena;
+}
+
+void resetJobArenas(JobSystem* pJobs)
+{
+    ASSERT(pJobs);
+    for(uint32 i = 0; i < pJobs->mWorkerCount; i++)
+    {
+        arenaClear(&pJobs->pWorkers[i].mArena);
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include "base.hpp"
+#include "memory.hpp"
+#include "thread.hpp"
+
+// Job system
+// Fixed pool of worker threads, each pinned to a core and owning a Chase-Lev
+// work-stealing deque. Workers push and pop jobs at the bottom of their own deque
+// (LIFO, cache warm) and steal from the top of others' when it runs dry. The thread
+// that calls initJobSystem is worker 0 and only runs jobs while waiting on a counter.
+//
+//  JobCounter counter = {};
+//  runJob(pJobs, updateProc, &data, &counter);
+//  runJobAfter(pJobs, renderProc, &data, &counter, &renderCounter);   // Once counter reaches 0
+//  waitJobs(pJobs, &renderCounter);
+#define JOB_MAX_WORKERS     64
+#define JOB_DEQUE_SIZE      4096        // Per worker, power of 2
+#define JOB_MAX_JOBS        65536       // Jobs in flight or waiting on a counter
+#define JOB_SPIN_COUNT      64          // Failed steal rounds before an idle worker sleeps
+#define JOB_ARENA_SIZE      GB(1)
+
+typedef void (*JobProc)(void* pData);
+typedef void (*ParallelForProc)(uint32 begin, uint32 end, void* pData);
+
+struct Job;
+
+// Counts unfinished jobs. Must stay alive until waitJobs/jobsDone report it done.
+struct JobCounter
+{
+    uint32  mValue      = 0;
+    uint32  mLock       = 0;        // Guards pWaiting
+    Job*    pWaiting    = NULL;     // Jobs to run once mValue reaches 0
+};
+
+struct Job
+{
+    JobProc     pProc       = NULL;
+    void*       pData       = NULL;
+    JobCounter* pCounter    = NULL;     // Decremented once the job is done
+    Job*        pNext       = NULL;     // Next job waiting on the same counter
+};
+
+// Owner pushes and pops at mBottom, thieves take from mTop. Kept on separate
+// cache lines so steals don't invalidate the owner's line.
+struct JobDeque
+{
+    alignas(CACHE_LINE_SIZE) int64 mTop = 0;
+    alignas(CACHE_LINE_SIZE) int64 mBottom = 0;
+    Job* pJobs[JOB_DEQUE_SIZE] = {};
+};
+
+struct JobSystem;
+
+struct JobWorker
+{
+    JobDeque    mDeque      = {};
+    Thread      mThread     = {};
+    PoolCache   mJobCache   = {};
+    Arena       mArena      = {};       // Per worker scratch, cleared by resetJobArenas
+    JobSystem*  pJobs       = NULL;
+    uint32      mIndex      = 0;
+    uint32      mRandom     = 0;        // Victim selection state
+
+    // Stats
+    uint64      mExecuted   = 0;
+    uint64      mStolen     = 0;
+};
+
+struct JobSystem
+{
+    Arena       mArena          = {};   // Worker storage
+    Pool        mJobPool        = {};
+    JobWorker*  pWorkers        = NULL;
+    uint32      mWorkerCount    = 0;    // Including the calling thread
+
+    Semaphore   mWakeup         = {};
+    alignas(CACHE_LINE_SIZE) uint32 mSleeping = 0;
+    uint32      mQuit           = false;
+};
+
+// workerCount includes the calling thread, 0 means one per core.
+void    initJobSystem(uint32 workerCount, JobSystem* pJobs);
+void    destroyJobSystem(JobSystem* pJobs);     // Waits for the workers, no jobs may be pending
+
+// Jobs can be run from any worker, including from inside other jobs. pCounter may be NULL.
+void    runJob(JobSystem* pJobs, JobProc proc, void* pData, JobCounter* pCounter);
+// Runs the job once pDependency reaches 0 (right away if it already is).
+void    runJobAfter(JobSystem* pJobs, JobProc proc, void* pData, JobCounter* pDependency, JobCounter* pCounter);
+// Runs other jobs while waiting, so it's safe to call from inside a job.
+void    waitJobs(JobSystem* pJobs, JobCounter* pCounter);
+bool    jobsDone(JobCounter* pCounter);
+
+// Splits [begin, end) into ranges of grain elements (0 picks one) and waits for all of them.
+void    parallelFor(JobSystem* pJobs, uint32 begin, uint32 end, uint32 grain, ParallelForProc proc, void* pData);
+
+template<typename F>
+void parallelFor(JobSystem* pJobs, uint32 begin, uint32 end, uint32 grain, F fn)
+{
+    ParallelForProc proc = [](uint32 rangeBegin, uint32 rangeEnd, void* pData) { (*(F*)pData)(rangeBegin, rangeEnd); };
+    parallelFor(pJobs, begin, end, grain, proc, &fn);
+}
+
+uint32  getJobWorkerIndex(JobSystem* pJobs);    // Of the calling thread
+Arena*  getJobArena(JobSystem* pJobs);          // Of the calling thread
+void    resetJobArenas(JobSystem* pJobs);       // Only while no jobs are running
@@ -1,24 +1,168 @@
 #include "memory.hpp"
 #include "debug.hpp"
+#include "thread.hpp"
 
-void initArena(uint64 size, Arena* pArena)
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdio.h>
+#endif
+
+// Platform virtual memory layer.
+// Reserved ranges are inaccessible until committed. Decommitting returns the
+// physical pages to the OS but keeps the address range reserved.
+#ifdef _WIN32
+
+uint64 getPageSize()
+{
+    static uint64 pageSize = 0;
+    if(!pageSize)
+    {
+        SYSTEM_INFO info = {};
+        GetSystemInfo(&info);
+        pageSize = (uint64)info.dwPageSize;
+    }
+    return pageSize;
+}
+
+uint64 getResidentMemory()
+{
+    PROCESS_MEMORY_COUNTERS counters = {};
+    BOOL ret = GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    ASSERT(ret);
+    return (uint64)counters.WorkingSetSize;
+}
+
+void* vmReserve(uint64 size)
+{
+    void* result = VirtualAlloc(0, size, MEM_RESERVE, PAGE_NOACCESS);
+    ASSERT(result);
+    return result;
+}
+
+void vmCommit(void* pStart, uint64 size)
+{
+    void* result = VirtualAlloc(pStart, size, MEM_COMMIT, PAGE_READWRITE);
+    ASSERT(result);
+}
+
+void vmDecommit(void* pStart, uint64 size)
+{
+    BOOL ret = VirtualFree(pStart, size, MEM_DECOMMIT);
+    ASSERT(ret);
+}
+
+void vmRelease(void* pStart, uint64 size)
+{
+    UNUSED(size);
+    BOOL ret = VirtualFree(pStart, 0, MEM_RELEASE);
+    ASSERT(ret);
+}
+
+#else
+
+uint64 getPageSize()
+{
+    static uint64 pageSize = 0;
+    if(!pageSize)
+    {
+        pageSize = (uint64)sysconf(_SC_PAGESIZE);
+    }
+    return pageSize;
+}
+
+uint64 getResidentMemory()
+{
+    // statm: total program size, then resident pages.
+    FILE* pFile = fopen("/proc/self/statm", "r");
+    ASSERT(pFile);
+    unsigned long long totalPages = 0;
+    unsigned long long residentPages = 0;
+    int32 ret = fscanf(pFile, "%llu %llu", &totalPages, &residentPages);
+    ASSERT(ret == 2);
+    fclose(pFile);
+    return (uint64)residentPages * getPageSize();
+}
+
+void* vmReserve(uint64 size)
+{
+    void* result = mmap(NULL, size, PROT_NONE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    ASSERT(result != MAP_FAILED);
+    return result;
+}
+
+void vmCommit(void* pStart, uint64 size)
+{
+    int32 ret = mprotect(pStart, size, PROT_READ | PROT_WRITE);
+    ASSERT(ret == 0);
+    madvise(pStart, size, MADV_WILLNEED);
+}
+
+void vmDecommit(void* pStart, uint64 size)
+{
+    // MADV_DONTNEED drops the pages immediately, later accesses would fault in zeroed pages.
+    int32 ret = madvise(pStart, size, MADV_DONTNEED);
+    ASSERT(ret == 0);
+    ret = mprotect(pStart, size, PROT_NONE);
+    ASSERT(ret == 0);
+}
+
+void vmRelease(void* pStart, uint64 size)
+{
+    int32 ret = munmap(pStart, size);
+    ASSERT(ret == 0);
+}
+
+#endif
+
+void initArena(uint64 size, Arena* pArena, uint64 commitChunk, uint64 decommitThreshold)
 {
     ASSERT(pArena);
-    // TODO_DW: MULTIPLATFORM
-    void* arenaMemory = VirtualAlloc(0, size,
-            MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
-    pArena->pStart = (byte*)arenaMemory;
+    ASSERT(size > 0);
+    uint64 pageSize = getPageSize();
+    commitChunk = MAX(commitChunk, pageSize);
+    ASSERT(IS_POW2(commitChunk));
+
+    pArena->pStart = (byte*)vmReserve(ALIGN_TO(size, pageSize));
     pArena->mOffset = 0;
     pArena->mCapacity = size;
+    pArena->mCommitted = 0;
+    pArena->mCommitChunk = commitChunk;
+    pArena->mDecommitThreshold = decommitThreshold;
 }
 
 void destroyArena(Arena* pArena)
 {
     ASSERT(pArena);
-    VirtualFree(pArena->pStart, 0, MEM_RELEASE);
+    vmRelease(pArena->pStart, ALIGN_TO(pArena->mCapacity, getPageSize()));
     *pArena = {};
 }
 
+// Commits pages up to (at least) the given offset, in commit chunk steps.
+void arenaCommit(Arena* pArena, uint64 offset)
+{
+    if(offset <= pArena->mCommitted) return;
+
+    uint64 reserved = ALIGN_TO(pArena->mCapacity, getPageSize());
+    uint64 newCommitted = MIN(ALIGN_TO(offset, pArena->mCommitChunk), reserved);
+    vmCommit(pArena->pStart + pArena->mCommitted, newCommitted - pArena->mCommitted);
+    pArena->mCommitted = newCommitted;
+}
+
+// Decommits pages above the high-water mark (offset + decommit threshold).
+void arenaDecommit(Arena* pArena)
+{
+    if(pArena->mCommitted - pArena->mOffset <= pArena->mDecommitThreshold) return;
+
+    uint64 newCommitted = ALIGN_TO(pArena->mOffset + pArena->mDecommitThreshold, pArena->mCommitChunk);
+    if(newCommitted >= pArena->mCommitted) return;
+    vmDecommit(pArena->pStart + newCommitted, pArena->mCommitted - newCommitted);
+    pArena->mCommitted = newCommitted;
+}
+
 void* arenaPush(Arena* pArena, uint64 size)
 {
     ASSERT(pArena);
@@ -26,6 +170,7 @@ void* arenaPush(Arena* pArena, uint64 size)
     ASSERT(pArena->mOffset + size <= pArena->mCapacity);
     byte* result = pArena->pStart + pArena->mOffset;
     pArena->mOffset += size;
+    arenaCommit(pArena, pArena->mOffset);
     return result;
 }
 
@@ -40,6 +185,7 @@ void* arenaPush(Arena* pArena, uint64 size, uint64 alignment)
     uint64 newOffset = pArena->mOffset + (arenaTopAligned - arenaTop) + size;
     ASSERT(newOffset <= pArena->mCapacity);
     pArena->mOffset = newOffset;
+    arenaCommit(pArena, newOffset);
 
     return arenaTopAligned;
 }
@@ -71,10 +217,22 @@ void* arenaPushCopy(Arena* pArena, uint64 size, void* pSrc, uint64 srcSize)
     return result;
 }
 
+void* arenaPushCopy(Arena* pArena, uint64 size, void* pSrc, uint64 srcSize, uint64 alignment)
+{
+    ASSERT(pArena);
+    void* result = arenaPush(pArena, size, alignment);
+    if(pSrc)
+    {
+        memcpy(result, pSrc, srcSize);
+    }
+    return result;
+}
+
 void arenaClear(Arena* pArena)
 {
     ASSERT(pArena);
     pArena->mOffset = 0;
+    arenaDecommit(pArena);
 }
 
 void* arenaGetTop(Arena* pArena)
@@ -88,63 +246,364 @@ void arenaFallback(Arena* pArena, uint64 offset)
     ASSERT(pArena);
     ASSERT(offset <= pArena->mOffset);
     pArena->mOffset = offset;
+    arenaDecommit(pArena);
+}
+
+ArenaScope::ArenaScope(Arena* pArena)
+{
+    ASSERT(pArena);
+    this->pArena = pArena;
+    this->mOffset = pArena->mOffset;
+}
+
+ArenaScope::~ArenaScope()
+{
+    arenaFallback(pArena, mOffset);
+}
+
+thread_local Arena tScratchArenas[SCRATCH_ARENA_COUNT];
+
+Arena* getScratch(Arena** ppConflicts, uint32 conflictCount)
+{
+    for(uint32 i = 0; i < SCRATCH_ARENA_COUNT; i++)
+    {
+        Arena* pScratch = &tScratchArenas[i];
+        bool conflicts = false;
+        for(uint32 j = 0; j < conflictCount; j++)
+        {
+            if(ppConflicts[j] == pScratch)
+            {
+                conflicts = true;
+                break;
+            }
+        }
+        if(conflicts) continue;
+
+        if(!pScratch->pStart)
+        {
+            initArena(SCRATCH_ARENA_SIZE, pScratch);
+        }
+        return pScratch;
+    }
+
+    ASSERT(0);      // Every scratch arena conflicts, SCRATCH_ARENA_COUNT is too small.
+    return NULL;
+}
+
+Arena* getScratch(Arena* pConflict)
+{
+    return getScratch(&pConflict, pConflict ? 1 : 0);
+}
+
+void destroyScratchArenas()
+{
+    for(uint32 i = 0; i < SCRATCH_ARENA_COUNT; i++)
+    {
+        if(tScratchArenas[i].pStart)
+        {
+            destroyArena(&tScratchArenas[i]);
+        }
+    }
+}
+
+ScratchScope::ScratchScope(Arena** ppConflicts, uint32 conflictCount)
+    : ArenaScope(getScratch(ppConflicts, conflictCount))
+{
+}
+
+ScratchScope::ScratchScope(Arena* pConflict)
+    : ArenaScope(getScratch(pConflict))
+{
+}
+
+// Pool internals
+inline Pool::Header* poolHeader(Pool* pPool, uint32 index)
+{
+    return (Pool::Header*)(pPool->pStart + (uint64)index * pPool->mStride);
+}
+
+inline void* poolBlock(Pool* pPool, uint32 index)
+{
+    return pPool->pStart + (uint64)index * pPool->mStride + sizeof(Pool::Header);
+}
+
+inline uint64 poolPackHead(uint32 index, uint32 tag)
+{
+    return ((uint64)tag << 32) | index;
+}
+
+uint32 poolBlockIndex(Pool* pPool, void* pBlock)
+{
+    ASSERT(pBlock >= pPool->pStart + sizeof(Pool::Header));
+    uint64 offset = PTR_DIFF(pBlock, pPool->pStart) - sizeof(Pool::Header);
+    ASSERT(offset % pPool->mStride == 0);
+    uint32 index = (uint32)(offset / pPool->mStride);
+    ASSERT(index < pPool->mBlockCount);
+    return index;
+}
+
+// Pops up to maxCount linked free blocks with a single compare-exchange.
+// As long as the tagged head didn't change, no block in the chain was popped or
+// pushed either, so the walked chain is still intact when the exchange succeeds.
+uint32 poolPopChain(Pool* pPool, uint32 maxCount, uint32* pOut)
+{
+    uint64 head = atomicLoad(&pPool->mFreeHead);
+    while(true)
+    {
+        uint32 first = (uint32)head;
+        if(first == POOL_INDEX_NONE) return 0;
+
+        uint32 last = first;
+        uint32 count = 1;
+        uint32 next = atomicLoadRelaxed(&poolHeader(pPool, last)->mNextFree);
+        while(count < maxCount && next != POOL_INDEX_NONE)
+        {
+            last = next;
+            next = atomicLoadRelaxed(&poolHeader(pPool, last)->mNextFree);
+            count++;
+        }
+
+        uint64 newHead = poolPackHead(next, (uint32)(head >> 32) + 1);
+        if(atomicCompareExchange(&pPool->mFreeHead, &head, newHead))
+        {
+            uint32 index = first;
+            for(uint32 i = 0; i < count; i++)
+            {
+                pOut[i] = index;
+                index = poolHeader(pPool, index)->mNextFree;
+            }
+            return count;
+        }
+    }
+}
+
+// Pushes an already linked chain of free blocks (first -> ... -> last).
+void poolPushChain(Pool* pPool, uint32 first, uint32 last)
+{
+    uint64 head = atomicLoad(&pPool->mFreeHead);
+    while(true)
+    {
+        atomicStoreRelaxed(&poolHeader(pPool, last)->mNextFree, (uint32)head);
+        uint64 newHead = poolPackHead(first, (uint32)(head >> 32) + 1);
+        if(atomicCompareExchange(&pPool->mFreeHead, &head, newHead)) return;
+    }
+}
+
+// Marks a popped block as used and returns its handle.
+HND poolAcquire(Pool* pPool, uint32 index)
+{
+    Pool::Header* header = poolHeader(pPool, index);
+    uint32 wasUsed = atomicExchange(&header->mUsed, (uint32)true);
+    ASSERT(!wasUsed);
+    UNUSED(wasUsed);
+    return HND_MAKE(index, atomicLoad(&header->mGeneration));
+}
+
+// Invalidates outstanding handles to the block. Returns false on double frees.
+bool poolRelease(Pool* pPool, uint32 index)
+{
+    Pool::Header* header = poolHeader(pPool, index);
+    uint32 expected = true;
+    if(!atomicCompareExchange(&header->mUsed, &expected, (uint32)false)) return false;
+    atomicAdd(&header->mGeneration, 1u);
+    return true;
 }
 
 void initPool(uint64 blockSize, uint64 blockCount, Pool* pPool)
 {
     ASSERT(pPool);
+    ASSERT(blockCount > 0 && blockCount <= POOL_MAX_BLOCKS);
 
-    uint64 fullBlockSize = blockSize + sizeof(Pool::Header);
-    uint64 poolSize = fullBlockSize * blockCount;
-    void* poolMemory = VirtualAlloc(0, poolSize,
-            MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    uint64 stride = ALIGN_TO(sizeof(Pool::Header) + blockSize, POOL_BLOCK_ALIGNMENT);
+    uint64 poolSize = ALIGN_TO(stride * blockCount, getPageSize());
+    void* poolMemory = vmReserve(poolSize);
+    vmCommit(poolMemory, poolSize);
     pPool->pStart = (byte*)poolMemory;
     pPool->mBlockSize = blockSize;
     pPool->mBlockCount = blockCount;
+    pPool->mStride = stride;
 
     // Initializing block headers and free list
-    Pool::Header* header = (Pool::Header*)pPool->pStart;
-    for(uint64 i = 0; i < blockCount; i++)
+    for(uint32 i = 0; i < blockCount; i++)
     {
-        header->mUsed = false;
-        Pool::Header* next = (Pool::Header*)((uint64)header + fullBlockSize);
-        header->pNextFree = (i == blockCount - 1)
-            ? NULL
-            : next;
-        header = next;
+        Pool::Header* header = poolHeader(pPool, i);
+        *header = {};
+        header->mNextFree = (i == blockCount - 1)
+            ? POOL_INDEX_NONE
+            : i + 1;
     }
 
-    pPool->pFreeBlocks = (Pool::Header*)pPool->pStart;
+    pPool->mFreeHead = poolPackHead(0, 0);
 }
 
 void destroyPool(Pool* pPool)
 {
     ASSERT(pPool);
-    VirtualFree(pPool->pStart, 0, MEM_RELEASE);
+    vmRelease(pPool->pStart, ALIGN_TO(pPool->mStride * pPool->mBlockCount, getPageSize()));
     *pPool = {};
 }
 
 void* poolAlloc(Pool* pPool)
+{
+    HND handle = poolAllocHandle(pPool);
+    if(handle == HND_INVALID) return NULL;
+    return poolBlock(pPool, HND_INDEX(handle));
+}
+
+void poolFree(Pool* pPool, void* pBlock)
+{
+    ASSERT(pPool && pBlock);
+    uint32 index = poolBlockIndex(pPool, pBlock);
+    bool released = poolRelease(pPool, index);
+    ASSERTF(released, "Double free of pool block %u", index);
+    if(!released) return;
+    poolPushChain(pPool, index, index);
+}
+
+HND poolAllocHandle(Pool* pPool)
 {
     ASSERT(pPool);
-    ASSERT(pPool->pFreeBlocks);
+    uint32 index = POOL_INDEX_NONE;
+    if(!poolPopChain(pPool, 1, &index)) return HND_INVALID;
+    return poolAcquire(pPool, index);
+}
 
-    Pool::Header* header = pPool->pFreeBlocks;
-    pPool->pFreeBlocks = header->pNextFree;
-    header->mUsed = true;
-    return (void*)((uint64)header + sizeof(Pool::Header));
+void poolFreeHandle(Pool* pPool, HND handle)
+{
+    ASSERT(pPool);
+    ASSERTF(poolValid(pPool, handle), "Freeing stale pool handle 0x%08x", handle);
+    poolFree(pPool, poolBlock(pPool, HND_INDEX(handle)));
 }
 
-void poolFree(Pool* pPool, void* pBlock)
+bool poolValid(Pool* pPool, HND handle)
+{
+    ASSERT(pPool);
+    uint32 index = HND_INDEX(handle);
+    if(handle == HND_INVALID || index >= pPool->mBlockCount) return false;
+
+    Pool::Header* header = poolHeader(pPool, index);
+    return atomicLoad(&header->mUsed)
+        && (atomicLoad(&header->mGeneration) & POOL_HND_GENERATION_MASK) == HND_GENERATION(handle);
+}
+
+void* poolGet(Pool* pPool, HND handle)
+{
+    if(!poolValid(pPool, handle)) return NULL;
+    return poolBlock(pPool, HND_INDEX(handle));
+}
+
+HND poolGetHandle(Pool* pPool, void* pBlock)
 {
     ASSERT(pPool && pBlock);
-    ASSERT(pBlock >= pPool->pStart);
-    uint64 fullBlockSize = pPool->mBlockSize + sizeof(Pool::Header);
-    uint64 poolSize = fullBlockSize * pPool->mBlockCount;
-    ASSERT(pBlock < pPool->pStart + poolSize);
-
-    Pool::Header* header = (Pool::Header*)((uint64)pBlock - sizeof(Pool::Header));
-    header->mUsed = false;
-    header->pNextFree = pPool->pFreeBlocks;
-    pPool->pFreeBlocks = header;
+    uint32 index = poolBlockIndex(pPool, pBlock);
+    Pool::Header* header = poolHeader(pPool, index);
+    ASSERT(atomicLoad(&header->mUsed));
+    return HND_MAKE(index, atomicLoad(&header->mGeneration));
+}
+
+bool poolExhausted(Pool* pPool)
+{
+    ASSERT(pPool);
+    return (uint32)atomicLoad(&pPool->mFreeHead) == POOL_INDEX_NONE;
+}
+
+void initPoolCache(Pool* pPool, PoolCache* pCache)
+{
+    ASSERT(pPool && pCache);
+    pCache->pPool = pPool;
+    pCache->mCount = 0;
+}
+
+// Links the top count cached blocks and pushes them to the pool.
+void poolCacheRelease(PoolCache* pCache, uint32 count)
+{
+    ASSERT(count <= pCache->mCount);
+    if(!count) return;
+
+    Pool* pPool = pCache->pPool;
+    uint32* indices = pCache->mIndices + pCache->mCount - count;
+    for(uint32 i = 0; i < count - 1; i++)
+    {
+        atomicStoreRelaxed(&poolHeader(pPool, indices[i])->mNextFree, indices[i + 1]);
+    }
+    poolPushChain(pPool, indices[0], indices[count - 1]);
+    pCache->mCount -= count;
+}
+
+void flushPoolCache(PoolCache* pCache)
+{
+    ASSERT(pCache && pCache->pPool);
+    poolCacheRelease(pCache, pCache->mCount);
+}
+
+HND poolAllocHandle(PoolCache* pCache)
+{
+    ASSERT(pCache && pCache->pPool);
+    if(!pCache->mCount)
+    {
+        pCache->mCount = poolPopChain(pCache->pPool, POOL_CACHE_BATCH, pCache->mIndices);
+        if(!pCache->mCount) return HND_INVALID;
+    }
+    return poolAcquire(pCache->pPool, pCache->mIndices[--pCache->mCount]);
+}
+
+void* poolAlloc(PoolCache* pCache)
+{
+    HND handle = poolAllocHandle(pCache);
+    if(handle == HND_INVALID) return NULL;
+    return poolBlock(pCache->pPool, HND_INDEX(handle));
+}
+
+void poolFree(PoolCache* pCache, void* pBlock)
+{
+    ASSERT(pCache && pCache->pPool && pBlock);
+    uint32 index = poolBlockIndex(pCache->pPool, pBlock);
+    bool released = poolRelease(pCache->pPool, index);
+    ASSERTF(released, "Double free of pool block %u", index);
+    if(!released) return;
+
+    if(pCache->mCount == POOL_CACHE_CAPACITY)
+    {
+        poolCacheRelease(pCache, POOL_CACHE_BATCH);
+    }
+    pCache->mIndices[pCache->mCount++] = index;
+}
+
+void poolFreeHandle(PoolCache* pCache, HND handle)
+{
+    ASSERT(pCache && pCache->pPool);
+    ASSERTF(poolValid(pCache->pPool, handle), "Freeing stale pool handle 0x%08x", handle);
+    poolFree(pCache, poolBlock(pCache->pPool, HND_INDEX(handle)));
+}
+
+void initFrameRing(uint64 regionSize, uint32 frameCount, FrameRing* pRing)
+{
+    ASSERT(pRing);
+    ASSERT(regionSize && frameCount && frameCount <= FRAME_RING_MAX_FRAMES);
+    *pRing = {};
+    pRing->mRegionSize = regionSize;
+    pRing->mFrameCount = frameCount;
+}
+
+void beginRingFrame(FrameRing* pRing, uint32 frame)
+{
+    ASSERT(pRing && pRing->mFrameCount);
+    pRing->mFrame = frame % pRing->mFrameCount;
+    pRing->mOffset = 0;
+}
+
+uint64 frameRingPush(FrameRing* pRing, uint64 size, uint64 alignment)
+{
+    ASSERT(pRing && pRing->mFrameCount);
+    ASSERT(size > 0);
+    ASSERT(alignment && IS_POW2(alignment));
+
+    // Regions start aligned as long as mRegionSize is a multiple of the alignment
+    uint64 regionStart = pRing->mFrame * pRing->mRegionSize;
+    uint64 offset = ALIGN_TO(regionStart + pRing->mOffset, alignment) - regionStart;
+    if(offset + size > pRing->mRegionSize) return FRAME_RING_FULL;
+
+    pRing->mOffset = offset + size;
+    pRing->mPeak = MAX(pRing->mPeak, pRing->mOffset);
+    return regionStart + offset;
 }
@@ -1,15 +1,30 @@
 #pragma once
 #include "base.hpp"
 
+// Virtual memory
+uint64  getPageSize();
+uint64  getResidentMemory();    // Resident set size of the process, in bytes
+
 // Arena allocator
+// The whole capacity is reserved up front, but pages are only committed in
+// mCommitChunk steps as pushes cross the commit watermark. Clearing/falling back
+// decommits everything more than mDecommitThreshold bytes above the new offset.
+#define ARENA_DEFAULT_COMMIT_CHUNK          KB(64)
+#define ARENA_DEFAULT_DECOMMIT_THRESHOLD    MB(4)
+
 struct Arena
 {
-    byte*   pStart       = NULL;
-    uint64  mOffset      = 0;
-    uint64  mCapacity    = 0;
+    byte*   pStart              = NULL;
+    uint64  mOffset             = 0;
+    uint64  mCapacity           = 0;
+    uint64  mCommitted          = 0;
+    uint64  mCommitChunk        = 0;
+    uint64  mDecommitThreshold  = 0;
 };
 
-void initArena(uint64 size, Arena* pArena);
+void initArena(uint64 size, Arena* pArena,
+        uint64 commitChunk = ARENA_DEFAULT_COMMIT_CHUNK,
+        uint64 decommitThreshold = ARENA_DEFAULT_DECOMMIT_THRESHOLD);
 void destroyArena(Arena* pArena);
 
 void*   arenaPush(Arena* pArena, uint64 size);
@@ -17,6 +32,7 @@ void*   arenaPush(Arena* pArena, uint64 size, uint64 alignment);
 void*   arenaPushZero(Arena* pArena, uint64 size);
 void*   arenaPushZero(Arena* pArena, uint64 size, uint64 alignment);
 void*   arenaPushCopy(Arena* pArena, uint64 size, void* pSrc, uint64 srcSize);
+void*   arenaPushCopy(Arena* pArena, uint64 size, void* pSrc, uint64 srcSize, uint64 alignment);
 void    arenaClear(Arena* pArena);
 void*   arenaGetTop(Arena* pArena);
 void    arenaFallback(Arena* pArena, uint64 offset);
@@ -24,23 +40,130 @@ void    arenaFallback(Arena* pArena, uint64 offset);
 #define ARENA_CHECKPOINT_SET(ARENA, NAME) uint64 CONCATENATE(NAME, __fallback) = (ARENA)->mOffset
 #define ARENA_CHECKPOINT_RESET(ARENA, NAME) arenaFallback((ARENA), CONCATENATE(NAME, __fallback))
 
+// Arena scope (falls back to the offset the arena had when the scope started)
+struct ArenaScope
+{
+    Arena*  pArena  = NULL;
+    uint64  mOffset = 0;
+
+    ArenaScope(Arena* pArena);
+    ~ArenaScope();
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+};
+
+#define ARENA_SCOPE(ARENA) ArenaScope CONCATENATE(__arenaScope, __LINE__)((ARENA))
+
+// Scratch arenas
+// Each thread owns SCRATCH_ARENA_COUNT lazily initialized scratch arenas.
+// Arenas passed as conflicts (e.g. an output arena that may itself be a scratch
+// arena of the caller) are never returned, so nested users never stomp each other.
+#define SCRATCH_ARENA_COUNT 2
+#define SCRATCH_ARENA_SIZE  GB(1)
+
+Arena*  getScratch(Arena** ppConflicts = NULL, uint32 conflictCount = 0);
+Arena*  getScratch(Arena* pConflict);
+void    destroyScratchArenas();     // Call before a thread that used scratch arenas exits.
+
+struct ScratchScope : ArenaScope
+{
+    ScratchScope(Arena** ppConflicts = NULL, uint32 conflictCount = 0);
+    ScratchScope(Arena* pConflict);
+};
+
 // Pool allocator
+// Lock-free fixed size block allocator, safe to use from any number of threads.
+// Free blocks form a stack of block indices whose head is tagged with an ABA
+// counter. Each block carries a generation that is bumped when it's freed, so
+// handles to freed blocks and double frees are caught in O(1).
+#define POOL_INDEX_NONE             MAX_UINT32
+#define POOL_BLOCK_ALIGNMENT        16
+
+// Pool handles
+// Lower POOL_HND_INDEX_BITS bits hold the block index, the rest the block's generation.
+#define POOL_HND_INDEX_BITS         20
+#define POOL_HND_INDEX_MASK         (BIT(POOL_HND_INDEX_BITS) - 1)
+#define POOL_HND_GENERATION_MASK    (MAX_UINT32 >> POOL_HND_INDEX_BITS)
+#define POOL_MAX_BLOCKS             POOL_HND_INDEX_MASK     // All index bits set is reserved for HND_INVALID
+
+#define HND_INDEX(H)                ((uint32)(H) & POOL_HND_INDEX_MASK)
+#define HND_GENERATION(H)           ((uint32)(H) >> POOL_HND_INDEX_BITS)
+#define HND_MAKE(INDEX, GEN)        ((HND)((((GEN) & POOL_HND_GENERATION_MASK) << POOL_HND_INDEX_BITS) | ((INDEX) & POOL_HND_INDEX_MASK)))
+
 struct Pool
 {
     struct Header
     {
-        Header*     pNextFree = NULL;
-        bool        mUsed = false;
+        uint32  mNextFree   = POOL_INDEX_NONE;
+        uint32  mGeneration = 0;
+        uint32  mUsed       = false;
+        uint32  mPadding    = 0;
     };
 
-    byte*   pStart = NULL;
-    Header* pFreeBlocks = NULL;
+    // Low 32 bits: index of the first free block, high 32 bits: ABA tag.
+    // Kept on its own cache line, it's the only field written by every alloc/free.
+    alignas(64) uint64 mFreeHead = POOL_INDEX_NONE;
+
+    alignas(64) byte* pStart = NULL;
     uint64  mBlockSize  = 0;
     uint64  mBlockCount = 0;
+    uint64  mStride     = 0;    // Header + block, aligned to POOL_BLOCK_ALIGNMENT
 };
 
 void initPool(uint64 blockSize, uint64 blockCount, Pool* pPool);
 void destroyPool(Pool* pPool);
 
-void*   poolAlloc(Pool* pPool);
+void*   poolAlloc(Pool* pPool);             // Returns NULL when the pool is exhausted
 void    poolFree(Pool* pPool, void* pBlock);
+
+HND     poolAllocHandle(Pool* pPool);       // Returns HND_INVALID when the pool is exhausted
+void    poolFreeHandle(Pool* pPool, HND handle);
+void*   poolGet(Pool* pPool, HND handle);   // Returns NULL for stale handles
+bool    poolValid(Pool* pPool, HND handle);
+HND     poolGetHandle(Pool* pPool, void* pBlock);
+bool    poolExhausted(Pool* pPool);
+
+// Pool cache (per-thread magazine)
+// Owned by a single thread. Refills pop POOL_CACHE_BATCH blocks from the pool
+// and overflows push them back, each with a single compare-exchange.
+#define POOL_CACHE_BATCH    32
+#define POOL_CACHE_CAPACITY (POOL_CACHE_BATCH * 2)
+
+struct PoolCache
+{
+    Pool*   pPool   = NULL;
+    uint32  mIndices[POOL_CACHE_CAPACITY];
+    uint32  mCount  = 0;
+};
+
+void    initPoolCache(Pool* pPool, PoolCache* pCache);
+void    flushPoolCache(PoolCache* pCache);  // Returns all cached blocks to the pool
+
+void*   poolAlloc(PoolCache* pCache);
+void    poolFree(PoolCache* pCache, void* pBlock);
+HND     poolAllocHandle(PoolCache* pCache);
+void    poolFreeHandle(PoolCache* pCache, HND handle);
+
+// Frame ring allocator
+// Linear allocator over a range split into mFrameCount equal regions, one per frame in
+// flight. Pushes bump an offset through the current frame's region and beginning a frame
+// rewinds its region, which must only happen once the GPU is done reading it (its fence
+// signaled). Only offsets are handed out, the memory they index lives elsewhere, like a
+// persistently mapped buffer. Not thread safe, like arenas.
+#define FRAME_RING_MAX_FRAMES   4
+#define FRAME_RING_FULL         MAX_UINT64
+
+struct FrameRing
+{
+    uint64  mRegionSize = 0;
+    uint32  mFrameCount = 0;
+    uint32  mFrame      = 0;    // Region pushed to
+    uint64  mOffset     = 0;    // In the region
+    uint64  mPeak       = 0;    // Most bytes used by a frame, for sizing regions
+};
+
+void    initFrameRing(uint64 regionSize, uint32 frameCount, FrameRing* pRing);
+void    beginRingFrame(FrameRing* pRing, uint32 frame);     // frame is wrapped to mFrameCount
+// Returns the offset from the start of the whole range, FRAME_RING_FULL when the frame's
+// region can't fit size. alignment must be a power of 2.
+uint64  frameRingPush(FrameRing* pRing, uint64 size, uint64 alignment);
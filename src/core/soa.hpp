@@ -0,0 +1,121 @@
+#pragma once
+#include "base.hpp"
+#include "memory.hpp"
+#include "array.hpp"
+#include "debug.hpp"
+
+// Structure of arrays container
+// Every field lives in its own stream, aligned to SOA_STREAM_ALIGNMENT so batch
+// kernels can use aligned vector loads. Capacity is rounded up to a multiple of
+// SOA_STREAM_PADDING, so a kernel may always process the last elements with a
+// full vector width (reading padding past mCount, never past the stream).
+//
+//  enum { POS_X, POS_Y, POS_Z, ID };
+//  SoAArray<float, float, float, uint32> soa = soaArray<float, float, float, uint32>(pArena, 1024);
+//  soa.push(1.f, 2.f, 3.f, 7);
+//  float* xs = soa.column<POS_X>();
+#define SOA_STREAM_ALIGNMENT    32      // AVX2 register width
+#define SOA_STREAM_PADDING      8       // Floats per AVX2 register
+
+template <uint32 I, typename T, typename... Ts>
+struct SoAFieldType
+{
+    typedef typename SoAFieldType<I - 1, Ts...>::Type Type;
+};
+
+template <typename T, typename... Ts>
+struct SoAFieldType<0, T, Ts...>
+{
+    typedef T Type;
+};
+
+template <typename... Fields>
+struct SoAArray
+{
+    static constexpr uint32 FIELD_COUNT = sizeof...(Fields);
+    static constexpr uint64 FIELD_SIZES[FIELD_COUNT] = { sizeof(Fields)... };
+
+    template <uint32 I>
+    using Field = typename SoAFieldType<I, Fields...>::Type;
+
+    byte*   pStreams[FIELD_COUNT] = {};
+    uint64  mCapacity = 0;
+    uint64  mCount = 0;
+
+    template <uint32 I>
+    Field<I>* column()
+    {
+        STATIC_ASSERT(I < FIELD_COUNT);
+        return (Field<I>*)pStreams[I];
+    }
+
+    template <uint32 I>
+    const Field<I>* column() const
+    {
+        STATIC_ASSERT(I < FIELD_COUNT);
+        return (const Field<I>*)pStreams[I];
+    }
+
+    template <uint32 I>
+    Field<I>& get(uint64 index)
+    {
+        ASSERT(index < mCount);
+        return column<I>()[index];
+    }
+
+    void push(const Fields&... values)
+    {
+        ASSERT(mCount < mCapacity);
+        uint64 index = mCount++;
+        uint32 field = 0;
+        int unused[] = { (((Fields*)pStreams[field++])[index] = values, 0)... };
+        UNUSED(unused);
+    }
+
+    // Appends count uninitialized elements and returns the index of the first one.
+    uint64 pushCount(uint64 count)
+    {
+        ASSERT(mCount + count <= mCapacity);
+        uint64 first = mCount;
+        mCount += count;
+        return first;
+    }
+
+    void pop()
+    {
+        ASSERT(mCount > 0);
+        mCount--;
+    }
+
+    // O(1), moves the last element into the removed slot in every stream.
+    void removeSwap(uint64 index)
+    {
+        ASSERT(index < mCount);
+        mCount--;
+        if(index == mCount) return;
+        for(uint32 i = 0; i < FIELD_COUNT; i++)
+        {
+            memcpy(pStreams[i] + index * FIELD_SIZES[i], pStreams[i] + mCount * FIELD_SIZES[i], FIELD_SIZES[i]);
+        }
+    }
+
+    void clear()
+    {
+        mCount = 0;
+    }
+};
+
+template <typename... Fields>
+SoAArray<Fields...> soaArray(Arena* pArena, uint64 capacity, uint64 alignment = SOA_STREAM_ALIGNMENT)
+{
+    ASSERT(pArena);
+    SoAArray<Fields...> result = {};
+    result.mCapacity = ALIGN_TO(capacity, SOA_STREAM_PADDING);
+
+    byte* streams[] = { (byte*)arrayAlign<Fields>(pArena, result.mCapacity, alignment).mData... };
+    for(uint32 i = 0; i < result.FIELD_COUNT; i++)
+    {
+        result.pStreams[i] = streams[i];
+    }
+    return result;
+}
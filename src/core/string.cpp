@@ -60,6 +60,93 @@ uint64 hash(const char* s)
     return hash(str(s));
 }
 
+bool operator==(Hash128 h1, Hash128 h2)
+{
+    return h1.mLow == h2.mLow && h1.mHigh == h2.mHigh;
+}
+
+bool operator!=(Hash128 h1, Hash128 h2)
+{
+    return !(h1 == h2);
+}
+
+uint64 hash(Hash128 h)
+{
+    // Already well mixed
+    return h.mLow ^ h.mHigh;
+}
+
+inline uint64 hashRotl(uint64 x, uint32 r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64 hashFinalMix(uint64 k)
+{
+    k ^= k >> 33;
+    k *= 0xFF51AFD7ED558CCDULL;
+    k ^= k >> 33;
+    k *= 0xC4CEB9FE1A85EC53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+Hash128 hash128(byte* pData, uint64 len, uint64 seed)
+{
+    const uint64 c1 = 0x87C37B91114253D5ULL;
+    const uint64 c2 = 0x4CF5AD432745937FULL;
+    uint64 h1 = seed;
+    uint64 h2 = seed;
+
+    uint64 blockCount = len / 16;
+    for(uint64 i = 0; i < blockCount; i++)
+    {
+        uint64 k1, k2;
+        memcpy(&k1, pData + i * 16, sizeof(uint64));
+        memcpy(&k2, pData + i * 16 + 8, sizeof(uint64));
+
+        k1 *= c1; k1 = hashRotl(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = hashRotl(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52DCE729;
+        k2 *= c2; k2 = hashRotl(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = hashRotl(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495AB5;
+    }
+
+    // Tail, little endian like the blocks
+    byte* pTail = pData + blockCount * 16;
+    uint64 tailLen = len & 15;
+    uint64 k1 = 0, k2 = 0;
+    for(uint64 i = tailLen; i > 8; i--)
+    {
+        k2 = (k2 << 8) | pTail[i - 1];
+    }
+    for(uint64 i = MIN(tailLen, 8); i > 0; i--)
+    {
+        k1 = (k1 << 8) | pTail[i - 1];
+    }
+    if(tailLen > 8)
+    {
+        k2 *= c2; k2 = hashRotl(k2, 33); k2 *= c1; h2 ^= k2;
+    }
+    if(tailLen > 0)
+    {
+        k1 *= c1; k1 = hashRotl(k1, 31); k1 *= c2; h1 ^= k1;
+    }
+
+    h1 ^= len;
+    h2 ^= len;
+    h1 += h2;
+    h2 += h1;
+    h1 = hashFinalMix(h1);
+    h2 = hashFinalMix(h2);
+    h1 += h2;
+    h2 += h1;
+
+    Hash128 result = {};
+    result.mLow = h1;
+    result.mHigh = h2;
+    return result;
+}
+
 String str(byte* pData, uint64 len)
 {
     String s = {};
@@ -211,13 +298,16 @@ String join(Arena* pArena, String s1, String s2)
 String strf(Arena* pArena, const char* fmt, ...)
 {
     va_list args;
+    va_list argsCopy;
     va_start(args, fmt);
+    va_copy(argsCopy, args);    // va_list can't be reused after vsnprintf on all platforms
 
     int64 len = vsnprintf(0, 0, fmt, args);
     byte* buf = (byte*)arenaPush(pArena, len + 1);
-    vsnprintf((char*)buf, len + 1, fmt, args);
+    vsnprintf((char*)buf, len + 1, fmt, argsCopy);
     buf[len] = 0;   // Null terminator for c-string compatibility
 
+    va_end(argsCopy);
     va_end(args);
     return str(buf, len);
 }
@@ -225,12 +315,15 @@ String strf(Arena* pArena, const char* fmt, ...)
 String strf(char* buf, const char* fmt, ...)
 {
     va_list args;
+    va_list argsCopy;
     va_start(args, fmt);
+    va_copy(argsCopy, args);
 
     int64 len = vsnprintf(0, 0, fmt, args);
-    vsnprintf((char*)buf, len + 1, fmt, args);
+    vsnprintf((char*)buf, len + 1, fmt, argsCopy);
     buf[len] = 0;   // Null terminator for c-string compatibility
 
+    va_end(argsCopy);
     va_end(args);
     return str((byte*)buf, len);
 }
@@ -24,6 +24,19 @@ char* cstr(String s);
 uint64 hash(String s);
 uint64 hash(const char* s);
 
+// MurmurHash3 x64 128, for content keys where collisions must not happen in practice
+struct Hash128
+{
+    uint64 mLow = 0;
+    uint64 mHigh = 0;
+};
+
+bool operator==(Hash128 h1, Hash128 h2);
+bool operator!=(Hash128 h1, Hash128 h2);
+uint64 hash(Hash128 h);     // For hash map keys
+
+Hash128 hash128(byte* pData, uint64 len, uint64 seed = 0);
+
 String str(byte* pData, uint64 len);
 String str(const char* literal);
 String str(Arena* pArena, const char* src);
@@ -6,6 +6,10 @@
 #include "file.hpp"
 #include "array.hpp"
 #include "hash_map.hpp"
+#include "thread.hpp"
+#include "soa.hpp"
+#include "jobs.hpp"
+#include "async_io.hpp"
 
 bool testArena()
 {
@@ -85,6 +89,10 @@ bool testArena()
         ASSERT(mem);
         ASSERT(memcmp(mem, srcData, srcSize) == 0);
 
+        void* aligned = arenaPushCopy(&arena, srcSize, (void*)srcData, srcSize, 16);
+        ASSERT(IS_ALIGNED(aligned, 16));
+        ASSERT(memcmp(aligned, srcData, srcSize) == 0);
+
         destroyArena(&arena);
     }
 
@@ -109,9 +117,165 @@ bool testArena()
         destroyArena(&arena);
     }
 
+    // Testing lazy commit (nothing is committed until pushed)
+    {
+        initArena(GB(4), &arena, KB(64), MB(1));
+        ASSERT(arena.mCapacity == GB(4));
+        ASSERT(arena.mCommitted == 0);
+
+        arenaPush(&arena, 100);
+        ASSERT(arena.mCommitted == KB(64));
+        arenaPush(&arena, KB(64));
+        ASSERT(arena.mCommitted == KB(128));
+
+        destroyArena(&arena);
+        ASSERT(arena.mCommitted == 0);
+    }
+
+    // Testing resident memory stays proportional to use, not to reserved size
+    {
+        uint64 rssStart = getResidentMemory();
+        initArena(GB(4), &arena, KB(64), MB(1));
+        ASSERT(getResidentMemory() < rssStart + MB(1));
+
+        byte* mem = (byte*)arenaPush(&arena, MB(16));
+        memset(mem, 0xAB, MB(16));
+        uint64 rssUsed = getResidentMemory();
+        ASSERT(rssUsed >= rssStart + MB(15));
+        ASSERT(rssUsed <= rssStart + MB(20));
+        ASSERT(arena.mCommitted == MB(16));
+
+        // Fallback keeps up to the decommit threshold committed above the offset
+        arenaFallback(&arena, MB(2));
+        ASSERT(arena.mCommitted == MB(3));
+        ASSERT(getResidentMemory() <= rssUsed - MB(12));
+
+        // Small fallbacks under the threshold don't decommit
+        arenaPush(&arena, KB(512));
+        arenaFallback(&arena, MB(2));
+        ASSERT(arena.mCommitted == MB(3));
+
+        arenaClear(&arena);
+        ASSERT(arena.mCommitted == MB(1));
+
+        // Decommitted memory is committed (zeroed) again on the next push
+        byte* zeroed = (byte*)arenaPush(&arena, MB(8));
+        ASSERT(arena.mCommitted == MB(8));
+        ASSERT(zeroed[MB(8) - 1] == 0);
+
+        destroyArena(&arena);
+        ASSERT(getResidentMemory() < rssUsed);
+    }
+
+    return true;
+}
+
+bool testScratch()
+{
+    // Testing scratch arenas are lazily created per thread
+    {
+        Arena* pScratch = getScratch();
+        ASSERT(pScratch != NULL);
+        ASSERT(pScratch->pStart != NULL);
+        ASSERT(pScratch->mCapacity == SCRATCH_ARENA_SIZE);
+        ASSERT(getScratch() == pScratch);
+
+        // A conflicting arena is never handed out
+        Arena* pOther = getScratch(pScratch);
+        ASSERT(pOther != NULL);
+        ASSERT(pOther != pScratch);
+        ASSERT(getScratch(pOther) == pScratch);
+    }
+
+    // Testing arena scope restores the offset on exit
+    {
+        Arena arena = {};
+        initArena(KB(4), &arena);
+        arenaPush(&arena, 16);
+        {
+            ARENA_SCOPE(&arena);
+            arenaPush(&arena, 128);
+            {
+                ARENA_SCOPE(&arena);
+                arenaPush(&arena, 256);
+                ASSERT(arena.mOffset == 16 + 128 + 256);
+            }
+            ASSERT(arena.mOffset == 16 + 128);
+        }
+        ASSERT(arena.mOffset == 16);
+        destroyArena(&arena);
+    }
+
+    // Testing nested scratch scopes don't clobber each other
+    {
+        ScratchScope outer;
+        uint64 outerStart = outer.pArena->mOffset;
+        uint32* pOuter = (uint32*)arenaPush(outer.pArena, sizeof(uint32) * 64);
+        for(uint32 i = 0; i < 64; i++) pOuter[i] = i;
+        {
+            // Callee receives the caller's arena and must avoid it
+            ScratchScope inner(outer.pArena);
+            ASSERT(inner.pArena != outer.pArena);
+            uint32* pInner = (uint32*)arenaPush(inner.pArena, sizeof(uint32) * 64);
+            memset(pInner, 0xFF, sizeof(uint32) * 64);
+
+            Arena* conflicts[] = { outer.pArena, inner.pArena };
+            ASSERT(getScratch(&conflicts[0], 1) == inner.pArena);
+            ASSERT(getScratch(&conflicts[1], 1) == outer.pArena);
+        }
+        for(uint32 i = 0; i < 64; i++) ASSERT(pOuter[i] == i);
+        ASSERT(outer.pArena->mOffset == outerStart + sizeof(uint32) * 64);
+    }
+    ASSERT(getScratch()->mOffset == 0);
+
+    // Testing destruction
+    {
+        destroyScratchArenas();
+        ASSERT(getScratch()->mOffset == 0);
+        destroyScratchArenas();
+    }
+
     return true;
 }
 
+struct PoolTestThread
+{
+    Thread      mThread = {};
+    Pool*       pPool   = NULL;
+    uint32      mId     = 0;
+    bool        mCached = false;
+    bool        mFailed = false;
+};
+
+void poolTestThreadProc(void* pData)
+{
+    PoolTestThread* pTest = (PoolTestThread*)pData;
+    PoolCache cache = {};
+    initPoolCache(pTest->pPool, &cache);
+
+    uint64* held[16];
+    for(uint32 iter = 0; iter < 2000; iter++)
+    {
+        uint32 count = 0;
+        for(uint32 i = 0; i < ARR_LEN(held); i++)
+        {
+            uint64* pBlock = (uint64*)(pTest->mCached ? poolAlloc(&cache) : poolAlloc(pTest->pPool));
+            if(!pBlock) break;
+            *pBlock = ((uint64)pTest->mId << 32) | i;
+            held[count++] = pBlock;
+        }
+        for(uint32 i = 0; i < count; i++)
+        {
+            // Another owner would have overwritten the tag
+            if(*held[i] != (((uint64)pTest->mId << 32) | i)) pTest->mFailed = true;
+
+            if(pTest->mCached) poolFree(&cache, held[i]);
+            else poolFree(pTest->pPool, held[i]);
+        }
+    }
+    flushPoolCache(&cache);
+}
+
 bool testPool()
 {
     // Basic initialization
@@ -122,15 +286,15 @@ bool testPool()
         ASSERT(pool.pStart != NULL);
         ASSERT(pool.mBlockSize == 64);
         ASSERT(pool.mBlockCount == 8);
-        ASSERT(pool.pFreeBlocks != NULL);
+        ASSERT(!poolExhausted(&pool));
 
         // Free list should contain all blocks initially
         uint64 freeCount = 0;
-        Pool::Header* h = pool.pFreeBlocks;
-        while (h)
+        uint32 index = (uint32)pool.mFreeHead;
+        while (index != POOL_INDEX_NONE)
         {
             freeCount++;
-            h = h->pNextFree;
+            index = ((Pool::Header*)(pool.pStart + index * pool.mStride))->mNextFree;
         }
         ASSERT(freeCount == 8);
 
@@ -155,7 +319,8 @@ bool testPool()
         ASSERT(a != b && a != c && a != d && b != c && c != d);
 
         // Pool should now be exhausted
-        ASSERT(pool.pFreeBlocks == NULL);
+        ASSERT(poolExhausted(&pool));
+        ASSERT(poolAlloc(&pool) == NULL);
 
         // Free one and allocate again
         poolFree(&pool, b);
@@ -174,7 +339,7 @@ bool testPool()
         for (int i = 0; i < 3; ++i)
             blocks[i] = poolAlloc(&pool);
 
-        ASSERT(pool.pFreeBlocks == NULL);
+        ASSERT(poolExhausted(&pool));
 
         // Free all in reverse
         poolFree(&pool, blocks[2]);
@@ -187,7 +352,7 @@ bool testPool()
             newBlocks[i] = poolAlloc(&pool);
 
         ASSERT(newBlocks[0] != NULL && newBlocks[1] != NULL && newBlocks[2] != NULL);
-        ASSERT(pool.pFreeBlocks == NULL);
+        ASSERT(poolExhausted(&pool));
 
         destroyPool(&pool);
     }
@@ -198,11 +363,180 @@ bool testPool()
         initPool(64, 4, &pool);
         destroyPool(&pool);
         ASSERT(pool.pStart == NULL);
-        ASSERT(pool.pFreeBlocks == NULL);
+        ASSERT((uint32)pool.mFreeHead == POOL_INDEX_NONE);
         ASSERT(pool.mBlockSize == 0);
         ASSERT(pool.mBlockCount == 0);
     }
 
+    // Handles and generations
+    {
+        Pool pool = {};
+        initPool(24, 4, &pool);
+        ASSERT(IS_ALIGNED(pool.mStride, POOL_BLOCK_ALIGNMENT));
+
+        HND a = poolAllocHandle(&pool);
+        HND b = poolAllocHandle(&pool);
+        ASSERT(a != HND_INVALID && b != HND_INVALID);
+        ASSERT(HND_INDEX(a) != HND_INDEX(b));
+        ASSERT(poolValid(&pool, a));
+        ASSERT(!poolValid(&pool, HND_INVALID));
+
+        void* pA = poolGet(&pool, a);
+        ASSERT(pA != NULL);
+        ASSERT(IS_ALIGNED(pA, POOL_BLOCK_ALIGNMENT));
+        ASSERT(poolGetHandle(&pool, pA) == a);
+
+        // Freed handles go stale, the reused block gets a new generation
+        poolFreeHandle(&pool, a);
+        ASSERT(!poolValid(&pool, a));
+        ASSERT(poolGet(&pool, a) == NULL);
+
+        HND c = poolAllocHandle(&pool);
+        ASSERT(HND_INDEX(c) == HND_INDEX(a));
+        ASSERT(HND_GENERATION(c) == HND_GENERATION(a) + 1);
+        ASSERT(poolGet(&pool, c) == pA);
+        ASSERT(!poolValid(&pool, a));
+
+        // Pointer frees invalidate handles too
+        poolFree(&pool, poolGet(&pool, b));
+        ASSERT(!poolValid(&pool, b));
+
+        HND d = poolAllocHandle(&pool);
+        HND e = poolAllocHandle(&pool);
+        HND f = poolAllocHandle(&pool);
+        ASSERT(d != HND_INVALID && e != HND_INVALID && f != HND_INVALID);
+        ASSERT(poolAllocHandle(&pool) == HND_INVALID);
+
+        destroyPool(&pool);
+    }
+
+    // Per-thread cache
+    {
+        Pool pool = {};
+        initPool(16, POOL_CACHE_BATCH * 4, &pool);
+
+        PoolCache cache = {};
+        initPoolCache(&pool, &cache);
+
+        // First alloc refills a whole batch at once
+        void* a = poolAlloc(&cache);
+        ASSERT(a != NULL);
+        ASSERT(cache.mCount == POOL_CACHE_BATCH - 1);
+
+        void* blocks[POOL_CACHE_BATCH * 4];
+        blocks[0] = a;
+        for(uint32 i = 1; i < POOL_CACHE_BATCH * 4; i++)
+        {
+            blocks[i] = poolAlloc(&cache);
+            ASSERT(blocks[i] != NULL);
+        }
+        ASSERT(poolExhausted(&pool));
+        ASSERT(poolAlloc(&cache) == NULL);
+
+        // Overflowing the cache hands a batch back to the pool
+        for(uint32 i = 0; i < POOL_CACHE_BATCH * 4; i++)
+        {
+            poolFree(&cache, blocks[i]);
+            ASSERT(cache.mCount <= POOL_CACHE_CAPACITY);
+        }
+        ASSERT(!poolExhausted(&pool));
+
+        flushPoolCache(&cache);
+        ASSERT(cache.mCount == 0);
+
+        // All blocks are back in the pool
+        for(uint32 i = 0; i < POOL_CACHE_BATCH * 4; i++)
+        {
+            ASSERT(poolAlloc(&pool) != NULL);
+        }
+        ASSERT(poolExhausted(&pool));
+
+        destroyPool(&pool);
+    }
+
+    // Concurrent alloc/free never hands out a block twice
+    {
+        Pool pool = {};
+        initPool(sizeof(uint64), 256, &pool);
+
+        PoolTestThread threads[8];
+        for(uint32 t = 0; t < ARR_LEN(threads); t++)
+        {
+            threads[t].pPool = &pool;
+            threads[t].mId = t + 1;
+            threads[t].mCached = t % 2;
+            createThread(poolTestThreadProc, &threads[t], &threads[t].mThread);
+        }
+
+        for(uint32 t = 0; t < ARR_LEN(threads); t++)
+        {
+            joinThread(&threads[t].mThread);
+            ASSERT(!threads[t].mFailed);
+        }
+
+        // Every block made it back to the free list
+        uint32 freeCount = 0;
+        while(poolAlloc(&pool)) freeCount++;
+        ASSERT(freeCount == 256);
+
+        destroyPool(&pool);
+    }
+
+    return true;
+}
+
+bool testFrameRing()
+{
+    FrameRing ring = {};
+
+    // Testing pushes stay in the frame's region, aligned
+    {
+        initFrameRing(1024, 2, &ring);
+        beginRingFrame(&ring, 0);
+        ASSERT(frameRingPush(&ring, 100, 1) == 0);
+        ASSERT(frameRingPush(&ring, 4, 256) == 256);
+        ASSERT(frameRingPush(&ring, 8, 8) == 264);
+        ASSERT(ring.mOffset == 272);
+
+        beginRingFrame(&ring, 1);
+        uint64 a = frameRingPush(&ring, 10, 64);
+        uint64 b = frameRingPush(&ring, 10, 64);
+        ASSERT(a == 1024 && b == 1088);
+        ASSERT(IS_ALIGNED(b, 64));
+    }
+
+    // Testing a full region refuses pushes without touching the other regions
+    {
+        initFrameRing(256, 3, &ring);
+        beginRingFrame(&ring, 4);
+        ASSERT(ring.mFrame == 1);
+        ASSERT(frameRingPush(&ring, 200, 16) == 256);
+        ASSERT(frameRingPush(&ring, 64, 16) == FRAME_RING_FULL);
+        ASSERT(frameRingPush(&ring, 48, 16) == 464);
+        ASSERT(frameRingPush(&ring, 1, 1) == FRAME_RING_FULL);
+        ASSERT(frameRingPush(&ring, 257, 1) == FRAME_RING_FULL);
+        ASSERT(ring.mPeak == 256);
+    }
+
+    // Testing frames recycle their region once begun again
+    {
+        initFrameRing(512, 2, &ring);
+        for(uint32 frame = 0; frame < 8; frame++)
+        {
+            beginRingFrame(&ring, frame);
+            uint64 regionStart = (frame % 2) * 512;
+            for(uint32 i = 0; i < 4; i++)
+            {
+                uint64 offset = frameRingPush(&ring, 100, 32);
+                ASSERT(offset != FRAME_RING_FULL);
+                ASSERT(offset >= regionStart && offset + 100 <= regionStart + 512);
+                ASSERT(offset == regionStart + i * 128);
+            }
+            ASSERT(frameRingPush(&ring, 100, 32) == FRAME_RING_FULL);
+        }
+        ASSERT(ring.mPeak == 484);
+    }
+
     return true;
 }
 
@@ -321,6 +655,21 @@ bool testString()
         ASSERT(s[4] == 'x');
     }
 
+    // Testing hash128(), reference vectors of MurmurHash3 x64 128
+    {
+        String fox = str("The quick brown fox jumps over the lazy dog");
+        Hash128 h = hash128(fox.mData, fox.mLen);
+        ASSERT(h.mLow == 0xE34BBC7BBC071B6CULL && h.mHigh == 0x7A433CA9C49A9347ULL);
+        ASSERT(hash128(fox.mData, 0) == Hash128{});
+
+        // Every tail length, and seeds, give different keys
+        for(uint64 len = 1; len < 32; len++)
+        {
+            ASSERT(hash128(fox.mData, len) != hash128(fox.mData, len - 1));
+            ASSERT(hash128(fox.mData, len, 1) != hash128(fox.mData, len));
+        }
+    }
+
     destroyArena(&arena);
     return true;
 }
@@ -417,6 +766,188 @@ bool testArray()
     return true;
 }
 
+bool testDynArray()
+{
+    // Owned reservation grows in place without copying
+    {
+        DynArray<uint32> arr = dynArrayVirtual<uint32>(MB(16));
+        ASSERT(arr.mCapacity == 0);
+        ASSERT(arr.mArena.mCommitted == 0);
+
+        arr.push(7);
+        ASSERT(arr.mCount == 1);
+        ASSERT(arr.mCapacity == DYN_ARRAY_MIN_CAPACITY);
+        uint32* pData = arr.mData;
+
+        for(uint32 i = 1; i < 100000; i++)
+        {
+            arr.push(i);
+        }
+        ASSERT(arr.mData == pData);
+        ASSERT(arr.mCount == 100000);
+        ASSERT(arr[0] == 7);
+        ASSERT(arr[99999] == 99999);
+
+        // Only what's used is committed
+        ASSERT(arr.mArena.mCommitted < MB(1));
+
+        destroyDynArray(&arr);
+        ASSERT(arr.mData == NULL);
+    }
+
+    // Shared arena: in place while on top, copies once something else is pushed
+    {
+        Arena arena = {};
+        initArena(MB(1), &arena);
+
+        DynArray<uint64> arr = dynArray<uint64>(&arena, 4);
+        ASSERT(arr.mCapacity == DYN_ARRAY_MIN_CAPACITY);
+        for(uint64 i = 0; i < DYN_ARRAY_MIN_CAPACITY; i++) arr.push(i);
+
+        uint64* pData = arr.mData;
+        arr.push(16);
+        ASSERT(arr.mData == pData);
+        ASSERT(arr.mCapacity == DYN_ARRAY_MIN_CAPACITY * 2);
+
+        arenaPush(&arena, 8);
+        arr.resize(arr.mCapacity + 1, 42);
+        ASSERT(arr.mData != pData);
+        ASSERT(arr.mCount == DYN_ARRAY_MIN_CAPACITY * 2 + 1);
+        for(uint64 i = 0; i <= 16; i++) ASSERT(arr[i] == i);
+        for(uint64 i = 17; i < arr.mCount; i++) ASSERT(arr[i] == 42);
+
+        destroyArena(&arena);
+    }
+
+    // Insert, remove, swap remove, append
+    {
+        Arena arena = {};
+        initArena(KB(64), &arena);
+        DynArray<int32> arr = dynArray<int32>(&arena);
+
+        int32 values[] = { 0, 1, 2, 3, 4 };
+        arr.append(values, ARR_LEN(values));
+        ASSERT(arr.mCount == 5);
+
+        arr.insert(0, -1);
+        arr.insert(3, 100);
+        arr.insert(arr.mCount, 5);
+        int32 expected[] = { -1, 0, 1, 100, 2, 3, 4, 5 };
+        ASSERT(arr.mCount == ARR_LEN(expected));
+        for(uint64 i = 0; i < arr.mCount; i++) ASSERT(arr[i] == expected[i]);
+
+        arr.remove(3);
+        ASSERT(arr[3] == 2);
+        ASSERT(arr.mCount == 7);
+
+        arr.removeSwap(0);
+        ASSERT(arr[0] == 5);
+        ASSERT(arr.mCount == 6);
+
+        arr.pop();
+        ASSERT(arr.top() == 3);
+
+        arr.resize(2);
+        ASSERT(arr.mCount == 2);
+        arr.clear();
+        ASSERT(arr.mCount == 0);
+
+        destroyArena(&arena);
+    }
+
+    // Non trivially copyable elements are copied one by one
+    {
+        struct Counted
+        {
+            uint32 mValue = 0;
+            Counted() = default;
+            Counted(uint32 value) : mValue(value) {}
+            Counted(const Counted& other) : mValue(other.mValue) {}
+            Counted& operator=(const Counted& other) { mValue = other.mValue; return *this; }
+        };
+
+        Arena arena = {};
+        initArena(KB(64), &arena);
+        DynArray<Counted> arr = dynArray<Counted>(&arena);
+        for(uint32 i = 0; i < 40; i++)
+        {
+            arr.push(Counted(i));
+            arenaPush(&arena, 4);       // Forces copies on growth
+        }
+        arr.insert(1, Counted(1000));
+        ASSERT(arr[0].mValue == 0);
+        ASSERT(arr[1].mValue == 1000);
+        ASSERT(arr[2].mValue == 1);
+        ASSERT(arr[40].mValue == 39);
+
+        destroyArena(&arena);
+    }
+
+    return true;
+}
+
+bool testSoA()
+{
+    Arena arena = {};
+    initArena(MB(1), &arena);
+
+    enum { FIELD_ID, FIELD_WEIGHT, FIELD_KEY };
+
+    // Streams are separate, aligned and padded
+    {
+        SoAArray<uint32, float, uint64> soa = soaArray<uint32, float, uint64>(&arena, 10);
+        ASSERT(soa.FIELD_COUNT == 3);
+        ASSERT(soa.mCapacity == ALIGN_TO(10, SOA_STREAM_PADDING));
+        ASSERT(soa.mCount == 0);
+        ASSERT(IS_ALIGNED(soa.column<FIELD_ID>(), SOA_STREAM_ALIGNMENT));
+        ASSERT(IS_ALIGNED(soa.column<FIELD_WEIGHT>(), SOA_STREAM_ALIGNMENT));
+        ASSERT(IS_ALIGNED(soa.column<FIELD_KEY>(), SOA_STREAM_ALIGNMENT));
+        ASSERT((void*)soa.column<FIELD_ID>() != (void*)soa.column<FIELD_WEIGHT>());
+    }
+
+    // Push, pop, swap remove
+    {
+        SoAArray<uint32, float, uint64> soa = soaArray<uint32, float, uint64>(&arena, 16);
+        for(uint32 i = 0; i < 5; i++)
+        {
+            soa.push(i, (float)i * 0.5f, (uint64)i << 40);
+        }
+        ASSERT(soa.mCount == 5);
+        ASSERT(soa.get<FIELD_ID>(3) == 3);
+        ASSERT(soa.get<FIELD_WEIGHT>(3) == 1.5f);
+        ASSERT(soa.get<FIELD_KEY>(3) == 3ULL << 40);
+
+        uint32* ids = soa.column<FIELD_ID>();
+        for(uint32 i = 0; i < soa.mCount; i++) ASSERT(ids[i] == i);
+
+        soa.removeSwap(1);
+        ASSERT(soa.mCount == 4);
+        ASSERT(soa.get<FIELD_ID>(1) == 4);
+        ASSERT(soa.get<FIELD_WEIGHT>(1) == 2.0f);
+        ASSERT(soa.get<FIELD_KEY>(1) == 4ULL << 40);
+
+        soa.removeSwap(soa.mCount - 1);
+        ASSERT(soa.mCount == 3);
+        ASSERT(soa.get<FIELD_ID>(2) == 2);
+
+        soa.get<FIELD_WEIGHT>(0) = 9.f;
+        ASSERT(soa.column<FIELD_WEIGHT>()[0] == 9.f);
+
+        soa.pop();
+        ASSERT(soa.mCount == 2);
+
+        uint64 first = soa.pushCount(4);
+        ASSERT(first == 2);
+        ASSERT(soa.mCount == 6);
+
+        soa.clear();
+        ASSERT(soa.mCount == 0);
+    }
+
+    destroyArena(&arena);
+    return true;
+}
+
 void testHashMap()
 {
     Arena arena = {};
@@ -425,10 +956,17 @@ void testHashMap()
     // Basic creation
     {
         HashMap<const char*, int> map = hashmap<const char*, int>(&arena, 8);
-        ASSERT(map.mBuckets.mCount == 8);
-        ASSERT(map.mBuckets.mCapacity == 8);
-        ASSERT(map.mBuckets[0].valid == false);
-        ASSERT(map.mBuckets[7].valid == false);
+        ASSERT(map.mCapacity == HASH_MAP_GROUP_WIDTH);
+        ASSERT(map.mCount == 0);
+        ASSERT(map.mGrowthLeft >= 8);
+        ASSERT(IS_ALIGNED(map.pCtrl, HASH_MAP_GROUP_WIDTH));
+        ASSERT(map.pCtrl[0] == HASH_MAP_CTRL_EMPTY);
+        ASSERT(map.pCtrl[map.mCapacity - 1] == HASH_MAP_CTRL_EMPTY);
+
+        // Capacity is rounded up to fit the requested entries under the max load
+        HashMap<uint64, int> big = hashmap<uint64, int>(&arena, 100);
+        ASSERT(IS_POW2(big.mCapacity));
+        ASSERT(HASH_MAP_MAX_LOAD(big.mCapacity) >= 100);
     }
 
     // Insert & retrieve
@@ -524,9 +1062,255 @@ void testHashMap()
         ASSERT(!map.contains(&b));
     }
 
+    // Integer keys, find and clear
+    {
+        HashMap<uint64, uint32> map = hashmap<uint64, uint32>(&arena, 16);
+        for(uint64 i = 0; i < 10; i++)
+        {
+            ASSERT(map.insert(i * 1000, (uint32)i));
+        }
+        ASSERT(map.mCount == 10);
+        ASSERT(map.find(5000) && *map.find(5000) == 5);
+        ASSERT(map.find(5001) == NULL);
+
+        *map.find(5000) = 55;
+        ASSERT(map[5000] == 55);
+
+        map.clear();
+        ASSERT(map.mCount == 0);
+        ASSERT(!map.contains(5000));
+    }
+
+    // Growth
+    {
+        HashMap<int32, int32> map = hashmap<int32, int32>(&arena, 8);
+        uint64 startCapacity = map.mCapacity;
+        for(int32 i = 0; i < 5000; i++)
+        {
+            ASSERT(map.insert(i, -i));
+        }
+        ASSERT(map.mCount == 5000);
+        ASSERT(map.mCapacity > startCapacity);
+        for(int32 i = 0; i < 5000; i++)
+        {
+            ASSERT(map[i] == -i);
+        }
+        ASSERT(!map.contains(5000));
+    }
+
+    // Tombstones keep probe chains intact and are purged on rehash
+    {
+        HashMap<uint32, uint32> map = hashmap<uint32, uint32>(&arena, 64, false);
+        uint64 capacity = map.mCapacity;
+        uint64 maxLoad = HASH_MAP_MAX_LOAD(capacity);
+
+        // Churning far more keys than fit through a fixed size map
+        for(uint32 i = 0; i < 20000; i++)
+        {
+            ASSERT(map.insert(i, i * 3));
+            if(i >= 40)
+            {
+                map.remove(i - 40);
+                ASSERT(!map.contains(i - 40));
+            }
+            ASSERT(map.mCount <= maxLoad);
+        }
+        ASSERT(map.mCapacity == capacity);
+        ASSERT(map.mCount == 40);
+        for(uint32 i = 20000 - 40; i < 20000; i++)
+        {
+            ASSERT(map[i] == i * 3);
+        }
+
+        // Filling it up completely
+        for(uint32 i = 0; map.mCount < maxLoad; i++)
+        {
+            ASSERT(map.insert(100000 + i, i));
+        }
+        ASSERT(map.mCapacity == capacity);
+        ASSERT(map[19999] == 19999 * 3);
+    }
+
     destroyArena(&arena);
 }
 
+struct JobTestData
+{
+    JobSystem*  pJobs       = NULL;
+    uint32*     pCounts     = NULL;     // Per element run count
+    uint32      mSum        = 0;
+    uint32      mStage      = 0;
+    uint32      mStageError = 0;
+};
+
+void jobTestIncrementProc(void* pData)
+{
+    JobTestData* pTest = (JobTestData*)pData;
+    atomicAdd(&pTest->mSum, 1u);
+}
+
+// Spawns child jobs and waits on them from inside a job
+void jobTestNestedProc(void* pData)
+{
+    JobTestData* pTest = (JobTestData*)pData;
+    JobCounter counter = {};
+    for(uint32 i = 0; i < 16; i++)
+    {
+        runJob(pTest->pJobs, jobTestIncrementProc, pTest, &counter);
+    }
+    waitJobs(pTest->pJobs, &counter);
+}
+
+void jobTestStageProc(void* pData)
+{
+    JobTestData* pTest = (JobTestData*)pData;
+    // Every stage 0 job must be done before the first stage 1 job runs
+    if(atomicLoad(&pTest->mSum) != 64) atomicAdd(&pTest->mStageError, 1u);
+    atomicAdd(&pTest->mStage, 1u);
+}
+
+void jobTestRangeProc(uint32 begin, uint32 end, void* pData)
+{
+    JobTestData* pTest = (JobTestData*)pData;
+    for(uint32 i = begin; i < end; i++)
+    {
+        atomicAdd(&pTest->pCounts[i], 1u);
+    }
+}
+
+bool testJobs()
+{
+    Arena arena = {};
+    initArena(MB(16), &arena);
+
+    for(uint32 workerCount = 1; workerCount <= 8; workerCount *= 2)
+    {
+        JobSystem jobs = {};
+        initJobSystem(workerCount, &jobs);
+        ASSERT(jobs.mWorkerCount == workerCount);
+        ASSERT(getJobWorkerIndex(&jobs) == 0);
+
+        // Testing counters
+        {
+            JobTestData test = {};
+            test.pJobs = &jobs;
+            JobCounter counter = {};
+            ASSERT(jobsDone(&counter));
+            for(uint32 i = 0; i < 10000; i++)
+            {
+                runJob(&jobs, jobTestIncrementProc, &test, &counter);
+            }
+            waitJobs(&jobs, &counter);
+            ASSERT(jobsDone(&counter));
+            ASSERT(test.mSum == 10000);
+        }
+
+        // Testing jobs that spawn and wait on jobs
+        {
+            JobTestData test = {};
+            test.pJobs = &jobs;
+            JobCounter counter = {};
+            for(uint32 i = 0; i < 64; i++)
+            {
+                runJob(&jobs, jobTestNestedProc, &test, &counter);
+            }
+            waitJobs(&jobs, &counter);
+            ASSERT(test.mSum == 64 * 16);
+        }
+
+        // Testing dependencies
+        {
+            JobTestData test = {};
+            test.pJobs = &jobs;
+            JobCounter stage0 = {};
+            JobCounter stage1 = {};
+            for(uint32 i = 0; i < 64; i++)
+            {
+                runJob(&jobs, jobTestIncrementProc, &test, &stage0);
+            }
+            for(uint32 i = 0; i < 32; i++)
+            {
+                runJobAfter(&jobs, jobTestStageProc, &test, &stage0, &stage1);
+            }
+            waitJobs(&jobs, &stage1);
+            ASSERT(jobsDone(&stage0));
+            ASSERT(test.mStage == 32);
+            ASSERT(test.mStageError == 0);
+
+            // Already done dependency
+            runJobAfter(&jobs, jobTestStageProc, &test, &stage0, &stage1);
+            waitJobs(&jobs, &stage1);
+            ASSERT(test.mStage == 33);
+        }
+
+        // Testing parallelFor, every element visited exactly once
+        {
+            const uint32 count = 100003;
+            JobTestData test = {};
+            test.pJobs = &jobs;
+            test.pCounts = (uint32*)arenaPushZero(&arena, count * sizeof(uint32));
+            parallelFor(&jobs, 0, count, 1000, jobTestRangeProc, &test);
+            for(uint32 i = 0; i < count; i++)
+            {
+                ASSERT(test.pCounts[i] == 1);
+            }
+
+            // Automatic grain, sub range, lambda
+            uint32 sum = 0;
+            parallelFor(&jobs, 10, count, 0, [&](uint32 begin, uint32 end)
+            {
+                for(uint32 i = begin; i < end; i++)
+                {
+                    atomicAdd(&test.pCounts[i], 1u);
+                }
+                atomicAdd(&sum, end - begin);
+            });
+            ASSERT(sum == count - 10);
+            for(uint32 i = 0; i < count; i++)
+            {
+                ASSERT(test.pCounts[i] == (i < 10 ? 1u : 2u));
+            }
+
+            // Empty and single element ranges
+            parallelFor(&jobs, 5, 5, 1, jobTestRangeProc, &test);
+            parallelFor(&jobs, 5, 6, 1, jobTestRangeProc, &test);
+            ASSERT(test.pCounts[5] == 2);
+            ASSERT(test.pCounts[4] == 1);
+            arenaClear(&arena);
+        }
+
+        // Testing per worker arenas
+        {
+            Arena* arenas[8] = {};
+            parallelFor(&jobs, 0, 1000, 1, [&](uint32 begin, uint32 end)
+            {
+                uint32 worker = getJobWorkerIndex(&jobs);
+                ASSERT(worker < workerCount);
+                Arena* pArena = getJobArena(&jobs);
+                ASSERT(!arenas[worker] || arenas[worker] == pArena);
+                arenas[worker] = pArena;
+                uint32* pValue = (uint32*)arenaPush(pArena, sizeof(uint32));
+                *pValue = begin;
+            });
+            for(uint32 i = 0; i < workerCount; i++)
+            {
+                for(uint32 j = i + 1; j < workerCount; j++)
+                {
+                    ASSERT(!arenas[i] || arenas[i] != arenas[j]);
+                }
+            }
+            ASSERT(getJobArena(&jobs)->mOffset > 0);
+            resetJobArenas(&jobs);
+            ASSERT(getJobArena(&jobs)->mOffset == 0);
+        }
+
+        destroyJobSystem(&jobs);
+    }
+
+    destroyArena(&arena);
+    return true;
+}
+
 void testTime(App* pApp)
 {
     ASSERT(pApp);
@@ -672,6 +1456,53 @@ bool testFile()
         ASSERT(content == fileContent);
     }
 
+    // Mapping file
+    {
+        FileView view = {};
+        ASSERT(mapFile(filePath, &view));
+        ASSERT(view.pData);
+        ASSERT(view.mSize == contentLen);
+        ASSERT(memcmp(view.pData, fileContent, contentLen) == 0);
+        prefetchFile(&view, 7, 1000);   // Clamped to the file
+        unmapFile(&view);
+        ASSERT(!view.pData && view.mSize == 0);
+
+        ASSERT(mapFile(filePath, &view, FILE_ACCESS_RANDOM));
+        ASSERT(view.mSize == contentLen);
+        ASSERT(view.pData[contentLen - 1] == fileContent[contentLen - 1]);
+        unmapFile(&view);
+
+        ASSERT(!mapFile(str("test_dir/missing_file.txt"), &view));
+        ASSERT(!view.pData);
+    }
+
+    // Empty files map to an empty view
+    {
+        String emptyPath = str("test_dir/empty_file.txt");
+        ASSERT(createFile(emptyPath));
+        FileView view = {};
+        ASSERT(mapFile(emptyPath, &view));
+        ASSERT(!view.pData && view.mSize == 0);
+        unmapFile(&view);
+        ASSERT(deleteFile(emptyPath));
+    }
+
+    // Writing replaces the whole file, shorter content truncates it
+    {
+        uint64 bytesWritten = writeFile(filePath, (byte*)fileContent, 5);
+        ASSERT(bytesWritten == 5);
+        ASSERT(getFileSize(filePath) == 5);
+    }
+
+    // Moving replaces the destination
+    {
+        String movedPath = str("test_dir/moved_file.txt");
+        ASSERT(writeFile(movedPath, (byte*)fileContent, 3) == 3);
+        ASSERT(moveFile(movedPath, filePath));
+        ASSERT(!pathExists(movedPath));
+        ASSERT(getFileSize(filePath) == 3);
+    }
+
     // Cleanup and deletion
     {
         ASSERT(deleteFile(filePath));
@@ -685,15 +1516,170 @@ bool testFile()
     return true;
 }
 
+struct AsyncIOTestResult
+{
+    uint32  mCalls      = 0;
+    IOStatus mStatus    = IO_INVALID;
+    uint64  mBytesRead  = 0;
+};
+
+void asyncIOTestCallback(void* pUserData, IOTicket ticket, IOStatus status, uint64 bytesRead)
+{
+    AsyncIOTestResult* pResult = (AsyncIOTestResult*)pUserData;
+    pResult->mCalls++;
+    pResult->mStatus = status;
+    pResult->mBytesRead = bytesRead;
+}
+
+void testAsyncIOBackend(AsyncIO* pIO, String* pPaths, uint32 fileCount, uint64 fileSize)
+{
+    Arena arena = {};
+    initArena(fileCount * fileSize + MB(1), &arena);
+
+    // Whole files, more than the queue depth, polled
+    {
+        IOTicket* pTickets = (IOTicket*)arenaPush(&arena, fileCount * sizeof(IOTicket));
+        byte* pData = (byte*)arenaPush(&arena, fileCount * fileSize);
+        for(uint32 i = 0; i < fileCount; i++)
+        {
+            IORead read = {};
+            read.mPath = pPaths[i];
+            read.mSize = fileSize;
+            read.pDst = pData + i * fileSize;
+            pTickets[i] = readFileAsync(pIO, read);
+            ASSERT(pTickets[i] != HND_INVALID);
+            ASSERT(pollAsyncIO(pIO, pTickets[i]) == IO_PENDING);
+        }
+        waitAsyncIO(pIO);
+        ASSERT(isAsyncIOIdle(pIO));
+
+        for(uint32 i = 0; i < fileCount; i++)
+        {
+            uint64 bytesRead = 0;
+            ASSERT(pollAsyncIO(pIO, pTickets[i], &bytesRead) == IO_DONE);
+            ASSERT(bytesRead == fileSize);
+            ASSERT(pollAsyncIO(pIO, pTickets[i]) == IO_INVALID);
+            for(uint64 b = 0; b < fileSize; b++)
+            {
+                ASSERT(pData[i * fileSize + b] == (byte)(i * 7 + b));
+            }
+        }
+    }
+
+    // Offsets, reads past the end stop short
+    {
+        byte buffer[64] = {};
+        IORead read = {};
+        read.mPath = pPaths[1];
+        read.mOffset = fileSize - 10;
+        read.mSize = sizeof(buffer);
+        read.pDst = buffer;
+        IOTicket ticket = readFileAsync(pIO, read);
+        waitAsyncIO(pIO);
+        uint64 bytesRead = 0;
+        ASSERT(pollAsyncIO(pIO, ticket, &bytesRead) == IO_DONE);
+        ASSERT(bytesRead == 10);
+        ASSERT(buffer[0] == (byte)(7 + fileSize - 10));
+        ASSERT(buffer[10] == 0);
+    }
+
+    // Callbacks consume the ticket, missing files fail
+    {
+        AsyncIOTestResult found = {};
+        AsyncIOTestResult missing = {};
+        byte buffer[16] = {};
+        IORead read = {};
+        read.mPath = pPaths[0];
+        read.mSize = sizeof(buffer);
+        read.pDst = buffer;
+        read.pfnComplete = asyncIOTestCallback;
+        read.pUserData = &found;
+        IOTicket foundTicket = readFileAsync(pIO, read);
+        read.mPath = str("test_io/missing.bin");
+        read.pUserData = &missing;
+        readFileAsync(pIO, read);
+        waitAsyncIO(pIO);
+
+        ASSERT(found.mCalls == 1 && found.mStatus == IO_DONE && found.mBytesRead == sizeof(buffer));
+        ASSERT(missing.mCalls == 1 && missing.mStatus == IO_FAILED);
+        ASSERT(pollAsyncIO(pIO, foundTicket) == IO_INVALID);
+        ASSERT(buffer[15] == 15);
+    }
+
+    destroyArena(&arena);
+}
+
+bool testAsyncIO()
+{
+    Arena arena = {};
+    initArena(MB(1), &arena);
+
+    const uint32 fileCount = 100;
+    const uint64 fileSize = 3000;
+    String dirPath = str("test_io");
+    ASSERT(createDir(dirPath));
+    String* pPaths = (String*)arenaPush(&arena, fileCount * sizeof(String));
+    byte* pContent = (byte*)arenaPush(&arena, fileSize);
+    for(uint32 i = 0; i < fileCount; i++)
+    {
+        pPaths[i] = strf(&arena, "test_io/file_%u.bin", i);
+        for(uint64 b = 0; b < fileSize; b++)
+        {
+            pContent[b] = (byte)(i * 7 + b);
+        }
+        ASSERT(writeFile(pPaths[i], pContent, fileSize) == fileSize);
+    }
+
+    JobSystem jobs = {};
+    initJobSystem(4, &jobs);
+
+    // io_uring is only there on recent Linux kernels
+    AsyncIODesc desc = {};
+    desc.mQueueDepth = 16;
+    desc.mBackend = IO_BACKEND_URING;
+    AsyncIO io = {};
+    if(initAsyncIO(desc, &io))
+    {
+        testAsyncIOBackend(&io, pPaths, fileCount, fileSize);
+        destroyAsyncIO(&io);
+    }
+
+    desc.mBackend = IO_BACKEND_JOBS;
+    desc.pJobs = &jobs;
+    ASSERT(initAsyncIO(desc, &io));
+    testAsyncIOBackend(&io, pPaths, fileCount, fileSize);
+    destroyAsyncIO(&io);
+
+    desc.pJobs = NULL;
+    ASSERT(initAsyncIO(desc, &io));
+    testAsyncIOBackend(&io, pPaths, fileCount, fileSize);
+    destroyAsyncIO(&io);
+
+    destroyJobSystem(&jobs);
+    for(uint32 i = 0; i < fileCount; i++)
+    {
+        ASSERT(deleteFile(pPaths[i]));
+    }
+    ASSERT(deleteDir(dirPath));
+    destroyArena(&arena);
+    return true;
+}
+
 void testCore(App* pApp)
 {
     ASSERT(pApp);
     LOG("[TEST-CORE] Testing arena allocator...");
     testArena();
 
+    LOG("[TEST-CORE] Testing scratch arenas...");
+    testScratch();
+
     LOG("[TEST-CORE] Testing pool allocator...");
     testPool();
 
+    LOG("[TEST-CORE] Testing frame ring allocator...");
+    testFrameRing();
+
     LOG("[TEST-CORE] Testing string...");
     testString();
 
@@ -703,9 +1689,21 @@ void testCore(App* pApp)
     LOG("[TEST-CORE] Testing array...");
     testArray();
 
+    LOG("[TEST-CORE] Testing dynamic array...");
+    testDynArray();
+
+    LOG("[TEST-CORE] Testing SoA array...");
+    testSoA();
+
     LOG("[TEST-CORE] Testing hash map...");
     testHashMap();
 
+    LOG("[TEST-CORE] Testing job system...");
+    testJobs();
+
+    LOG("[TEST-CORE] Testing async file reads...");
+    testAsyncIO();
+
     LOG("[TEST-CORE] Testing time...");
     testTime(pApp);
 
@@ -0,0 +1,160 @@
+#include "thread.hpp"
+#include "debug.hpp"
+
+#ifndef _WIN32
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+DWORD WINAPI threadEntry(LPVOID pParam)
+{
+    Thread* pThread = (Thread*)pParam;
+    pThread->pProc(pThread->pData);
+    return 0;
+}
+
+void createThread(ThreadProc proc, void* pData, Thread* pThread)
+{
+    ASSERT(proc && pThread);
+    pThread->pProc = proc;
+    pThread->pData = pData;
+    pThread->mHandle = CreateThread(NULL, 0, threadEntry, pThread, 0, NULL);
+    ASSERT(pThread->mHandle);
+}
+
+void joinThread(Thread* pThread)
+{
+    ASSERT(pThread && pThread->mHandle);
+    DWORD ret = WaitForSingleObject(pThread->mHandle, INFINITE);
+    ASSERT(ret == WAIT_OBJECT_0);
+    CloseHandle(pThread->mHandle);
+    *pThread = {};
+}
+
+void yieldThread()
+{
+    SwitchToThread();
+}
+
+uint32 getCoreCount()
+{
+    SYSTEM_INFO info = {};
+    GetSystemInfo(&info);
+    return (uint32)info.dwNumberOfProcessors;
+}
+
+bool pinThread(uint32 core)
+{
+    if(core >= 64) return false;
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << core) != 0;
+}
+
+void initSemaphore(uint32 count, Semaphore* pSemaphore)
+{
+    ASSERT(pSemaphore);
+    pSemaphore->mHandle = CreateSemaphoreA(NULL, (LONG)count, MAXLONG, NULL);
+    ASSERT(pSemaphore->mHandle);
+}
+
+void destroySemaphore(Semaphore* pSemaphore)
+{
+    ASSERT(pSemaphore && pSemaphore->mHandle);
+    CloseHandle(pSemaphore->mHandle);
+    *pSemaphore = {};
+}
+
+void signalSemaphore(Semaphore* pSemaphore, uint32 count)
+{
+    ASSERT(pSemaphore);
+    BOOL ret = ReleaseSemaphore(pSemaphore->mHandle, (LONG)count, NULL);
+    ASSERT(ret);
+}
+
+void waitSemaphore(Semaphore* pSemaphore)
+{
+    ASSERT(pSemaphore);
+    DWORD ret = WaitForSingleObject(pSemaphore->mHandle, INFINITE);
+    ASSERT(ret == WAIT_OBJECT_0);
+}
+
+#else
+
+void* threadEntry(void* pParam)
+{
+    Thread* pThread = (Thread*)pParam;
+    pThread->pProc(pThread->pData);
+    return NULL;
+}
+
+void createThread(ThreadProc proc, void* pData, Thread* pThread)
+{
+    ASSERT(proc && pThread);
+    pThread->pProc = proc;
+    pThread->pData = pData;
+    int32 ret = pthread_create(&pThread->mHandle, NULL, threadEntry, pThread);
+    ASSERT(ret == 0);
+}
+
+void joinThread(Thread* pThread)
+{
+    ASSERT(pThread);
+    int32 ret = pthread_join(pThread->mHandle, NULL);
+    ASSERT(ret == 0);
+    *pThread = {};
+}
+
+void yieldThread()
+{
+    sched_yield();
+}
+
+uint32 getCoreCount()
+{
+    int64 count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (uint32)count : 1;
+}
+
+bool pinThread(uint32 core)
+{
+    if(core >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+void initSemaphore(uint32 count, Semaphore* pSemaphore)
+{
+    ASSERT(pSemaphore);
+    int32 ret = sem_init(&pSemaphore->mHandle, 0, count);
+    ASSERT(ret == 0);
+}
+
+void destroySemaphore(Semaphore* pSemaphore)
+{
+    ASSERT(pSemaphore);
+    sem_destroy(&pSemaphore->mHandle);
+    *pSemaphore = {};
+}
+
+void signalSemaphore(Semaphore* pSemaphore, uint32 count)
+{
+    ASSERT(pSemaphore);
+    for(uint32 i = 0; i < count; i++)
+    {
+        sem_post(&pSemaphore->mHandle);
+    }
+}
+
+void waitSemaphore(Semaphore* pSemaphore)
+{
+    ASSERT(pSemaphore);
+    while(sem_wait(&pSemaphore->mHandle) != 0)
+    {
+        // Interrupted by a signal
+    }
+}
+
+#endif
@@ -0,0 +1,79 @@
+#pragma once
+#include "base.hpp"
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <semaphore.h>
+#endif
+
+// Atomics
+// Thin wrappers over the compiler builtins (clang/gcc). Loads acquire, stores
+// release and read-modify-write operations are acquire-release unless suffixed.
+template<typename T> inline T atomicLoad(T* p)            { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+template<typename T> inline T atomicLoadRelaxed(T* p)     { return __atomic_load_n(p, __ATOMIC_RELAXED); }
+template<typename T> inline void atomicStore(T* p, T v)         { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+template<typename T> inline void atomicStoreRelaxed(T* p, T v)  { __atomic_store_n(p, v, __ATOMIC_RELAXED); }
+template<typename T> inline T atomicAdd(T* p, T v)        { return __atomic_fetch_add(p, v, __ATOMIC_ACQ_REL); }  // Returns previous value
+template<typename T> inline T atomicSub(T* p, T v)        { return __atomic_fetch_sub(p, v, __ATOMIC_ACQ_REL); }  // Returns previous value
+template<typename T> inline T atomicExchange(T* p, T v)   { return __atomic_exchange_n(p, v, __ATOMIC_ACQ_REL); }
+
+// On failure pExpected is updated with the current value.
+template<typename T> inline bool atomicCompareExchange(T* p, T* pExpected, T desired)
+{
+    return __atomic_compare_exchange_n(p, pExpected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+inline void atomicFence() { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+
+#define CACHE_LINE_SIZE 64
+
+// Thread
+typedef void (*ThreadProc)(void* pData);
+
+struct Thread
+{
+#ifdef _WIN32
+    HANDLE      mHandle = NULL;
+#else
+    pthread_t   mHandle = 0;
+#endif
+    ThreadProc  pProc   = NULL;
+    void*       pData   = NULL;
+};
+
+// The Thread struct must stay alive until joinThread returns.
+void    createThread(ThreadProc proc, void* pData, Thread* pThread);
+void    joinThread(Thread* pThread);
+void    yieldThread();
+uint32  getCoreCount();
+bool    pinThread(uint32 core);     // Pins the calling thread to a core, false if the core is not available
+
+// Spin lock
+// For short critical sections, a waiting thread yields between attempts.
+inline void spinLock(uint32* pLock)
+{
+    while(atomicExchange(pLock, 1u))
+    {
+        yieldThread();
+    }
+}
+
+inline void spinUnlock(uint32* pLock)
+{
+    atomicStore(pLock, 0u);
+}
+
+// Semaphore
+struct Semaphore
+{
+#ifdef _WIN32
+    HANDLE  mHandle = NULL;
+#else
+    sem_t   mHandle = {};
+#endif
+};
+
+void    initSemaphore(uint32 count, Semaphore* pSemaphore);
+void    destroySemaphore(Semaphore* pSemaphore);
+void    signalSemaphore(Semaphore* pSemaphore, uint32 count = 1);
+void    waitSemaphore(Semaphore* pSemaphore);
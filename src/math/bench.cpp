@@ -0,0 +1,523 @@
+#include "math.hpp"
+#include "volumes.hpp"
+#include "random.hpp"
+#include "bvh.hpp"
+#include "../core/app.hpp"
+#include "../core/memory.hpp"
+#include "../core/time.hpp"
+#include "../core/debug.hpp"
+#include "../core/thread.hpp"
+#include "../core/jobs.hpp"
+
+// Math benchmarks. Results are only logged, run with an optimized DW_DEBUG build
+// (logging is compiled out otherwise).
+
+// Scalar implementations, kept as the baseline for the SIMD backend.
+m4f scalarMatMul(m4f a, m4f b)
+{
+    m4f result = {};
+    for(uint32 col = 0; col < 4; col++)
+    {
+        for(uint32 row = 0; row < 4; row++)
+        {
+            result.mData[col * 4 + row] =
+                a.mData[0 * 4 + row] * b.mData[col * 4 + 0] +
+                a.mData[1 * 4 + row] * b.mData[col * 4 + 1] +
+                a.mData[2 * 4 + row] * b.mData[col * 4 + 2] +
+                a.mData[3 * 4 + row] * b.mData[col * 4 + 3];
+        }
+    }
+    return result;
+}
+
+v4f scalarMatMul(m4f m, v4f v)
+{
+    return
+    {
+        m.m00 * v.x + m.m01 * v.y + m.m02 * v.z + m.m03 * v.w,
+        m.m10 * v.x + m.m11 * v.y + m.m12 * v.z + m.m13 * v.w,
+        m.m20 * v.x + m.m21 * v.y + m.m22 * v.z + m.m23 * v.w,
+        m.m30 * v.x + m.m31 * v.y + m.m32 * v.z + m.m33 * v.w,
+    };
+}
+
+m4f scalarTranspose(m4f m)
+{
+    return
+    {
+        m.m00, m.m01, m.m02, m.m03,
+        m.m10, m.m11, m.m12, m.m13,
+        m.m20, m.m21, m.m22, m.m23,
+        m.m30, m.m31, m.m32, m.m33,
+    };
+}
+
+m4f scalarInverse(m4f m)
+{
+    float A2323 = m.m22 * m.m33 - m.m23 * m.m32;
+    float A1323 = m.m21 * m.m33 - m.m23 * m.m31;
+    float A1223 = m.m21 * m.m32 - m.m22 * m.m31;
+    float A0323 = m.m20 * m.m33 - m.m23 * m.m30;
+    float A0223 = m.m20 * m.m32 - m.m22 * m.m30;
+    float A0123 = m.m20 * m.m31 - m.m21 * m.m30;
+    float A2313 = m.m12 * m.m33 - m.m13 * m.m32;
+    float A1313 = m.m11 * m.m33 - m.m13 * m.m31;
+    float A1213 = m.m11 * m.m32 - m.m12 * m.m31;
+    float A2312 = m.m12 * m.m23 - m.m13 * m.m22;
+    float A1312 = m.m11 * m.m23 - m.m13 * m.m21;
+    float A1212 = m.m11 * m.m22 - m.m12 * m.m21;
+    float A0313 = m.m10 * m.m33 - m.m13 * m.m30;
+    float A0213 = m.m10 * m.m32 - m.m12 * m.m30;
+    float A0312 = m.m10 * m.m23 - m.m13 * m.m20;
+    float A0212 = m.m10 * m.m22 - m.m12 * m.m20;
+    float A0113 = m.m10 * m.m31 - m.m11 * m.m30;
+    float A0112 = m.m10 * m.m21 - m.m11 * m.m20;
+
+    float det = m.m00 * (m.m11 * A2323 - m.m12 * A1323 + m.m13 * A1223)
+    - m.m01 * (m.m10 * A2323 - m.m12 * A0323 + m.m13 * A0223)
+    + m.m02 * (m.m10 * A1323 - m.m11 * A0323 + m.m13 * A0123)
+    - m.m03 * (m.m10 * A1223 - m.m11 * A0223 + m.m12 * A0123);
+    det = 1 / det;
+
+    return
+    {
+        det *  (m.m11 * A2323 - m.m12 * A1323 + m.m13 * A1223),
+        det * -(m.m10 * A2323 - m.m12 * A0323 + m.m13 * A0223),
+        det *  (m.m10 * A1323 - m.m11 * A0323 + m.m13 * A0123),
+        det * -(m.m10 * A1223 - m.m11 * A0223 + m.m12 * A0123),
+        det * -(m.m01 * A2323 - m.m02 * A1323 + m.m03 * A1223),
+        det *  (m.m00 * A2323 - m.m02 * A0323 + m.m03 * A0223),
+        det * -(m.m00 * A1323 - m.m01 * A0323 + m.m03 * A0123),
+        det *  (m.m00 * A1223 - m.m01 * A0223 + m.m02 * A0123),
+        det *  (m.m01 * A2313 - m.m02 * A1313 + m.m03 * A1213),
+        det * -(m.m00 * A2313 - m.m02 * A0313 + m.m03 * A0213),
+        det *  (m.m00 * A1313 - m.m01 * A0313 + m.m03 * A0113),
+        det * -(m.m00 * A1213 - m.m01 * A0213 + m.m02 * A0113),
+        det * -(m.m01 * A2312 - m.m02 * A1312 + m.m03 * A1212),
+        det *  (m.m00 * A2312 - m.m02 * A0312 + m.m03 * A0212),
+        det * -(m.m00 * A1312 - m.m01 * A0312 + m.m03 * A0112),
+        det *  (m.m00 * A1212 - m.m01 * A0212 + m.m02 * A0112),
+    };
+}
+
+quat scalarQuatMul(quat a, quat b)
+{
+    return
+    {
+        a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+        a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+        a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+        a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z
+    };
+}
+
+v3f scalarRotate(v3f p, quat q)
+{
+    quat conj = { -q.x, -q.y, -q.z, q.w };
+    quat result = scalarQuatMul(scalarQuatMul(q, quat{p.x, p.y, p.z, 0}), conj);
+    return { result.x, result.y, result.z };
+}
+
+// Previous transformAABB, bounds of the 8 transformed corners.
+AABB scalarTransformAABB(AABB aabb, m4f transform)
+{
+    AABB result = {};
+    for(uint32 i = 0; i < 8; i++)
+    {
+        v4f corner =
+        {
+            i & 1 ? aabb.max.x : aabb.min.x,
+            i & 2 ? aabb.max.y : aabb.min.y,
+            i & 4 ? aabb.max.z : aabb.min.z,
+            1.f
+        };
+        v3f p = to3f(scalarMatMul(transform, corner));
+        result.min = i == 0 ? p : v3f{ MIN(result.min.x, p.x), MIN(result.min.y, p.y), MIN(result.min.z, p.z) };
+        result.max = i == 0 ? p : v3f{ MAX(result.max.x, p.x), MAX(result.max.y, p.y), MAX(result.max.z, p.z) };
+    }
+    return result;
+}
+
+#define MATH_BENCH_COUNT        4096    // Inputs per pass, small enough to stay in L1/L2
+#define MATH_BENCH_ITERATIONS   1000
+
+// Runs OP over every input MATH_BENCH_ITERATIONS times, logging ns per call.
+// Outputs are folded into sink so the calls can't be optimized out.
+#define MATH_BENCH_OP(NAME, OP)                                                     \
+{                                                                                   \
+    Timer timer = createTimer(pApp);                                                \
+    startTimer(&timer);                                                             \
+    for(uint32 iter = 0; iter < MATH_BENCH_ITERATIONS; iter++)                      \
+    {                                                                               \
+        for(uint32 i = 0; i < MATH_BENCH_COUNT; i++)                                \
+        {                                                                           \
+            OP;                                                                     \
+        }                                                                           \
+        sink += pOutM[iter % MATH_BENCH_COUNT].m00 + pOutV[iter % MATH_BENCH_COUNT].x; \
+    }                                                                               \
+    endTimer(&timer);                                                               \
+    LOGF("[BENCH-MATH] %-22s %6.2f ns/op", NAME,                                    \
+            getNS(&timer) / ((double)MATH_BENCH_ITERATIONS * MATH_BENCH_COUNT));    \
+}
+
+void benchMathOps(App* pApp)
+{
+    ASSERT(pApp);
+
+    Arena arena = {};
+    initArena(MB(64), &arena);
+
+    m4f* pA = (m4f*)arenaPush(&arena, MATH_BENCH_COUNT * sizeof(m4f), alignof(m4f));
+    m4f* pB = (m4f*)arenaPush(&arena, MATH_BENCH_COUNT * sizeof(m4f), alignof(m4f));
+    m4f* pOutM = (m4f*)arenaPush(&arena, MATH_BENCH_COUNT * sizeof(m4f), alignof(m4f));
+    quat* pQ = (quat*)arenaPush(&arena, MATH_BENCH_COUNT * sizeof(quat), alignof(quat));
+    v4f* pV = (v4f*)arenaPush(&arena, MATH_BENCH_COUNT * sizeof(v4f), alignof(v4f));
+    v4f* pOutV = (v4f*)arenaPush(&arena, MATH_BENCH_COUNT * sizeof(v4f), alignof(v4f));
+
+    // Random rigid transforms with scale, always invertible
+    for(uint32 i = 0; i < MATH_BENCH_COUNT; i++)
+    {
+        float t = (float)i / MATH_BENCH_COUNT;
+        v3f axis = normalize(v3f{ 0.3f + t, 1.f - t, 0.5f });
+        pQ[i] = quatAngleAxis(t * 6.f, axis);
+        pA[i] = matMul(translation(v3f{ t, -2.f * t, 3.f }), matMul(rotation(pQ[i]), scale(1.f + t)));
+        pB[i] = matMul(rotation(pQ[i]), translation(v3f{ -t, 1.f, t * t }));
+        pV[i] = { t, 1.f - t, 2.f * t, 1.f };
+        pOutM[i] = {};
+        pOutV[i] = {};
+    }
+
+    float sink = 0;
+#ifdef DW_MATH_SIMD
+    LOG("[BENCH-MATH] Backend: SSE (scalar baselines are local copies of the non SIMD math.cpp)");
+#else
+    LOG("[BENCH-MATH] Backend: scalar (DW_MATH_SIMD disabled, both columns run scalar code)");
+#endif
+
+    MATH_BENCH_OP("matMul(m4f, m4f)", pOutM[i] = matMul(pA[i], pB[i]));
+    MATH_BENCH_OP("  scalar", pOutM[i] = scalarMatMul(pA[i], pB[i]));
+    MATH_BENCH_OP("matMul(m4f, v4f)", pOutV[i] = matMul(pA[i], pV[i]));
+    MATH_BENCH_OP("  scalar", pOutV[i] = scalarMatMul(pA[i], pV[i]));
+    MATH_BENCH_OP("inverse", pOutM[i] = inverse(pA[i]));
+    MATH_BENCH_OP("  scalar", pOutM[i] = scalarInverse(pA[i]));
+    MATH_BENCH_OP("transpose", pOutM[i] = transpose(pA[i]));
+    MATH_BENCH_OP("  scalar", pOutM[i] = scalarTranspose(pA[i]));
+    MATH_BENCH_OP("quatMul", pOutV[i] = quatMul(pQ[i], pV[i]));
+    MATH_BENCH_OP("  scalar", pOutV[i] = scalarQuatMul(pQ[i], pV[i]));
+    MATH_BENCH_OP("rotate", pOutV[i] = to4f(rotate(to3f(pV[i]), pQ[i]), 0));
+    MATH_BENCH_OP("  scalar", pOutV[i] = to4f(scalarRotate(to3f(pV[i]), pQ[i]), 0));
+
+    LOGF("[BENCH-MATH] (sink %f)", sink);
+    destroyArena(&arena);
+}
+
+void benchCullAABBs(App* pApp)
+{
+    ASSERT(pApp);
+
+    Arena arena = {};
+    initArena(GB(1), &arena);
+
+    m4f view = lookAtViewRH({0, 0, 0}, {0, 0, -1}, {0, 1, 0});
+    m4f proj = perspectiveRH(PI / 3, 16.f / 9.f, 0.1f, 1000.f);
+    Frustum f = frustum(matMul(proj, view));
+
+    const uint32 maxCount = 1000000;
+    AABB* boxes = (AABB*)arenaPush(&arena, maxCount * sizeof(AABB), alignof(AABB));
+    SoAAABBs soa = soaAABBs(&arena, maxCount);
+    uint32* visible = (uint32*)arenaPush(&arena, maxCount * sizeof(uint32), alignof(uint32));
+
+    // Boxes all around the camera, roughly 1/10 visible
+    for(uint32 i = 0; i < maxCount; i++)
+    {
+        v3f center = randomUniformV3F(-500.f, 500.f);
+        v3f extent = randomUniformV3F(0.5f, 4.f);
+        boxes[i].min = center - extent;
+        boxes[i].max = center + extent;
+    }
+    toSoA(boxes, maxCount, &soa);
+
+    for(uint32 count = 1000; count <= maxCount; count *= 10)
+    {
+        // Enough passes for ~10M box tests per measurement
+        uint32 passes = 10000000 / count;
+        Timer timer = createTimer(pApp);
+
+        uint64 loopVisible = 0;
+        startTimer(&timer);
+        for(uint32 pass = 0; pass < passes; pass++)
+        {
+            uint64 n = 0;
+            for(uint32 i = 0; i < count; i++)
+            {
+                visible[n] = i;
+                n += inFrustum(boxes[i], f);
+            }
+            loopVisible += n;
+        }
+        endTimer(&timer);
+        double loopNs = getNS(&timer) / ((double)passes * count);
+
+        uint64 batchVisible = 0;
+        startTimer(&timer);
+        for(uint32 pass = 0; pass < passes; pass++)
+        {
+            batchVisible += cullAABBs(soa.column<SOA_MIN_X>(), soa.column<SOA_MIN_Y>(), soa.column<SOA_MIN_Z>(),
+                    soa.column<SOA_MAX_X>(), soa.column<SOA_MAX_Y>(), soa.column<SOA_MAX_Z>(), count, f, visible);
+        }
+        endTimer(&timer);
+        double batchNs = getNS(&timer) / ((double)passes * count);
+        ASSERT(loopVisible == batchVisible);
+
+        LOGF("[BENCH-MATH] Cull %7u boxes (%5.1f%% visible): inFrustum %5.2f ns/box, cullAABBs %5.2f ns/box (x%.1f)",
+                count, 100.0 * batchVisible / ((double)passes * count), loopNs, batchNs, loopNs / batchNs);
+    }
+
+    destroyArena(&arena);
+}
+
+#define CULL_JOBS_GRAIN 16384
+
+struct CullJobsBench
+{
+    SoAAABBs*   pBoxes      = NULL;
+    Frustum     mFrustum    = {};
+    uint32*     pVisible    = NULL;     // Every range writes at its own offset
+    uint32*     pRangeCount = NULL;     // Visible count per range
+};
+
+void cullJobsBenchProc(uint32 begin, uint32 end, void* pData)
+{
+    CullJobsBench* pBench = (CullJobsBench*)pData;
+    SoAAABBs* pBoxes = pBench->pBoxes;
+    pBench->pRangeCount[begin / CULL_JOBS_GRAIN] = (uint32)cullAABBs(
+            pBoxes->column<SOA_MIN_X>() + begin, pBoxes->column<SOA_MIN_Y>() + begin, pBoxes->column<SOA_MIN_Z>() + begin,
+            pBoxes->column<SOA_MAX_X>() + begin, pBoxes->column<SOA_MAX_Y>() + begin, pBoxes->column<SOA_MAX_Z>() + begin,
+            end - begin, pBench->mFrustum, pBench->pVisible + begin);
+}
+
+// Frustum culling split across the job system, 1 thread up to all cores
+void benchCullJobs(App* pApp)
+{
+    ASSERT(pApp);
+
+    Arena arena = {};
+    initArena(GB(1), &arena);
+
+    m4f view = lookAtViewRH({0, 0, 0}, {0, 0, -1}, {0, 1, 0});
+    m4f proj = perspectiveRH(PI / 3, 16.f / 9.f, 0.1f, 1000.f);
+
+    const uint32 count = 4000000;
+    const uint32 passes = 20;
+    AABB* boxes = (AABB*)arenaPush(&arena, count * sizeof(AABB), alignof(AABB));
+    SoAAABBs soa = soaAABBs(&arena, count);
+    for(uint32 i = 0; i < count; i++)
+    {
+        v3f center = randomUniformV3F(-500.f, 500.f);
+        v3f extent = randomUniformV3F(0.5f, 4.f);
+        boxes[i].min = center - extent;
+        boxes[i].max = center + extent;
+    }
+    toSoA(boxes, count, &soa);
+
+    CullJobsBench bench = {};
+    bench.pBoxes = &soa;
+    bench.mFrustum = frustum(matMul(proj, view));
+    bench.pVisible = (uint32*)arenaPush(&arena, count * sizeof(uint32), alignof(uint32));
+    bench.pRangeCount = (uint32*)arenaPush(&arena, (count / CULL_JOBS_GRAIN + 1) * sizeof(uint32), alignof(uint32));
+
+    Timer timer = createTimer(pApp);
+    uint32 coreCount = getCoreCount();
+    double baseMs = 0.0;
+    uint64 baseVisible = 0;
+    for(uint32 threadCount = 1;; threadCount = MIN(threadCount * 2, coreCount))
+    {
+        JobSystem jobs = {};
+        initJobSystem(threadCount, &jobs);
+
+        uint64 visible = 0;
+        startTimer(&timer);
+        for(uint32 pass = 0; pass < passes; pass++)
+        {
+            parallelFor(&jobs, 0, count, CULL_JOBS_GRAIN, cullJobsBenchProc, &bench);
+            for(uint32 i = 0; i <= (count - 1) / CULL_JOBS_GRAIN; i++)
+            {
+                visible += bench.pRangeCount[i];
+            }
+        }
+        endTimer(&timer);
+        double ms = getMS(&timer) / passes;
+        if(threadCount == 1)
+        {
+            baseMs = ms;
+            baseVisible = visible;
+        }
+        ASSERT(visible == baseVisible);
+
+        LOGF("[BENCH-MATH] Cull jobs %7u boxes %2u threads: %6.2f ms (%.2fx)", count, threadCount, ms, baseMs / ms);
+
+        destroyJobSystem(&jobs);
+        if(threadCount == coreCount) break;
+    }
+
+    destroyArena(&arena);
+}
+
+void benchTransformAABBs(App* pApp)
+{
+    ASSERT(pApp);
+
+    Arena arena = {};
+    initArena(GB(1), &arena);
+
+    const uint32 count = 1000000;
+    AABB* src = (AABB*)arenaPush(&arena, count * sizeof(AABB), alignof(AABB));
+    m4f* transforms = (m4f*)arenaPush(&arena, count * sizeof(m4f), alignof(m4f));
+    AABB* dst = (AABB*)arenaPush(&arena, count * sizeof(AABB), alignof(AABB));
+    for(uint32 i = 0; i < count; i++)
+    {
+        v3f center = randomUniformV3F(-100.f, 100.f);
+        v3f extent = randomUniformV3F(0.f, 10.f);
+        src[i] = { center - extent, center + extent };
+        transforms[i] = matMul(translation(center), matMul(rotation(randomUniformF32(0.f, 6.28f), v3f{0, 1, 0}),
+                scale(randomUniformV3F(0.5f, 2.f))));
+    }
+
+    Timer timer = createTimer(pApp);
+    startTimer(&timer);
+    for(uint32 i = 0; i < count; i++) dst[i] = scalarTransformAABB(src[i], transforms[i]);
+    endTimer(&timer);
+    double cornersNs = getNS(&timer) / count;
+
+    startTimer(&timer);
+    for(uint32 i = 0; i < count; i++) dst[i] = transformAABB(src[i], transforms[i]);
+    endTimer(&timer);
+    double arvoNs = getNS(&timer) / count;
+    LOGF("[BENCH-MATH] transformAABB %u boxes: 8 corners %5.2f ns/box, Arvo %5.2f ns/box", count, cornersNs, arvoNs);
+
+    uint32 coreCount = getCoreCount();
+    for(uint32 threadCount = 1; threadCount <= coreCount; threadCount *= 2)
+    {
+        startTimer(&timer);
+        transformAABBs(src, transforms, count, dst, threadCount);
+        endTimer(&timer);
+        LOGF("[BENCH-MATH] transformAABBs %u boxes, %2u threads: %6.2f ms", count, threadCount, getMS(&timer));
+    }
+
+    destroyArena(&arena);
+}
+
+void benchBvh(App* pApp)
+{
+    ASSERT(pApp);
+
+    Arena arena = {};
+    initArena(GB(4), &arena);
+
+    const uint32 maxCount = 1000000;
+    AABB* boxes = (AABB*)arenaPush(&arena, maxCount * sizeof(AABB), alignof(AABB));
+    SoAAABBs soa = soaAABBs(&arena, maxCount);
+    uint32* results = (uint32*)arenaPush(&arena, maxCount * sizeof(uint32), alignof(uint32));
+
+    m4f view = lookAtViewRH({0, 0, 0}, {0, 0, -1}, {0, 1, 0});
+    m4f proj = perspectiveRH(PI / 3, 16.f / 9.f, 0.1f, 1000.f);
+    Frustum f = frustum(matMul(proj, view));
+    uint32 coreCount = getCoreCount();
+
+    for(uint32 count = 10000; count <= maxCount; count *= 10)
+    {
+        // Same density at every size, so query results scale with the count
+        float side = 500.f * cbrtf((float)count / maxCount);
+        for(uint32 i = 0; i < count; i++)
+        {
+            v3f center = randomUniformV3F(-side, side);
+            v3f extent = randomUniformV3F(0.5f, 4.f);
+            boxes[i] = { center - extent, center + extent };
+        }
+        soa.clear();
+        toSoA(boxes, count, &soa);
+
+        ARENA_SCOPE(&arena);
+        Timer timer = createTimer(pApp);
+        Bvh bvh = {};
+        for(uint32 threadCount = 1; threadCount <= coreCount; threadCount *= 2)
+        {
+            ARENA_SCOPE(&arena);
+            startTimer(&timer);
+            buildBvh(boxes, count, &arena, &bvh, threadCount);
+            endTimer(&timer);
+            LOGF("[BENCH-MATH] BVH %7u boxes: build %2u threads %8.2f ms (%u nodes)",
+                    count, threadCount, getMS(&timer), bvh.mNodeCount);
+        }
+        buildBvh(boxes, count, &arena, &bvh);
+
+        startTimer(&timer);
+        refitBvh(&bvh, boxes);
+        endTimer(&timer);
+        LOGF("[BENCH-MATH] BVH %7u boxes: refit %8.2f ms", count, getMS(&timer));
+
+        const uint32 cullPasses = 20;
+        uint64 bvhVisible = 0;
+        startTimer(&timer);
+        for(uint32 pass = 0; pass < cullPasses; pass++) bvhVisible += bvhCullFrustum(&bvh, f, results);
+        endTimer(&timer);
+        double bvhMs = getMS(&timer) / cullPasses;
+
+        uint64 linearVisible = 0;
+        startTimer(&timer);
+        for(uint32 pass = 0; pass < cullPasses; pass++) linearVisible += cullAABBs(&soa, f, results);
+        endTimer(&timer);
+        double linearMs = getMS(&timer) / cullPasses;
+        ASSERT(bvhVisible == linearVisible);
+        LOGF("[BENCH-MATH] BVH %7u boxes: frustum %6.3f ms, cullAABBs %6.3f ms (%llu visible)",
+                count, bvhMs, linearMs, (unsigned long long)(bvhVisible / cullPasses));
+
+        const uint32 rayCount = 100000;
+        uint32 hits = 0;
+        startTimer(&timer);
+        for(uint32 r = 0; r < rayCount; r++)
+        {
+            BvhHit hit = {};
+            v3f dir = normalize(randomUniformV3F(-1.f, 1.f) + v3f{0.001f, 0, 0});
+            hits += bvhRaycast(&bvh, randomUniformV3F(-side, side), dir, 2.f * side, &hit);
+        }
+        endTimer(&timer);
+        LOGF("[BENCH-MATH] BVH %7u boxes: raycast %6.2f Mrays/s (%.0f%% hit)",
+                count, rayCount / (getMS(&timer) * 1e3), 100.0 * hits / rayCount);
+
+        const uint32 queryCount = 100000;
+        uint64 overlapCount = 0;
+        startTimer(&timer);
+        for(uint32 q = 0; q < queryCount; q++)
+        {
+            v3f center = randomUniformV3F(-side, side);
+            overlapCount += bvhOverlap(&bvh, AABB{ center - v3f{5, 5, 5}, center + v3f{5, 5, 5} }, results);
+        }
+        endTimer(&timer);
+        LOGF("[BENCH-MATH] BVH %7u boxes: overlap %6.2f Mqueries/s (%.1f overlaps/query)",
+                count, queryCount / (getMS(&timer) * 1e3), (double)overlapCount / queryCount);
+    }
+
+    destroyArena(&arena);
+}
+
+void benchMath(App* pApp)
+{
+    ASSERT(pApp);
+    LOG("[BENCH-MATH] Benchmarking math operations...");
+    benchMathOps(pApp);
+
+    LOG("[BENCH-MATH] Benchmarking batch frustum culling...");
+    benchCullAABBs(pApp);
+
+    LOG("[BENCH-MATH] Benchmarking frustum culling on the job system...");
+    benchCullJobs(pApp);
+
+    LOG("[BENCH-MATH] Benchmarking AABB transforms...");
+    benchTransformAABBs(pApp);
+
+    LOG("[BENCH-MATH] Benchmarking BVH...");
+    benchBvh(pApp);
+
+    LOG("[BENCH-MATH] All math benchmarks done.");
+}
@@ -0,0 +1,666 @@
+#include "bvh.hpp"
+#include "../core/debug.hpp"
+#include "../core/thread.hpp"
+
+#define BVH_PARALLEL_MIN    4096    // Smallest subtree built on its own thread
+
+// Build bounds, padded to v4f so they grow with SIMD min/max
+struct BvhBounds
+{
+    v4f mMin = { MAX_FLOAT, MAX_FLOAT, MAX_FLOAT, 0 };
+    v4f mMax = { -MAX_FLOAT, -MAX_FLOAT, -MAX_FLOAT, 0 };
+};
+
+inline void bvhGrow(BvhBounds* pBounds, v4f min, v4f max)
+{
+#ifdef DW_MATH_SIMD
+    pBounds->mMin = simdStore(_mm_min_ps(simdLoad(pBounds->mMin), simdLoad(min)));
+    pBounds->mMax = simdStore(_mm_max_ps(simdLoad(pBounds->mMax), simdLoad(max)));
+#else
+    for(uint32 i = 0; i < 3; i++)
+    {
+        pBounds->mMin.mData[i] = MIN(pBounds->mMin.mData[i], min.mData[i]);
+        pBounds->mMax.mData[i] = MAX(pBounds->mMax.mData[i], max.mData[i]);
+    }
+#endif
+}
+
+inline float bvhHalfArea(const BvhBounds* pBounds)
+{
+    v4f size = pBounds->mMax - pBounds->mMin;
+    return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+inline AABB bvhToAABB(const BvhBounds* pBounds)
+{
+    return { to3f(pBounds->mMin), to3f(pBounds->mMax) };
+}
+
+// Kept in partition order rather than indexed, so every pass over a node's range is linear in memory
+struct BvhPrim
+{
+    v4f mMin;
+    v4f mMax;
+    v4f mCentroid;
+};
+
+// Binary build tree, children of a node are mLeft and mLeft + 1
+struct BvhBuildNode
+{
+    BvhBounds   mBounds = {};
+    uint32      mLeft   = 0;
+    uint32      mFirst  = 0;
+    uint32      mCount  = 0;
+    bool        mLeaf   = false;
+};
+
+struct BvhBuilder
+{
+    BvhPrim*        pPrims      = NULL;     // Partitioned in place with pIndices, every node owns a contiguous range
+    uint32*         pIndices    = NULL;
+    BvhBuildNode*   pNodes      = NULL;
+    uint32          mNodeCount  = 0;        // Atomic, nodes are allocated from every build thread
+    uint32          mSpawnDepth = 0;        // Nodes above this depth build their right child on a new thread
+};
+
+struct BvhBuildTask
+{
+    Thread          mThread     = {};
+    BvhBuilder*     pBuilder    = NULL;
+    uint32          mNode       = 0;
+    uint32          mDepth      = 0;
+};
+
+struct BvhBin
+{
+    BvhBounds   mBounds = {};
+    uint32      mCount  = 0;
+};
+
+inline uint32 bvhBinIndex(float centroid, float min, float scale)
+{
+    int32 bin = (int32)((centroid - min) * scale);
+    return (uint32)CLAMP(bin, 0, BVH_BINS - 1);
+}
+
+// Partitions the node's primitives along the cheapest binned SAH split.
+// Returns the index of the first primitive of the right child, or 0 for a leaf.
+uint32 bvhSplit(BvhBuilder* pBuilder, BvhBuildNode* pNode, const BvhBounds* pCentroidBounds)
+{
+    uint32 first = pNode->mFirst;
+    uint32 count = pNode->mCount;
+    if(count <= BVH_LEAF_MAX) return 0;
+
+    // Binning along the 3 axes in a single pass over the primitives
+    BvhBin bins[3][BVH_BINS];
+    float mins[3];
+    float scales[3];
+    for(uint32 axis = 0; axis < 3; axis++)
+    {
+        mins[axis] = pCentroidBounds->mMin.mData[axis];
+        float extent = pCentroidBounds->mMax.mData[axis] - mins[axis];
+        scales[axis] = extent > 0.f ? BVH_BINS / extent : 0.f;
+    }
+    for(uint32 i = first; i < first + count; i++)
+    {
+        BvhPrim* pPrim = &pBuilder->pPrims[i];
+        for(uint32 axis = 0; axis < 3; axis++)
+        {
+            BvhBin* pBin = &bins[axis][bvhBinIndex(pPrim->mCentroid.mData[axis], mins[axis], scales[axis])];
+            bvhGrow(&pBin->mBounds, pPrim->mMin, pPrim->mMax);
+            pBin->mCount++;
+        }
+    }
+
+    float bestCost = MAX_FLOAT;
+    uint32 bestAxis = 0;
+    uint32 bestBin = 0;
+    for(uint32 axis = 0; axis < 3; axis++)
+    {
+        if(scales[axis] == 0.f) continue;
+
+        // Sweeping from both ends, split s puts bins [0, s) on the left
+        float leftArea[BVH_BINS] = {};
+        uint32 leftCount[BVH_BINS];
+        BvhBounds bounds = {};
+        uint32 sum = 0;
+        for(uint32 s = 1; s < BVH_BINS; s++)
+        {
+            BvhBin* pBin = &bins[axis][s - 1];
+            if(pBin->mCount)
+            {
+                bvhGrow(&bounds, pBin->mBounds.mMin, pBin->mBounds.mMax);
+                sum += pBin->mCount;
+                leftArea[s] = bvhHalfArea(&bounds);
+            }
+            else
+            {
+                leftArea[s] = leftArea[s - 1];
+            }
+            leftCount[s] = sum;
+        }
+        bounds = {};
+        sum = 0;
+        for(uint32 s = BVH_BINS - 1; s > 0; s--)
+        {
+            // Splits between empty bins are the same as their neighbours
+            BvhBin* pBin = &bins[axis][s];
+            if(!pBin->mCount) continue;
+            bvhGrow(&bounds, pBin->mBounds.mMin, pBin->mBounds.mMax);
+            sum += pBin->mCount;
+            if(!leftCount[s]) continue;
+            float cost = leftArea[s] * leftCount[s] + bvhHalfArea(&bounds) * sum;
+            if(cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = s;
+            }
+        }
+    }
+
+    if(bestCost == MAX_FLOAT)
+    {
+        // All centroids in the same spot, any split is as good as another
+        return first + count / 2;
+    }
+
+    uint32 i = first;
+    uint32 j = first + count;
+    while(i < j)
+    {
+        if(bvhBinIndex(pBuilder->pPrims[i].mCentroid.mData[bestAxis], mins[bestAxis], scales[bestAxis]) < bestBin)
+        {
+            i++;
+        }
+        else
+        {
+            j--;
+            BvhPrim prim = pBuilder->pPrims[i];
+            pBuilder->pPrims[i] = pBuilder->pPrims[j];
+            pBuilder->pPrims[j] = prim;
+            uint32 index = pBuilder->pIndices[i];
+            pBuilder->pIndices[i] = pBuilder->pIndices[j];
+            pBuilder->pIndices[j] = index;
+        }
+    }
+    ASSERT(i > first && i < first + count);
+    return i;
+}
+
+void bvhBuildNode(BvhBuilder* pBuilder, uint32 nodeIndex, uint32 depth);
+
+void bvhBuildTaskProc(void* pData)
+{
+    BvhBuildTask* pTask = (BvhBuildTask*)pData;
+    bvhBuildNode(pTask->pBuilder, pTask->mNode, pTask->mDepth);
+}
+
+void bvhBuildNode(BvhBuilder* pBuilder, uint32 nodeIndex, uint32 depth)
+{
+    BvhBuildNode* pNode = &pBuilder->pNodes[nodeIndex];
+    BvhBounds bounds = {};
+    BvhBounds centroidBounds = {};
+    for(uint32 i = pNode->mFirst; i < pNode->mFirst + pNode->mCount; i++)
+    {
+        BvhPrim* pPrim = &pBuilder->pPrims[i];
+        bvhGrow(&bounds, pPrim->mMin, pPrim->mMax);
+        bvhGrow(&centroidBounds, pPrim->mCentroid, pPrim->mCentroid);
+    }
+    pNode->mBounds = bounds;
+
+    uint32 split = bvhSplit(pBuilder, pNode, &centroidBounds);
+    if(!split)
+    {
+        pNode->mLeaf = true;
+        return;
+    }
+
+    uint32 left = atomicAdd(&pBuilder->mNodeCount, 2u);
+    pNode->mLeft = left;
+    BvhBuildNode* pLeft = &pBuilder->pNodes[left];
+    BvhBuildNode* pRight = &pBuilder->pNodes[left + 1];
+    *pLeft = {};
+    *pRight = {};
+    pLeft->mFirst = pNode->mFirst;
+    pLeft->mCount = split - pNode->mFirst;
+    pRight->mFirst = split;
+    pRight->mCount = pNode->mCount - pLeft->mCount;
+
+    if(depth < pBuilder->mSpawnDepth && pRight->mCount >= BVH_PARALLEL_MIN)
+    {
+        BvhBuildTask task = {};
+        task.pBuilder = pBuilder;
+        task.mNode = left + 1;
+        task.mDepth = depth + 1;
+        createThread(bvhBuildTaskProc, &task, &task.mThread);
+        bvhBuildNode(pBuilder, left, depth + 1);
+        joinThread(&task.mThread);
+    }
+    else
+    {
+        bvhBuildNode(pBuilder, left, depth + 1);
+        bvhBuildNode(pBuilder, left + 1, depth + 1);
+    }
+}
+
+void bvhSetChild(BvhNode* pNode, uint32 slot, AABB bounds, uint32 child, uint32 first, uint32 count)
+{
+    pNode->mMinX[slot] = bounds.min.x;
+    pNode->mMinY[slot] = bounds.min.y;
+    pNode->mMinZ[slot] = bounds.min.z;
+    pNode->mMaxX[slot] = bounds.max.x;
+    pNode->mMaxY[slot] = bounds.max.y;
+    pNode->mMaxZ[slot] = bounds.max.z;
+    pNode->mChild[slot] = child;
+    pNode->mFirst[slot] = first;
+    pNode->mCount[slot] = count;
+}
+
+// Collapses the binary subtree under a (non leaf) build node into 4-wide nodes,
+// returns the index of the new node.
+uint32 bvhCollapse(BvhBuilder* pBuilder, uint32 buildIndex, BvhNode* pNodes, uint32* pNodeCount)
+{
+    // Opening the largest inner child until the node is full
+    uint32 slots[BVH_WIDTH];
+    uint32 slotCount = 2;
+    slots[0] = pBuilder->pNodes[buildIndex].mLeft;
+    slots[1] = slots[0] + 1;
+    while(slotCount < BVH_WIDTH)
+    {
+        int32 open = -1;
+        float openArea = -1.f;
+        for(uint32 i = 0; i < slotCount; i++)
+        {
+            BvhBuildNode* pChild = &pBuilder->pNodes[slots[i]];
+            float area = bvhHalfArea(&pChild->mBounds);
+            if(!pChild->mLeaf && area > openArea)
+            {
+                open = (int32)i;
+                openArea = area;
+            }
+        }
+        if(open < 0) break;
+        uint32 left = pBuilder->pNodes[slots[open]].mLeft;
+        slots[open] = left;
+        slots[slotCount++] = left + 1;
+    }
+
+    uint32 nodeIndex = (*pNodeCount)++;
+    BvhNode* pNode = &pNodes[nodeIndex];
+    *pNode = {};
+    for(uint32 i = 0; i < BVH_WIDTH; i++)
+    {
+        bvhSetChild(pNode, i, emptyAABB(), BVH_CHILD_EMPTY, 0, 0);
+    }
+    for(uint32 i = 0; i < slotCount; i++)
+    {
+        BvhBuildNode* pChild = &pBuilder->pNodes[slots[i]];
+        uint32 child = pChild->mLeaf ? BVH_CHILD_LEAF : bvhCollapse(pBuilder, slots[i], pNodes, pNodeCount);
+        bvhSetChild(pNode, i, bvhToAABB(&pChild->mBounds), child, pChild->mFirst, pChild->mCount);
+    }
+    return nodeIndex;
+}
+
+void buildBvh(const AABB* pBoxes, uint32 count, Arena* pArena, Bvh* pBvh, uint32 threadCount)
+{
+    ASSERT(pArena && pBvh);
+    ASSERT(pBoxes || !count);
+    ASSERT(threadCount > 0);
+
+    *pBvh = {};
+    pBvh->mPrimCount = count;
+    if(!count) return;
+
+    ScratchScope scratch(pArena);
+    BvhBuilder builder = {};
+    builder.pPrims = (BvhPrim*)arenaPush(scratch.pArena, count * sizeof(BvhPrim), alignof(BvhPrim));
+    builder.pIndices = (uint32*)arenaPush(scratch.pArena, count * sizeof(uint32), alignof(uint32));
+    builder.pNodes = (BvhBuildNode*)arenaPush(scratch.pArena, 2 * count * sizeof(BvhBuildNode), alignof(BvhBuildNode));
+    for(uint32 i = 0; i < count; i++)
+    {
+        BvhPrim* pPrim = &builder.pPrims[i];
+        pPrim->mMin = to4f(pBoxes[i].min, 0.f);
+        pPrim->mMax = to4f(pBoxes[i].max, 0.f);
+        pPrim->mCentroid = (pPrim->mMin + pPrim->mMax) * 0.5f;
+        builder.pIndices[i] = i;
+    }
+    while((1u << builder.mSpawnDepth) < threadCount)
+    {
+        builder.mSpawnDepth++;
+    }
+
+    builder.pNodes[0] = {};
+    builder.pNodes[0].mCount = count;
+    builder.mNodeCount = 1;
+    bvhBuildNode(&builder, 0, 0);
+
+    // Every 4-wide node replaces at least one binary inner node
+    uint32 maxNodes = MAX(1u, builder.mNodeCount / 2);
+    BvhNode* pNodes = (BvhNode*)arenaPush(scratch.pArena, maxNodes * sizeof(BvhNode), alignof(BvhNode));
+    uint32 nodeCount = 0;
+    BvhBuildNode* pRoot = &builder.pNodes[0];
+    if(pRoot->mLeaf)
+    {
+        pNodes[0] = {};
+        for(uint32 i = 0; i < BVH_WIDTH; i++)
+        {
+            bvhSetChild(&pNodes[0], i, emptyAABB(), BVH_CHILD_EMPTY, 0, 0);
+        }
+        bvhSetChild(&pNodes[0], 0, bvhToAABB(&pRoot->mBounds), BVH_CHILD_LEAF, 0, count);
+        nodeCount = 1;
+    }
+    else
+    {
+        bvhCollapse(&builder, 0, pNodes, &nodeCount);
+    }
+    ASSERT(nodeCount <= maxNodes);
+
+    pBvh->mNodeCount = nodeCount;
+    pBvh->pNodes = (BvhNode*)arenaPush(pArena, nodeCount * sizeof(BvhNode), alignof(BvhNode));
+    memcpy(pBvh->pNodes, pNodes, nodeCount * sizeof(BvhNode));
+    pBvh->pPrimIndices = (uint32*)arenaPush(pArena, count * sizeof(uint32), alignof(uint32));
+    memcpy(pBvh->pPrimIndices, builder.pIndices, count * sizeof(uint32));
+    pBvh->pPrimBoxes = (AABB*)arenaPush(pArena, count * sizeof(AABB), alignof(AABB));
+    for(uint32 i = 0; i < count; i++)
+    {
+        pBvh->pPrimBoxes[i] = pBoxes[pBvh->pPrimIndices[i]];
+    }
+}
+
+void refitBvh(Bvh* pBvh, const AABB* pBoxes)
+{
+    ASSERT(pBvh);
+    ASSERT(pBoxes || !pBvh->mPrimCount);
+    for(uint32 i = 0; i < pBvh->mPrimCount; i++)
+    {
+        pBvh->pPrimBoxes[i] = pBoxes[pBvh->pPrimIndices[i]];
+    }
+
+    // Children come after their parent, so walking backwards refits them first
+    for(uint32 n = pBvh->mNodeCount; n-- > 0;)
+    {
+        BvhNode* pNode = &pBvh->pNodes[n];
+        for(uint32 i = 0; i < BVH_WIDTH; i++)
+        {
+            AABB bounds = emptyAABB();
+            if(pNode->mChild[i] == BVH_CHILD_EMPTY) continue;
+            if(pNode->mChild[i] == BVH_CHILD_LEAF)
+            {
+                for(uint32 p = pNode->mFirst[i]; p < pNode->mFirst[i] + pNode->mCount[i]; p++)
+                {
+                    bounds = merge(bounds, pBvh->pPrimBoxes[p]);
+                }
+            }
+            else
+            {
+                BvhNode* pChild = &pBvh->pNodes[pNode->mChild[i]];
+                for(uint32 c = 0; c < BVH_WIDTH; c++)
+                {
+                    if(pChild->mChild[c] == BVH_CHILD_EMPTY) continue;
+                    bounds = merge(bounds, AABB{ {pChild->mMinX[c], pChild->mMinY[c], pChild->mMinZ[c]},
+                                                 {pChild->mMaxX[c], pChild->mMaxY[c], pChild->mMaxZ[c]} });
+                }
+            }
+            bvhSetChild(pNode, i, bounds, pNode->mChild[i], pNode->mFirst[i], pNode->mCount[i]);
+        }
+    }
+}
+
+// Node tests, each returns a bitmask of the children that pass.
+
+// Children not fully outside the frustum, pInside gets the ones fully inside it.
+uint32 bvhTestFrustum(const BvhNode* pNode, const Frustum* pF, uint32* pInside)
+{
+#ifdef DW_MATH_SIMD
+    __m128 outside = _mm_setzero_ps();
+    __m128 partial = _mm_setzero_ps();
+    for(uint32 p = 0; p < 6; p++)
+    {
+        // Corners furthest along (p) and against (n) the plane normal, see inFrustum
+        plane pl = pF->planes[p];
+        __m128 nx = _mm_set1_ps(pl.x);
+        __m128 ny = _mm_set1_ps(pl.y);
+        __m128 nz = _mm_set1_ps(pl.z);
+        __m128 d = _mm_set1_ps(pl.w);
+        __m128 px = _mm_load_ps(pl.x < 0.f ? pNode->mMinX : pNode->mMaxX);
+        __m128 py = _mm_load_ps(pl.y < 0.f ? pNode->mMinY : pNode->mMaxY);
+        __m128 pz = _mm_load_ps(pl.z < 0.f ? pNode->mMinZ : pNode->mMaxZ);
+        __m128 qx = _mm_load_ps(pl.x < 0.f ? pNode->mMaxX : pNode->mMinX);
+        __m128 qy = _mm_load_ps(pl.y < 0.f ? pNode->mMaxY : pNode->mMinY);
+        __m128 qz = _mm_load_ps(pl.z < 0.f ? pNode->mMaxZ : pNode->mMinZ);
+        __m128 pDist = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px, nx), _mm_mul_ps(py, ny)), _mm_mul_ps(pz, nz)), d);
+        __m128 qDist = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, nx), _mm_mul_ps(qy, ny)), _mm_mul_ps(qz, nz)), d);
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(pDist, _mm_setzero_ps()));
+        partial = _mm_or_ps(partial, _mm_cmplt_ps(qDist, _mm_setzero_ps()));
+    }
+    uint32 visible = ~(uint32)_mm_movemask_ps(outside) & 0xF;
+    *pInside = visible & ~(uint32)_mm_movemask_ps(partial);
+    return visible;
+#else
+    uint32 visible = 0;
+    uint32 inside = 0;
+    for(uint32 i = 0; i < BVH_WIDTH; i++)
+    {
+        bool out = false;
+        bool in = true;
+        for(uint32 p = 0; p < 6 && !out; p++)
+        {
+            plane pl = pF->planes[p];
+            float pDist = (pl.x < 0.f ? pNode->mMinX[i] : pNode->mMaxX[i]) * pl.x
+                        + (pl.y < 0.f ? pNode->mMinY[i] : pNode->mMaxY[i]) * pl.y
+                        + (pl.z < 0.f ? pNode->mMinZ[i] : pNode->mMaxZ[i]) * pl.z + pl.w;
+            float qDist = (pl.x < 0.f ? pNode->mMaxX[i] : pNode->mMinX[i]) * pl.x
+                        + (pl.y < 0.f ? pNode->mMaxY[i] : pNode->mMinY[i]) * pl.y
+                        + (pl.z < 0.f ? pNode->mMaxZ[i] : pNode->mMinZ[i]) * pl.z + pl.w;
+            out = pDist < 0.f;
+            in = in && !(qDist < 0.f);
+        }
+        if(out) continue;
+        visible |= 1u << i;
+        if(in) inside |= 1u << i;
+    }
+    *pInside = inside;
+    return visible;
+#endif
+}
+
+uint32 bvhTestOverlap(const BvhNode* pNode, AABB aabb)
+{
+#ifdef DW_MATH_SIMD
+    __m128 hit = _mm_and_ps(
+            _mm_and_ps(_mm_cmple_ps(_mm_load_ps(pNode->mMinX), _mm_set1_ps(aabb.max.x)),
+                       _mm_cmpge_ps(_mm_load_ps(pNode->mMaxX), _mm_set1_ps(aabb.min.x))),
+            _mm_and_ps(_mm_cmple_ps(_mm_load_ps(pNode->mMinY), _mm_set1_ps(aabb.max.y)),
+                       _mm_cmpge_ps(_mm_load_ps(pNode->mMaxY), _mm_set1_ps(aabb.min.y))));
+    hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmple_ps(_mm_load_ps(pNode->mMinZ), _mm_set1_ps(aabb.max.z)),
+                                     _mm_cmpge_ps(_mm_load_ps(pNode->mMaxZ), _mm_set1_ps(aabb.min.z))));
+    return (uint32)_mm_movemask_ps(hit);
+#else
+    uint32 result = 0;
+    for(uint32 i = 0; i < BVH_WIDTH; i++)
+    {
+        AABB child = { {pNode->mMinX[i], pNode->mMinY[i], pNode->mMinZ[i]},
+                       {pNode->mMaxX[i], pNode->mMaxY[i], pNode->mMaxZ[i]} };
+        if(overlaps(child, aabb)) result |= 1u << i;
+    }
+    return result;
+#endif
+}
+
+// Children hit by the ray within [0, maxT], pTs gets their entry distances.
+uint32 bvhTestRay(const BvhNode* pNode, v3f origin, v3f invDir, float maxT, float* pTs)
+{
+#ifdef DW_MATH_SIMD
+    __m128 tMin = _mm_setzero_ps();
+    __m128 tMax = _mm_set1_ps(maxT);
+    const float* mins[3] = { pNode->mMinX, pNode->mMinY, pNode->mMinZ };
+    const float* maxs[3] = { pNode->mMaxX, pNode->mMaxY, pNode->mMaxZ };
+    for(uint32 axis = 0; axis < 3; axis++)
+    {
+        __m128 o = _mm_set1_ps(origin.mData[axis]);
+        __m128 inv = _mm_set1_ps(invDir.mData[axis]);
+        __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(mins[axis]), o), inv);
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(maxs[axis]), o), inv);
+        tMin = _mm_max_ps(tMin, _mm_min_ps(t0, t1));
+        tMax = _mm_min_ps(tMax, _mm_max_ps(t0, t1));
+    }
+    _mm_storeu_ps(pTs, tMin);
+    return (uint32)_mm_movemask_ps(_mm_cmple_ps(tMin, tMax));
+#else
+    uint32 result = 0;
+    for(uint32 i = 0; i < BVH_WIDTH; i++)
+    {
+        AABB child = { {pNode->mMinX[i], pNode->mMinY[i], pNode->mMinZ[i]},
+                       {pNode->mMaxX[i], pNode->mMaxY[i], pNode->mMaxZ[i]} };
+        if(intersectRay(child, origin, invDir, maxT, &pTs[i])) result |= 1u << i;
+    }
+    return result;
+#endif
+}
+
+uint32 bvhCullFrustum(Bvh* pBvh, Frustum f, uint32* pVisible)
+{
+    ASSERT(pBvh);
+    ASSERT(pVisible || !pBvh->mPrimCount);
+    if(!pBvh->mNodeCount) return 0;
+
+    uint32 visibleCount = 0;
+    uint32 stack[BVH_STACK_SIZE];
+    uint32 stackSize = 0;
+    stack[stackSize++] = 0;
+    while(stackSize)
+    {
+        const BvhNode* pNode = &pBvh->pNodes[stack[--stackSize]];
+        uint32 inside = 0;
+        uint32 visible = bvhTestFrustum(pNode, &f, &inside);
+        for(uint32 i = 0; i < BVH_WIDTH; i++)
+        {
+            uint32 child = pNode->mChild[i];
+            if(!(visible & (1u << i)) || child == BVH_CHILD_EMPTY) continue;
+
+            if(inside & (1u << i))
+            {
+                // Whole subtree visible
+                memcpy(pVisible + visibleCount, pBvh->pPrimIndices + pNode->mFirst[i], pNode->mCount[i] * sizeof(uint32));
+                visibleCount += pNode->mCount[i];
+            }
+            else if(child == BVH_CHILD_LEAF)
+            {
+                for(uint32 p = pNode->mFirst[i]; p < pNode->mFirst[i] + pNode->mCount[i]; p++)
+                {
+                    if(inFrustum(pBvh->pPrimBoxes[p], f)) pVisible[visibleCount++] = pBvh->pPrimIndices[p];
+                }
+            }
+            else
+            {
+                ASSERT(stackSize < BVH_STACK_SIZE);
+                stack[stackSize++] = child;
+            }
+        }
+    }
+    return visibleCount;
+}
+
+uint32 bvhOverlap(Bvh* pBvh, AABB aabb, uint32* pOverlaps)
+{
+    ASSERT(pBvh);
+    ASSERT(pOverlaps || !pBvh->mPrimCount);
+    if(!pBvh->mNodeCount) return 0;
+
+    uint32 overlapCount = 0;
+    uint32 stack[BVH_STACK_SIZE];
+    uint32 stackSize = 0;
+    stack[stackSize++] = 0;
+    while(stackSize)
+    {
+        const BvhNode* pNode = &pBvh->pNodes[stack[--stackSize]];
+        uint32 hit = bvhTestOverlap(pNode, aabb);
+        for(uint32 i = 0; i < BVH_WIDTH; i++)
+        {
+            uint32 child = pNode->mChild[i];
+            if(!(hit & (1u << i)) || child == BVH_CHILD_EMPTY) continue;
+
+            if(child == BVH_CHILD_LEAF)
+            {
+                for(uint32 p = pNode->mFirst[i]; p < pNode->mFirst[i] + pNode->mCount[i]; p++)
+                {
+                    if(overlaps(pBvh->pPrimBoxes[p], aabb)) pOverlaps[overlapCount++] = pBvh->pPrimIndices[p];
+                }
+            }
+            else
+            {
+                ASSERT(stackSize < BVH_STACK_SIZE);
+                stack[stackSize++] = child;
+            }
+        }
+    }
+    return overlapCount;
+}
+
+bool bvhRaycast(Bvh* pBvh, v3f origin, v3f dir, float maxT, BvhHit* pHit)
+{
+    ASSERT(pBvh && pHit);
+    *pHit = {};
+    if(!pBvh->mNodeCount) return false;
+
+    v3f invDir = { 1.f / dir.x, 1.f / dir.y, 1.f / dir.z };
+    float closest = maxT;
+
+    struct Entry
+    {
+        uint32  mNode;
+        float   mT;
+    };
+    Entry stack[BVH_STACK_SIZE];
+    uint32 stackSize = 0;
+    stack[stackSize++] = { 0, 0.f };
+    while(stackSize)
+    {
+        Entry entry = stack[--stackSize];
+        if(entry.mT > closest) continue;     // A closer hit was found since this was pushed
+
+        const BvhNode* pNode = &pBvh->pNodes[entry.mNode];
+        float ts[BVH_WIDTH];
+        uint32 hit = bvhTestRay(pNode, origin, invDir, closest, ts);
+
+        // Leaves are tested right away, inner children are pushed far to near
+        Entry inner[BVH_WIDTH];
+        uint32 innerCount = 0;
+        for(uint32 i = 0; i < BVH_WIDTH; i++)
+        {
+            uint32 child = pNode->mChild[i];
+            if(!(hit & (1u << i)) || child == BVH_CHILD_EMPTY) continue;
+
+            if(child == BVH_CHILD_LEAF)
+            {
+                for(uint32 p = pNode->mFirst[i]; p < pNode->mFirst[i] + pNode->mCount[i]; p++)
+                {
+                    float t = 0.f;
+                    if(intersectRay(pBvh->pPrimBoxes[p], origin, invDir, closest, &t) && t < pHit->mT)
+                    {
+                        closest = t;
+                        pHit->mT = t;
+                        pHit->mIndex = pBvh->pPrimIndices[p];
+                    }
+                }
+            }
+            else
+            {
+                uint32 j = innerCount++;
+                for(; j > 0 && inner[j - 1].mT < ts[i]; j--)
+                {
+                    inner[j] = inner[j - 1];
+                }
+                inner[j] = { child, ts[i] };
+            }
+        }
+
+        ASSERT(stackSize + innerCount <= BVH_STACK_SIZE);
+        for(uint32 i = 0; i < innerCount; i++)
+        {
+            stack[stackSize++] = inner[i];
+        }
+    }
+    return pHit->mIndex != MAX_UINT32;
+}
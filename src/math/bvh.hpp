@@ -0,0 +1,65 @@
+#pragma once
+#include "math.hpp"
+#include "volumes.hpp"
+#include "../core/memory.hpp"
+
+// Bounding volume hierarchy
+// 4-wide BVH over AABBs. Built top-down with binned SAH into a binary tree (the
+// top levels split across threads), which is then collapsed into nodes holding
+// the bounds of 4 children in SoA layout, so one SIMD op tests all the children
+// against a plane or slab. Nodes are stored depth first in one array, children
+// always after their parent. Every subtree owns a contiguous range of primitives
+// (in leaf order), so fully visible subtrees are emitted without further tests.
+//
+//  Bvh bvh = {};
+//  buildBvh(boxes, boxCount, pArena, &bvh, getCoreCount());
+//  uint32 visibleCount = bvhCullFrustum(&bvh, frustum(vp), pVisible);
+#define BVH_WIDTH       4
+#define BVH_BINS        16
+#define BVH_LEAF_MAX    4       // Max primitives per leaf
+#define BVH_STACK_SIZE  256
+
+#define BVH_CHILD_LEAF  (MAX_UINT32 - 1)
+#define BVH_CHILD_EMPTY MAX_UINT32
+
+struct alignas(16) BvhNode
+{
+    // Child bounds, inverted for empty slots
+    float   mMinX[BVH_WIDTH]    = {};
+    float   mMinY[BVH_WIDTH]    = {};
+    float   mMinZ[BVH_WIDTH]    = {};
+    float   mMaxX[BVH_WIDTH]    = {};
+    float   mMaxY[BVH_WIDTH]    = {};
+    float   mMaxZ[BVH_WIDTH]    = {};
+
+    uint32  mChild[BVH_WIDTH]   = {};   // Child node index, BVH_CHILD_LEAF or BVH_CHILD_EMPTY
+    uint32  mFirst[BVH_WIDTH]   = {};   // First primitive of the child's subtree (leaf order)
+    uint32  mCount[BVH_WIDTH]   = {};   // Primitives in the child's subtree
+};
+
+struct Bvh
+{
+    BvhNode*    pNodes          = NULL;
+    uint32*     pPrimIndices    = NULL;     // Leaf order to primitive index
+    AABB*       pPrimBoxes      = NULL;     // Primitive bounds, in leaf order
+    uint32      mNodeCount      = 0;
+    uint32      mPrimCount      = 0;
+};
+
+struct BvhHit
+{
+    uint32  mIndex  = MAX_UINT32;   // Primitive index
+    float   mT      = MAX_FLOAT;
+};
+
+// Primitives are referred to by their index in pBoxes. Build temporaries live in
+// the scratch arena of the calling thread.
+void    buildBvh(const AABB* pBoxes, uint32 count, Arena* pArena, Bvh* pBvh, uint32 threadCount = 1);
+// Updates the bounds for moved primitives (same count and order as in buildBvh),
+// keeping the topology. Quality degrades as primitives move far, rebuild then.
+void    refitBvh(Bvh* pBvh, const AABB* pBoxes);
+
+// Queries write primitive indices, outputs need room for mPrimCount of them.
+uint32  bvhCullFrustum(Bvh* pBvh, Frustum f, uint32* pVisible);
+uint32  bvhOverlap(Bvh* pBvh, AABB aabb, uint32* pOverlaps);
+bool    bvhRaycast(Bvh* pBvh, v3f origin, v3f dir, float maxT, BvhHit* pHit);    // Closest hit
@@ -225,6 +225,7 @@ bool operator!=(v4f a, v4f b)
         || a.w != b.w;
 }
 
+#ifndef DW_MATH_SIMD
 v4f operator+(v4f a, v4f b)
 {
     return
@@ -290,6 +291,7 @@ v4f operator*(float a, v4f b)
         b.w * a
     };
 }
+#endif
 
 v4f to4f(v3f v, float w)
 {
@@ -315,10 +317,12 @@ v4f to4f(float* f)
     };
 }
 
+#ifndef DW_MATH_SIMD
 float dot(v4f a, v4f b)
 {
     return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
 }
+#endif
 
 float magn2(v4f v)
 {
@@ -354,6 +358,7 @@ quat quatAngleAxis(float angle, v3f axis)
     return normalize(q);    // Quaternions always normalized for rotations
 }
 
+#ifndef DW_MATH_SIMD
 quat quatConj(quat q)
 {
     return
@@ -379,6 +384,7 @@ v3f rotate(v3f p, quat q)
     quat result = quatMul(quatMul(q, pure), quatConj(q));
     return to3f(result);
 }
+#endif
 
 v3f rotate(v3f p, float angle, v3f axis)
 {
@@ -466,6 +472,7 @@ float distanceToPlane(v3f o, plane p)
     return dot(o, to3f(p)) + p.w;
 }
 
+#ifndef DW_MATH_SIMD
 m4f operator+(m4f a, m4f b)
 {
     return 
@@ -584,6 +591,7 @@ m4f matMul(m4f a, m4f b)
         a.m30 * b.m03 + a.m31 * b.m13 + a.m32 * b.m23 + a.m33 * b.m33,
     };
 }
+#endif
 
 m4f identity()
 {
@@ -596,6 +604,7 @@ m4f identity()
     };
 }
 
+#ifndef DW_MATH_SIMD
 m4f transpose(m4f m)
 {
     return
@@ -654,6 +663,7 @@ m4f inverse(m4f m)
         det *  (m.m00 * A1212 - m.m01 * A0212 + m.m02 * A0112), // m33
     };
 }
+#endif
 
 quat toQuat(m4f m)
 {
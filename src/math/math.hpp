@@ -2,6 +2,13 @@
 #include "../core/base.hpp"
 #include "math.h"
 
+// SIMD backend: SSE definitions of the hot v4f/quat/m4f operations, inlined
+// from math_simd.hpp. Define DW_MATH_NO_SIMD to build the scalar ones instead.
+#if !defined(DW_MATH_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define DW_MATH_SIMD
+#endif
+
 // Constants
 #define PI 3.14159265358979323846
 
@@ -76,7 +83,8 @@ float   magn2     (v3f v);
 float   magn      (v3f v);
 v3f     normalize (v3f v);
 
-struct v4f
+// 16 byte aligned whether or not the SIMD backend is enabled, so the layout never depends on it
+struct alignas(16) v4f
 {
     union
     {
@@ -95,6 +103,7 @@ bool operator==(v4f a, v4f b);
 bool operator!=(v4f a, v4f b);
 v4f  operator+ (v4f a, v4f b);
 v4f  operator- (v4f a, v4f b);
+v4f  operator- (v4f a);
 v4f  operator* (v4f a, v4f b);
 v4f  operator* (v4f a, float b);
 v4f  operator* (float a, v4f b);
@@ -124,7 +133,7 @@ plane getPlane(v3f p0, v3f p1, v3f p2);
 float distanceToPlane(v3f o, plane p);
 
 // Matrices
-struct m4f
+struct alignas(16) m4f
 {
     union
     {
@@ -174,3 +183,5 @@ float   lerp(float a, float b, float t);
 v2f     lerp(v2f a, v2f b, float t);
 v3f     lerp(v3f a, v3f b, float t);
 v3f     fromPolar(float radius, float theta, float phi);
+
+#include "math_simd.hpp"
@@ -0,0 +1,263 @@
+#pragma once
+#include "math.hpp"
+
+#ifdef DW_MATH_SIMD
+
+// SSE backend
+// Inline definitions of the hot v4f/quat/m4f operations, math.cpp only keeps
+// the scalar versions for non SIMD builds. m4f is column-major, so every column
+// is a single __m128 and matrix products are splat-multiply-adds over columns.
+#define MATH_SHUFFLE(A, B, X, Y, Z, W)  _mm_shuffle_ps((A), (B), _MM_SHUFFLE((W), (Z), (Y), (X)))
+#define MATH_SWIZZLE(A, X, Y, Z, W)     MATH_SHUFFLE(A, A, X, Y, Z, W)
+#define MATH_SPLAT(A, I)                MATH_SWIZZLE(A, I, I, I, I)
+
+inline __m128 simdLoad(v4f v)
+{
+    return _mm_load_ps(v.mData);
+}
+
+inline v4f simdStore(__m128 v)
+{
+    v4f result;
+    _mm_store_ps(result.mData, v);
+    return result;
+}
+
+inline m4f simdStore(__m128 c0, __m128 c1, __m128 c2, __m128 c3)
+{
+    m4f result;
+    _mm_store_ps(result.mData + 0, c0);
+    _mm_store_ps(result.mData + 4, c1);
+    _mm_store_ps(result.mData + 8, c2);
+    _mm_store_ps(result.mData + 12, c3);
+    return result;
+}
+
+// Columns c0..c3 times v, same operation order as the scalar matMul.
+inline __m128 simdTransform(__m128 c0, __m128 c1, __m128 c2, __m128 c3, __m128 v)
+{
+    __m128 result = _mm_mul_ps(c0, MATH_SPLAT(v, 0));
+    result = _mm_add_ps(result, _mm_mul_ps(c1, MATH_SPLAT(v, 1)));
+    result = _mm_add_ps(result, _mm_mul_ps(c2, MATH_SPLAT(v, 2)));
+    result = _mm_add_ps(result, _mm_mul_ps(c3, MATH_SPLAT(v, 3)));
+    return result;
+}
+
+// Dot product broadcast to every lane.
+inline __m128 simdDot(__m128 a, __m128 b)
+{
+    __m128 m = _mm_mul_ps(a, b);
+    m = _mm_add_ps(m, MATH_SWIZZLE(m, 2, 3, 0, 1));
+    return _mm_add_ps(m, MATH_SWIZZLE(m, 1, 0, 3, 2));
+}
+
+// Cross product of the xyz lanes, w is 0 if the inputs' w is finite.
+inline __m128 simdCross(__m128 a, __m128 b)
+{
+    return _mm_sub_ps(_mm_mul_ps(MATH_SWIZZLE(a, 1, 2, 0, 3), MATH_SWIZZLE(b, 2, 0, 1, 3)),
+                      _mm_mul_ps(MATH_SWIZZLE(a, 2, 0, 1, 3), MATH_SWIZZLE(b, 1, 2, 0, 3)));
+}
+
+inline v4f operator+(v4f a, v4f b)
+{
+    return simdStore(_mm_add_ps(simdLoad(a), simdLoad(b)));
+}
+
+inline v4f operator-(v4f a, v4f b)
+{
+    return simdStore(_mm_sub_ps(simdLoad(a), simdLoad(b)));
+}
+
+inline v4f operator-(v4f a)
+{
+    return simdStore(_mm_xor_ps(simdLoad(a), _mm_set1_ps(-0.f)));
+}
+
+inline v4f operator*(v4f a, v4f b)
+{
+    return simdStore(_mm_mul_ps(simdLoad(a), simdLoad(b)));
+}
+
+inline v4f operator*(v4f a, float b)
+{
+    return simdStore(_mm_mul_ps(simdLoad(a), _mm_set1_ps(b)));
+}
+
+inline v4f operator*(float a, v4f b)
+{
+    return simdStore(_mm_mul_ps(simdLoad(b), _mm_set1_ps(a)));
+}
+
+inline float dot(v4f a, v4f b)
+{
+    return _mm_cvtss_f32(simdDot(simdLoad(a), simdLoad(b)));
+}
+
+inline quat quatConj(quat q)
+{
+    return simdStore(_mm_xor_ps(simdLoad(q), _mm_setr_ps(-0.f, -0.f, -0.f, 0.f)));
+}
+
+inline quat quatMul(quat a, quat b)
+{
+    // a.w * b + a.x * (bw, -bz, by, -bx) + a.y * (bz, bw, -bx, -by) + a.z * (-by, bx, bw, -bz)
+    __m128 va = simdLoad(a);
+    __m128 vb = simdLoad(b);
+    __m128 result = _mm_mul_ps(MATH_SPLAT(va, 3), vb);
+    result = _mm_add_ps(result, _mm_mul_ps(MATH_SPLAT(va, 0),
+                _mm_xor_ps(MATH_SWIZZLE(vb, 3, 2, 1, 0), _mm_setr_ps(0.f, -0.f, 0.f, -0.f))));
+    result = _mm_add_ps(result, _mm_mul_ps(MATH_SPLAT(va, 1),
+                _mm_xor_ps(MATH_SWIZZLE(vb, 2, 3, 0, 1), _mm_setr_ps(0.f, 0.f, -0.f, -0.f))));
+    result = _mm_add_ps(result, _mm_mul_ps(MATH_SPLAT(va, 2),
+                _mm_xor_ps(MATH_SWIZZLE(vb, 1, 0, 3, 2), _mm_setr_ps(-0.f, 0.f, 0.f, -0.f))));
+    return simdStore(result);
+}
+
+inline v3f rotate(v3f p, quat q)
+{
+    // q * p * conj(q) expanded, with u = q.xyz: (w^2 - u.u) p + 2 (u.p) u + 2 w (u x p)
+    __m128 vq = simdLoad(q);
+    __m128 vp = _mm_setr_ps(p.x, p.y, p.z, 0.f);
+    __m128 u = _mm_mul_ps(vq, _mm_setr_ps(1.f, 1.f, 1.f, 0.f));
+    __m128 w = MATH_SPLAT(vq, 3);
+    __m128 two = _mm_set1_ps(2.f);
+
+    __m128 result = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(w, w), simdDot(u, u)), vp);
+    result = _mm_add_ps(result, _mm_mul_ps(_mm_mul_ps(two, simdDot(u, vp)), u));
+    result = _mm_add_ps(result, _mm_mul_ps(_mm_mul_ps(two, w), simdCross(u, vp)));
+    v4f r = simdStore(result);
+    return { r.x, r.y, r.z };
+}
+
+inline m4f operator+(m4f a, m4f b)
+{
+    return simdStore(
+            _mm_add_ps(_mm_load_ps(a.mData + 0), _mm_load_ps(b.mData + 0)),
+            _mm_add_ps(_mm_load_ps(a.mData + 4), _mm_load_ps(b.mData + 4)),
+            _mm_add_ps(_mm_load_ps(a.mData + 8), _mm_load_ps(b.mData + 8)),
+            _mm_add_ps(_mm_load_ps(a.mData + 12), _mm_load_ps(b.mData + 12)));
+}
+
+inline m4f operator-(m4f a, m4f b)
+{
+    return simdStore(
+            _mm_sub_ps(_mm_load_ps(a.mData + 0), _mm_load_ps(b.mData + 0)),
+            _mm_sub_ps(_mm_load_ps(a.mData + 4), _mm_load_ps(b.mData + 4)),
+            _mm_sub_ps(_mm_load_ps(a.mData + 8), _mm_load_ps(b.mData + 8)),
+            _mm_sub_ps(_mm_load_ps(a.mData + 12), _mm_load_ps(b.mData + 12)));
+}
+
+inline m4f matMul(m4f m, float a)
+{
+    __m128 s = _mm_set1_ps(a);
+    return simdStore(
+            _mm_mul_ps(_mm_load_ps(m.mData + 0), s),
+            _mm_mul_ps(_mm_load_ps(m.mData + 4), s),
+            _mm_mul_ps(_mm_load_ps(m.mData + 8), s),
+            _mm_mul_ps(_mm_load_ps(m.mData + 12), s));
+}
+
+inline v4f matMul(m4f m, v4f v)
+{
+    return simdStore(simdTransform(
+            _mm_load_ps(m.mData + 0), _mm_load_ps(m.mData + 4),
+            _mm_load_ps(m.mData + 8), _mm_load_ps(m.mData + 12), simdLoad(v)));
+}
+
+inline m4f matMul(m4f a, m4f b)
+{
+    __m128 c0 = _mm_load_ps(a.mData + 0);
+    __m128 c1 = _mm_load_ps(a.mData + 4);
+    __m128 c2 = _mm_load_ps(a.mData + 8);
+    __m128 c3 = _mm_load_ps(a.mData + 12);
+    return simdStore(
+            simdTransform(c0, c1, c2, c3, _mm_load_ps(b.mData + 0)),
+            simdTransform(c0, c1, c2, c3, _mm_load_ps(b.mData + 4)),
+            simdTransform(c0, c1, c2, c3, _mm_load_ps(b.mData + 8)),
+            simdTransform(c0, c1, c2, c3, _mm_load_ps(b.mData + 12)));
+}
+
+inline m4f transpose(m4f m)
+{
+    __m128 c0 = _mm_load_ps(m.mData + 0);
+    __m128 c1 = _mm_load_ps(m.mData + 4);
+    __m128 c2 = _mm_load_ps(m.mData + 8);
+    __m128 c3 = _mm_load_ps(m.mData + 12);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    return simdStore(c0, c1, c2, c3);
+}
+
+// 2x2 matrices packed as (m00, m01, m10, m11).
+// A * B
+inline __m128 simdMat2Mul(__m128 a, __m128 b)
+{
+    return _mm_add_ps(_mm_mul_ps(a, MATH_SWIZZLE(b, 0, 3, 0, 3)),
+                      _mm_mul_ps(MATH_SWIZZLE(a, 1, 0, 3, 2), MATH_SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+// adj(A) * B
+inline __m128 simdMat2AdjMul(__m128 a, __m128 b)
+{
+    return _mm_sub_ps(_mm_mul_ps(MATH_SWIZZLE(a, 3, 3, 0, 0), b),
+                      _mm_mul_ps(MATH_SWIZZLE(a, 1, 1, 2, 2), MATH_SWIZZLE(b, 2, 3, 0, 1)));
+}
+
+// A * adj(B)
+inline __m128 simdMat2MulAdj(__m128 a, __m128 b)
+{
+    return _mm_sub_ps(_mm_mul_ps(a, MATH_SWIZZLE(b, 3, 0, 3, 0)),
+                      _mm_mul_ps(MATH_SWIZZLE(a, 1, 0, 3, 2), MATH_SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+inline m4f inverse(m4f m)
+{
+    // Block inverse over the 2x2 sub matrices | A B |
+    //                                         | C D |
+    // Works on columns as if they were rows: inverse(transpose(M)) = transpose(inverse(M)).
+    __m128 c0 = _mm_load_ps(m.mData + 0);
+    __m128 c1 = _mm_load_ps(m.mData + 4);
+    __m128 c2 = _mm_load_ps(m.mData + 8);
+    __m128 c3 = _mm_load_ps(m.mData + 12);
+
+    __m128 A = _mm_movelh_ps(c0, c1);
+    __m128 B = _mm_movehl_ps(c1, c0);
+    __m128 C = _mm_movelh_ps(c2, c3);
+    __m128 D = _mm_movehl_ps(c3, c2);
+
+    // (|A|, |B|, |C|, |D|)
+    __m128 detSub = _mm_sub_ps(
+            _mm_mul_ps(MATH_SHUFFLE(c0, c2, 0, 2, 0, 2), MATH_SHUFFLE(c1, c3, 1, 3, 1, 3)),
+            _mm_mul_ps(MATH_SHUFFLE(c0, c2, 1, 3, 1, 3), MATH_SHUFFLE(c1, c3, 0, 2, 0, 2)));
+    __m128 detA = MATH_SPLAT(detSub, 0);
+    __m128 detB = MATH_SPLAT(detSub, 1);
+    __m128 detC = MATH_SPLAT(detSub, 2);
+    __m128 detD = MATH_SPLAT(detSub, 3);
+
+    __m128 DC = simdMat2AdjMul(D, C);
+    __m128 AB = simdMat2AdjMul(A, B);
+    __m128 X = _mm_sub_ps(_mm_mul_ps(detD, A), simdMat2Mul(B, DC));
+    __m128 W = _mm_sub_ps(_mm_mul_ps(detA, D), simdMat2Mul(C, AB));
+    __m128 Y = _mm_sub_ps(_mm_mul_ps(detB, C), simdMat2MulAdj(D, AB));
+    __m128 Z = _mm_sub_ps(_mm_mul_ps(detC, B), simdMat2MulAdj(A, DC));
+
+    // |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+    __m128 tr = _mm_mul_ps(AB, MATH_SWIZZLE(DC, 0, 2, 1, 3));
+    tr = _mm_add_ps(tr, MATH_SWIZZLE(tr, 2, 3, 0, 1));
+    tr = _mm_add_ps(tr, MATH_SWIZZLE(tr, 1, 0, 3, 2));
+    __m128 det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), tr);
+    __m128 invDet = _mm_div_ps(_mm_setr_ps(1.f, -1.f, -1.f, 1.f), det);
+
+    X = _mm_mul_ps(X, invDet);
+    Y = _mm_mul_ps(Y, invDet);
+    Z = _mm_mul_ps(Z, invDet);
+    W = _mm_mul_ps(W, invDet);
+
+    // Adjugate of every block, shuffled back into columns
+    return simdStore(
+            MATH_SHUFFLE(X, Y, 3, 1, 3, 1),
+            MATH_SHUFFLE(X, Y, 2, 0, 2, 0),
+            MATH_SHUFFLE(Z, W, 3, 1, 3, 1),
+            MATH_SHUFFLE(Z, W, 2, 0, 2, 0));
+}
+
+#endif
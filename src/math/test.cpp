@@ -1,6 +1,8 @@
 #include "math.hpp"
 #include "volumes.hpp"
+#include "bvh.hpp"
 #include "../core/debug.hpp"
+#include "random.hpp"
 
 bool testVector()
 {
@@ -58,6 +60,18 @@ bool testQuat()
     ASSERT(eqf(r.x, 0.0f));
     ASSERT(eqf(r.z, -1.0f));
 
+    // Composition, rotating by a * b is rotating by b then by a
+    quat a = quatAngleAxis(PI / 2, v3f{0, 0, 1});
+    quat b = quatAngleAxis(PI / 3, v3f{1, 0, 0});
+    v3f p = {0.3f, -1.2f, 2.5f};
+    v3f r0 = rotate(p, quatMul(a, b));
+    v3f r1 = rotate(rotate(p, b), a);
+    ASSERT(eqf(r0.x, r1.x) && eqf(r0.y, r1.y) && eqf(r0.z, r1.z));
+
+    quat ab = quatMul(a, b);
+    ASSERT(eqf(ab.x, 0.5f * 0.70710678f) && eqf(ab.y, 0.5f * 0.70710678f));
+    ASSERT(eqf(ab.z, 0.8660254f * 0.70710678f) && eqf(ab.w, 0.8660254f * 0.70710678f));
+
     return true;
 }
 
@@ -94,6 +108,28 @@ bool testMatrix()
     ASSERT(eqf(t.z, v.z));
     ASSERT(eqf(t.w, v.w));
 
+    // General matrix, no zero entries
+    m4f G = {};
+    for(uint32 i = 0; i < 16; i++)
+    {
+        G.mData[i] = (float)((i * 7) % 11) - 4.5f + (i % 5 == 0 ? 10.f : 0.f);
+    }
+    m4f GI = matMul(G, inverse(G));
+    for(uint32 i = 0; i < 16; i++)
+    {
+        ASSERT(fabsf(GI.mData[i] - I.mData[i]) < 1e-4f);
+    }
+
+    m4f GT = transpose(G);
+    ASSERT(GT.m01 == G.m10 && GT.m32 == G.m23 && GT.m30 == G.m03 && GT.m22 == G.m22);
+
+    // Column-major product, (G * T) translates first
+    m4f T = translation(v3f{1, 2, 3});
+    v4f a = matMul(matMul(G, T), v);
+    v4f b = matMul(G, matMul(T, v));
+    ASSERT(fabsf(a.x - b.x) < 1e-4f && fabsf(a.y - b.y) < 1e-4f);
+    ASSERT(fabsf(a.z - b.z) < 1e-4f && fabsf(a.w - b.w) < 1e-4f);
+
     return true;
 }
 
@@ -222,6 +258,294 @@ bool testAABB()
     return true;
 }
 
+// Reference for transformAABB: bounds of the 8 transformed corners.
+AABB transformAABBCorners(AABB aabb, m4f transform)
+{
+    AABB result = {};
+    for(uint32 i = 0; i < 8; i++)
+    {
+        v4f corner =
+        {
+            i & 1 ? aabb.max.x : aabb.min.x,
+            i & 2 ? aabb.max.y : aabb.min.y,
+            i & 4 ? aabb.max.z : aabb.min.z,
+            1.f
+        };
+        v3f p = to3f(matMul(transform, corner));
+        result.min = i == 0 ? p : v3f{ MIN(result.min.x, p.x), MIN(result.min.y, p.y), MIN(result.min.z, p.z) };
+        result.max = i == 0 ? p : v3f{ MAX(result.max.x, p.x), MAX(result.max.y, p.y), MAX(result.max.z, p.z) };
+    }
+    return result;
+}
+
+bool eqAABB(AABB a, AABB b)
+{
+    for(uint32 i = 0; i < 3; i++)
+    {
+        float tolerance = 1e-4f * MAX(1.f, fabsf(b.min.mData[i]) + fabsf(b.max.mData[i]));
+        if(fabsf(a.min.mData[i] - b.min.mData[i]) > tolerance) return false;
+        if(fabsf(a.max.mData[i] - b.max.mData[i]) > tolerance) return false;
+    }
+    return true;
+}
+
+bool testTransformAABB()
+{
+    // Rotation + non uniform scale + translation
+    AABB box = { {-1, -2, 0.5f}, {3, 1, 2} };
+    m4f M = matMul(translation({4, -1, 2}), matMul(rotation(0.7f, normalize(v3f{1, 2, -1})), scale(v3f{2, 0.5f, 3})));
+    ASSERT(eqAABB(transformAABB(box, M), transformAABBCorners(box, M)));
+
+    // Mirroring
+    m4f mirror = scale(v3f{-1, 1, -2});
+    AABB mirrored = transformAABB(box, mirror);
+    ASSERT(mirrored.min.x == -3 && mirrored.max.x == 1);
+    ASSERT(mirrored.min.z == -4 && mirrored.max.z == -1);
+
+    // Batch over random transforms, single and multithreaded
+    Arena arena = {};
+    initArena(MB(16), &arena);
+    const uint32 count = 20000;
+    AABB* src = (AABB*)arenaPush(&arena, count * sizeof(AABB), alignof(AABB));
+    m4f* transforms = (m4f*)arenaPush(&arena, count * sizeof(m4f), alignof(m4f));
+    AABB* dst = (AABB*)arenaPush(&arena, count * sizeof(AABB), alignof(AABB));
+    AABB* dstThreaded = (AABB*)arenaPush(&arena, count * sizeof(AABB), alignof(AABB));
+    for(uint32 i = 0; i < count; i++)
+    {
+        v3f center = randomUniformV3F(-100.f, 100.f);
+        v3f extent = randomUniformV3F(0.f, 10.f);
+        src[i] = { center - extent, center + extent };
+        v3f axis = normalize(randomUniformV3F(-1.f, 1.f) + v3f{0, 0, 0.01f});
+        transforms[i] = matMul(translation(randomUniformV3F(-50.f, 50.f)),
+                matMul(rotation(randomUniformF32(0.f, 6.28f), axis), scale(randomUniformV3F(-3.f, 3.f))));
+    }
+
+    transformAABBs(src, transforms, count, dst);
+    transformAABBs(src, transforms, count, dstThreaded, 4);
+    for(uint32 i = 0; i < count; i++)
+    {
+        ASSERT(eqAABB(dst[i], transformAABBCorners(src[i], transforms[i])));
+        ASSERT(dst[i].min == dstThreaded[i].min && dst[i].max == dstThreaded[i].max);
+    }
+
+    destroyArena(&arena);
+    return true;
+}
+
+bool testSoAConversion()
+{
+    Arena arena = {};
+    initArena(MB(1), &arena);
+
+    // Positions
+    {
+        v3f positions[13];
+        for(uint32 i = 0; i < ARR_LEN(positions); i++)
+        {
+            positions[i] = { (float)i, (float)i * 2.f, (float)i * -3.f };
+        }
+
+        SoAPositions soa = soaPositions(&arena, ARR_LEN(positions));
+        toSoA(positions, ARR_LEN(positions), &soa);
+        ASSERT(soa.mCount == ARR_LEN(positions));
+        ASSERT(soa.column<SOA_POS_Y>()[5] == 10.f);
+        ASSERT(soa.column<SOA_POS_Z>()[12] == -36.f);
+
+        v3f back[13];
+        toAoS(&soa, 0, soa.mCount, back);
+        for(uint32 i = 0; i < ARR_LEN(positions); i++)
+        {
+            ASSERT(back[i] == positions[i]);
+        }
+    }
+
+    // AABBs
+    {
+        AABB boxes[9];
+        for(uint32 i = 0; i < ARR_LEN(boxes); i++)
+        {
+            boxes[i].min = { (float)i, -(float)i, 0.5f };
+            boxes[i].max = { (float)i + 1.f, 1.f, 2.f * i };
+        }
+
+        SoAAABBs soa = soaAABBs(&arena, 32);
+        toSoA(boxes, 4, &soa);
+        toSoA(boxes + 4, ARR_LEN(boxes) - 4, &soa);
+        ASSERT(soa.mCount == ARR_LEN(boxes));
+        ASSERT(soa.column<SOA_MIN_Y>()[7] == -7.f);
+        ASSERT(soa.column<SOA_MAX_Z>()[8] == 16.f);
+
+        AABB back[3];
+        toAoS(&soa, 5, 3, back);
+        for(uint32 i = 0; i < 3; i++)
+        {
+            ASSERT(back[i].min == boxes[5 + i].min);
+            ASSERT(back[i].max == boxes[5 + i].max);
+        }
+    }
+
+    destroyArena(&arena);
+    return true;
+}
+
+bool testCullAABBs()
+{
+    Arena arena = {};
+    initArena(MB(1), &arena);
+
+    m4f view = lookAtViewRH({0, 0, 0}, {0, 0, -1}, {0, 1, 0});
+    m4f proj = perspectiveRH(PI / 3, 16.f / 9.f, 0.1f, 100.f);
+    Frustum f = frustum(matMul(proj, view));
+
+    // Count not a multiple of the vector width, to cover the remainder loop
+    const uint32 count = 1003;
+    SoAAABBs soa = soaAABBs(&arena, count);
+    AABB* boxes = (AABB*)arenaPush(&arena, count * sizeof(AABB), alignof(AABB));
+    for(uint32 i = 0; i < count; i++)
+    {
+        v3f center = randomUniformV3F(-60.f, 60.f);
+        v3f extent = randomUniformV3F(0.1f, 5.f);
+        boxes[i].min = center - extent;
+        boxes[i].max = center + extent;
+    }
+    toSoA(boxes, count, &soa);
+
+    uint32* visible = (uint32*)arenaPush(&arena, count * sizeof(uint32), alignof(uint32));
+    uint64 visibleCount = cullAABBs(&soa, f, visible);
+
+    uint64 expected = 0;
+    for(uint32 i = 0; i < count; i++)
+    {
+        if(!inFrustum(boxes[i], f)) continue;
+        ASSERT(expected < visibleCount && visible[expected] == i);
+        expected++;
+    }
+    ASSERT(expected == visibleCount);
+    ASSERT(visibleCount > 0 && visibleCount < count);
+
+    ASSERT(cullAABBs(&soa, f, visible) == visibleCount);
+    soa.clear();
+    ASSERT(cullAABBs(&soa, f, visible) == 0);
+
+    destroyArena(&arena);
+    return true;
+}
+
+// Checks the BVH queries against brute force loops over the boxes.
+void testBvhQueries(Bvh* pBvh, const AABB* boxes, uint32 count, Arena* pArena)
+{
+    ARENA_SCOPE(pArena);
+    uint32* results = (uint32*)arenaPush(pArena, (count + 1) * sizeof(uint32), alignof(uint32));
+    uint8* marks = (uint8*)arenaPushZero(pArena, count + 1);
+
+    m4f view = lookAtViewRH({-20, 5, 30}, {10, 0, -10}, {0, 1, 0});
+    m4f proj = perspectiveRH(PI / 3, 16.f / 9.f, 0.1f, 80.f);
+    Frustum f = frustum(matMul(proj, view));
+    uint32 visibleCount = bvhCullFrustum(pBvh, f, results);
+    for(uint32 i = 0; i < visibleCount; i++)
+    {
+        ASSERT(results[i] < count && !marks[results[i]]);
+        marks[results[i]] = 1;
+    }
+    uint32 expected = 0;
+    for(uint32 i = 0; i < count; i++)
+    {
+        ASSERT(marks[i] == (uint8)inFrustum(boxes[i], f));
+        expected += marks[i];
+        marks[i] = 0;
+    }
+    ASSERT(expected == visibleCount);
+
+    AABB query = { {-10, -10, -10}, {15, 5, 10} };
+    uint32 overlapCount = bvhOverlap(pBvh, query, results);
+    for(uint32 i = 0; i < overlapCount; i++)
+    {
+        ASSERT(results[i] < count && !marks[results[i]]);
+        marks[results[i]] = 1;
+    }
+    expected = 0;
+    for(uint32 i = 0; i < count; i++)
+    {
+        ASSERT(marks[i] == (uint8)overlaps(boxes[i], query));
+        expected += marks[i];
+    }
+    ASSERT(expected == overlapCount);
+
+    for(uint32 r = 0; r < 64; r++)
+    {
+        v3f origin = randomUniformV3F(-60.f, 60.f);
+        v3f dir = normalize(randomUniformV3F(-1.f, 1.f) + v3f{0.001f, 0, 0});
+        v3f invDir = { 1.f / dir.x, 1.f / dir.y, 1.f / dir.z };
+        float closest = 200.f;
+        for(uint32 i = 0; i < count; i++)
+        {
+            float t = 0.f;
+            if(intersectRay(boxes[i], origin, invDir, closest, &t) && t < closest) closest = t;
+        }
+
+        BvhHit hit = {};
+        bool found = bvhRaycast(pBvh, origin, dir, 200.f, &hit);
+        ASSERT(found == (closest < 200.f));
+        if(found)
+        {
+            ASSERT(eqf(hit.mT, closest));
+            float t = 0.f;
+            ASSERT(intersectRay(boxes[hit.mIndex], origin, invDir, 200.f, &t) && eqf(t, closest));
+        }
+    }
+}
+
+bool testBvh()
+{
+    Arena arena = {};
+    initArena(MB(64), &arena);
+
+    const uint32 count = 20000;
+    AABB* boxes = (AABB*)arenaPush(&arena, count * sizeof(AABB), alignof(AABB));
+    for(uint32 i = 0; i < count; i++)
+    {
+        v3f center = randomUniformV3F(-50.f, 50.f);
+        v3f extent = randomUniformV3F(0.05f, 1.f);
+        boxes[i] = { center - extent, center + extent };
+    }
+
+    // Single and multithreaded builds
+    for(uint32 threadCount = 1; threadCount <= 4; threadCount *= 4)
+    {
+        Bvh bvh = {};
+        buildBvh(boxes, count, &arena, &bvh, threadCount);
+        ASSERT(bvh.mPrimCount == count && bvh.mNodeCount > 0);
+        testBvhQueries(&bvh, boxes, count, &arena);
+
+        // Moving everything, refit keeps queries exact
+        for(uint32 i = 0; i < count; i++)
+        {
+            v3f offset = randomUniformV3F(-3.f, 3.f);
+            boxes[i] = { boxes[i].min + offset, boxes[i].max + offset };
+        }
+        refitBvh(&bvh, boxes);
+        testBvhQueries(&bvh, boxes, count, &arena);
+    }
+
+    // Degenerate inputs: empty, a single leaf, identical boxes
+    {
+        Bvh bvh = {};
+        buildBvh(boxes, 0, &arena, &bvh);
+        BvhHit hit = {};
+        ASSERT(!bvhRaycast(&bvh, {0, 0, 0}, {1, 0, 0}, 100.f, &hit));
+
+        buildBvh(boxes, 3, &arena, &bvh);
+        testBvhQueries(&bvh, boxes, 3, &arena);
+
+        for(uint32 i = 1; i < 100; i++) boxes[i] = boxes[0];
+        buildBvh(boxes, 100, &arena, &bvh);
+        testBvhQueries(&bvh, boxes, 100, &arena);
+    }
+
+    destroyArena(&arena);
+    return true;
+}
+
 bool testMisc()
 {
     ASSERT(eqf(lerp(0.0f, 10.0f, 0.5f), 5.0f));
@@ -263,6 +587,18 @@ bool testMath()
     LOG("[TEST-MATH] Testing AABB...");
     testAABB();
 
+    LOG("[TEST-MATH] Testing AABB transforms...");
+    testTransformAABB();
+
+    LOG("[TEST-MATH] Testing SoA conversion...");
+    testSoAConversion();
+
+    LOG("[TEST-MATH] Testing batch frustum culling...");
+    testCullAABBs();
+
+    LOG("[TEST-MATH] Testing BVH...");
+    testBvh();
+
     LOG("[TEST-MATH] All math tests passed.");
     return true;
 }
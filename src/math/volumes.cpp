@@ -1,54 +1,103 @@
 #include "volumes.hpp"
 #include "../core/debug.hpp"
 #include "../math/math.hpp"
+#include "../core/thread.hpp"
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
 
 AABB transformAABB(AABB aabb, m4f transform)
 {
-    // TODO_DW: MATH
-    // This performs a lot of calculations that could be optimized to less
-    // transforming, and no idea if this works for non uniform scaling.
-
-    // Compute all 8 vertices of AABB
-    v4f aabbVertices[8] =
-    {
-        {aabb.min.x, aabb.min.y, aabb.min.z, 1.f},
-        {aabb.max.x, aabb.min.y, aabb.min.z, 1.f},
-        {aabb.min.x, aabb.max.y, aabb.min.z, 1.f},
-        {aabb.max.x, aabb.max.y, aabb.min.z, 1.f},
-        {aabb.min.x, aabb.min.y, aabb.max.z, 1.f},
-        {aabb.max.x, aabb.min.y, aabb.max.z, 1.f},
-        {aabb.min.x, aabb.max.y, aabb.max.z, 1.f},
-        {aabb.max.x, aabb.max.y, aabb.max.z, 1.f},
-    };
-
-    // Transform all vertices
-    v4f aabbTransformedVertices[8] =
-    {
-        matMul(transform, aabbVertices[0]),
-        matMul(transform, aabbVertices[1]),
-        matMul(transform, aabbVertices[2]),
-        matMul(transform, aabbVertices[3]),
-        matMul(transform, aabbVertices[4]),
-        matMul(transform, aabbVertices[5]),
-        matMul(transform, aabbVertices[6]),
-        matMul(transform, aabbVertices[7]),
-    };
+    // Arvo, "Transforming Axis-Aligned Bounding Boxes" (Graphics Gems, 1990)
+    // Every corner coordinate is a sum of independent per-axis terms, so the new
+    // min (max) is the translation plus the smaller (larger) of each term.
+    // Exact for any affine transform, including non uniform scale. The projective
+    // row is ignored, as with the corners transformed by matMul before.
+#ifdef DW_MATH_SIMD
+    __m128 newMin = _mm_load_ps(transform.mData + 12);
+    __m128 newMax = newMin;
+    for(uint32 j = 0; j < 3; j++)
+    {
+        __m128 column = _mm_load_ps(transform.mData + j * 4);
+        __m128 a = _mm_mul_ps(column, _mm_set1_ps(aabb.min.mData[j]));
+        __m128 b = _mm_mul_ps(column, _mm_set1_ps(aabb.max.mData[j]));
+        newMin = _mm_add_ps(newMin, _mm_min_ps(a, b));
+        newMax = _mm_add_ps(newMax, _mm_max_ps(a, b));
+    }
+    v4f min = simdStore(newMin);
+    v4f max = simdStore(newMax);
 
-    // Find min/max of new vertices and create new AABB
     AABB result = {};
-    result.min = to3f(aabbTransformedVertices[0]);
-    result.max = to3f(aabbTransformedVertices[0]);
-    for(int32 i = 1; i < 8; i++)
+    result.min = { min.x, min.y, min.z };
+    result.max = { max.x, max.y, max.z };
+    return result;
+#else
+    AABB result = {};
+    for(uint32 i = 0; i < 3; i++)
     {
-        result.min.x = MIN(result.min.x, aabbTransformedVertices[i].x);
-        result.min.y = MIN(result.min.y, aabbTransformedVertices[i].y);
-        result.min.z = MIN(result.min.z, aabbTransformedVertices[i].z);
-
-        result.max.x = MAX(result.max.x, aabbTransformedVertices[i].x);
-        result.max.y = MAX(result.max.y, aabbTransformedVertices[i].y);
-        result.max.z = MAX(result.max.z, aabbTransformedVertices[i].z);
+        result.min.mData[i] = transform.mData[12 + i];
+        result.max.mData[i] = transform.mData[12 + i];
+        for(uint32 j = 0; j < 3; j++)
+        {
+            float a = transform.mData[j * 4 + i] * aabb.min.mData[j];
+            float b = transform.mData[j * 4 + i] * aabb.max.mData[j];
+            result.min.mData[i] += MIN(a, b);
+            result.max.mData[i] += MAX(a, b);
+        }
     }
     return result;
+#endif
+}
+
+struct TransformAABBsTask
+{
+    Thread      mThread     = {};
+    const AABB* pSrc        = NULL;
+    const m4f*  pTransforms = NULL;
+    AABB*       pDst        = NULL;
+    uint64      mCount      = 0;
+};
+
+void transformAABBsProc(void* pData)
+{
+    TransformAABBsTask* pTask = (TransformAABBsTask*)pData;
+    for(uint64 i = 0; i < pTask->mCount; i++)
+    {
+        pTask->pDst[i] = transformAABB(pTask->pSrc[i], pTask->pTransforms[i]);
+    }
+}
+
+#define TRANSFORM_AABBS_MAX_THREADS         64
+#define TRANSFORM_AABBS_MIN_PER_THREAD      4096    // Below this, spawning costs more than it saves
+
+void transformAABBs(const AABB* pSrc, const m4f* pTransforms, uint64 count, AABB* pDst, uint32 threadCount)
+{
+    ASSERT((pSrc && pTransforms && pDst) || !count);
+    ASSERT(threadCount > 0);
+
+    threadCount = MIN(threadCount, TRANSFORM_AABBS_MAX_THREADS);
+    threadCount = (uint32)MAX(1, MIN((uint64)threadCount, count / TRANSFORM_AABBS_MIN_PER_THREAD));
+
+    // Contiguous ranges, the calling thread takes the first one
+    TransformAABBsTask tasks[TRANSFORM_AABBS_MAX_THREADS];
+    uint64 perThread = count / threadCount;
+    for(uint32 t = 0; t < threadCount; t++)
+    {
+        uint64 first = t * perThread;
+        tasks[t] = {};
+        tasks[t].pSrc = pSrc + first;
+        tasks[t].pTransforms = pTransforms + first;
+        tasks[t].pDst = pDst + first;
+        tasks[t].mCount = t == threadCount - 1 ? count - first : perThread;
+        if(t > 0) createThread(transformAABBsProc, &tasks[t], &tasks[t].mThread);
+    }
+
+    transformAABBsProc(&tasks[0]);
+    for(uint32 t = 1; t < threadCount; t++)
+    {
+        joinThread(&tasks[t].mThread);
+    }
 }
 
 v3f getSize(AABB aabb)
@@ -61,6 +110,132 @@ v3f getCenter(AABB aabb)
     return aabb.min + getSize(aabb) * 0.5;
 }
 
+AABB emptyAABB()
+{
+    AABB result = {};
+    result.min = { MAX_FLOAT, MAX_FLOAT, MAX_FLOAT };
+    result.max = { -MAX_FLOAT, -MAX_FLOAT, -MAX_FLOAT };
+    return result;
+}
+
+AABB merge(AABB a, AABB b)
+{
+    AABB result = {};
+    result.min = { MIN(a.min.x, b.min.x), MIN(a.min.y, b.min.y), MIN(a.min.z, b.min.z) };
+    result.max = { MAX(a.max.x, b.max.x), MAX(a.max.y, b.max.y), MAX(a.max.z, b.max.z) };
+    return result;
+}
+
+AABB merge(AABB aabb, v3f p)
+{
+    return merge(aabb, AABB{ p, p });
+}
+
+float surfaceArea(AABB aabb)
+{
+    v3f size = getSize(aabb);
+    return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+bool overlaps(AABB a, AABB b)
+{
+    return a.min.x <= b.max.x && a.max.x >= b.min.x
+        && a.min.y <= b.max.y && a.max.y >= b.min.y
+        && a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+bool intersectRay(AABB aabb, v3f origin, v3f invDir, float maxT, float* pT)
+{
+    float tMin = 0.f;
+    float tMax = maxT;
+    for(uint32 i = 0; i < 3; i++)
+    {
+        float t0 = (aabb.min.mData[i] - origin.mData[i]) * invDir.mData[i];
+        float t1 = (aabb.max.mData[i] - origin.mData[i]) * invDir.mData[i];
+        tMin = MAX(tMin, MIN(t0, t1));
+        tMax = MIN(tMax, MAX(t0, t1));
+    }
+    if(tMin > tMax) return false;
+    if(pT) *pT = tMin;
+    return true;
+}
+
+SoAPositions soaPositions(Arena* pArena, uint64 capacity)
+{
+    return soaArray<float, float, float>(pArena, capacity);
+}
+
+SoAAABBs soaAABBs(Arena* pArena, uint64 capacity)
+{
+    return soaArray<float, float, float, float, float, float>(pArena, capacity);
+}
+
+void toSoA(const v3f* pSrc, uint64 count, SoAPositions* pDst)
+{
+    ASSERT(pSrc && pDst);
+    uint64 first = pDst->pushCount(count);
+    float* xs = pDst->column<SOA_POS_X>() + first;
+    float* ys = pDst->column<SOA_POS_Y>() + first;
+    float* zs = pDst->column<SOA_POS_Z>() + first;
+    for(uint64 i = 0; i < count; i++)
+    {
+        xs[i] = pSrc[i].x;
+        ys[i] = pSrc[i].y;
+        zs[i] = pSrc[i].z;
+    }
+}
+
+void toSoA(const AABB* pSrc, uint64 count, SoAAABBs* pDst)
+{
+    ASSERT(pSrc && pDst);
+    uint64 first = pDst->pushCount(count);
+    float* minXs = pDst->column<SOA_MIN_X>() + first;
+    float* minYs = pDst->column<SOA_MIN_Y>() + first;
+    float* minZs = pDst->column<SOA_MIN_Z>() + first;
+    float* maxXs = pDst->column<SOA_MAX_X>() + first;
+    float* maxYs = pDst->column<SOA_MAX_Y>() + first;
+    float* maxZs = pDst->column<SOA_MAX_Z>() + first;
+    for(uint64 i = 0; i < count; i++)
+    {
+        minXs[i] = pSrc[i].min.x;
+        minYs[i] = pSrc[i].min.y;
+        minZs[i] = pSrc[i].min.z;
+        maxXs[i] = pSrc[i].max.x;
+        maxYs[i] = pSrc[i].max.y;
+        maxZs[i] = pSrc[i].max.z;
+    }
+}
+
+void toAoS(SoAPositions* pSrc, uint64 first, uint64 count, v3f* pDst)
+{
+    ASSERT(pSrc && pDst);
+    ASSERT(first + count <= pSrc->mCount);
+    const float* xs = pSrc->column<SOA_POS_X>() + first;
+    const float* ys = pSrc->column<SOA_POS_Y>() + first;
+    const float* zs = pSrc->column<SOA_POS_Z>() + first;
+    for(uint64 i = 0; i < count; i++)
+    {
+        pDst[i] = { xs[i], ys[i], zs[i] };
+    }
+}
+
+void toAoS(SoAAABBs* pSrc, uint64 first, uint64 count, AABB* pDst)
+{
+    ASSERT(pSrc && pDst);
+    ASSERT(first + count <= pSrc->mCount);
+    const float* minXs = pSrc->column<SOA_MIN_X>() + first;
+    const float* minYs = pSrc->column<SOA_MIN_Y>() + first;
+    const float* minZs = pSrc->column<SOA_MIN_Z>() + first;
+    const float* maxXs = pSrc->column<SOA_MAX_X>() + first;
+    const float* maxYs = pSrc->column<SOA_MAX_Y>() + first;
+    const float* maxZs = pSrc->column<SOA_MAX_Z>() + first;
+    for(uint64 i = 0; i < count; i++)
+    {
+        pDst[i].min = { minXs[i], minYs[i], minZs[i] };
+        pDst[i].max = { maxXs[i], maxYs[i], maxZs[i] };
+    }
+}
+
 void sphere(float radius, uint32 stacks, uint32 slices,
         float* pVertices, uint16* pIndices, 
         uint32* pIndexCount, uint32* pVertexCount)
@@ -161,6 +336,109 @@ bool inFrustum(AABB aabb, Frustum f)
     return true;
 }
 
+uint64 cullAABBs(const float* pMinX, const float* pMinY, const float* pMinZ,
+        const float* pMaxX, const float* pMaxY, const float* pMaxZ,
+        uint64 count, Frustum f, uint32* pVisible)
+{
+    ASSERT(pMinX && pMinY && pMinZ && pMaxX && pMaxY && pMaxZ);
+    ASSERT(pVisible || !count);
+    ASSERT(count <= MAX_UINT32);
+
+    // Plane signs are the same for every box, so the corner furthest along each
+    // plane's normal (see inFrustum) is picked once per stream instead of per box.
+    const float* xs[6];
+    const float* ys[6];
+    const float* zs[6];
+    for(uint32 p = 0; p < 6; p++)
+    {
+        xs[p] = f.planes[p].x < 0.f ? pMinX : pMaxX;
+        ys[p] = f.planes[p].y < 0.f ? pMinY : pMaxY;
+        zs[p] = f.planes[p].z < 0.f ? pMinZ : pMaxZ;
+    }
+
+    // Visible indices are written unconditionally and only kept when the box
+    // passes, so compaction doesn't branch on the result.
+    uint64 visible = 0;
+    uint64 i = 0;
+#if defined(__AVX__)
+    __m256 nx[6], ny[6], nz[6], d[6];
+    for(uint32 p = 0; p < 6; p++)
+    {
+        nx[p] = _mm256_set1_ps(f.planes[p].x);
+        ny[p] = _mm256_set1_ps(f.planes[p].y);
+        nz[p] = _mm256_set1_ps(f.planes[p].z);
+        d[p] = _mm256_set1_ps(f.planes[p].w);
+    }
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256 culled = _mm256_setzero_ps();
+        for(uint32 p = 0; p < 6; p++)
+        {
+            __m256 sdf = _mm256_mul_ps(_mm256_loadu_ps(xs[p] + i), nx[p]);
+            sdf = _mm256_add_ps(sdf, _mm256_mul_ps(_mm256_loadu_ps(ys[p] + i), ny[p]));
+            sdf = _mm256_add_ps(sdf, _mm256_mul_ps(_mm256_loadu_ps(zs[p] + i), nz[p]));
+            sdf = _mm256_add_ps(sdf, d[p]);
+            culled = _mm256_or_ps(culled, _mm256_cmp_ps(sdf, _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+        uint32 mask = ~(uint32)_mm256_movemask_ps(culled);
+        for(uint32 lane = 0; lane < 8; lane++)
+        {
+            pVisible[visible] = (uint32)(i + lane);
+            visible += (mask >> lane) & 1;
+        }
+    }
+#elif defined(DW_MATH_SIMD)
+    __m128 nx[6], ny[6], nz[6], d[6];
+    for(uint32 p = 0; p < 6; p++)
+    {
+        nx[p] = _mm_set1_ps(f.planes[p].x);
+        ny[p] = _mm_set1_ps(f.planes[p].y);
+        nz[p] = _mm_set1_ps(f.planes[p].z);
+        d[p] = _mm_set1_ps(f.planes[p].w);
+    }
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128 culled = _mm_setzero_ps();
+        for(uint32 p = 0; p < 6; p++)
+        {
+            __m128 sdf = _mm_mul_ps(_mm_loadu_ps(xs[p] + i), nx[p]);
+            sdf = _mm_add_ps(sdf, _mm_mul_ps(_mm_loadu_ps(ys[p] + i), ny[p]));
+            sdf = _mm_add_ps(sdf, _mm_mul_ps(_mm_loadu_ps(zs[p] + i), nz[p]));
+            sdf = _mm_add_ps(sdf, d[p]);
+            culled = _mm_or_ps(culled, _mm_cmplt_ps(sdf, _mm_setzero_ps()));
+        }
+        uint32 mask = ~(uint32)_mm_movemask_ps(culled);
+        for(uint32 lane = 0; lane < 4; lane++)
+        {
+            pVisible[visible] = (uint32)(i + lane);
+            visible += (mask >> lane) & 1;
+        }
+    }
+#endif
+
+    // Remainder (or everything without SIMD)
+    for(; i < count; i++)
+    {
+        uint32 inside = 1;
+        for(uint32 p = 0; p < 6; p++)
+        {
+            float sdf = xs[p][i] * f.planes[p].x + ys[p][i] * f.planes[p].y + zs[p][i] * f.planes[p].z + f.planes[p].w;
+            inside &= !(sdf < 0.f);
+        }
+        pVisible[visible] = (uint32)i;
+        visible += inside;
+    }
+    return visible;
+}
+
+uint64 cullAABBs(SoAAABBs* pAABBs, Frustum f, uint32* pVisible)
+{
+    ASSERT(pAABBs);
+    return cullAABBs(pAABBs->column<SOA_MIN_X>(), pAABBs->column<SOA_MIN_Y>(), pAABBs->column<SOA_MIN_Z>(),
+            pAABBs->column<SOA_MAX_X>(), pAABBs->column<SOA_MAX_Y>(), pAABBs->column<SOA_MAX_Z>(),
+            pAABBs->mCount, f, pVisible);
+}
+
 void frustumCorners(m4f view, m4f proj, v3f* pCorners, float zOffset)
 {
     m4f mVP = matMul(proj, view);
@@ -1,5 +1,6 @@
 #pragma once
 #include "math.hpp"
+#include "../core/soa.hpp"
 struct Camera;
 
 // AABB
@@ -9,9 +10,20 @@ struct AABB
     v3f max = {0,0,0};
 };
 
+// Exact bounds of the transformed box for affine transforms (Arvo's method).
 AABB transformAABB(AABB aabb, m4f transform);
+// pDst[i] = transformAABB(pSrc[i], pTransforms[i]), split over threadCount threads.
+void transformAABBs(const AABB* pSrc, const m4f* pTransforms, uint64 count, AABB* pDst, uint32 threadCount = 1);
 v3f getSize(AABB aabb);
 v3f getCenter(AABB aabb);
+AABB emptyAABB();                   // Inverted bounds, merging anything into it yields that thing
+AABB merge(AABB a, AABB b);
+AABB merge(AABB aabb, v3f p);
+float surfaceArea(AABB aabb);
+bool overlaps(AABB a, AABB b);
+// Slab test against the ray origin + t * dir, t in [0, maxT]. pT gets the entry
+// distance (0 if the origin is inside). invDir is 1 / dir per component.
+bool intersectRay(AABB aabb, v3f origin, v3f invDir, float maxT, float* pT);
 
 // Frustum
 struct Frustum
@@ -22,9 +34,34 @@ struct Frustum
 
 bool inFrustum(v3f p, Frustum f);
 bool inFrustum(AABB aabb, Frustum f);
+
+// Batch version of inFrustum(AABB, Frustum) over SoA bounds, 4 or 8 boxes at a time.
+// Writes the indices of the visible boxes to pVisible (room for count indices)
+// and returns how many there are.
+uint64 cullAABBs(const float* pMinX, const float* pMinY, const float* pMinZ,
+        const float* pMaxX, const float* pMaxY, const float* pMaxZ,
+        uint64 count, Frustum f, uint32* pVisible);
 void frustumCorners(m4f view, m4f proj, v3f* pCorners, float zOffset = 0);
 Frustum frustum(m4f vp);
 
+// SoA streams
+// Position and AABB streams for batch kernels, see SoAArray.
+enum SoAPositionField { SOA_POS_X, SOA_POS_Y, SOA_POS_Z };
+enum SoAAABBField { SOA_MIN_X, SOA_MIN_Y, SOA_MIN_Z, SOA_MAX_X, SOA_MAX_Y, SOA_MAX_Z };
+
+typedef SoAArray<float, float, float> SoAPositions;
+typedef SoAArray<float, float, float, float, float, float> SoAAABBs;
+
+SoAPositions    soaPositions(Arena* pArena, uint64 capacity);
+SoAAABBs        soaAABBs(Arena* pArena, uint64 capacity);
+
+void toSoA(const v3f* pSrc, uint64 count, SoAPositions* pDst);     // Appends
+void toSoA(const AABB* pSrc, uint64 count, SoAAABBs* pDst);        // Appends
+void toAoS(SoAPositions* pSrc, uint64 first, uint64 count, v3f* pDst);
+void toAoS(SoAAABBs* pSrc, uint64 first, uint64 count, AABB* pDst);
+
+uint64 cullAABBs(SoAAABBs* pAABBs, Frustum f, uint32* pVisible);
+
 // Misc
 void sphere(float radius, uint32 stacks, uint32 slices,
         float* pVertices, uint16* pIndices, 
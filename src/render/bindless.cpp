@@ -0,0 +1,244 @@
+#include "bindless.hpp"
+#include "render.hpp"
+#include "../core/debug.hpp"
+
+void markBindlessSlot(BindlessTable* pTable, uint32 slot)
+{
+    uint32 word = slot / 64;
+    uint64 bit = 1ull << (slot % 64);
+    if(pTable->pDirty[word] & bit) return;
+
+    pTable->pDirty[word] |= bit;
+    pTable->mDirtyFirst = pTable->mDirtyCount ? MIN(pTable->mDirtyFirst, word) : word;
+    pTable->mDirtyLast = pTable->mDirtyCount ? MAX(pTable->mDirtyLast, word) : word;
+    pTable->mDirtyCount++;
+}
+
+void initBindlessTable(Renderer* pRenderer, BindlessTableDesc desc, BindlessTable* pTable)
+{
+    ASSERT(pTable && desc.pFallback);
+    ASSERT(desc.mCapacity > 1);     // A single texture isn't written as an array
+    ASSERT(desc.mType == DESCRIPTOR_TEXTURE || desc.mType == DESCRIPTOR_STORAGE_IMAGE);
+
+    *pTable = {};
+    pTable->mDesc = desc;
+
+    uint32 capacity = desc.mCapacity;
+    uint32 words = (capacity + 63) / 64;
+    initArena(capacity * (sizeof(Texture*) + sizeof(uint32) + sizeof(uint64)) + words * sizeof(uint64) + KB(1),
+            &pTable->mArena);
+    pTable->ppTextures = (Texture**)arenaPush(&pTable->mArena, capacity * sizeof(Texture*), alignof(Texture*));
+    pTable->pDirty = (uint64*)arenaPush(&pTable->mArena, words * sizeof(uint64), alignof(uint64));
+    pTable->pRetiredSlots = (uint32*)arenaPush(&pTable->mArena, capacity * sizeof(uint32), alignof(uint32));
+    pTable->pRetiredFrames = (uint64*)arenaPush(&pTable->mArena, capacity * sizeof(uint64), alignof(uint64));
+    memset(pTable->pDirty, 0, words * sizeof(uint64));
+
+    // Empty slots hold the fallback, the set starts written whole
+    for(uint32 i = 0; i < capacity; i++)
+    {
+        pTable->ppTextures[i] = desc.pFallback;
+    }
+
+    if(pRenderer)
+    {
+        allocateBindlessSet(&pRenderer->mDescriptorBackend, &pRenderer->mDescriptorLayouts, pTable);
+        writeDescriptorSet(pRenderer, &pTable->mSet.mDesc, pTable->mSet.mVkSet);
+    }
+}
+
+void destroyBindlessTable(Renderer* pRenderer, BindlessTable* pTable)
+{
+    ASSERT(pTable);
+
+    if(pTable->pSet)
+    {
+        ASSERT(pRenderer);
+        freeBindlessSet(&pRenderer->mDescriptorBackend, pTable);
+    }
+    destroyArena(&pTable->mArena);
+    *pTable = {};
+}
+
+void allocateBindlessSet(DescriptorBackend* pBackend, DescriptorLayoutCache* pLayouts, BindlessTable* pTable)
+{
+    ASSERT(pBackend && pLayouts && pTable && pTable->ppTextures);
+    ASSERT(!pTable->pSet);
+
+    DescriptorSetDesc setDesc = {};
+    setDesc.mResources[0].mType = pTable->mDesc.mType;
+    setDesc.mResources[0].pData = pTable->ppTextures;
+    setDesc.mResources[0].mCount = pTable->mDesc.mCapacity;
+    setDesc.mResources[0].mMaxCount = pTable->mDesc.mCapacity;
+    setDesc.mCount = 1;
+
+    // One set written while bound, the pool never grows or resets
+    ASSERT(isUpdateAfterBind(&setDesc));
+    DescriptorCounts counts = countDescriptors(&setDesc);
+    VkDescriptorSetLayout vkLayout = getDescriptorSetLayout(pLayouts, &setDesc);
+    VkDescriptorPool vkPool = pBackend->pfnCreatePool(pBackend->pUserData, 1, &counts, false, true);
+    VkDescriptorSet vkSet = VK_NULL_HANDLE;
+    VkResult ret = pBackend->pfnAllocateSet(pBackend->pUserData, vkPool, vkLayout, &vkSet);
+    ASSERTVK(ret);
+
+    pTable->mVkPool = vkPool;
+    pTable->mSet = {};
+    pTable->mSet.mDesc = setDesc;
+    pTable->mSet.mVkLayout = vkLayout;
+    pTable->mSet.mVkSet = vkSet;
+    pTable->mSet.mVkPool = vkPool;
+    pTable->pSet = &pTable->mSet;
+}
+
+void freeBindlessSet(DescriptorBackend* pBackend, BindlessTable* pTable)
+{
+    ASSERT(pBackend && pTable && pTable->pSet);
+
+    // The set goes with its pool, the layout stays in the cache
+    pBackend->pfnDestroyPool(pBackend->pUserData, pTable->mVkPool);
+    pTable->mVkPool = VK_NULL_HANDLE;
+    pTable->mSet = {};
+    pTable->pSet = NULL;
+}
+
+void setBindlessTexture(BindlessTable* pTable, Texture* pTexture)
+{
+    ASSERT(pTable && pTexture);
+    ASSERT(pTexture->mHandle != HND_INVALID);
+    ASSERT(pTexture->mDesc.mUsage & (pTable->mDesc.mType == DESCRIPTOR_TEXTURE ?
+            TEXTURE_USAGE_SAMPLED : TEXTURE_USAGE_STORAGE));
+
+    uint32 slot = HND_INDEX(pTexture->mHandle);
+    ASSERTF(slot < pTable->mDesc.mCapacity, "Bindless slot %u past the table capacity %u",
+            slot, pTable->mDesc.mCapacity);
+
+    if(pTable->ppTextures[slot] == pTexture) return;
+    pTable->ppTextures[slot] = pTexture;
+    markBindlessSlot(pTable, slot);
+}
+
+void removeBindlessTexture(BindlessTable* pTable, Texture* pTexture, uint64 frame)
+{
+    ASSERT(pTable && pTexture);
+
+    uint32 slot = HND_INDEX(pTexture->mHandle);
+    ASSERT(slot < pTable->mDesc.mCapacity);
+    ASSERT(pTable->ppTextures[slot] == pTexture);     // Not in the table
+    ASSERT(pTable->mRetiredCount < pTable->mDesc.mCapacity);
+
+    // The descriptor stays as is until no frame in flight can read it, only the pointer
+    // goes since the texture is about to be removed
+    pTable->ppTextures[slot] = NULL;
+    uint32 tail = (pTable->mRetiredStart + pTable->mRetiredCount) % pTable->mDesc.mCapacity;
+    pTable->pRetiredSlots[tail] = slot;
+    pTable->pRetiredFrames[tail] = frame;
+    pTable->mRetiredCount++;
+}
+
+void retireBindlessSlots(BindlessTable* pTable, uint64 frame)
+{
+    ASSERT(pTable);
+
+    while(pTable->mRetiredCount)
+    {
+        uint32 head = pTable->mRetiredStart;
+        if(pTable->pRetiredFrames[head] + CONCURRENT_FRAMES > frame) break;
+
+        // A slot set again meanwhile keeps its new texture
+        uint32 slot = pTable->pRetiredSlots[head];
+        if(!pTable->ppTextures[slot])
+        {
+            pTable->ppTextures[slot] = pTable->mDesc.pFallback;
+            markBindlessSlot(pTable, slot);
+        }
+        pTable->mRetiredStart = (head + 1) % pTable->mDesc.mCapacity;
+        pTable->mRetiredCount--;
+    }
+}
+
+uint32 getBindlessUpdates(BindlessTable* pTable, Arena* pArena, BindlessRange** ppOut)
+{
+    ASSERT(pTable && pArena && ppOut);
+
+    *ppOut = NULL;
+    if(!pTable->mDirtyCount) return 0;
+
+    // At most one range per dirty slot
+    BindlessRange* pRanges = (BindlessRange*)arenaPush(pArena,
+            pTable->mDirtyCount * sizeof(BindlessRange), alignof(BindlessRange));
+    uint32 count = 0;
+    for(uint32 w = pTable->mDirtyFirst; w <= pTable->mDirtyLast; w++)
+    {
+        uint64 bits = pTable->pDirty[w];
+        pTable->pDirty[w] = 0;
+        while(bits)
+        {
+            uint32 slot = w * 64 + (uint32)__builtin_ctzll(bits);
+            bits &= bits - 1;
+
+            if(count && pRanges[count - 1].mFirst + pRanges[count - 1].mCount == slot)
+            {
+                pRanges[count - 1].mCount++;
+            }
+            else
+            {
+                pRanges[count++] = { slot, 1 };
+            }
+        }
+    }
+
+    pTable->mDirtyCount = 0;
+    *ppOut = pRanges;
+    return count;
+}
+
+Texture* getBindlessTexture(BindlessTable* pTable, uint32 slot)
+{
+    ASSERT(pTable && slot < pTable->mDesc.mCapacity);
+    Texture* pTexture = pTable->ppTextures[slot];
+    return pTexture ? pTexture : pTable->mDesc.pFallback;
+}
+
+void flushBindlessTable(Renderer* pRenderer, BindlessTable* pTable)
+{
+    ASSERT(pRenderer && pTable && pTable->pSet);
+
+    retireBindlessSlots(pTable, pRenderer->mFrameCount);
+    uint32 descriptorCount = pTable->mDirtyCount;
+    if(!descriptorCount) return;
+
+    ScratchScope scratch;
+    BindlessRange* pRanges = NULL;
+    uint32 rangeCount = getBindlessUpdates(pTable, scratch.pArena, &pRanges);
+
+    // One write per range of slots. A slot removed before its texture was ever written
+    // gets the fallback, no frame can be reading that texture
+    VkWriteDescriptorSet* vkWrites = (VkWriteDescriptorSet*)arenaPush(scratch.pArena,
+            rangeCount * sizeof(VkWriteDescriptorSet), alignof(VkWriteDescriptorSet));
+    VkDescriptorImageInfo* vkImageInfos = (VkDescriptorImageInfo*)arenaPush(scratch.pArena,
+            descriptorCount * sizeof(VkDescriptorImageInfo), alignof(VkDescriptorImageInfo));
+    uint32 cursor = 0;
+    for(uint32 i = 0; i < rangeCount; i++)
+    {
+        vkWrites[i] = {};
+        vkWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        vkWrites[i].dstSet = pTable->pSet->mVkSet;
+        vkWrites[i].dstBinding = 0;
+        vkWrites[i].dstArrayElement = pRanges[i].mFirst;
+        vkWrites[i].descriptorType = (VkDescriptorType)pTable->mDesc.mType;
+        vkWrites[i].descriptorCount = pRanges[i].mCount;
+        vkWrites[i].pImageInfo = &vkImageInfos[cursor];
+
+        for(uint32 s = 0; s < pRanges[i].mCount; s++)
+        {
+            Texture* pTexture = getBindlessTexture(pTable, pRanges[i].mFirst + s);
+            vkImageInfos[cursor] = {};
+            vkImageInfos[cursor].imageView = pTexture->mVkImageView;
+            vkImageInfos[cursor].imageLayout = (VkImageLayout)pTexture->mDesc.mBaseLayout;
+            vkImageInfos[cursor].sampler = VK_NULL_HANDLE;
+            cursor++;
+        }
+    }
+
+    vkUpdateDescriptorSets(pRenderer->mVkDevice, rangeCount, vkWrites, 0, NULL);
+    pTable->mWrites += descriptorCount;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "../core/base.hpp"
+#include "../core/memory.hpp"
+#include "descriptor.hpp"
+#include "descriptor_cache.hpp"
+
+struct Renderer;
+struct Texture;
+struct DescriptorSet;
+
+// Bindless texture table
+// One texture array descriptor, slot i holding the texture whose HND_INDEX(mHandle) is i
+// and the fallback texture when there's none. Textures are set and removed one by one,
+// each change marks its slot dirty and flushBindlessTable writes the dirty slots only,
+// consecutive ones in a single write, instead of the whole array.
+//
+// Frames in flight may still sample a removed texture's slot, so the slot keeps its
+// descriptor until CONCURRENT_FRAMES frames later, then gets the fallback. The set is
+// update after bind with unused slots writable while pending, so writes never wait for
+// the GPU. It comes from a pool of its own holding exactly the table's descriptors, the
+// shared allocators' pools are sized for ordinary sets. The texture must outlive those
+// frames too: with a ResourceManager created with retireFrames = CONCURRENT_FRAMES,
+// destroyTexture keeps both the texture and its handle slot until then.
+//
+//  initTexture(&resMan, desc, &pTexture);
+//  setBindlessTexture(&table, pTexture);
+//  ...every frame, after acquireNextImage
+//  flushBindlessTable(pRenderer, &table);
+//  recycleResourceSlots(&resMan, pRenderer->mFrameCount);
+//  cmdBindDescriptorSet(pCmd, pPipeline, table.pSet, 0);
+//  ...
+//  removeBindlessTexture(&table, pTexture, pRenderer->mFrameCount);
+//  destroyTexture(&resMan, &pTexture);     // Removed CONCURRENT_FRAMES frames later
+struct BindlessTableDesc
+{
+    DescriptorType  mType       = DESCRIPTOR_TEXTURE;  // Or DESCRIPTOR_STORAGE_IMAGE
+    uint32          mCapacity   = 1024;                 // Slots, max handle index + 1
+    Texture*        pFallback   = NULL;
+};
+
+// Consecutive dirty slots
+struct BindlessRange
+{
+    uint32  mFirst  = 0;
+    uint32  mCount  = 0;
+};
+
+struct BindlessTable
+{
+    BindlessTableDesc mDesc = {};
+
+    Texture**   ppTextures      = NULL;     // Per slot, NULL while the slot retires
+    uint64*     pDirty          = NULL;     // One bit per slot
+    uint32      mDirtyCount     = 0;
+    uint32      mDirtyFirst     = 0;        // Range of words in pDirty with dirty bits
+    uint32      mDirtyLast      = 0;
+
+    // Removed slots waiting for the frames using them, oldest first
+    uint32*     pRetiredSlots   = NULL;     // Ring of mDesc.mCapacity
+    uint64*     pRetiredFrames  = NULL;
+    uint32      mRetiredStart   = 0;
+    uint32      mRetiredCount   = 0;
+
+    DescriptorSet* pSet         = NULL;     // &mSet, NULL without a renderer
+    DescriptorSet mSet          = {};
+    VkDescriptorPool mVkPool    = VK_NULL_HANDLE;
+    Arena       mArena          = {};
+
+    uint64      mWrites         = 0;        // Descriptors written by flushes
+};
+
+// pRenderer may be NULL, keeping only the slot bookkeeping (no descriptor set).
+void    initBindlessTable(Renderer* pRenderer, BindlessTableDesc desc, BindlessTable* pTable);
+void    destroyBindlessTable(Renderer* pRenderer, BindlessTable* pTable);
+// The table's layout, pool and set, unwritten. initBindlessTable calls it with the renderer's.
+void    allocateBindlessSet(DescriptorBackend* pBackend, DescriptorLayoutCache* pLayouts, BindlessTable* pTable);
+void    freeBindlessSet(DescriptorBackend* pBackend, BindlessTable* pTable);
+
+void    setBindlessTexture(BindlessTable* pTable, Texture* pTexture);
+// frame is the one the texture was last used in, usually Renderer::mFrameCount.
+void    removeBindlessTexture(BindlessTable* pTable, Texture* pTexture, uint64 frame);
+// Gives the fallback to slots removed at least CONCURRENT_FRAMES before frame.
+void    retireBindlessSlots(BindlessTable* pTable, uint64 frame);
+// Returns the dirty slots as ranges in pArena and clears them.
+uint32  getBindlessUpdates(BindlessTable* pTable, Arena* pArena, BindlessRange** ppOut);
+Texture* getBindlessTexture(BindlessTable* pTable, uint32 slot);    // The fallback for empty slots
+
+// Retires slots then writes the dirty ones to pSet.
+void    flushBindlessTable(Renderer* pRenderer, BindlessTable* pTable);
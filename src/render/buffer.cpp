@@ -8,6 +8,7 @@ void addBuffer(Renderer* pRenderer, BufferDesc desc, Buffer** ppBuffer, void* pS
     ASSERT(*ppBuffer == NULL);
 
     *ppBuffer = (Buffer*)poolAlloc(&pRenderer->poolBuffers);
+    ASSERT(*ppBuffer);
 
     **ppBuffer = {};
 
@@ -20,22 +21,31 @@ void addBuffer(Renderer* pRenderer, BufferDesc desc, Buffer** ppBuffer, void* pS
 
     VmaAllocationCreateInfo allocInfo = {};
     allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
-    allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;   // TODO_DW: Revise this
+    allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT    // TODO_DW: Revise this
+                    | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    if(desc.mType == BUFFER_TYPE_UPLOAD)
+    {
+        // Written every frame through pushUpload, without flushes
+        allocInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    }
 
     VkBuffer vkBuffer;
     VmaAllocation vkAlloc;
+    VmaAllocationInfo vkAllocInfo = {};
     VkResult ret = vmaCreateBuffer(
             pRenderer->mVkAllocator,
             &info,
             &allocInfo,
             &vkBuffer,
             &vkAlloc,
-            NULL);
+            &vkAllocInfo);
     ASSERTVK(ret);
+    ASSERT(vkAllocInfo.pMappedData);
 
     (*ppBuffer)->mDesc = desc;
     (*ppBuffer)->mVkBuffer = vkBuffer;
     (*ppBuffer)->mVkAllocation = vkAlloc;
+    (*ppBuffer)->pMapped = vkAllocInfo.pMappedData;
 
     if(pSrc)
     {
@@ -68,6 +78,9 @@ uint32 getBufferAlignment(Renderer* pRenderer, Buffer* pBuffer)
             return pRenderer->mVkDeviceProperties.limits.minUniformBufferOffsetAlignment;
         case BUFFER_TYPE_STORAGE:
             return pRenderer->mVkDeviceProperties.limits.minStorageBufferOffsetAlignment;
+        case BUFFER_TYPE_UPLOAD:
+            return MAX(pRenderer->mVkDeviceProperties.limits.minUniformBufferOffsetAlignment,
+                    pRenderer->mVkDeviceProperties.limits.minStorageBufferOffsetAlignment);
         default: return 1;
     }
 }
@@ -78,11 +91,34 @@ void copyToBuffer(Renderer* pRenderer, Buffer* pDst, uint64 dstOffset, void* src
     
     uint32 align = getBufferAlignment(pRenderer, pDst);
     ASSERT(srcSize % align == 0);
+    ASSERT(dstOffset + srcSize <= pDst->mDesc.mSize);
 
-    void* pMapping = NULL;
-    VkResult ret = vmaMapMemory(pRenderer->mVkAllocator, pDst->mVkAllocation, &pMapping);
+    memcpy((byte*)pDst->pMapped + dstOffset, srcData, srcSize);
+    VkResult ret = vmaFlushAllocation(pRenderer->mVkAllocator, pDst->mVkAllocation, dstOffset, srcSize);     // No-op on coherent memory
     ASSERTVK(ret);
-    void* pStart = (void*)((uint64)pMapping + dstOffset);
-    memcpy(pStart, srcData, srcSize);
-    vmaUnmapMemory(pRenderer->mVkAllocator, pDst->mVkAllocation);
+}
+
+UploadAllocation pushUpload(Renderer* pRenderer, uint64 size)
+{
+    ASSERT(pRenderer && pRenderer->pUploadBuffer);
+
+    Buffer* pBuffer = pRenderer->pUploadBuffer;
+    uint64 offset = frameRingPush(&pRenderer->mUploadRing, size, getBufferAlignment(pRenderer, pBuffer));
+    ASSERTF(offset != FRAME_RING_FULL, "Upload ring full, %llu bytes pushed this frame (RendererDesc::mUploadFrameSize)",
+            pRenderer->mUploadRing.mOffset);
+    if(offset == FRAME_RING_FULL) return {};
+
+    UploadAllocation result = {};
+    result.pBuffer = pBuffer;
+    result.mOffset = offset;
+    result.pData = (byte*)pBuffer->pMapped + offset;
+    return result;
+}
+
+UploadAllocation pushUpload(Renderer* pRenderer, void* pSrc, uint64 size)
+{
+    ASSERT(pSrc);
+    UploadAllocation result = pushUpload(pRenderer, size);
+    if(result.pData) memcpy(result.pData, pSrc, size);
+    return result;
 }
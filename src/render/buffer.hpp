@@ -19,6 +19,11 @@ enum BufferType : uint32
     BUFFER_TYPE_INDIRECT        = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
                                 | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
                                 | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    BUFFER_TYPE_UPLOAD          = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT     // Renderer's upload ring
+                                | VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+                                | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT
+                                | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                                | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 };
 
 struct BufferDesc
@@ -37,6 +42,7 @@ struct Buffer
 
     VkBuffer        mVkBuffer           = VK_NULL_HANDLE;
     VmaAllocation   mVkAllocation       = VK_NULL_HANDLE;
+    void*           pMapped             = NULL;     // Persistently mapped for the buffer's lifetime
 };
 
 void addBuffer(Renderer* pRenderer, BufferDesc desc, Buffer** ppBuffer, void* pSrc = NULL);
@@ -44,3 +50,19 @@ void removeBuffer(Renderer* pRenderer, Buffer** ppBuffer);
 
 uint32  getBufferAlignment(Renderer* pRenderer, Buffer* pBuffer);
 void    copyToBuffer(Renderer* pRenderer, Buffer* pDst, uint64 dstOffset, void* srcData, uint64 srcSize);
+
+// --------------------------------------
+// Upload ring
+// Per frame data (dynamic uniforms, storage, vertices) is pushed to one persistently
+// mapped buffer split in CONCURRENT_FRAMES regions (see FrameRing). acquireNextImage
+// waits for the frame's fence and recycles its region, push after it. Offsets are
+// aligned for dynamic uniform and storage descriptors.
+struct UploadAllocation
+{
+    Buffer* pBuffer = NULL;     // The renderer's upload buffer, NULL when the frame's region is full
+    uint64  mOffset = 0;        // For dynamic descriptor offsets and vertex/index binds
+    void*   pData   = NULL;     // Mapped, write only
+};
+
+UploadAllocation pushUpload(Renderer* pRenderer, uint64 size);
+UploadAllocation pushUpload(Renderer* pRenderer, void* pSrc, uint64 size);
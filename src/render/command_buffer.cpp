@@ -1,91 +1,155 @@
 #include "command_buffer.hpp"
 #include "render.hpp"
 #include "../core/debug.hpp"
+#include "../core/jobs.hpp"
 #include "vulkan/vulkan_core.h"
 
 void initCommandBuffers(Renderer* pRenderer)
 {
     ASSERT(pRenderer);
 
-    VkCommandBuffer vkCommandBuffers[MAX_COMMAND_BUFFERS];
+    uint32 threadCount = pRenderer->mDesc.pJobs ? pRenderer->mDesc.pJobs->mWorkerCount : 1;
+    ASSERT(threadCount <= MAX_COMMAND_THREADS);
+    pRenderer->mCommandThreadCount = threadCount;
+
+    // Command buffers are only allocated once a thread records, pools are cheap
+    for(uint32 frame = 0; frame < CONCURRENT_FRAMES; frame++)
+    {
+        for(uint32 i = 0; i < pRenderer->mCommandThreadCount; i++)
+        {
+            CommandPool* pPool = &pRenderer->mCommandPools[frame][i];
+            *pPool = {};
+
+            VkCommandPoolCreateInfo info = {};
+            info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            info.queueFamilyIndex = pRenderer->mVkQueueFamily;
+            info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            VkResult ret = vkCreateCommandPool(pRenderer->mVkDevice, &info, NULL, &pPool->mVkPool);
+            ASSERTVK(ret);
+        }
+    }
+
     VkCommandBufferAllocateInfo info = {};
     info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     info.commandPool = pRenderer->mVkCommandPool;
     info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    info.commandBufferCount = MAX_COMMAND_BUFFERS;
-    VkResult ret = vkAllocateCommandBuffers(pRenderer->mVkDevice, &info, vkCommandBuffers);
+    info.commandBufferCount = 1;
+    VkResult ret = vkAllocateCommandBuffers(pRenderer->mVkDevice, &info, &pRenderer->mImmediateCmd.mVkCmd);
     ASSERTVK(ret);
+    pRenderer->mImmediateCmd.mState = COMMAND_BUFFER_IDLE;
+    pRenderer->mImmediateCmd.mVkFence = pRenderer->mVkImmediateFence;
+}
+
+void destroyCommandBuffers(Renderer* pRenderer)
+{
+    ASSERT(pRenderer);
 
-    for(uint32 i = 0; i < MAX_COMMAND_BUFFERS; i++)
+    // Destroying a pool frees its command buffers
+    for(uint32 frame = 0; frame < CONCURRENT_FRAMES; frame++)
     {
-        pRenderer->mCommandBuffers[i].mState = COMMAND_BUFFER_IDLE;
-        pRenderer->mCommandBuffers[i].mVkCmd = vkCommandBuffers[i];
-        pRenderer->mCommandBuffers[i].mVkFence = VK_NULL_HANDLE;
+        for(uint32 i = 0; i < pRenderer->mCommandThreadCount; i++)
+        {
+            vkDestroyCommandPool(pRenderer->mVkDevice, pRenderer->mCommandPools[frame][i].mVkPool, NULL);
+            pRenderer->mCommandPools[frame][i] = {};
+        }
     }
+    vkFreeCommandBuffers(pRenderer->mVkDevice, pRenderer->mVkCommandPool, 1, &pRenderer->mImmediateCmd.mVkCmd);
+    pRenderer->mImmediateCmd = {};
+    pRenderer->mCommandThreadCount = 0;
 }
 
-CommandBuffer* getCmd(Renderer* pRenderer, bool immediate)
+void resetCommandPools(Renderer* pRenderer, uint32 frame)
 {
-    VkFence fence;
-    if(immediate)
-    {
-        // Immediate command buffers already wait right after submit
-        fence = pRenderer->mVkImmediateFence;
-    }
-    else
+    ASSERT(pRenderer && frame < CONCURRENT_FRAMES);
+
+    for(uint32 i = 0; i < pRenderer->mCommandThreadCount; i++)
     {
-        // Wait for this frame's fence to signal before recording another command buffer to it
-        fence = pRenderer->mVkFences[pRenderer->mActiveFrame];
-        VkResult ret = vkWaitForFences(pRenderer->mVkDevice, 1, &fence, VK_TRUE, MAX_UINT64);
+        CommandPool* pPool = &pRenderer->mCommandPools[frame][i];
+        if(!pPool->mPrimaryUsed && !pPool->mSecondaryUsed) continue;
+
+        // One reset for every command buffer the pool handed out
+        VkResult ret = vkResetCommandPool(pRenderer->mVkDevice, pPool->mVkPool, 0);
         ASSERTVK(ret);
+        for(uint32 j = 0; j < pPool->mPrimaryUsed; j++)
+        {
+            pPool->mPrimary[j].mState = COMMAND_BUFFER_IDLE;
+        }
+        for(uint32 j = 0; j < pPool->mSecondaryUsed; j++)
+        {
+            pPool->mSecondary[j].mState = COMMAND_BUFFER_IDLE;
+        }
+        pPool->mPrimaryUsed = 0;
+        pPool->mSecondaryUsed = 0;
     }
+}
 
-    CommandBuffer* pOutCmd = NULL;
+// Of the calling thread, for the active frame
+CommandPool* getCommandPool(Renderer* pRenderer)
+{
+    uint32 thread = pRenderer->mDesc.pJobs ? getJobWorkerIndex(pRenderer->mDesc.pJobs) : 0;
+    ASSERT(thread < pRenderer->mCommandThreadCount);
+    return &pRenderer->mCommandPools[pRenderer->mActiveFrame][thread];
+}
 
-    // Find an idle command buffer
-    for(uint32 i = 0; i < MAX_COMMAND_BUFFERS; i++)
+CommandBuffer* takeCommandBuffer(Renderer* pRenderer, CommandPool* pPool, bool secondary)
+{
+    CommandBuffer* pCmds = secondary ? pPool->mSecondary : pPool->mPrimary;
+    uint32* pUsed = secondary ? &pPool->mSecondaryUsed : &pPool->mPrimaryUsed;
+    uint32* pCount = secondary ? &pPool->mSecondaryCount : &pPool->mPrimaryCount;
+    ASSERTF(*pUsed < MAX_COMMAND_BUFFERS, "Out of %s command buffers this frame", secondary ? "secondary" : "primary");
+    if(*pUsed == MAX_COMMAND_BUFFERS) return NULL;
+
+    if(*pUsed == *pCount)
     {
-        CommandBuffer* pCmd = &pRenderer->mCommandBuffers[i];
-        if(pCmd->mState == COMMAND_BUFFER_IDLE)
-        {
-            pOutCmd = pCmd;
-            break;
-        }
+        VkCommandBufferAllocateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        info.commandPool = pPool->mVkPool;
+        info.level = secondary ? VK_COMMAND_BUFFER_LEVEL_SECONDARY : VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        info.commandBufferCount = 1;
+        CommandBuffer* pCmd = &pCmds[*pCount];
+        *pCmd = {};
+        VkResult ret = vkAllocateCommandBuffers(pRenderer->mVkDevice, &info, &pCmd->mVkCmd);
+        ASSERTVK(ret);
+        pCmd->mState = COMMAND_BUFFER_IDLE;
+        pCmd->mSecondary = secondary;
+        (*pCount)++;
     }
 
-    if(!pOutCmd)
+    CommandBuffer* pCmd = &pCmds[(*pUsed)++];
+    ASSERT(pCmd->mState == COMMAND_BUFFER_IDLE);
+    return pCmd;
+}
+
+CommandBuffer* getCmd(Renderer* pRenderer, bool immediate)
+{
+    ASSERT(pRenderer);
+
+    if(immediate)
     {
-        // Look for a submitted command buffer, then reset it to idle if finished.
-        for(uint32 i = 0; i < MAX_COMMAND_BUFFERS; i++)
-        {
-            CommandBuffer* pCmd = &pRenderer->mCommandBuffers[i];
-            if(pCmd->mState == COMMAND_BUFFER_SUBMITTED)
-            {
-                ASSERT(pCmd->mVkFence != VK_NULL_HANDLE);
-                VkResult ret = vkGetFenceStatus(pRenderer->mVkDevice, pCmd->mVkFence);
-                if(ret == VK_SUCCESS)
-                {
-                    pOutCmd = pCmd;
-                    break;
-                }
-            }
-        }
+        // submitImmediateCmd already waited for the last one
+        CommandBuffer* pCmd = &pRenderer->mImmediateCmd;
+        ASSERT(pCmd->mState == COMMAND_BUFFER_IDLE || pCmd->mState == COMMAND_BUFFER_SUBMITTED);
+        VkResult ret = vkResetCommandBuffer(pCmd->mVkCmd, 0);
+        ASSERTVK(ret);
+        ret = vkResetFences(pRenderer->mVkDevice, 1, &pCmd->mVkFence);
+        ASSERTVK(ret);
+        pCmd->mState = COMMAND_BUFFER_IDLE;
+        return pCmd;
     }
 
-    VkResult ret = vkResetCommandBuffer(pOutCmd->mVkCmd, 0);
-    ASSERTVK(ret);
-    pOutCmd->mVkFence = fence;
-    ret = vkResetFences(pRenderer->mVkDevice, 1, &pOutCmd->mVkFence);
-    ASSERTVK(ret);
-    pOutCmd->mState = COMMAND_BUFFER_IDLE;
+    return takeCommandBuffer(pRenderer, getCommandPool(pRenderer), false);
+}
 
-    ASSERT(pOutCmd);
-    return pOutCmd;
+CommandBuffer* getSecondaryCmd(Renderer* pRenderer)
+{
+    ASSERT(pRenderer);
+    return takeCommandBuffer(pRenderer, getCommandPool(pRenderer), true);
 }
 
 void beginCmd(CommandBuffer* pCmd)
 {
     ASSERT(pCmd && pCmd->mState == COMMAND_BUFFER_IDLE);
+    ASSERT(!pCmd->mSecondary);
 
     VkCommandBufferBeginInfo info = {};
     info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -96,6 +160,45 @@ void beginCmd(CommandBuffer* pCmd)
     pCmd->mState = COMMAND_BUFFER_RECORDING;
 }
 
+void beginSecondaryCmd(CommandBuffer* pCmd, RenderTargetBindDesc* pTargets)
+{
+    ASSERT(pCmd && pCmd->mState == COMMAND_BUFFER_IDLE);
+    ASSERT(pCmd->mSecondary && pTargets);
+
+    // Has to match the primary's cmdBindRenderTargets
+    VkFormat vkColorFormats[MAX_PIPELINE_RENDER_TARGETS];
+    for(uint32 i = 0; i < pTargets->mColorCount; i++)
+    {
+        vkColorFormats[i] = (VkFormat)pTargets->mColorBindings[i].pTarget->mDesc.mFormat;
+    }
+    RenderTarget* pMainTarget = pTargets->mColorCount
+        ? pTargets->mColorBindings[0].pTarget
+        : pTargets->mDepthBinding.pTarget;
+    ASSERT(pMainTarget);
+
+    VkCommandBufferInheritanceRenderingInfo renderingInfo = {};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    renderingInfo.colorAttachmentCount = pTargets->mColorCount;
+    renderingInfo.pColorAttachmentFormats = vkColorFormats;
+    renderingInfo.depthAttachmentFormat = pTargets->mDepthBinding.pTarget
+        ? (VkFormat)pTargets->mDepthBinding.pTarget->mDesc.mFormat
+        : VK_FORMAT_UNDEFINED;
+    renderingInfo.rasterizationSamples = (VkSampleCountFlagBits)pMainTarget->mDesc.mSamples;
+
+    VkCommandBufferInheritanceInfo inheritanceInfo = {};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.pNext = &renderingInfo;
+
+    VkCommandBufferBeginInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    info.pInheritanceInfo = &inheritanceInfo;
+    VkResult ret = vkBeginCommandBuffer(pCmd->mVkCmd, &info);
+    ASSERTVK(ret);
+
+    pCmd->mState = COMMAND_BUFFER_RECORDING;
+}
+
 void endCmd(CommandBuffer* pCmd)
 {
     ASSERT(pCmd && pCmd->mState == COMMAND_BUFFER_RECORDING);
@@ -106,10 +209,26 @@ void endCmd(CommandBuffer* pCmd)
     pCmd->mState = COMMAND_BUFFER_READY;
 }
 
+void cmdExecuteCmds(CommandBuffer* pCmd, uint32 count, CommandBuffer** ppSecondaryCmds)
+{
+    ASSERT(pCmd && pCmd->mState == COMMAND_BUFFER_RECORDING && !pCmd->mSecondary);
+    ASSERT(count && ppSecondaryCmds);
+
+    ScratchScope scratch;
+    VkCommandBuffer* vkCmds = (VkCommandBuffer*)arenaPush(scratch.pArena, count * sizeof(VkCommandBuffer),
+            alignof(VkCommandBuffer));
+    for(uint32 i = 0; i < count; i++)
+    {
+        ASSERT(ppSecondaryCmds[i]->mSecondary && ppSecondaryCmds[i]->mState == COMMAND_BUFFER_READY);
+        vkCmds[i] = ppSecondaryCmds[i]->mVkCmd;
+    }
+    vkCmdExecuteCommands(pCmd->mVkCmd, count, vkCmds);
+}
+
 void submitFrameCmd(Renderer* pRenderer, CommandBuffer* pCmd)
 {
     ASSERT(pRenderer);
-    ASSERT(pCmd && pCmd->mState == COMMAND_BUFFER_READY);
+    ASSERT(pCmd && pCmd->mState == COMMAND_BUFFER_READY && !pCmd->mSecondary);
 
     VkSubmitInfo info = {};
     info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -126,19 +245,32 @@ void submitFrameCmd(Renderer* pRenderer, CommandBuffer* pCmd)
     info.signalSemaphoreCount = 1;
     info.pSignalSemaphores = &vkRenderSemaphore;
 
-    VkResult ret = vkQueueSubmit(pRenderer->mVkQueue, 
+    // acquireNextImage waited for it, it signals once this and everything before it is done
+    VkFence vkFence = pRenderer->mVkFences[pRenderer->mActiveFrame];
+    VkResult ret = vkResetFences(pRenderer->mVkDevice, 1, &vkFence);
+    ASSERTVK(ret);
+    ret = vkQueueSubmit(pRenderer->mVkQueue, 
             1, 
             &info, 
-            pCmd->mVkFence);
+            vkFence);
     ASSERTVK(ret);
 
     pCmd->mState = COMMAND_BUFFER_SUBMITTED;
 }
 
 void submitImmediateCmd(Renderer* pRenderer, CommandBuffer* pCmd)
+{
+    ASSERT(pCmd && pCmd->mVkFence);
+    submitCmd(pRenderer, pCmd);
+
+    VkResult ret = vkWaitForFences(pRenderer->mVkDevice, 1, &pCmd->mVkFence, VK_TRUE, MAX_UINT64);
+    ASSERTVK(ret);
+}
+
+void submitCmd(Renderer* pRenderer, CommandBuffer* pCmd)
 {
     ASSERT(pRenderer);
-    ASSERT(pCmd && pCmd->mState == COMMAND_BUFFER_READY);
+    ASSERT(pCmd && pCmd->mState == COMMAND_BUFFER_READY && !pCmd->mSecondary);
 
     VkSubmitInfo info = {};
     info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -149,7 +281,4 @@ void submitImmediateCmd(Renderer* pRenderer, CommandBuffer* pCmd)
     ASSERTVK(ret);
 
     pCmd->mState = COMMAND_BUFFER_SUBMITTED;
-
-    ret = vkWaitForFences(pRenderer->mVkDevice, 1, &pCmd->mVkFence, VK_TRUE, MAX_UINT64);
-    ASSERTVK(ret);
 }
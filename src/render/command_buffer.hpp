@@ -1,8 +1,10 @@
 #pragma once
 #include "../core/base.hpp"
+#include "../core/jobs.hpp"
 #include "vulkan/vulkan_core.h"
 
 struct Renderer;
+struct RenderTargetBindDesc;
 
 enum CommandBufferState
 {
@@ -19,14 +21,47 @@ struct CommandBuffer
 
     VkCommandBuffer mVkCmd = VK_NULL_HANDLE;
     VkFence mVkFence = VK_NULL_HANDLE;
+    bool mSecondary = false;
 };
 
-#define MAX_COMMAND_BUFFERS 16
+// Command pools
+// Each frame in flight has one pool per recording thread (job system workers, or just
+// the calling thread without one). Command buffers are handed out in order from the
+// calling thread's pool of the active frame, allocated the first time the pool runs
+// out, and all come back at once when acquireNextImage resets the frame's pools after
+// its fence signaled. Frame command buffers have no fence of their own, the frame's
+// fence covers everything submitted before it.
+//
+// Secondary command buffers let workers record draws of one render pass concurrently,
+// the pass is bound with mSecondaryCmds set and they run with cmdExecuteCmds.
+#define MAX_COMMAND_BUFFERS     16      // Of each level, per pool
+#define MAX_COMMAND_THREADS     JOB_MAX_WORKERS     // Any worker may record
+
+struct CommandPool
+{
+    VkCommandPool mVkPool = VK_NULL_HANDLE;
+
+    CommandBuffer mPrimary[MAX_COMMAND_BUFFERS];
+    CommandBuffer mSecondary[MAX_COMMAND_BUFFERS];
+    uint32 mPrimaryCount    = 0;    // Allocated
+    uint32 mPrimaryUsed     = 0;    // Handed out this frame
+    uint32 mSecondaryCount  = 0;
+    uint32 mSecondaryUsed   = 0;
+};
 
 void initCommandBuffers(Renderer* pRenderer);
+void destroyCommandBuffers(Renderer* pRenderer);
+void resetCommandPools(Renderer* pRenderer, uint32 frame);    // Only once the frame's fence signaled
 
+// Immediate command buffers are single, submit each before getting the next one.
+// Returns NULL when the thread's pool is out of command buffers.
 CommandBuffer* getCmd(Renderer* pRenderer, bool immediate = false);
+CommandBuffer* getSecondaryCmd(Renderer* pRenderer);
 void beginCmd(CommandBuffer* pCmd);
+// Secondary command buffers record inside the bound render targets of the primary.
+void beginSecondaryCmd(CommandBuffer* pCmd, RenderTargetBindDesc* pTargets);
 void endCmd(CommandBuffer* pCmd);
+void cmdExecuteCmds(CommandBuffer* pCmd, uint32 count, CommandBuffer** ppSecondaryCmds);
 void submitFrameCmd(Renderer* pRenderer, CommandBuffer* pCmd);
 void submitImmediateCmd(Renderer* pRenderer, CommandBuffer* pCmd);
+void submitCmd(Renderer* pRenderer, CommandBuffer* pCmd);   // Doesn't wait, poll pCmd->mVkFence if it has one
@@ -6,17 +6,14 @@
 #include "../core/memory.hpp"
 #include "vulkan/vulkan_core.h"
 
-void addDescriptorSet(Renderer* pRenderer, DescriptorSetDesc desc, DescriptorSet** ppSet)
-{
-    ASSERT(pRenderer && ppSet);
-    ASSERT(*ppSet == NULL);
-    ASSERT(desc.mCount);
-
-    *ppSet = (DescriptorSet*)poolAlloc(&pRenderer->poolDescriptorSets);
-
-    **ppSet = {};
+// --------------------------------------
+// Vulkan descriptor backend, pUserData is the Renderer
 
-    uint32 count = desc.mCount;
+VkDescriptorSetLayout createVkDescriptorSetLayout(void* pUserData, DescriptorSetDesc* pDesc)
+{
+    Renderer* pRenderer = (Renderer*)pUserData;
+    uint32 count = pDesc->mCount;
+    bool updateAfterBind = isUpdateAfterBind(pDesc);
     VkDescriptorSetLayoutBinding    vkBindings[count];
     VkDescriptorBindingFlags        vkBindingFlags[count];
     for(uint32 i = 0; i < count; i++)
@@ -24,14 +21,20 @@ void addDescriptorSet(Renderer* pRenderer, DescriptorSetDesc desc, DescriptorSet
         vkBindings[i] = {};
         vkBindings[i].binding = i;
         vkBindings[i].stageFlags = VK_SHADER_STAGE_ALL;
-        vkBindings[i].descriptorType = (VkDescriptorType)desc.mResources[i].mType;
+        vkBindings[i].descriptorType = (VkDescriptorType)pDesc->mResources[i].mType;
         // Here the descriptor count must be >= the max index statically used by the shader.
         // The actual count is bound later, using partially bound descriptor sets.
-        vkBindings[i].descriptorCount = (VkDescriptorType)desc.mResources[i].mMaxCount;
+        vkBindings[i].descriptorCount = (VkDescriptorType)pDesc->mResources[i].mMaxCount;
 
-        vkBindingFlags[i] =
-            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
-            VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+        // Slots frames in flight don't use can be written meanwhile, see BindlessTable.
+        // Dynamic buffers can't be, their offsets change at bind time instead.
+        vkBindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+        if(!isDynamicDescriptor(pDesc->mResources[i].mType))
+        {
+            vkBindingFlags[i] |=
+                VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+        }
     }
 
     VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = {};
@@ -44,7 +47,7 @@ void addDescriptorSet(Renderer* pRenderer, DescriptorSetDesc desc, DescriptorSet
     layoutInfo.bindingCount = count;
     layoutInfo.pBindings = vkBindings;
     layoutInfo.pNext = &flagsInfo;
-    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.flags = updateAfterBind ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT : 0;
 
     VkDescriptorSetLayout vkLayout;
     VkResult ret = vkCreateDescriptorSetLayout(
@@ -53,37 +56,116 @@ void addDescriptorSet(Renderer* pRenderer, DescriptorSetDesc desc, DescriptorSet
             NULL, 
             &vkLayout);
     ASSERTVK(ret);
+    return vkLayout;
+}
+
+void destroyVkDescriptorSetLayout(void* pUserData, VkDescriptorSetLayout layout)
+{
+    Renderer* pRenderer = (Renderer*)pUserData;
+    vkDestroyDescriptorSetLayout(pRenderer->mVkDevice, layout, NULL);
+}
+
+VkDescriptorPool createVkDescriptorPool(void* pUserData, uint32 maxSets, DescriptorCounts* pCounts, bool freeable,
+        bool updateAfterBind)
+{
+    Renderer* pRenderer = (Renderer*)pUserData;
+    VkDescriptorPoolSize poolSizes[DESCRIPTOR_POOL_TYPES];
+    uint32 sizeCount = 0;
+    for(uint32 i = 0; i < DESCRIPTOR_POOL_TYPES; i++)
+    {
+        if(!pCounts->mCounts[i]) continue;
+        poolSizes[sizeCount] = {};
+        poolSizes[sizeCount].type = getDescriptorPoolType(i);
+        poolSizes[sizeCount].descriptorCount = pCounts->mCounts[i];
+        sizeCount++;
+    }
+
+    VkDescriptorPoolCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    info.poolSizeCount = sizeCount;
+    info.pPoolSizes = poolSizes;
+    info.maxSets = maxSets;
+    info.flags = 0;
+    if(updateAfterBind) info.flags |= VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    if(freeable) info.flags |= VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    VkDescriptorPool vkPool;
+    VkResult ret = vkCreateDescriptorPool(pRenderer->mVkDevice, &info, NULL, &vkPool);
+    ASSERTVK(ret);
+    return vkPool;
+}
+
+void destroyVkDescriptorPool(void* pUserData, VkDescriptorPool pool)
+{
+    Renderer* pRenderer = (Renderer*)pUserData;
+    vkDestroyDescriptorPool(pRenderer->mVkDevice, pool, NULL);
+}
+
+void resetVkDescriptorPool(void* pUserData, VkDescriptorPool pool)
+{
+    Renderer* pRenderer = (Renderer*)pUserData;
+    VkResult ret = vkResetDescriptorPool(pRenderer->mVkDevice, pool, 0);
+    ASSERTVK(ret);
+}
 
+VkResult allocateVkDescriptorSet(void* pUserData, VkDescriptorPool pool,
+        VkDescriptorSetLayout layout, VkDescriptorSet* pOut)
+{
+    Renderer* pRenderer = (Renderer*)pUserData;
     VkDescriptorSetAllocateInfo info = {};
     info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    info.descriptorPool = pRenderer->mVkDescriptorPool;
+    info.descriptorPool = pool;
     info.descriptorSetCount = 1;
-    info.pSetLayouts = &vkLayout;
-    VkDescriptorSet vkSet;
-    ret = vkAllocateDescriptorSets(
-            pRenderer->mVkDevice, 
-            &info, 
-            &vkSet);
+    info.pSetLayouts = &layout;
+    return vkAllocateDescriptorSets(pRenderer->mVkDevice, &info, pOut);
+}
+
+void freeVkDescriptorSet(void* pUserData, VkDescriptorPool pool, VkDescriptorSet set)
+{
+    Renderer* pRenderer = (Renderer*)pUserData;
+    VkResult ret = vkFreeDescriptorSets(pRenderer->mVkDevice, pool, 1, &set);
     ASSERTVK(ret);
+}
 
-    (*ppSet)->mDesc = desc;
-    (*ppSet)->mVkLayout = vkLayout;
-    (*ppSet)->mVkSet = vkSet;
+void initDescriptorBackend(Renderer* pRenderer, DescriptorBackend* pBackend)
+{
+    ASSERT(pRenderer && pBackend);
+
+    *pBackend = {};
+    pBackend->pUserData = pRenderer;
+    pBackend->pfnCreateLayout = createVkDescriptorSetLayout;
+    pBackend->pfnDestroyLayout = destroyVkDescriptorSetLayout;
+    pBackend->pfnCreatePool = createVkDescriptorPool;
+    pBackend->pfnDestroyPool = destroyVkDescriptorPool;
+    pBackend->pfnResetPool = resetVkDescriptorPool;
+    pBackend->pfnAllocateSet = allocateVkDescriptorSet;
+    pBackend->pfnFreeSet = freeVkDescriptorSet;
+}
+
+// --------------------------------------
+// Descriptor sets
+
+void writeDescriptorSet(Renderer* pRenderer, DescriptorSetDesc* pDesc, VkDescriptorSet vkSet)
+{
+    uint32 count = pDesc->mCount;
 
     // Populate descriptor set with descriptors
     uint32 descriptorCount = 0;
     for(uint32 i = 0; i < count; i++)
     {
-        descriptorCount += desc.mResources[i].mCount;
+        descriptorCount += pDesc->mResources[i].mCount;
     }
 
+    // Texture arrays may hold thousands of descriptors, too many for the stack
+    ScratchScope scratch;
     VkWriteDescriptorSet    vkWrites[count];
-    VkDescriptorBufferInfo  vkBufferInfos[descriptorCount];
-    VkDescriptorImageInfo   vkImageInfos[descriptorCount];
+    VkDescriptorBufferInfo* vkBufferInfos = (VkDescriptorBufferInfo*)arenaPush(scratch.pArena,
+            descriptorCount * sizeof(VkDescriptorBufferInfo), alignof(VkDescriptorBufferInfo));
+    VkDescriptorImageInfo*  vkImageInfos = (VkDescriptorImageInfo*)arenaPush(scratch.pArena,
+            descriptorCount * sizeof(VkDescriptorImageInfo), alignof(VkDescriptorImageInfo));
     uint32 cursor = 0;
     for(uint32 i = 0; i < count; i++)
     {
-        Descriptor res = desc.mResources[i];
+        Descriptor res = pDesc->mResources[i];
         vkWrites[i] = {};
         vkWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         vkWrites[i].dstSet = vkSet;
@@ -102,7 +184,7 @@ void addDescriptorSet(Renderer* pRenderer, DescriptorSetDesc desc, DescriptorSet
                 vkBufferInfos[cursor] = {};
                 vkBufferInfos[cursor].buffer = pBuffer->mVkBuffer;
                 vkBufferInfos[cursor].offset = 0;
-                vkBufferInfos[cursor].range = pBuffer->mDesc.mSize;
+                vkBufferInfos[cursor].range = res.mRange ? res.mRange : pBuffer->mDesc.mSize;
                 vkWrites[i].pBufferInfo = &vkBufferInfos[cursor];
                 cursor++;
             } break;
@@ -161,18 +243,52 @@ void addDescriptorSet(Renderer* pRenderer, DescriptorSetDesc desc, DescriptorSet
             0, NULL);
 }
 
-void removeDescriptorSet(Renderer* pRenderer, DescriptorSet** ppSet)
+void addDescriptorSet(Renderer* pRenderer, DescriptorSetDesc desc, DescriptorSet** ppSet)
 {
     ASSERT(pRenderer && ppSet);
+    ASSERT(*ppSet == NULL);
+    ASSERT(desc.mCount);
+
+    *ppSet = (DescriptorSet*)poolAlloc(&pRenderer->poolDescriptorSets);
     ASSERT(*ppSet);
 
-    vkDestroyDescriptorSetLayout(
-            pRenderer->mVkDevice,
-            (*ppSet)->mVkLayout,
-            NULL);
+    **ppSet = {};
+
+    VkDescriptorSetLayout vkLayout = getDescriptorSetLayout(&pRenderer->mDescriptorLayouts, &desc);
+    VkDescriptorPool vkPool;
+    VkDescriptorSet vkSet = allocateDescriptorSet(&pRenderer->mDescriptorAllocator, vkLayout, &desc, &vkPool);
+
+    (*ppSet)->mDesc = desc;
+    (*ppSet)->mVkLayout = vkLayout;
+    (*ppSet)->mVkSet = vkSet;
+    (*ppSet)->mVkPool = vkPool;
+
+    writeDescriptorSet(pRenderer, &desc, vkSet);
+}
+
+void addTransientDescriptorSet(Renderer* pRenderer, DescriptorSetDesc desc, DescriptorSet* pSet)
+{
+    ASSERT(pRenderer && pSet);
+    ASSERT(desc.mCount);
+
+    VkDescriptorSetLayout vkLayout = getDescriptorSetLayout(&pRenderer->mDescriptorLayouts, &desc);
+    DescriptorAllocator* pAllocator = &pRenderer->mFrameDescriptorAllocators[pRenderer->mActiveFrame];
+
+    *pSet = {};
+    pSet->mDesc = desc;
+    pSet->mVkLayout = vkLayout;
+    pSet->mVkSet = allocateDescriptorSet(pAllocator, vkLayout, &desc);
+
+    writeDescriptorSet(pRenderer, &desc, pSet->mVkSet);
+}
+
+void removeDescriptorSet(Renderer* pRenderer, DescriptorSet** ppSet)
+{
+    ASSERT(pRenderer && ppSet);
+    ASSERT(*ppSet);
 
-    // TODO_DW: Descriptor sets are freed with the pool. I might need to
-    // free and recreate the descriptor pool on shader reload.
+    // The layout stays in the cache, other sets and pipelines may share it
+    freeDescriptorSet(&pRenderer->mDescriptorAllocator, (*ppSet)->mVkPool, (*ppSet)->mVkSet);
     **ppSet = {};
 
     poolFree(&pRenderer->poolDescriptorSets, *ppSet);
@@ -1,5 +1,6 @@
 #pragma once
 #include "../core/base.hpp"
+#include "descriptor_cache.hpp"
 #include "vulkan/vulkan_core.h"
 
 struct Renderer;
@@ -17,12 +18,18 @@ enum DescriptorType
     DESCRIPTOR_SAMPLER                = VK_DESCRIPTOR_TYPE_SAMPLER,
 };
 
+inline bool isDynamicDescriptor(DescriptorType type)
+{
+    return type == DESCRIPTOR_DYNAMIC_UNIFORM_BUFFER || type == DESCRIPTOR_DYNAMIC_STORAGE_BUFFER;
+}
+
 struct Descriptor
 {
     DescriptorType mType;
     void* pData = NULL;
     uint32 mCount = 1;
     uint32 mMaxCount = 1;
+    uint64 mRange = 0;      // Buffers, bytes seen from the (dynamic) offset, 0 for the whole buffer
 };
 
 #define MAX_SHADER_RESOURCES_PER_SET 32
@@ -36,9 +43,18 @@ struct DescriptorSet
 {
     DescriptorSetDesc mDesc = {};
 
-    VkDescriptorSetLayout mVkLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout mVkLayout = VK_NULL_HANDLE;     // Shared, see DescriptorLayoutCache
     VkDescriptorSet mVkSet = VK_NULL_HANDLE;
+    VkDescriptorPool mVkPool = VK_NULL_HANDLE;          // NULL for transient sets
 };
 
 void addDescriptorSet(Renderer* pRenderer, DescriptorSetDesc desc, DescriptorSet** ppSet);
+// Writes every resource of pDesc to vkSet, texture arrays whole.
+void writeDescriptorSet(Renderer* pRenderer, DescriptorSetDesc* pDesc, VkDescriptorSet vkSet);
 void removeDescriptorSet(Renderer* pRenderer, DescriptorSet** ppSet);
+// Set for the active frame only, released in bulk when the frame comes around again (see
+// acquireNextImage). pSet is the caller's, it's never removed.
+void addTransientDescriptorSet(Renderer* pRenderer, DescriptorSetDesc desc, DescriptorSet* pSet);
+
+// Fills pBackend with the Vulkan implementation, on the renderer's device.
+void initDescriptorBackend(Renderer* pRenderer, DescriptorBackend* pBackend);
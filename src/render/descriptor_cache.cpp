@@ -0,0 +1,226 @@
+#include "descriptor_cache.hpp"
+#include "descriptor.hpp"
+#include "render.hpp"
+#include "../core/debug.hpp"
+
+// Descriptors per set a pool holds, by type. Texture arrays take one per element.
+struct DescriptorPoolRatio
+{
+    VkDescriptorType mType;
+    uint32 mPerSet;
+};
+
+static const DescriptorPoolRatio gDescriptorPoolRatios[DESCRIPTOR_POOL_TYPES] =
+{
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,            2 },
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,    1 },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,            4 },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,    1 },
+    { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,             16 },
+    { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,             2 },
+    { VK_DESCRIPTOR_TYPE_SAMPLER,                   2 },
+};
+
+VkDescriptorType getDescriptorPoolType(uint32 index)
+{
+    ASSERT(index < DESCRIPTOR_POOL_TYPES);
+    return gDescriptorPoolRatios[index].mType;
+}
+
+DescriptorCounts countDescriptors(DescriptorSetDesc* pDesc)
+{
+    ASSERT(pDesc);
+
+    DescriptorCounts counts = {};
+    for(uint32 i = 0; i < pDesc->mCount; i++)
+    {
+        uint32 type = 0;
+        while(type < DESCRIPTOR_POOL_TYPES
+                && gDescriptorPoolRatios[type].mType != (VkDescriptorType)pDesc->mResources[i].mType) type++;
+        ASSERT(type < DESCRIPTOR_POOL_TYPES);   // Not a type pools are made for
+        counts.mCounts[type] += pDesc->mResources[i].mMaxCount;
+    }
+    return counts;
+}
+
+bool isUpdateAfterBind(DescriptorSetDesc* pDesc)
+{
+    ASSERT(pDesc);
+
+    for(uint32 i = 0; i < pDesc->mCount; i++)
+    {
+        if(!isDynamicDescriptor(pDesc->mResources[i].mType)) return true;
+    }
+    return false;
+}
+
+DescriptorCounts getDescriptorPoolCounts(uint32 maxSets, DescriptorCounts* pMinCounts)
+{
+    DescriptorCounts counts = {};
+    for(uint32 i = 0; i < DESCRIPTOR_POOL_TYPES; i++)
+    {
+        counts.mCounts[i] = maxSets * gDescriptorPoolRatios[i].mPerSet;
+        if(pMinCounts) counts.mCounts[i] = MAX(counts.mCounts[i], pMinCounts->mCounts[i]);
+    }
+    return counts;
+}
+
+Hash128 hashDescriptorSetLayout(DescriptorSetDesc* pDesc)
+{
+    ASSERT(pDesc);
+    ASSERT(pDesc->mCount <= MAX_SHADER_RESOURCES_PER_SET);
+
+    // Bindings only, the resources bound and their counts don't change the layout
+    uint32 key[1 + 2 * MAX_SHADER_RESOURCES_PER_SET];
+    uint32 size = 0;
+    key[size++] = pDesc->mCount;
+    for(uint32 i = 0; i < pDesc->mCount; i++)
+    {
+        key[size++] = (uint32)pDesc->mResources[i].mType;
+        key[size++] = pDesc->mResources[i].mMaxCount;
+    }
+    return hash128((byte*)key, size * sizeof(uint32));
+}
+
+void initDescriptorLayoutCache(DescriptorBackend* pBackend, DescriptorLayoutCache* pCache)
+{
+    ASSERT(pBackend && pCache);
+
+    *pCache = {};
+    pCache->pBackend = pBackend;
+    initArena(KB(64), &pCache->mArena);
+    pCache->mLayouts = hashmap<Hash128, VkDescriptorSetLayout>(&pCache->mArena, DESCRIPTOR_LAYOUT_CACHE_MAX, false);
+    pCache->pCreated = (VkDescriptorSetLayout*)arenaPush(&pCache->mArena,
+            DESCRIPTOR_LAYOUT_CACHE_MAX * sizeof(VkDescriptorSetLayout), alignof(VkDescriptorSetLayout));
+}
+
+void destroyDescriptorLayoutCache(DescriptorLayoutCache* pCache)
+{
+    ASSERT(pCache && pCache->pBackend);
+
+    DescriptorBackend* pBackend = pCache->pBackend;
+    for(uint32 i = 0; i < pCache->mCount; i++)
+    {
+        pBackend->pfnDestroyLayout(pBackend->pUserData, pCache->pCreated[i]);
+    }
+    destroyArena(&pCache->mArena);
+    *pCache = {};
+}
+
+VkDescriptorSetLayout getDescriptorSetLayout(DescriptorLayoutCache* pCache, DescriptorSetDesc* pDesc)
+{
+    ASSERT(pCache && pCache->pBackend && pDesc);
+
+    Hash128 key = hashDescriptorSetLayout(pDesc);
+    VkDescriptorSetLayout* pLayout = pCache->mLayouts.find(key);
+    if(pLayout)
+    {
+        pCache->mHits++;
+        return *pLayout;
+    }
+
+    ASSERT(pCache->mCount < DESCRIPTOR_LAYOUT_CACHE_MAX);     // Too many distinct layouts
+    DescriptorBackend* pBackend = pCache->pBackend;
+    VkDescriptorSetLayout layout = pBackend->pfnCreateLayout(pBackend->pUserData, pDesc);
+    pCache->mLayouts.insert(key, layout);
+    pCache->pCreated[pCache->mCount++] = layout;
+    pCache->mMisses++;
+    return layout;
+}
+
+void initDescriptorAllocator(DescriptorBackend* pBackend, bool freeable, DescriptorAllocator* pAllocator)
+{
+    ASSERT(pBackend && pAllocator);
+
+    *pAllocator = {};
+    pAllocator->pBackend = pBackend;
+    pAllocator->mFreeable = freeable;
+}
+
+void destroyDescriptorAllocator(DescriptorAllocator* pAllocator)
+{
+    ASSERT(pAllocator && pAllocator->pBackend);
+
+    DescriptorBackend* pBackend = pAllocator->pBackend;
+    for(uint32 i = 0; i < pAllocator->mPoolCount; i++)
+    {
+        pBackend->pfnDestroyPool(pBackend->pUserData, pAllocator->mPools[i]);
+    }
+    *pAllocator = {};
+}
+
+VkDescriptorSet allocateDescriptorSet(DescriptorAllocator* pAllocator, VkDescriptorSetLayout layout,
+        DescriptorSetDesc* pDesc, VkDescriptorPool* pOutPool)
+{
+    ASSERT(pAllocator && pAllocator->pBackend && pDesc);
+
+    DescriptorBackend* pBackend = pAllocator->pBackend;
+    bool updateAfterBind = isUpdateAfterBind(pDesc);
+    uint32* pActivePool = &pAllocator->mActivePools[updateAfterBind];
+    while(true)
+    {
+        // Pools of the other kind can't take the set
+        while(*pActivePool < pAllocator->mPoolCount
+                && pAllocator->mPoolsUpdateAfterBind[*pActivePool] != updateAfterBind) (*pActivePool)++;
+
+        bool newPool = *pActivePool == pAllocator->mPoolCount;
+        if(newPool)
+        {
+            // Large enough for this set whatever its arrays, the ratios alone may not be
+            ASSERT(pAllocator->mPoolCount < DESCRIPTOR_ALLOCATOR_MAX_POOLS);
+            DescriptorCounts setCounts = countDescriptors(pDesc);
+            DescriptorCounts poolCounts = getDescriptorPoolCounts(pAllocator->mNextPoolSets, &setCounts);
+            pAllocator->mPools[pAllocator->mPoolCount] = pBackend->pfnCreatePool(pBackend->pUserData,
+                    pAllocator->mNextPoolSets, &poolCounts, pAllocator->mFreeable, updateAfterBind);
+            pAllocator->mPoolsUpdateAfterBind[pAllocator->mPoolCount] = updateAfterBind;
+            pAllocator->mPoolCount++;
+            pAllocator->mNextPoolSets = MIN(pAllocator->mNextPoolSets * 2, DESCRIPTOR_POOL_MAX_SETS);
+        }
+
+        VkDescriptorPool pool = pAllocator->mPools[*pActivePool];
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        VkResult ret = pBackend->pfnAllocateSet(pBackend->pUserData, pool, layout, &set);
+        if(ret == VK_SUCCESS)
+        {
+            pAllocator->mAllocated++;
+            if(pOutPool) *pOutPool = pool;
+            return set;
+        }
+
+        // Fresh pools are sized for the set, only the device can refuse it
+        ASSERTF(!newPool, "[VULKAN] - New descriptor pool can't hold the set, %s", vkResultToStr(ret));
+        ASSERTF(ret == VK_ERROR_OUT_OF_POOL_MEMORY || ret == VK_ERROR_FRAGMENTED_POOL,
+                "[VULKAN] - %s", vkResultToStr(ret));
+        (*pActivePool)++;
+    }
+}
+
+void freeDescriptorSet(DescriptorAllocator* pAllocator, VkDescriptorPool pool, VkDescriptorSet set)
+{
+    ASSERT(pAllocator && pAllocator->pBackend);
+    ASSERT(pAllocator->mFreeable && pAllocator->mAllocated);
+
+    uint32 index = 0;
+    while(index < pAllocator->mPoolCount && pAllocator->mPools[index] != pool) index++;
+    ASSERT(index < pAllocator->mPoolCount);     // Not a pool of this allocator
+
+    DescriptorBackend* pBackend = pAllocator->pBackend;
+    pBackend->pfnFreeSet(pBackend->pUserData, pool, set);
+    uint32* pActivePool = &pAllocator->mActivePools[pAllocator->mPoolsUpdateAfterBind[index]];
+    *pActivePool = MIN(*pActivePool, index);
+    pAllocator->mAllocated--;
+}
+
+void resetDescriptorAllocator(DescriptorAllocator* pAllocator)
+{
+    ASSERT(pAllocator && pAllocator->pBackend);
+
+    DescriptorBackend* pBackend = pAllocator->pBackend;
+    for(uint32 i = 0; i < pAllocator->mPoolCount; i++)
+    {
+        pBackend->pfnResetPool(pBackend->pUserData, pAllocator->mPools[i]);
+    }
+    pAllocator->mActivePools[0] = 0;
+    pAllocator->mActivePools[1] = 0;
+    pAllocator->mAllocated = 0;
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include "../core/base.hpp"
+#include "../core/memory.hpp"
+#include "../core/string.hpp"
+#include "../core/hash_map.hpp"
+#include "vulkan/vulkan_core.h"
+
+struct DescriptorSetDesc;
+
+// Descriptor layout cache and allocators
+// Set layouts are created once per distinct binding list (types and max counts, see
+// hashDescriptorSetLayout) and shared by every set and pipeline using it, until the
+// cache is destroyed. A layout is a handful of bytes, so they're never freed earlier.
+//
+// Sets are allocated from pools of pools. An allocator starts with one pool and adds
+// another, twice as big up to DESCRIPTOR_POOL_MAX_SETS, whenever every pool it has is
+// out of room. Pools hold a few descriptors of each type per set (see
+// gDescriptorPoolRatios), and never fewer than the set that needs the new pool, so
+// large arrays get a pool that fits them. Persistent allocators free sets one by one
+// and refill the first pool with room. Transient ones never free:
+// resetDescriptorAllocator resets all their pools at once, which is how per frame sets
+// are released.
+//
+// Bindings other than dynamic buffers can be written after the set is bound (see
+// isUpdateAfterBind). Their sets need pools created for it, so allocators keep
+// those pools apart from the ones for sets made of dynamic buffers only.
+//
+// Every call into the graphics API goes through a DescriptorBackend, tests replace
+// the Vulkan one with a fake to run without a device.
+#define DESCRIPTOR_LAYOUT_CACHE_MAX     256
+#define DESCRIPTOR_ALLOCATOR_MAX_POOLS  32
+#define DESCRIPTOR_POOL_MIN_SETS        64
+#define DESCRIPTOR_POOL_MAX_SETS        4096
+#define DESCRIPTOR_POOL_TYPES           7
+
+// Descriptors of each type a pool holds or a set needs, in gDescriptorPoolRatios order
+struct DescriptorCounts
+{
+    uint32 mCounts[DESCRIPTOR_POOL_TYPES] = {};
+};
+
+VkDescriptorType    getDescriptorPoolType(uint32 index);
+DescriptorCounts    countDescriptors(DescriptorSetDesc* pDesc);     // Bindings' max counts
+// Whether the set has bindings written after bind, any but dynamic buffers: those have
+// their offsets bound instead and Vulkan doesn't allow updating them after bind.
+bool                isUpdateAfterBind(DescriptorSetDesc* pDesc);
+// maxSets sets at the usual ratios, at least pMinCounts (may be NULL).
+DescriptorCounts    getDescriptorPoolCounts(uint32 maxSets, DescriptorCounts* pMinCounts);
+
+struct DescriptorBackend
+{
+    void* pUserData = NULL;
+
+    VkDescriptorSetLayout   (*pfnCreateLayout)(void* pUserData, DescriptorSetDesc* pDesc) = NULL;
+    void                    (*pfnDestroyLayout)(void* pUserData, VkDescriptorSetLayout layout) = NULL;
+    // pCounts descriptors of each type, freeable pools allow pfnFreeSet on their sets.
+    // Only updateAfterBind pools can hold sets whose isUpdateAfterBind is true.
+    VkDescriptorPool        (*pfnCreatePool)(void* pUserData, uint32 maxSets, DescriptorCounts* pCounts,
+                                    bool freeable, bool updateAfterBind) = NULL;
+    void                    (*pfnDestroyPool)(void* pUserData, VkDescriptorPool pool) = NULL;
+    void                    (*pfnResetPool)(void* pUserData, VkDescriptorPool pool) = NULL;
+    // Returns VK_ERROR_OUT_OF_POOL_MEMORY or VK_ERROR_FRAGMENTED_POOL when the pool is full
+    VkResult                (*pfnAllocateSet)(void* pUserData, VkDescriptorPool pool,
+                                    VkDescriptorSetLayout layout, VkDescriptorSet* pOut) = NULL;
+    void                    (*pfnFreeSet)(void* pUserData, VkDescriptorPool pool, VkDescriptorSet set) = NULL;
+};
+
+struct DescriptorLayoutCache
+{
+    DescriptorBackend*      pBackend    = NULL;
+    HashMap<Hash128, VkDescriptorSetLayout> mLayouts = {};
+    VkDescriptorSetLayout*  pCreated    = NULL;     // Layouts in mLayouts, DESCRIPTOR_LAYOUT_CACHE_MAX
+    uint32                  mCount      = 0;
+    Arena                   mArena      = {};
+
+    uint64                  mHits       = 0;
+    uint64                  mMisses     = 0;
+};
+
+void    initDescriptorLayoutCache(DescriptorBackend* pBackend, DescriptorLayoutCache* pCache);
+void    destroyDescriptorLayoutCache(DescriptorLayoutCache* pCache);    // Destroys every layout
+VkDescriptorSetLayout getDescriptorSetLayout(DescriptorLayoutCache* pCache, DescriptorSetDesc* pDesc);
+
+// Of what the set's layout is made of: binding types and max counts.
+Hash128 hashDescriptorSetLayout(DescriptorSetDesc* pDesc);
+
+struct DescriptorAllocator
+{
+    DescriptorBackend*  pBackend    = NULL;
+    bool                mFreeable   = false;
+    VkDescriptorPool    mPools[DESCRIPTOR_ALLOCATOR_MAX_POOLS];
+    bool                mPoolsUpdateAfterBind[DESCRIPTOR_ALLOCATOR_MAX_POOLS];
+    uint32              mPoolCount  = 0;
+    // Allocations start here, the pools of the same kind before it are full. Indexed by
+    // isUpdateAfterBind.
+    uint32              mActivePools[2] = {};
+    uint32              mNextPoolSets = DESCRIPTOR_POOL_MIN_SETS;
+
+    uint64              mAllocated  = 0;    // Sets live, or since the last reset
+};
+
+// Persistent allocators are freeable, transient ones are reset in bulk.
+void    initDescriptorAllocator(DescriptorBackend* pBackend, bool freeable, DescriptorAllocator* pAllocator);
+void    destroyDescriptorAllocator(DescriptorAllocator* pAllocator);
+// pDesc is the one layout was made from. Returns the pool the set came from in pOutPool,
+// needed to free it.
+VkDescriptorSet allocateDescriptorSet(DescriptorAllocator* pAllocator, VkDescriptorSetLayout layout,
+        DescriptorSetDesc* pDesc, VkDescriptorPool* pOutPool = NULL);
+void    freeDescriptorSet(DescriptorAllocator* pAllocator, VkDescriptorPool pool, VkDescriptorSet set);
+void    resetDescriptorAllocator(DescriptorAllocator* pAllocator);     // Every set allocated is released
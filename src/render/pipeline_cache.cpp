@@ -0,0 +1,206 @@
+#include "pipeline_cache.hpp"
+#include "render.hpp"
+#include "../core/debug.hpp"
+#include "../core/file.hpp"
+
+// Largest graphics key: every render target, set, vertex attribute and constant block
+#define PIPELINE_KEY_MAX_SIZE 1024
+
+// Fields are written one by one, never whole structs, so padding and unused array slots
+// stay out of the key
+struct PipelineKey
+{
+    byte    mData[PIPELINE_KEY_MAX_SIZE];
+    uint32  mSize = 0;
+};
+
+void pushPipelineKey(PipelineKey* pKey, void* pData, uint32 size)
+{
+    ASSERT(pKey->mSize + size <= PIPELINE_KEY_MAX_SIZE);
+    memcpy(pKey->mData + pKey->mSize, pData, size);
+    pKey->mSize += size;
+}
+
+void pushPipelineKey(PipelineKey* pKey, uint32 value)
+{
+    pushPipelineKey(pKey, &value, sizeof(value));
+}
+
+void pushPipelineKey(PipelineKey* pKey, Hash128 value)
+{
+    pushPipelineKey(pKey, &value, sizeof(value));
+}
+
+void pushPipelineLayoutKey(PipelineKey* pKey, DescriptorSet** ppSets, uint32 setCount,
+        ConstantBlock* pBlocks, uint32 blockCount)
+{
+    pushPipelineKey(pKey, setCount);
+    for(uint32 i = 0; i < setCount; i++)
+    {
+        ASSERT(ppSets[i]);
+        pushPipelineKey(pKey, hashDescriptorSetLayout(&ppSets[i]->mDesc));
+    }
+    pushPipelineKey(pKey, blockCount);
+    for(uint32 i = 0; i < blockCount; i++)
+    {
+        pushPipelineKey(pKey, pBlocks[i].mShaderTypes);
+        pushPipelineKey(pKey, pBlocks[i].mSize);
+    }
+}
+
+Hash128 hashPipelineDesc(GraphicsPipelineDesc* pDesc)
+{
+    ASSERT(pDesc && pDesc->pVS && pDesc->pFS);
+    ASSERT(pDesc->mRenderTargetCount <= MAX_PIPELINE_RENDER_TARGETS);
+
+    PipelineKey key;
+
+    // Attachments
+    pushPipelineKey(&key, pDesc->mRenderTargetCount);
+    for(uint32 i = 0; i < pDesc->mRenderTargetCount; i++)
+    {
+        pushPipelineKey(&key, (uint32)pDesc->mRenderTargetFormats[i]);
+    }
+    pushPipelineKey(&key, (uint32)pDesc->mDepthTargetFormat);
+
+    pushPipelineLayoutKey(&key, pDesc->pDescriptorSets, pDesc->mDescriptorSetCount,
+            pDesc->mConstantBlocks, pDesc->mConstantBlockCount);
+
+    // Shaders by their bytecode, the same source compiled twice is one shader
+    pushPipelineKey(&key, pDesc->pVS->mHash);
+    pushPipelineKey(&key, pDesc->pFS->mHash);
+
+    // Fixed stage, the Vulkan vertex layout is built from its desc alone
+    VertexLayoutDesc* pLayout = &pDesc->mVertexLayout.mDesc;
+    pushPipelineKey(&key, pLayout->mCount);
+    for(uint32 i = 0; i < pLayout->mCount; i++)
+    {
+        pushPipelineKey(&key, (uint32)pLayout->mAttribs[i]);
+    }
+    pushPipelineKey(&key, (uint32)pDesc->mPrimitive);
+    pushPipelineKey(&key, (uint32)pDesc->mFillMode);
+    pushPipelineKey(&key, (uint32)pDesc->mCullMode);
+    pushPipelineKey(&key, (uint32)pDesc->mFrontFace);
+    if(pDesc->mFillMode == FILL_MODE_LINE)
+    {
+        pushPipelineKey(&key, &pDesc->mLineWidth, sizeof(pDesc->mLineWidth));
+    }
+
+    // Depth state, writes need the test enabled
+    pushPipelineKey(&key, (uint32)pDesc->mDepthTest);
+    if(pDesc->mDepthTest)
+    {
+        pushPipelineKey(&key, (uint32)pDesc->mDepthWrite);
+        pushPipelineKey(&key, (uint32)pDesc->mDepthOp);
+    }
+
+    // Blend state, only used through color targets
+    if(pDesc->mRenderTargetCount)
+    {
+        pushPipelineKey(&key, pDesc->mBlendMask);
+        pushPipelineKey(&key, (uint32)pDesc->mBlendEnable);
+        if(pDesc->mBlendEnable)
+        {
+            pushPipelineKey(&key, (uint32)pDesc->mSrcColorFactor);
+            pushPipelineKey(&key, (uint32)pDesc->mDstColorFactor);
+            pushPipelineKey(&key, (uint32)pDesc->mSrcAlphaFactor);
+            pushPipelineKey(&key, (uint32)pDesc->mDstAlphaFactor);
+            pushPipelineKey(&key, (uint32)pDesc->mBlendOp);
+        }
+    }
+
+    return hash128(key.mData, key.mSize);
+}
+
+Hash128 hashPipelineDesc(ComputePipelineDesc* pDesc)
+{
+    ASSERT(pDesc && pDesc->pCS);
+
+    PipelineKey key;
+    pushPipelineLayoutKey(&key, pDesc->pDescriptorSets, pDesc->mDescriptorSetCount,
+            pDesc->mConstantBlocks, pDesc->mConstantBlockCount);
+    pushPipelineKey(&key, pDesc->pCS->mHash);
+    return hash128(key.mData, key.mSize);
+}
+
+bool isPipelineCacheCompatible(byte* pData, uint64 size, VkPhysicalDeviceProperties* pProps)
+{
+    ASSERT(pProps);
+
+    VkPipelineCacheHeaderVersionOne header;
+    if(!pData || size < sizeof(header)) return false;
+    memcpy(&header, pData, sizeof(header));
+
+    return header.headerSize >= sizeof(header) && header.headerSize <= size
+        && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && header.vendorID == pProps->vendorID
+        && header.deviceID == pProps->deviceID
+        && memcmp(header.pipelineCacheUUID, pProps->pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void initPipelineCache(Renderer* pRenderer, String path, PipelineCache* pCache)
+{
+    ASSERT(pRenderer && pCache);
+    ASSERT(path.mLen < PIPELINE_CACHE_MAX_PATH);
+
+    *pCache = {};
+    initArena(MB(1), &pCache->mArena);
+    pCache->mGraphics = hashmap<Hash128, GraphicsPipeline*>(&pCache->mArena, 64);
+    pCache->mCompute = hashmap<Hash128, ComputePipeline*>(&pCache->mArena, 64);
+
+    memcpy(pCache->mPath, path.mData, path.mLen);
+    pCache->mPath[path.mLen] = 0;
+    pCache->mPathLen = (uint32)path.mLen;
+
+    ScratchScope scratch;
+    byte* pData = NULL;
+    uint64 size = 0;
+    if(path.mLen && pathExists(path))
+    {
+        pData = readFile(scratch.pArena, path, &size);
+        if(!isPipelineCacheCompatible(pData, size, &pRenderer->mVkDeviceProperties))
+        {
+            LOGLF("PIPELINE CACHE", "Dropping %s, saved by another driver or device", pCache->mPath);
+            pData = NULL;
+            size = 0;
+        }
+    }
+
+    VkPipelineCacheCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    info.initialDataSize = size;
+    info.pInitialData = pData;
+    VkResult ret = vkCreatePipelineCache(pRenderer->mVkDevice, &info, NULL, &pCache->mVkCache);
+    ASSERTVK(ret);
+}
+
+void destroyPipelineCache(Renderer* pRenderer, PipelineCache* pCache)
+{
+    ASSERT(pRenderer && pCache);
+    ASSERT(!pCache->mGraphics.mCount && !pCache->mCompute.mCount);   // Pipelines must be removed first
+
+    savePipelineCache(pRenderer, pCache);
+    vkDestroyPipelineCache(pRenderer->mVkDevice, pCache->mVkCache, NULL);
+    destroyArena(&pCache->mArena);
+    *pCache = {};
+}
+
+bool savePipelineCache(Renderer* pRenderer, PipelineCache* pCache)
+{
+    ASSERT(pRenderer && pCache);
+    if(!pCache->mPathLen) return false;
+
+    size_t size = 0;
+    VkResult ret = vkGetPipelineCacheData(pRenderer->mVkDevice, pCache->mVkCache, &size, NULL);
+    if(ret != VK_SUCCESS || !size) return false;
+
+    ScratchScope scratch;
+    byte* pData = (byte*)arenaPush(scratch.pArena, size);
+    ret = vkGetPipelineCacheData(pRenderer->mVkDevice, pCache->mVkCache, &size, pData);
+    if(ret != VK_SUCCESS) return false;
+
+    // Written aside and moved over the old data, a crash leaves one of the two whole
+    String path = str(pCache->mPath);
+    String tempPath = join(scratch.pArena, path, str(".tmp"));
+    return writeFile(tempPath, pData, size) == size && moveFile(tempPath, path);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "../core/base.hpp"
+#include "../core/memory.hpp"
+#include "../core/string.hpp"
+#include "../core/hash_map.hpp"
+#include "vulkan/vulkan_core.h"
+
+struct Renderer;
+struct GraphicsPipelineDesc;
+struct ComputePipelineDesc;
+struct GraphicsPipeline;
+struct ComputePipeline;
+
+// Pipeline cache
+// addPipeline looks pipelines up by a key hashing their desc in canonical form: only what
+// ends up in the Vulkan create infos, shaders by bytecode hash and descriptor sets by
+// layout, leaving out unused array slots and the state of disabled features (blend
+// factors without blending, the depth op without depth tests). Descs with equal keys share
+// one pipeline, reference counted, so removePipeline only destroys it with the last user.
+//
+// New pipelines are created through a VkPipelineCache, persisted to mPath so the driver
+// skips compiling the ones it has seen in earlier runs. Data saved by another driver or
+// device is dropped at init. Not thread safe, like the rest of the renderer's resources.
+#define PIPELINE_CACHE_MAX_PATH 260
+
+struct PipelineCacheStats
+{
+    uint64  mHits       = 0;    // addPipeline calls sharing an existing pipeline
+    uint64  mMisses     = 0;
+};
+
+struct PipelineCache
+{
+    char    mPath[PIPELINE_CACHE_MAX_PATH];
+    uint32  mPathLen    = 0;    // 0 doesn't persist
+
+    HashMap<Hash128, GraphicsPipeline*> mGraphics   = {};
+    HashMap<Hash128, ComputePipeline*>  mCompute    = {};
+    Arena   mArena      = {};
+
+    VkPipelineCache mVkCache = VK_NULL_HANDLE;
+    PipelineCacheStats mStats = {};
+};
+
+// Loads the cache data at path when it's compatible with the device.
+void    initPipelineCache(Renderer* pRenderer, String path, PipelineCache* pCache);
+void    destroyPipelineCache(Renderer* pRenderer, PipelineCache* pCache);  // Saves the cache data
+bool    savePipelineCache(Renderer* pRenderer, PipelineCache* pCache);
+
+Hash128 hashPipelineDesc(GraphicsPipelineDesc* pDesc);
+Hash128 hashPipelineDesc(ComputePipelineDesc* pDesc);
+// Checks the header Vulkan puts in front of VkPipelineCache data against the device.
+bool    isPipelineCacheCompatible(byte* pData, uint64 size, VkPhysicalDeviceProperties* pProps);
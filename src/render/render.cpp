@@ -218,6 +218,7 @@ void addRenderTarget(Renderer* pRenderer, RenderTargetDesc desc, RenderTarget**
     ASSERT(*ppTarget == NULL);
 
     *ppTarget = (RenderTarget*)poolAlloc(&pRenderer->poolRenderTargets);
+    ASSERT(*ppTarget);
 
     **ppTarget = {};
 
@@ -249,6 +250,7 @@ void addDepthTarget(Renderer* pRenderer, RenderTargetDesc desc, RenderTarget** p
     ASSERT(*ppTarget == NULL);
 
     *ppTarget = (RenderTarget*)poolAlloc(&pRenderer->poolRenderTargets);
+    ASSERT(*ppTarget);
 
     **ppTarget = {};
 
@@ -351,7 +353,20 @@ void addPipeline(Renderer* pRenderer, GraphicsPipelineDesc desc, GraphicsPipelin
     ASSERT(pRenderer && ppPipeline);
     ASSERT(*ppPipeline == NULL);
 
+    PipelineCache* pCache = &pRenderer->mPipelineCache;
+    Hash128 key = hashPipelineDesc(&desc);
+    GraphicsPipeline** ppShared = pCache->mGraphics.find(key);
+    if(ppShared)
+    {
+        (*ppShared)->mRefCount++;
+        pCache->mStats.mHits++;
+        *ppPipeline = *ppShared;
+        return;
+    }
+    pCache->mStats.mMisses++;
+
     *ppPipeline = (GraphicsPipeline*)poolAlloc(&pRenderer->poolGraphicsPipelines);
+    ASSERT(*ppPipeline);
 
     **ppPipeline = {};
 
@@ -498,7 +513,7 @@ void addPipeline(Renderer* pRenderer, GraphicsPipelineDesc desc, GraphicsPipelin
     info.renderPass = VK_NULL_HANDLE;
     VkPipeline vkPipeline;
     ret = vkCreateGraphicsPipelines(pRenderer->mVkDevice, 
-            VK_NULL_HANDLE, 
+            pCache->mVkCache, 
             1, 
             &info, 
             NULL, 
@@ -506,14 +521,24 @@ void addPipeline(Renderer* pRenderer, GraphicsPipelineDesc desc, GraphicsPipelin
     ASSERTVK(ret);
 
     (*ppPipeline)->mDesc = desc;
+    (*ppPipeline)->mKey = key;
+    (*ppPipeline)->mRefCount = 1;
     (*ppPipeline)->mVkPipeline = vkPipeline;
     (*ppPipeline)->mVkLayout = vkLayout;
+    pCache->mGraphics.insert(key, *ppPipeline);
 }
 
 void removePipeline(Renderer* pRenderer, GraphicsPipeline** ppPipeline)
 {
     ASSERT(pRenderer && ppPipeline);
-    ASSERT(*ppPipeline);
+    ASSERT(*ppPipeline && (*ppPipeline)->mRefCount);
+
+    if(--(*ppPipeline)->mRefCount)
+    {
+        *ppPipeline = NULL;
+        return;
+    }
+    pRenderer->mPipelineCache.mGraphics.remove((*ppPipeline)->mKey);
 
     vkDestroyPipelineLayout(pRenderer->mVkDevice, (*ppPipeline)->mVkLayout, NULL);
     vkDestroyPipeline(pRenderer->mVkDevice, (*ppPipeline)->mVkPipeline, NULL);
@@ -529,7 +554,20 @@ void addPipeline(Renderer* pRenderer, ComputePipelineDesc desc, ComputePipeline*
     ASSERT(pRenderer && ppPipeline);
     ASSERT(*ppPipeline == NULL);
 
+    PipelineCache* pCache = &pRenderer->mPipelineCache;
+    Hash128 key = hashPipelineDesc(&desc);
+    ComputePipeline** ppShared = pCache->mCompute.find(key);
+    if(ppShared)
+    {
+        (*ppShared)->mRefCount++;
+        pCache->mStats.mHits++;
+        *ppPipeline = *ppShared;
+        return;
+    }
+    pCache->mStats.mMisses++;
+
     *ppPipeline = (ComputePipeline*)poolAlloc(&pRenderer->poolComputePipelines);
+    ASSERT(*ppPipeline);
 
     **ppPipeline = {};
 
@@ -574,7 +612,7 @@ void addPipeline(Renderer* pRenderer, ComputePipelineDesc desc, ComputePipeline*
     info.stage = shaderInfo;
     VkPipeline vkPipeline;
     ret = vkCreateComputePipelines(pRenderer->mVkDevice, 
-            VK_NULL_HANDLE, 
+            pCache->mVkCache, 
             1, 
             &info, 
             NULL, 
@@ -582,14 +620,24 @@ void addPipeline(Renderer* pRenderer, ComputePipelineDesc desc, ComputePipeline*
     ASSERTVK(ret);
 
     (*ppPipeline)->mDesc = desc;
+    (*ppPipeline)->mKey = key;
+    (*ppPipeline)->mRefCount = 1;
     (*ppPipeline)->mVkPipeline = vkPipeline;
     (*ppPipeline)->mVkLayout = vkLayout;
+    pCache->mCompute.insert(key, *ppPipeline);
 }
 
 void removePipeline(Renderer* pRenderer, ComputePipeline** ppPipeline)
 {
     ASSERT(pRenderer && ppPipeline);
-    ASSERT(*ppPipeline);
+    ASSERT(*ppPipeline && (*ppPipeline)->mRefCount);
+
+    if(--(*ppPipeline)->mRefCount)
+    {
+        *ppPipeline = NULL;
+        return;
+    }
+    pRenderer->mPipelineCache.mCompute.remove((*ppPipeline)->mKey);
 
     vkDestroyPipelineLayout(pRenderer->mVkDevice, (*ppPipeline)->mVkLayout, NULL);
     vkDestroyPipeline(pRenderer->mVkDevice, (*ppPipeline)->mVkPipeline, NULL);
@@ -853,6 +901,7 @@ void initRenderer(RendererDesc desc, Renderer* pRenderer)
         features12.descriptorBindingStorageImageUpdateAfterBind = VK_TRUE;
         features12.descriptorBindingUniformBufferUpdateAfterBind = VK_TRUE;
         features12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
         features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
         features12.uniformBufferStandardLayout = VK_TRUE;
 
@@ -900,30 +949,6 @@ void initRenderer(RendererDesc desc, Renderer* pRenderer)
         ASSERTVK(ret);
     }
 
-    // Initializing descriptor pools for allocating descriptors
-    uint32 maxPoolSize = 1000;
-    uint32 maxSets = 1000;
-    VkDescriptorPool vkDescriptorPool;
-    {
-        VkDescriptorPoolSize poolSizes[] =
-        {
-            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,            maxPoolSize},
-            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,    maxPoolSize},
-            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,            maxPoolSize},
-            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,    maxPoolSize},
-            { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,             maxPoolSize},
-            { VK_DESCRIPTOR_TYPE_SAMPLER,                   maxPoolSize},
-        };
-        VkDescriptorPoolCreateInfo info = {};
-        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        info.poolSizeCount = ARR_LEN(poolSizes);
-        info.pPoolSizes = poolSizes;
-        info.maxSets = maxSets;
-        info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
-        VkResult ret = vkCreateDescriptorPool(vkDevice, &info, NULL, &vkDescriptorPool);
-        ASSERTVK(ret);
-    }
-
     // Initializing command pool
     VkCommandPool vkCommandPool;
     {
@@ -975,9 +1000,17 @@ void initRenderer(RendererDesc desc, Renderer* pRenderer)
     pRenderer->mVkQueue = vkQueue;
     pRenderer->mVkQueueFamily = vkQueueFamily;
     pRenderer->mVkAllocator = vkAllocator;
-    pRenderer->mVkDescriptorPool = vkDescriptorPool;
     pRenderer->mVkCommandPool = vkCommandPool;
 
+    // Initializing descriptor layouts and allocators, pools are created as sets are allocated
+    initDescriptorBackend(pRenderer, &pRenderer->mDescriptorBackend);
+    initDescriptorLayoutCache(&pRenderer->mDescriptorBackend, &pRenderer->mDescriptorLayouts);
+    initDescriptorAllocator(&pRenderer->mDescriptorBackend, true, &pRenderer->mDescriptorAllocator);
+    for(uint32 i = 0; i < CONCURRENT_FRAMES; i++)
+    {
+        initDescriptorAllocator(&pRenderer->mDescriptorBackend, false, &pRenderer->mFrameDescriptorAllocators[i]);
+    }
+
     // Initializing swap chain
     initSwapChain(pRenderer, &pRenderer->mSwapChain);
 
@@ -994,6 +1027,23 @@ void initRenderer(RendererDesc desc, Renderer* pRenderer)
         stagingDesc.mStride = stagingSize;
         addBuffer(pRenderer, stagingDesc, &pRenderer->pStagingBuffer);
     }
+
+    // Initializing upload ring for per frame data
+    {
+        uint32 align = MAX(vkPhysicalDeviceProps.limits.minUniformBufferOffsetAlignment,
+                vkPhysicalDeviceProps.limits.minStorageBufferOffsetAlignment);
+        uint64 regionSize = ALIGN_TO(desc.mUploadFrameSize, (uint64)align);
+        BufferDesc uploadDesc = {};
+        uploadDesc.mType = BUFFER_TYPE_UPLOAD;
+        uploadDesc.mCount = 1;
+        uploadDesc.mSize = regionSize * CONCURRENT_FRAMES;
+        uploadDesc.mStride = uploadDesc.mSize;
+        addBuffer(pRenderer, uploadDesc, &pRenderer->pUploadBuffer);
+        initFrameRing(regionSize, CONCURRENT_FRAMES, &pRenderer->mUploadRing);
+    }
+
+    // Initializing pipeline cache, after the device properties its data is checked against
+    initPipelineCache(pRenderer, desc.mPipelineCachePath, &pRenderer->mPipelineCache);
 }
 
 void destroyRenderer(Renderer* pRenderer)
@@ -1003,8 +1053,17 @@ void destroyRenderer(Renderer* pRenderer)
     waitForCommands(pRenderer);
 
     removeBuffer(pRenderer, &pRenderer->pStagingBuffer);
+    removeBuffer(pRenderer, &pRenderer->pUploadBuffer);
 
     destroySwapChain(pRenderer, &pRenderer->mSwapChain);
+    destroyCommandBuffers(pRenderer);
+    destroyPipelineCache(pRenderer, &pRenderer->mPipelineCache);
+    destroyDescriptorAllocator(&pRenderer->mDescriptorAllocator);
+    for(uint32 i = 0; i < CONCURRENT_FRAMES; i++)
+    {
+        destroyDescriptorAllocator(&pRenderer->mFrameDescriptorAllocators[i]);
+    }
+    destroyDescriptorLayoutCache(&pRenderer->mDescriptorLayouts);
     
     for(uint32 i = 0; i < CONCURRENT_FRAMES; i++)
     {
@@ -1014,7 +1073,6 @@ void destroyRenderer(Renderer* pRenderer)
     }
     vkDestroyFence(pRenderer->mVkDevice, pRenderer->mVkImmediateFence, NULL);
     vkDestroyCommandPool(pRenderer->mVkDevice, pRenderer->mVkCommandPool, NULL);
-    vkDestroyDescriptorPool(pRenderer->mVkDevice, pRenderer->mVkDescriptorPool, NULL);
     vmaDestroyAllocator(pRenderer->mVkAllocator);
     vkDestroyDevice(pRenderer->mVkDevice, NULL);
     vkDestroySurfaceKHR(pRenderer->mVkInstance, pRenderer->mVkSurface, NULL);
@@ -1047,9 +1105,19 @@ void acquireNextImage(Renderer* pRenderer, uint32 frame)
     ASSERT(pRenderer);
 
     pRenderer->mActiveFrame = frame % CONCURRENT_FRAMES;
-    
+
+    // The GPU is done with everything this frame submitted last time, its command buffers
+    // and uploads included
+    VkFence vkFence = pRenderer->mVkFences[pRenderer->mActiveFrame];
+    VkResult ret = vkWaitForFences(pRenderer->mVkDevice, 1, &vkFence, VK_TRUE, MAX_UINT64);
+    ASSERTVK(ret);
+    pRenderer->mFrameCount++;
+    resetCommandPools(pRenderer, pRenderer->mActiveFrame);
+    beginRingFrame(&pRenderer->mUploadRing, pRenderer->mActiveFrame);
+    resetDescriptorAllocator(&pRenderer->mFrameDescriptorAllocators[pRenderer->mActiveFrame]);
+
     VkSemaphore vkPresentSemaphore = pRenderer->mVkPresentSemaphores[pRenderer->mActiveFrame];
-    VkResult ret = vkAcquireNextImageKHR(pRenderer->mVkDevice, 
+    ret = vkAcquireNextImageKHR(pRenderer->mVkDevice, 
             pRenderer->mSwapChain.mVkSwapChain, 
             MAX_UINT64, 
             vkPresentSemaphore, 
@@ -1331,6 +1399,7 @@ void cmdBindRenderTargets(CommandBuffer* pCmd, RenderTargetBindDesc desc)
         info.pDepthAttachment = NULL;
     }
     info.pStencilAttachment = NULL;     // TODO_DW: Stencil
+    info.flags = desc.mSecondaryCmds ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0;
     
     vkCmdBeginRendering(pCmd->mVkCmd, &info);
 }
@@ -1354,27 +1423,31 @@ void cmdBindComputePipeline(CommandBuffer* pCmd, ComputePipeline* pPipeline)
 }
 
 void cmdBindDescriptorSet(CommandBuffer* pCmd, GraphicsPipeline* pPipeline,
-        DescriptorSet* pDescriptorSet, uint32 setBinding)
+        DescriptorSet* pDescriptorSet, uint32 setBinding,
+        uint32 dynamicOffsetCount, uint32* pDynamicOffsets)
 {
     ASSERT(pCmd && pPipeline && pDescriptorSet);
+    ASSERT(pDynamicOffsets || !dynamicOffsetCount);
     vkCmdBindDescriptorSets(pCmd->mVkCmd, 
             VK_PIPELINE_BIND_POINT_GRAPHICS, 
             pPipeline->mVkLayout, 
             setBinding, 
             1, &pDescriptorSet->mVkSet, 
-            0, NULL);
+            dynamicOffsetCount, pDynamicOffsets);
 }
 
 void cmdBindDescriptorSet(CommandBuffer* pCmd, ComputePipeline* pPipeline,
-        DescriptorSet* pDescriptorSet, uint32 setBinding)
+        DescriptorSet* pDescriptorSet, uint32 setBinding,
+        uint32 dynamicOffsetCount, uint32* pDynamicOffsets)
 {
     ASSERT(pCmd && pPipeline && pDescriptorSet);
+    ASSERT(pDynamicOffsets || !dynamicOffsetCount);
     vkCmdBindDescriptorSets(pCmd->mVkCmd, 
             VK_PIPELINE_BIND_POINT_COMPUTE, 
             pPipeline->mVkLayout, 
             setBinding, 
             1, &pDescriptorSet->mVkSet, 
-            0, NULL);
+            dynamicOffsetCount, pDynamicOffsets);
 }
 
 
@@ -1434,26 +1507,27 @@ void cmdSetScissor(CommandBuffer* pCmd, RenderTarget* pTarget)
     cmdSetScissor(pCmd, 0, 0, pTarget->mDesc.mWidth, pTarget->mDesc.mHeight);
 }
 
-void cmdBindVertexBuffer(CommandBuffer* pCmd, Buffer* pBuffer)
+void cmdBindVertexBuffer(CommandBuffer* pCmd, Buffer* pBuffer, uint64 offset)
 {
     ASSERT(pCmd && pBuffer);
-    ASSERT(pBuffer->mDesc.mType == BUFFER_TYPE_VERTEX);
+    ASSERT(pBuffer->mDesc.mType & BUFFER_TYPE_VERTEX);
 
-    VkDeviceSize vkOffset = 0;
+    VkDeviceSize vkOffset = offset;
     vkCmdBindVertexBuffers(pCmd->mVkCmd, 
             0, 1, 
             &pBuffer->mVkBuffer, &vkOffset);
 }
 
-void cmdBindIndexBuffer(CommandBuffer* pCmd, Buffer* pBuffer)
+void cmdBindIndexBuffer(CommandBuffer* pCmd, Buffer* pBuffer, uint64 offset, uint64 stride)
 {
     ASSERT(pCmd && pBuffer);
-    ASSERT(pBuffer->mDesc.mType == BUFFER_TYPE_INDEX);
+    ASSERT(pBuffer->mDesc.mType & BUFFER_TYPE_INDEX);
 
+    if(!stride) stride = pBuffer->mDesc.mStride;
     vkCmdBindIndexBuffer(pCmd->mVkCmd, 
             pBuffer->mVkBuffer, 
-            0, 
-            pBuffer->mDesc.mStride == 2
+            offset, 
+            stride == 2
             ? VK_INDEX_TYPE_UINT16
             : VK_INDEX_TYPE_UINT32);
 }
@@ -8,11 +8,14 @@
 #include "shader.hpp"
 #include "descriptor.hpp"
 #include "command_buffer.hpp"
+#include "pipeline_cache.hpp"
 #include "vulkan/vulkan_core.h"
 #include "vma/vk_mem_alloc.h"
 
 #define CONCURRENT_FRAMES 2
 
+struct JobSystem;
+
 const char* vkResultToStr(VkResult result);
 
 #define ASSERTVK(EXPR) ASSERTF((EXPR) == VK_SUCCESS, \
@@ -143,6 +146,7 @@ struct RenderTargetBindDesc
     uint32 mColorCount = 0;
     RenderTargetBinding mColorBindings[MAX_PIPELINE_RENDER_TARGETS];
     RenderTargetBinding mDepthBinding;
+    bool mSecondaryCmds = false;    // Drawn by secondary command buffers only, see cmdExecuteCmds
 };
 
 // --------------------------------------
@@ -321,11 +325,14 @@ struct GraphicsPipelineDesc
 struct GraphicsPipeline
 {
     GraphicsPipelineDesc mDesc = {};
+    Hash128 mKey                = {};   // Shared by equivalent descs, see PipelineCache
+    uint32 mRefCount            = 0;
 
     VkPipeline mVkPipeline      = VK_NULL_HANDLE;
     VkPipelineLayout mVkLayout  = VK_NULL_HANDLE;
 };
 
+// Returns the pipeline added before for an equivalent desc, removed with its last user.
 void addPipeline(Renderer* pRenderer, GraphicsPipelineDesc desc, GraphicsPipeline** ppPipeline);
 void removePipeline(Renderer* pRenderer, GraphicsPipeline** ppPipeline);
 
@@ -346,6 +353,8 @@ struct ComputePipelineDesc
 struct ComputePipeline
 {
     ComputePipelineDesc mDesc = {};
+    Hash128 mKey                = {};
+    uint32 mRefCount            = 0;
 
     VkPipeline mVkPipeline      = VK_NULL_HANDLE;
     VkPipelineLayout mVkLayout  = VK_NULL_HANDLE;
@@ -378,6 +387,11 @@ struct RendererDesc
     uint64 mMaxRenderTargets        = 64;
     uint64 mMaxGraphicsPipelines    = 64;
     uint64 mMaxComputePipelines     = 64;
+
+    uint64 mUploadFrameSize         = MB(8);    // Upload ring region per frame in flight
+    String mPipelineCachePath       = {};       // VkPipelineCache data, not persisted when empty
+
+    JobSystem* pJobs = NULL;    // Its workers can record commands, see CommandPool
 };
 
 struct Renderer
@@ -395,10 +409,22 @@ struct Renderer
     RendererDesc mDesc = {};
 
     SwapChain mSwapChain = {};
-    CommandBuffer mCommandBuffers[MAX_COMMAND_BUFFERS];
+    CommandPool mCommandPools[CONCURRENT_FRAMES][MAX_COMMAND_THREADS];
+    uint32 mCommandThreadCount = 0;
+    CommandBuffer mImmediateCmd = {};
     uint32 mActiveFrame = 0;
+    uint64 mFrameCount = 0;     // Frames acquired, frame N - CONCURRENT_FRAMES retired when N is acquired
 
     Buffer* pStagingBuffer = NULL;
+    Buffer* pUploadBuffer = NULL;       // CONCURRENT_FRAMES regions of mUploadRing
+    FrameRing mUploadRing = {};
+
+    PipelineCache mPipelineCache = {};
+
+    DescriptorBackend mDescriptorBackend = {};
+    DescriptorLayoutCache mDescriptorLayouts = {};
+    DescriptorAllocator mDescriptorAllocator = {};                      // Persistent sets
+    DescriptorAllocator mFrameDescriptorAllocators[CONCURRENT_FRAMES];  // Transient sets
 
     // Vulkan
     VkInstance mVkInstance = VK_NULL_HANDLE;
@@ -414,7 +440,6 @@ struct Renderer
     VkQueue mVkQueue = VK_NULL_HANDLE;
     uint32 mVkQueueFamily = 0;
     VmaAllocator mVkAllocator = VK_NULL_HANDLE;
-    VkDescriptorPool mVkDescriptorPool = VK_NULL_HANDLE;
     VkCommandPool mVkCommandPool = VK_NULL_HANDLE;
     VkSemaphore mVkRenderSemaphores[CONCURRENT_FRAMES];
     VkSemaphore mVkPresentSemaphores[CONCURRENT_FRAMES];
@@ -426,7 +451,7 @@ void initRenderer(RendererDesc desc, Renderer* pRenderer);
 void destroyRenderer(Renderer* pRenderer);
 
 void waitForCommands(Renderer* pRenderer);
-void acquireNextImage(Renderer* pRenderer, uint32 frame);
+void acquireNextImage(Renderer* pRenderer, uint32 frame);    // Waits for the frame's previous submit, recycles its command buffers, uploads and transient sets
 void present(Renderer* pRenderer);
 
 // --------------------------------------
@@ -443,10 +468,13 @@ void cmdBindRenderTargets(CommandBuffer* pCmd, RenderTargetBindDesc desc);
 void cmdUnbindRenderTargets(CommandBuffer* pCmd);
 void cmdBindGraphicsPipeline(CommandBuffer* pCmd, GraphicsPipeline* pPipeline);
 void cmdBindComputePipeline(CommandBuffer* pCmd, ComputePipeline* pPipeline);
+// pDynamicOffsets holds one offset per dynamic descriptor of the set, in binding order.
 void cmdBindDescriptorSet(CommandBuffer* pCmd, GraphicsPipeline* pPipeline,
-        DescriptorSet* pDescriptorSet, uint32 setBinding);
+        DescriptorSet* pDescriptorSet, uint32 setBinding,
+        uint32 dynamicOffsetCount = 0, uint32* pDynamicOffsets = NULL);
 void cmdBindDescriptorSet(CommandBuffer* pCmd, ComputePipeline* pPipeline,
-        DescriptorSet* pDescriptorSet, uint32 setBinding);
+        DescriptorSet* pDescriptorSet, uint32 setBinding,
+        uint32 dynamicOffsetCount = 0, uint32* pDynamicOffsets = NULL);
 void cmdSetConstants(CommandBuffer* pCmd, GraphicsPipeline* pPipeline,
         uint32 constant, uint64 size, void* pData);
 void cmdSetConstants(CommandBuffer* pCmd, ComputePipeline* pPipeline,
@@ -455,8 +483,8 @@ void cmdSetViewport(CommandBuffer* pCmd, float x, float y, float w, float h);
 void cmdSetViewport(CommandBuffer* pCmd, RenderTarget* pTarget);
 void cmdSetScissor(CommandBuffer* pCmd, int32 x, int32 y, uint32 w, uint32 h);
 void cmdSetScissor(CommandBuffer* pCmd, RenderTarget* pTarget);
-void cmdBindVertexBuffer(CommandBuffer* pCmd, Buffer* pBuffer);
-void cmdBindIndexBuffer(CommandBuffer* pCmd, Buffer* pBuffer);
+void cmdBindVertexBuffer(CommandBuffer* pCmd, Buffer* pBuffer, uint64 offset = 0);
+void cmdBindIndexBuffer(CommandBuffer* pCmd, Buffer* pBuffer, uint64 offset = 0, uint64 stride = 0);   // stride 0 is the buffer's
 void cmdDraw(CommandBuffer* pCmd, uint32 vertexCount, uint32 instanceCount);
 void cmdDrawIndexed(CommandBuffer* pCmd, uint32 indexCount, uint32 instanceCount,
         uint32 indexOffset, uint32 vertexOffset);
@@ -5,23 +5,19 @@ void initTexture(ResourceManager<Texture>* pResMan, TextureDesc desc, Texture**
 {
     ASSERT(pResMan && ppTexture);
     addTexture(pResMan->pRenderer, desc, ppTexture);
+    (*ppTexture)->mHandle = acquireResourceHandle(pResMan, *ppTexture, pResMan->pRenderer->mFrameCount);
+}
 
-    HND handle = pResMan->mHandleQueue.top();
-    pResMan->mHandleQueue.pop();
-
-    pResMan->pResources[handle] = *ppTexture;
-    (*ppTexture)->mHandle = handle;
+void removeRetiredResource(Renderer* pRenderer, Texture** ppTexture)
+{
+    removeTexture(pRenderer, ppTexture);
 }
 
 void destroyTexture(ResourceManager<Texture>* pResMan, Texture** ppTexture)
 {
     ASSERT(pResMan && ppTexture);
 
-    HND handle = (*ppTexture)->mHandle;
-    pResMan->pResources[handle] = NULL;
-    pResMan->mHandleQueue.push(handle);
-
-    removeTexture(pResMan->pRenderer, ppTexture);
+    retireResource(pResMan, ppTexture, pResMan->pRenderer->mFrameCount);
 }
 
 void initRenderTarget(ResourceManager<Texture>* pResMan, RenderTargetDesc desc, RenderTarget** ppTarget)
@@ -29,11 +25,8 @@ void initRenderTarget(ResourceManager<Texture>* pResMan, RenderTargetDesc desc,
     ASSERT(pResMan && ppTarget);
     addRenderTarget(pResMan->pRenderer, desc, ppTarget);
 
-    HND handle = pResMan->mHandleQueue.top();
-    pResMan->mHandleQueue.pop();
-
-    pResMan->pResources[handle] = (*ppTarget)->pTexture;
-    (*ppTarget)->pTexture->mHandle = handle;
+    Texture* pTexture = (*ppTarget)->pTexture;
+    pTexture->mHandle = acquireResourceHandle(pResMan, pTexture, pResMan->pRenderer->mFrameCount);
 }
 
 void initDepthTarget(ResourceManager<Texture>* pResMan, RenderTargetDesc desc, RenderTarget** ppTarget)
@@ -41,60 +34,15 @@ void initDepthTarget(ResourceManager<Texture>* pResMan, RenderTargetDesc desc, R
     ASSERT(pResMan && ppTarget);
     addDepthTarget(pResMan->pRenderer, desc, ppTarget);
 
-    HND handle = pResMan->mHandleQueue.top();
-    pResMan->mHandleQueue.pop();
-
-    pResMan->pResources[handle] = (*ppTarget)->pTexture;
-    (*ppTarget)->pTexture->mHandle = handle;
+    Texture* pTexture = (*ppTarget)->pTexture;
+    pTexture->mHandle = acquireResourceHandle(pResMan, pTexture, pResMan->pRenderer->mFrameCount);
 }
 
 void destroyRenderTarget(ResourceManager<Texture>* pResMan, RenderTarget** ppTarget)
 {
     ASSERT(pResMan && ppTarget);
 
-    HND handle = (*ppTarget)->pTexture->mHandle;
-    pResMan->pResources[handle] = NULL;
-    pResMan->mHandleQueue.push(handle);
-
+    // The texture may be sampled by frames in flight, it retires on its own
+    retireResource(pResMan, &(*ppTarget)->pTexture, pResMan->pRenderer->mFrameCount);
     removeRenderTarget(pResMan->pRenderer, ppTarget);
 }
-
-void getSampledTextureResources(ResourceManager<Texture>* pResMan, uint64 count, Texture* pFallback, Texture** pOut)
-{
-    ASSERT(pResMan && pOut && pFallback);
-    ASSERT(pFallback->mDesc.mUsage & TEXTURE_USAGE_SAMPLED);
-
-    for(uint64 i = 0; i < count; i++)
-    {
-        pOut[i] = pFallback;
-    }
-
-    for(uint64 i = 0; i < pResMan->pResources.mCount; i++)
-    {
-        Texture* pTexture = pResMan->pResources[i];
-        if(pTexture && pTexture->mDesc.mUsage & TEXTURE_USAGE_SAMPLED)
-        {
-            pOut[i] = pTexture;
-        }
-    }
-}
-
-void getStorageTextureResources(ResourceManager<Texture>* pResMan, uint64 count, Texture* pFallback, Texture** pOut)
-{
-    ASSERT(pResMan && pOut && pFallback);
-    ASSERT(pFallback->mDesc.mUsage & TEXTURE_USAGE_STORAGE);
-
-    for(uint64 i = 0; i < count; i++)
-    {
-        pOut[i] = pFallback;
-    }
-
-    for(uint64 i = 0; i < pResMan->pResources.mCount; i++)
-    {
-        Texture* pTexture = pResMan->pResources[i];
-        if(pTexture && pTexture->mDesc.mUsage & TEXTURE_USAGE_STORAGE)
-        {
-            pOut[i] = pTexture;
-        }
-    }
-}
@@ -1,6 +1,7 @@
 #pragma once
 #include "../core/base.hpp"
 #include "../core/array.hpp"
+#include "../core/memory.hpp"
 
 struct Renderer;
 struct TextureDesc;
@@ -8,32 +9,157 @@ struct Texture;
 struct RenderTargetDesc;
 struct RenderTarget;
 
+// Handles use the pool handle layout: HND_INDEX is the resource slot (and bindless
+// index), HND_GENERATION is bumped each time the slot is released so stale handles
+// can be rejected in O(1). Slots are only created as they're first needed.
+//
+// With retireFrames, a released slot waits that many frames before it's reused: frames
+// still in flight may index it (bindless), see BindlessTable. Resources given to
+// retireResource wait with their slot and are removed when it's recycled, so call
+// recycleResourceSlots every frame, and with MAX_UINT64 once the device is idle at
+// shutdown. Frames are counted by the caller, like Renderer::mFrameCount.
 template<typename T>
 struct ResourceManager
 {
+    struct Slot
+    {
+        T*      pResource   = NULL;
+        T*      pRetired    = NULL;     // Released resource, removed when the slot is recycled
+        uint32  mGeneration = 0;
+        uint32  mNextFree   = POOL_INDEX_NONE;
+        uint64  mRetiredAt  = 0;    // Frame it was released in
+    };
+
     Renderer* pRenderer = NULL;
-    Array<T*> pResources;
-    Array<HND> mHandleQueue;
+    DynArray<Slot> mSlots;
+    uint32 mFreeSlots = POOL_INDEX_NONE;    // Released slots, reused before growing
+    uint32 mRetiredHead = POOL_INDEX_NONE;  // Released slots waiting for their frame, oldest first
+    uint32 mRetiredTail = POOL_INDEX_NONE;
+    uint64 mRetireFrames = 0;
+    uint64 mMaxResources = 0;
 };
 
 template<typename T>
-ResourceManager<T> createResourceManager(Renderer* pRenderer, Arena* pArena, uint64 maxResources)
+ResourceManager<T> createResourceManager(Renderer* pRenderer, Arena* pArena, uint64 maxResources,
+        uint64 retireFrames = 0)
 {
     ASSERT(pRenderer && pArena);
+    ASSERT(maxResources <= POOL_MAX_BLOCKS);
     ResourceManager<T> resMan;
     resMan.pRenderer = pRenderer;
-    resMan.pResources = array<T*>(pArena, maxResources, maxResources, NULL);
-    resMan.mHandleQueue = array<HND>(pArena, maxResources);
+    resMan.mSlots = dynArray<typename ResourceManager<T>::Slot>(pArena);
+    resMan.mRetireFrames = retireFrames;
+    resMan.mMaxResources = maxResources;
+    return resMan;
+}
+
+// Removes a retired resource once no frame uses it, overloaded per resource type.
+void removeRetiredResource(Renderer* pRenderer, Texture** ppTexture);
 
-    // Queue all handles for assigning to resources
-    HND handle = (HND)(maxResources - 1);
-    for(uint64 i = 0; i < maxResources; i++)
+// Moves the slots released at least mRetireFrames before frame to the free list,
+// removing their retired resources.
+template<typename T>
+void recycleResourceSlots(ResourceManager<T>* pResMan, uint64 frame)
+{
+    ASSERT(pResMan);
+    while(pResMan->mRetiredHead != POOL_INDEX_NONE)
     {
-        resMan.mHandleQueue.push(handle);
-        handle--;
+        uint32 index = pResMan->mRetiredHead;
+        typename ResourceManager<T>::Slot& slot = pResMan->mSlots[index];
+        if(slot.mRetiredAt + pResMan->mRetireFrames > frame) break;
+
+        if(slot.pRetired)
+        {
+            removeRetiredResource(pResMan->pRenderer, &slot.pRetired);
+            ASSERT(!slot.pRetired);
+        }
+        pResMan->mRetiredHead = slot.mNextFree;
+        if(pResMan->mRetiredHead == POOL_INDEX_NONE) pResMan->mRetiredTail = POOL_INDEX_NONE;
+        slot.mNextFree = pResMan->mFreeSlots;
+        pResMan->mFreeSlots = index;
     }
+}
 
-    return resMan;
+template<typename T>
+HND acquireResourceHandle(ResourceManager<T>* pResMan, T* pResource, uint64 frame = 0)
+{
+    ASSERT(pResMan && pResource);
+    recycleResourceSlots(pResMan, frame);
+    uint32 index = pResMan->mFreeSlots;
+    if(index != POOL_INDEX_NONE)
+    {
+        pResMan->mFreeSlots = pResMan->mSlots[index].mNextFree;
+    }
+    else
+    {
+        ASSERT(pResMan->mSlots.mCount < pResMan->mMaxResources);
+        index = (uint32)pResMan->mSlots.mCount;
+        pResMan->mSlots.push({});
+    }
+
+    typename ResourceManager<T>::Slot& slot = pResMan->mSlots[index];
+    slot.pResource = pResource;
+    slot.mNextFree = POOL_INDEX_NONE;
+    return HND_MAKE(index, slot.mGeneration);
+}
+
+template<typename T>
+bool isResourceValid(ResourceManager<T>* pResMan, HND handle)
+{
+    ASSERT(pResMan);
+    uint32 index = HND_INDEX(handle);
+    if(handle == HND_INVALID || index >= pResMan->mSlots.mCount) return false;
+
+    typename ResourceManager<T>::Slot& slot = pResMan->mSlots[index];
+    return slot.pResource != NULL
+        && (slot.mGeneration & POOL_HND_GENERATION_MASK) == HND_GENERATION(handle);
+}
+
+template<typename T>
+T* getResource(ResourceManager<T>* pResMan, HND handle)
+{
+    return isResourceValid(pResMan, handle) ? pResMan->mSlots[HND_INDEX(handle)].pResource : NULL;
+}
+
+template<typename T>
+void releaseResourceHandle(ResourceManager<T>* pResMan, HND handle, uint64 frame = 0)
+{
+    ASSERTF(isResourceValid(pResMan, handle), "Releasing stale resource handle 0x%08x", handle);
+    uint32 index = HND_INDEX(handle);
+    typename ResourceManager<T>::Slot& slot = pResMan->mSlots[index];
+    slot.pResource = NULL;
+    slot.mGeneration++;
+    if(!pResMan->mRetireFrames)
+    {
+        slot.mNextFree = pResMan->mFreeSlots;
+        pResMan->mFreeSlots = index;
+        return;
+    }
+
+    // Frames are released in order, so the list stays sorted by mRetiredAt
+    slot.mRetiredAt = frame;
+    slot.mNextFree = POOL_INDEX_NONE;
+    if(pResMan->mRetiredTail != POOL_INDEX_NONE) pResMan->mSlots[pResMan->mRetiredTail].mNextFree = index;
+    else pResMan->mRetiredHead = index;
+    pResMan->mRetiredTail = index;
+}
+
+// Releases the resource's handle and removes the resource along with its slot, after
+// mRetireFrames frames. Without retireFrames it's removed right away.
+template<typename T>
+void retireResource(ResourceManager<T>* pResMan, T** ppResource, uint64 frame = 0)
+{
+    ASSERT(pResMan && ppResource && *ppResource);
+    HND handle = (*ppResource)->mHandle;
+    releaseResourceHandle(pResMan, handle, frame);
+    if(!pResMan->mRetireFrames)
+    {
+        removeRetiredResource(pResMan->pRenderer, ppResource);
+        return;
+    }
+
+    pResMan->mSlots[HND_INDEX(handle)].pRetired = *ppResource;
+    *ppResource = NULL;
 }
 
 void initTexture(ResourceManager<Texture>* pResMan, TextureDesc desc, Texture** ppTexture);
@@ -42,7 +168,3 @@ void initRenderTarget(ResourceManager<Texture>* pResMan, RenderTargetDesc desc,
 void initDepthTarget(ResourceManager<Texture>* pResMan, RenderTargetDesc desc, RenderTarget** ppTarget);
 void destroyRenderTarget(ResourceManager<Texture>* pResMan, RenderTarget** ppTarget);
 
-void getSampledTextureResources(ResourceManager<Texture>* pResMan, uint64 count, Texture* pFallback, Texture** pOut);
-void getStorageTextureResources(ResourceManager<Texture>* pResMan, uint64 count, Texture* pFallback, Texture** pOut);
-
-
@@ -8,6 +8,7 @@ void addShader(Renderer* pRenderer, ShaderDesc desc, Shader** ppShader)
     ASSERT(*ppShader == NULL);
 
     *ppShader = (Shader*)poolAlloc(&pRenderer->poolShaders);
+    ASSERT(*ppShader);
 
     **ppShader = {};
 
@@ -27,6 +28,7 @@ void addShader(Renderer* pRenderer, ShaderDesc desc, Shader** ppShader)
 
     (*ppShader)->mDesc = desc;
     (*ppShader)->mVkShader = vkShader; 
+    (*ppShader)->mHash = hash128((byte*)desc.pBytecode, desc.mBytecodeSize);
 }
 
 void removeShader(Renderer* pRenderer, Shader** ppShader)
@@ -1,5 +1,6 @@
 #pragma once
 #include "../core/base.hpp"
+#include "../core/string.hpp"
 #include "vulkan/vulkan_core.h"
 
 struct Renderer;
@@ -25,6 +26,7 @@ struct Shader
     ShaderDesc mDesc;
     
     VkShaderModule mVkShader = VK_NULL_HANDLE;
+    Hash128 mHash = {};     // Of the bytecode, names the shader in pipeline keys
 };
 
 void addShader(Renderer* pRenderer, ShaderDesc desc, Shader** ppShader);
@@ -0,0 +1,700 @@
+#include "render.hpp"
+#include "pipeline_cache.hpp"
+#include "descriptor_cache.hpp"
+#include "bindless.hpp"
+#include "resource_manager.hpp"
+#include "../core/debug.hpp"
+
+// Only the CPU side of the pipeline cache, keys and cache headers, no device is created
+bool testPipelineKeys()
+{
+    uint32 vsCode[] = { 0x07230203, 1, 2, 3 };
+    uint32 fsCode[] = { 0x07230203, 4, 5, 6 };
+    Shader vs = {};
+    vs.mHash = hash128((byte*)vsCode, sizeof(vsCode));
+    Shader vsCopy = {};     // Same bytecode, another shader
+    vsCopy.mHash = hash128((byte*)vsCode, sizeof(vsCode));
+    Shader fs = {};
+    fs.mHash = hash128((byte*)fsCode, sizeof(fsCode));
+
+    DescriptorSet set = {};
+    set.mDesc.mCount = 2;
+    set.mDesc.mResources[0].mType = DESCRIPTOR_UNIFORM_BUFFER;
+    set.mDesc.mResources[1].mType = DESCRIPTOR_TEXTURE;
+    set.mDesc.mResources[1].mMaxCount = 16;
+    DescriptorSet setCopy = set;    // Same layout, other resources
+    setCopy.mDesc.mResources[1].mCount = 3;
+    setCopy.mDesc.mResources[1].pData = &setCopy;
+
+    GraphicsPipelineDesc desc = {};
+    desc.mRenderTargetCount = 1;
+    desc.mRenderTargetFormats[0] = FORMAT_RGBA8_UNORM;
+    desc.mDepthTargetFormat = FORMAT_D32_SFLOAT;
+    desc.pDescriptorSets[0] = &set;
+    desc.mDescriptorSetCount = 1;
+    desc.pVS = &vs;
+    desc.pFS = &fs;
+    desc.mDepthTest = true;
+    desc.mDepthWrite = true;
+    desc.mConstantBlocks[0].mShaderTypes = SHADER_TYPE_VERT;
+    desc.mConstantBlocks[0].mSize = 64;
+    desc.mConstantBlockCount = 1;
+    Hash128 key = hashPipelineDesc(&desc);
+    ASSERT(key == hashPipelineDesc(&desc));
+
+    // Equivalent descs
+    {
+        GraphicsPipelineDesc other = desc;
+        other.pVS = &vsCopy;
+        other.pDescriptorSets[0] = &setCopy;
+        other.mRenderTargetFormats[1] = FORMAT_RGBA16_SFLOAT;   // Past mRenderTargetCount
+        other.mSrcColorFactor = BLEND_FACTOR_SRC_ALPHA;         // Blending disabled
+        other.mBlendOp = BLEND_MAX;
+        other.mLineWidth = 4.f;                                 // Solid fill
+        other.mVertexLayout.mDesc.mAttribs[0] = ATTRIBUTE_FLOAT3;
+        other.mConstantBlocks[1].mSize = 128;
+        ASSERT(hashPipelineDesc(&other) == key);
+
+        other = desc;
+        other.mDepthTest = false;
+        Hash128 noDepthKey = hashPipelineDesc(&other);
+        ASSERT(noDepthKey != key);
+        other.mDepthWrite = false;
+        other.mDepthOp = COMPARE_LESS;
+        ASSERT(hashPipelineDesc(&other) == noDepthKey);
+
+        other = desc;
+        other.mRenderTargetCount = 0;
+        Hash128 depthOnlyKey = hashPipelineDesc(&other);
+        other.mBlendEnable = true;
+        other.mBlendMask = COMPONENT_R;
+        ASSERT(hashPipelineDesc(&other) == depthOnlyKey);
+    }
+
+    // Descs that create different pipelines
+    {
+        GraphicsPipelineDesc other = desc;
+        other.pFS = &vs;
+        ASSERT(hashPipelineDesc(&other) != key);
+
+        other = desc;
+        other.mRenderTargetFormats[0] = FORMAT_RGBA16_SFLOAT;
+        ASSERT(hashPipelineDesc(&other) != key);
+
+        other = desc;
+        other.mRenderTargetCount = 2;
+        other.mRenderTargetFormats[1] = FORMAT_RGBA8_UNORM;
+        ASSERT(hashPipelineDesc(&other) != key);
+
+        other = desc;
+        other.mCullMode = CULL_MODE_BACK;
+        ASSERT(hashPipelineDesc(&other) != key);
+
+        other = desc;
+        other.mDepthOp = COMPARE_LESS;
+        ASSERT(hashPipelineDesc(&other) != key);
+
+        other = desc;
+        other.mBlendEnable = true;
+        Hash128 blendKey = hashPipelineDesc(&other);
+        ASSERT(blendKey != key);
+        other.mSrcColorFactor = BLEND_FACTOR_SRC_ALPHA;
+        ASSERT(hashPipelineDesc(&other) != blendKey);
+
+        other = desc;
+        other.mFillMode = FILL_MODE_LINE;
+        Hash128 lineKey = hashPipelineDesc(&other);
+        ASSERT(lineKey != key);
+        other.mLineWidth = 2.f;
+        ASSERT(hashPipelineDesc(&other) != lineKey);
+
+        other = desc;
+        other.mVertexLayout.mDesc.mCount = 1;
+        other.mVertexLayout.mDesc.mAttribs[0] = ATTRIBUTE_FLOAT3;
+        Hash128 vertexKey = hashPipelineDesc(&other);
+        ASSERT(vertexKey != key);
+        other.mVertexLayout.mDesc.mAttribs[0] = ATTRIBUTE_FLOAT4;
+        ASSERT(hashPipelineDesc(&other) != vertexKey);
+
+        other = desc;
+        other.mConstantBlocks[0].mSize = 128;
+        ASSERT(hashPipelineDesc(&other) != key);
+
+        // A wider texture array is another set layout
+        DescriptorSet wideSet = set;
+        wideSet.mDesc.mResources[1].mMaxCount = 32;
+        ASSERT(hashDescriptorSetLayout(&wideSet.mDesc) != hashDescriptorSetLayout(&set.mDesc));
+        other = desc;
+        other.pDescriptorSets[0] = &wideSet;
+        ASSERT(hashPipelineDesc(&other) != key);
+
+        other = desc;
+        other.pDescriptorSets[1] = &set;
+        other.mDescriptorSetCount = 2;
+        ASSERT(hashPipelineDesc(&other) != key);
+    }
+
+    // Compute
+    {
+        ComputePipelineDesc compute = {};
+        compute.pDescriptorSets[0] = &set;
+        compute.mDescriptorSetCount = 1;
+        compute.pCS = &vs;
+        Hash128 computeKey = hashPipelineDesc(&compute);
+        compute.pDescriptorSets[0] = &setCopy;
+        compute.pCS = &vsCopy;
+        ASSERT(hashPipelineDesc(&compute) == computeKey);
+        compute.pCS = &fs;
+        ASSERT(hashPipelineDesc(&compute) != computeKey);
+    }
+
+    return true;
+}
+
+bool testPipelineCacheHeader()
+{
+    VkPhysicalDeviceProperties props = {};
+    props.vendorID = 0x10de;
+    props.deviceID = 0x2684;
+    for(uint32 i = 0; i < VK_UUID_SIZE; i++)
+    {
+        props.pipelineCacheUUID[i] = (uint8)(i * 7 + 1);
+    }
+
+    // Header followed by driver data
+    byte data[sizeof(VkPipelineCacheHeaderVersionOne) + 64] = {};
+    VkPipelineCacheHeaderVersionOne header = {};
+    header.headerSize = sizeof(header);
+    header.headerVersion = VK_PIPELINE_CACHE_HEADER_VERSION_ONE;
+    header.vendorID = props.vendorID;
+    header.deviceID = props.deviceID;
+    memcpy(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE);
+    memcpy(data, &header, sizeof(header));
+    ASSERT(isPipelineCacheCompatible(data, sizeof(data), &props));
+
+    ASSERT(!isPipelineCacheCompatible(NULL, 0, &props));
+    ASSERT(!isPipelineCacheCompatible(data, sizeof(header) - 1, &props));
+
+    // Another driver or device
+    {
+        VkPhysicalDeviceProperties other = props;
+        other.vendorID = 0x1002;
+        ASSERT(!isPipelineCacheCompatible(data, sizeof(data), &other));
+        other = props;
+        other.deviceID++;
+        ASSERT(!isPipelineCacheCompatible(data, sizeof(data), &other));
+        other = props;
+        other.pipelineCacheUUID[VK_UUID_SIZE - 1] ^= 1;     // Driver update
+        ASSERT(!isPipelineCacheCompatible(data, sizeof(data), &other));
+    }
+
+    // Damaged headers
+    {
+        VkPipelineCacheHeaderVersionOne damaged = header;
+        damaged.headerSize = sizeof(data) + 1;
+        memcpy(data, &damaged, sizeof(damaged));
+        ASSERT(!isPipelineCacheCompatible(data, sizeof(data), &props));
+        damaged = header;
+        damaged.headerVersion = (VkPipelineCacheHeaderVersion)(VK_PIPELINE_CACHE_HEADER_VERSION_ONE + 1);
+        memcpy(data, &damaged, sizeof(damaged));
+        ASSERT(!isPipelineCacheCompatible(data, sizeof(data), &props));
+    }
+
+    return true;
+}
+
+// Fake descriptor backend, pools hold a fixed number of sets and handles are indices
+#define FAKE_DESCRIPTOR_MAX_LAYOUTS 16
+#define FAKE_DESCRIPTOR_MAX_SETS    4096
+
+// Pools hold sets and descriptors of each type like Vulkan's, running out of either fails
+struct FakeDescriptorDevice
+{
+    DescriptorCounts mLayouts[FAKE_DESCRIPTOR_MAX_LAYOUTS] = {};
+    bool    mLayoutsUpdateAfterBind[FAKE_DESCRIPTOR_MAX_LAYOUTS] = {};
+    uint32  mLayoutCount        = 0;
+    uint32  mLayoutsDestroyed   = 0;
+    uint32  mPoolSets[DESCRIPTOR_ALLOCATOR_MAX_POOLS] = {};
+    uint32  mPoolUsed[DESCRIPTOR_ALLOCATOR_MAX_POOLS] = {};
+    DescriptorCounts mPoolCounts[DESCRIPTOR_ALLOCATOR_MAX_POOLS] = {};
+    DescriptorCounts mPoolUsedCounts[DESCRIPTOR_ALLOCATOR_MAX_POOLS] = {};
+    bool    mPoolsUpdateAfterBind[DESCRIPTOR_ALLOCATOR_MAX_POOLS] = {};
+    uint32  mPoolCount          = 0;
+    uint32  mPoolsDestroyed     = 0;
+    uint32  mResets             = 0;
+    uint32  mSetLayouts[FAKE_DESCRIPTOR_MAX_SETS] = {};
+    uint64  mSetCount           = 0;
+};
+
+uint32 getFakeDescriptorLayout(VkDescriptorSetLayout layout)
+{
+    return (uint32)((uint64)layout - 1);
+}
+
+uint32 getFakeDescriptorPool(VkDescriptorPool pool)
+{
+    return (uint32)((uint64)pool - 1);
+}
+
+VkDescriptorSetLayout createFakeDescriptorSetLayout(void* pUserData, DescriptorSetDesc* pDesc)
+{
+    FakeDescriptorDevice* pDevice = (FakeDescriptorDevice*)pUserData;
+    ASSERT(pDevice->mLayoutCount < FAKE_DESCRIPTOR_MAX_LAYOUTS);
+    pDevice->mLayouts[pDevice->mLayoutCount] = countDescriptors(pDesc);
+    pDevice->mLayoutsUpdateAfterBind[pDevice->mLayoutCount] = isUpdateAfterBind(pDesc);
+    return (VkDescriptorSetLayout)(uint64)++pDevice->mLayoutCount;
+}
+
+void destroyFakeDescriptorSetLayout(void* pUserData, VkDescriptorSetLayout layout)
+{
+    ((FakeDescriptorDevice*)pUserData)->mLayoutsDestroyed++;
+}
+
+VkDescriptorPool createFakeDescriptorPool(void* pUserData, uint32 maxSets, DescriptorCounts* pCounts, bool freeable,
+        bool updateAfterBind)
+{
+    FakeDescriptorDevice* pDevice = (FakeDescriptorDevice*)pUserData;
+    pDevice->mPoolSets[pDevice->mPoolCount] = maxSets;
+    pDevice->mPoolCounts[pDevice->mPoolCount] = *pCounts;
+    pDevice->mPoolsUpdateAfterBind[pDevice->mPoolCount] = updateAfterBind;
+    return (VkDescriptorPool)(uint64)++pDevice->mPoolCount;
+}
+
+void destroyFakeDescriptorPool(void* pUserData, VkDescriptorPool pool)
+{
+    ((FakeDescriptorDevice*)pUserData)->mPoolsDestroyed++;
+}
+
+void resetFakeDescriptorPool(void* pUserData, VkDescriptorPool pool)
+{
+    FakeDescriptorDevice* pDevice = (FakeDescriptorDevice*)pUserData;
+    pDevice->mPoolUsed[getFakeDescriptorPool(pool)] = 0;
+    pDevice->mPoolUsedCounts[getFakeDescriptorPool(pool)] = {};
+    pDevice->mResets++;
+}
+
+VkResult allocateFakeDescriptorSet(void* pUserData, VkDescriptorPool pool,
+        VkDescriptorSetLayout layout, VkDescriptorSet* pOut)
+{
+    FakeDescriptorDevice* pDevice = (FakeDescriptorDevice*)pUserData;
+    uint32 index = getFakeDescriptorPool(pool);
+    DescriptorCounts* pLayout = &pDevice->mLayouts[getFakeDescriptorLayout(layout)];
+    DescriptorCounts* pUsed = &pDevice->mPoolUsedCounts[index];
+    // Invalid usage in Vulkan, not an error it reports
+    ASSERT(pDevice->mPoolsUpdateAfterBind[index] || !pDevice->mLayoutsUpdateAfterBind[getFakeDescriptorLayout(layout)]);
+    if(pDevice->mPoolUsed[index] == pDevice->mPoolSets[index]) return VK_ERROR_OUT_OF_POOL_MEMORY;
+    for(uint32 i = 0; i < DESCRIPTOR_POOL_TYPES; i++)
+    {
+        if(pUsed->mCounts[i] + pLayout->mCounts[i] > pDevice->mPoolCounts[index].mCounts[i]) return VK_ERROR_OUT_OF_POOL_MEMORY;
+    }
+
+    ASSERT(pDevice->mSetCount < FAKE_DESCRIPTOR_MAX_SETS);
+    for(uint32 i = 0; i < DESCRIPTOR_POOL_TYPES; i++)
+    {
+        pUsed->mCounts[i] += pLayout->mCounts[i];
+    }
+    pDevice->mPoolUsed[index]++;
+    pDevice->mSetLayouts[pDevice->mSetCount] = getFakeDescriptorLayout(layout);
+    *pOut = (VkDescriptorSet)(uint64)++pDevice->mSetCount;
+    return VK_SUCCESS;
+}
+
+void freeFakeDescriptorSet(void* pUserData, VkDescriptorPool pool, VkDescriptorSet set)
+{
+    FakeDescriptorDevice* pDevice = (FakeDescriptorDevice*)pUserData;
+    uint32 index = getFakeDescriptorPool(pool);
+    DescriptorCounts* pLayout = &pDevice->mLayouts[pDevice->mSetLayouts[(uint64)set - 1]];
+    for(uint32 i = 0; i < DESCRIPTOR_POOL_TYPES; i++)
+    {
+        pDevice->mPoolUsedCounts[index].mCounts[i] -= pLayout->mCounts[i];
+    }
+    pDevice->mPoolUsed[index]--;
+}
+
+uint32 getDescriptorPoolTypeIndex(VkDescriptorType type)
+{
+    uint32 index = 0;
+    while(getDescriptorPoolType(index) != type) index++;
+    return index;
+}
+
+DescriptorBackend getFakeDescriptorBackend(FakeDescriptorDevice* pDevice)
+{
+    DescriptorBackend backend = {};
+    backend.pUserData = pDevice;
+    backend.pfnCreateLayout = createFakeDescriptorSetLayout;
+    backend.pfnDestroyLayout = destroyFakeDescriptorSetLayout;
+    backend.pfnCreatePool = createFakeDescriptorPool;
+    backend.pfnDestroyPool = destroyFakeDescriptorPool;
+    backend.pfnResetPool = resetFakeDescriptorPool;
+    backend.pfnAllocateSet = allocateFakeDescriptorSet;
+    backend.pfnFreeSet = freeFakeDescriptorSet;
+    return backend;
+}
+
+bool testDescriptorCache()
+{
+    FakeDescriptorDevice device = {};
+    DescriptorBackend backend = getFakeDescriptorBackend(&device);
+
+    // One layout per distinct binding list
+    {
+        DescriptorLayoutCache cache = {};
+        initDescriptorLayoutCache(&backend, &cache);
+
+        DescriptorSetDesc desc = {};
+        desc.mCount = 2;
+        desc.mResources[0].mType = DESCRIPTOR_STORAGE_BUFFER;
+        desc.mResources[1].mType = DESCRIPTOR_TEXTURE;
+        desc.mResources[1].mMaxCount = 64;
+        VkDescriptorSetLayout layout = getDescriptorSetLayout(&cache, &desc);
+
+        DescriptorSetDesc same = desc;
+        same.mResources[0].pData = &same;
+        same.mResources[1].mCount = 10;
+        same.mResources[2].mType = DESCRIPTOR_SAMPLER;     // Past mCount
+        ASSERT(hashDescriptorSetLayout(&same) == hashDescriptorSetLayout(&desc));
+        ASSERT(getDescriptorSetLayout(&cache, &same) == layout);
+        ASSERT(device.mLayoutCount == 1);
+
+        DescriptorSetDesc other = desc;
+        other.mResources[1].mMaxCount = 128;
+        ASSERT(getDescriptorSetLayout(&cache, &other) != layout);
+        other = desc;
+        other.mResources[0].mType = DESCRIPTOR_DYNAMIC_STORAGE_BUFFER;
+        ASSERT(getDescriptorSetLayout(&cache, &other) != layout);
+        other = desc;
+        other.mCount = 1;
+        ASSERT(getDescriptorSetLayout(&cache, &other) != layout);
+        ASSERT(device.mLayoutCount == 4);
+        ASSERT(cache.mHits == 1 && cache.mMisses == 4);
+
+        destroyDescriptorLayoutCache(&cache);
+        ASSERT(device.mLayoutsDestroyed == 4);
+    }
+
+    // Sets of one uniform buffer, pools run out of sets before descriptors
+    DescriptorSetDesc smallDesc = {};
+    smallDesc.mCount = 1;
+    smallDesc.mResources[0].mType = DESCRIPTOR_UNIFORM_BUFFER;
+    VkDescriptorSetLayout layout = createFakeDescriptorSetLayout(&device, &smallDesc);
+
+    // Transient: pools are added as frames need more sets, then reused after resets
+    {
+        device.mPoolCount = 0;
+        device.mPoolsDestroyed = 0;
+        DescriptorAllocator allocator = {};
+        initDescriptorAllocator(&backend, false, &allocator);
+        ASSERT(allocator.mPoolCount == 0);
+
+        uint32 setsPerFrame = DESCRIPTOR_POOL_MIN_SETS * 3 + 1;
+        for(uint32 frame = 0; frame < 8; frame++)
+        {
+            resetDescriptorAllocator(&allocator);
+            for(uint32 i = 0; i < setsPerFrame; i++)
+            {
+                ASSERT(allocateDescriptorSet(&allocator, layout, &smallDesc) != VK_NULL_HANDLE);
+            }
+            ASSERT(allocator.mAllocated == setsPerFrame);
+            // 1x, 2x, then 4x the minimum
+            ASSERT(allocator.mPoolCount == 3);
+        }
+        ASSERT(device.mPoolCount == 3);
+        ASSERT(device.mPoolSets[0] == DESCRIPTOR_POOL_MIN_SETS);
+        ASSERT(device.mPoolSets[1] == DESCRIPTOR_POOL_MIN_SETS * 2);
+        ASSERT(device.mPoolSets[2] == DESCRIPTOR_POOL_MIN_SETS * 4);
+        ASSERT(device.mPoolUsed[2] == 1);
+
+        destroyDescriptorAllocator(&allocator);
+        ASSERT(device.mPoolsDestroyed == 3);
+    }
+
+    // Persistent: freed sets make room in the pool they came from
+    {
+        device = {};
+        layout = createFakeDescriptorSetLayout(&device, &smallDesc);
+        DescriptorAllocator allocator = {};
+        initDescriptorAllocator(&backend, true, &allocator);
+
+        VkDescriptorPool pools[DESCRIPTOR_POOL_MIN_SETS + 1];
+        VkDescriptorSet sets[DESCRIPTOR_POOL_MIN_SETS + 1];
+        for(uint32 i = 0; i < DESCRIPTOR_POOL_MIN_SETS + 1; i++)
+        {
+            sets[i] = allocateDescriptorSet(&allocator, layout, &smallDesc, &pools[i]);
+        }
+        ASSERT(allocator.mPoolCount == 2);
+        ASSERT(pools[0] == pools[DESCRIPTOR_POOL_MIN_SETS - 1]);
+        ASSERT(pools[DESCRIPTOR_POOL_MIN_SETS] != pools[0]);
+
+        freeDescriptorSet(&allocator, pools[3], sets[3]);
+        ASSERT(allocator.mAllocated == DESCRIPTOR_POOL_MIN_SETS);
+        VkDescriptorPool pool = VK_NULL_HANDLE;
+        allocateDescriptorSet(&allocator, layout, &smallDesc, &pool);
+        ASSERT(pool == pools[0]);
+        allocateDescriptorSet(&allocator, layout, &smallDesc, &pool);
+        ASSERT(pool == pools[DESCRIPTOR_POOL_MIN_SETS]);
+        ASSERT(allocator.mPoolCount == 2);
+
+        destroyDescriptorAllocator(&allocator);
+    }
+
+    // Arrays larger than the pool ratios get a pool sized for them, the default bindless
+    // table among them
+    {
+        device = {};
+        layout = createFakeDescriptorSetLayout(&device, &smallDesc);
+        DescriptorSetDesc largeDesc = {};
+        largeDesc.mCount = 2;
+        largeDesc.mResources[0].mType = DESCRIPTOR_UNIFORM_BUFFER;
+        largeDesc.mResources[1].mType = DESCRIPTOR_STORAGE_IMAGE;
+        largeDesc.mResources[1].mMaxCount = 1024;
+        VkDescriptorSetLayout largeLayout = createFakeDescriptorSetLayout(&device, &largeDesc);
+        uint32 storageImages = getDescriptorPoolTypeIndex(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+        ASSERT(getDescriptorPoolCounts(DESCRIPTOR_POOL_MIN_SETS, NULL).mCounts[storageImages] < 1024);
+
+        DescriptorAllocator allocator = {};
+        initDescriptorAllocator(&backend, true, &allocator);
+        VkDescriptorPool pool = VK_NULL_HANDLE;
+        ASSERT(allocateDescriptorSet(&allocator, largeLayout, &largeDesc, &pool) != VK_NULL_HANDLE);
+        ASSERT(allocator.mPoolCount == 1);
+        ASSERT(device.mPoolCounts[0].mCounts[storageImages] == 1024);
+
+        // The pool keeps its ratios for the other types and sets
+        VkDescriptorPool smallPool = VK_NULL_HANDLE;
+        allocateDescriptorSet(&allocator, layout, &smallDesc, &smallPool);
+        ASSERT(smallPool == pool);
+
+        // Out of storage images, the next large set gets the next pool
+        VkDescriptorPool nextPool = VK_NULL_HANDLE;
+        VkDescriptorSet set = allocateDescriptorSet(&allocator, largeLayout, &largeDesc, &nextPool);
+        ASSERT(set != VK_NULL_HANDLE && nextPool != pool);
+        ASSERT(allocator.mPoolCount == 2);
+        ASSERT(device.mPoolCounts[1].mCounts[storageImages] == 1024);
+        ASSERT(device.mPoolSets[1] == DESCRIPTOR_POOL_MIN_SETS * 2);
+
+        // Freed sets give their descriptors back
+        freeDescriptorSet(&allocator, nextPool, set);
+        ASSERT(device.mPoolUsedCounts[1].mCounts[storageImages] == 0);
+        allocateDescriptorSet(&allocator, largeLayout, &largeDesc, &pool);
+        ASSERT(pool == nextPool && allocator.mPoolCount == 2);
+
+        destroyDescriptorAllocator(&allocator);
+    }
+
+    // Sets of dynamic buffers only can't be updated after bind, they get pools of their own
+    {
+        device = {};
+        layout = createFakeDescriptorSetLayout(&device, &smallDesc);
+        DescriptorSetDesc dynamicDesc = {};
+        dynamicDesc.mCount = 2;
+        dynamicDesc.mResources[0].mType = DESCRIPTOR_DYNAMIC_UNIFORM_BUFFER;
+        dynamicDesc.mResources[1].mType = DESCRIPTOR_DYNAMIC_STORAGE_BUFFER;
+        VkDescriptorSetLayout dynamicLayout = createFakeDescriptorSetLayout(&device, &dynamicDesc);
+        ASSERT(isUpdateAfterBind(&smallDesc) && !isUpdateAfterBind(&dynamicDesc));
+
+        DescriptorAllocator allocator = {};
+        initDescriptorAllocator(&backend, true, &allocator);
+        VkDescriptorPool dynamicPool = VK_NULL_HANDLE;
+        VkDescriptorSet dynamicSet = allocateDescriptorSet(&allocator, dynamicLayout, &dynamicDesc, &dynamicPool);
+        VkDescriptorPool pool = VK_NULL_HANDLE;
+        allocateDescriptorSet(&allocator, layout, &smallDesc, &pool);
+        ASSERT(allocator.mPoolCount == 2 && pool != dynamicPool);
+        ASSERT(!device.mPoolsUpdateAfterBind[getFakeDescriptorPool(dynamicPool)]);
+        ASSERT(device.mPoolsUpdateAfterBind[getFakeDescriptorPool(pool)]);
+
+        // Each kind fills its own pools, full ones of the other kind are skipped
+        VkDescriptorPool next = VK_NULL_HANDLE;
+        for(uint32 i = 1; i < DESCRIPTOR_POOL_MIN_SETS; i++)
+        {
+            allocateDescriptorSet(&allocator, dynamicLayout, &dynamicDesc, &next);
+            ASSERT(next == dynamicPool);
+        }
+        allocateDescriptorSet(&allocator, dynamicLayout, &dynamicDesc, &next);
+        ASSERT(next != dynamicPool && next != pool && allocator.mPoolCount == 3);
+        allocateDescriptorSet(&allocator, layout, &smallDesc, &next);
+        ASSERT(next == pool);
+
+        // Freeing only brings back the pool's own kind
+        freeDescriptorSet(&allocator, dynamicPool, dynamicSet);
+        allocateDescriptorSet(&allocator, layout, &smallDesc, &next);
+        ASSERT(next == pool);
+        allocateDescriptorSet(&allocator, dynamicLayout, &dynamicDesc, &next);
+        ASSERT(next == dynamicPool);
+
+        destroyDescriptorAllocator(&allocator);
+    }
+
+    return true;
+}
+
+// Stands in for a texture, records its removal instead of touching the device
+struct FakeResource
+{
+    HND     mHandle     = HND_INVALID;
+    bool    mRemoved    = false;
+};
+
+void removeRetiredResource(Renderer* pRenderer, FakeResource** ppResource)
+{
+    (*ppResource)->mRemoved = true;
+    *ppResource = NULL;
+}
+
+// Headless table, only the slot bookkeeping: which slots get written and when
+bool testBindlessTable()
+{
+    Texture fallback = {};
+    Texture textures[8];
+    for(uint32 i = 0; i < 8; i++)
+    {
+        textures[i] = {};
+        textures[i].mHandle = HND_MAKE(i * 2, 0);     // Slots 0, 2, ..., 14
+        textures[i].mDesc.mUsage = TEXTURE_USAGE_SAMPLED;
+    }
+
+    BindlessTableDesc desc = {};
+    desc.mCapacity = 256;
+    desc.pFallback = &fallback;
+    BindlessTable table = {};
+    initBindlessTable(NULL, desc, &table);
+    ASSERT(table.mDirtyCount == 0);
+    ASSERT(getBindlessTexture(&table, 255) == &fallback);
+
+    Arena arena;
+    initArena(KB(64), &arena);
+    BindlessRange* pRanges = NULL;
+
+    // Only the changed slots, consecutive ones in one range
+    Texture extra = textures[0];
+    extra.mHandle = HND_MAKE(1, 0);
+    setBindlessTexture(&table, &textures[0]);
+    setBindlessTexture(&table, &extra);
+    setBindlessTexture(&table, &textures[1]);
+    setBindlessTexture(&table, &textures[1]);  // Unchanged
+    setBindlessTexture(&table, &textures[7]);
+    ASSERT(table.mDirtyCount == 4);
+    ASSERT(getBindlessUpdates(&table, &arena, &pRanges) == 2);
+    ASSERT(pRanges[0].mFirst == 0 && pRanges[0].mCount == 3);
+    ASSERT(pRanges[1].mFirst == 14 && pRanges[1].mCount == 1);
+    ASSERT(getBindlessUpdates(&table, &arena, &pRanges) == 0);
+
+    // Ranges across words
+    Texture far = textures[0];
+    far.mHandle = HND_MAKE(63, 0);
+    Texture farNext = textures[0];
+    farNext.mHandle = HND_MAKE(64, 0);
+    setBindlessTexture(&table, &farNext);
+    setBindlessTexture(&table, &far);
+    ASSERT(getBindlessUpdates(&table, &arena, &pRanges) == 1);
+    ASSERT(pRanges[0].mFirst == 63 && pRanges[0].mCount == 2);
+
+    // Removed slots keep their descriptor while frames in flight may read it
+    removeBindlessTexture(&table, &textures[1], 10);
+    removeBindlessTexture(&table, &textures[7], 11);
+    ASSERT(getBindlessTexture(&table, 2) == &fallback);
+    retireBindlessSlots(&table, 10 + CONCURRENT_FRAMES - 1);
+    ASSERT(table.mDirtyCount == 0 && table.mRetiredCount == 2);
+    retireBindlessSlots(&table, 10 + CONCURRENT_FRAMES);
+    ASSERT(table.mRetiredCount == 1);
+    ASSERT(getBindlessUpdates(&table, &arena, &pRanges) == 1);
+    ASSERT(pRanges[0].mFirst == 2 && pRanges[0].mCount == 1);
+    ASSERT(table.ppTextures[2] == &fallback && table.ppTextures[14] == NULL);
+
+    // A slot set again before it retires isn't given the fallback
+    setBindlessTexture(&table, &textures[7]);
+    retireBindlessSlots(&table, 100);
+    ASSERT(table.mRetiredCount == 0);
+    ASSERT(getBindlessUpdates(&table, &arena, &pRanges) == 1);
+    ASSERT(getBindlessTexture(&table, 14) == &textures[7]);
+
+    destroyBindlessTable(NULL, &table);
+
+    // The set gets a pool of its own holding the whole table, a storage image table at the
+    // default capacity is far past what the shared pools hold per type
+    {
+        FakeDescriptorDevice device = {};
+        DescriptorBackend backend = getFakeDescriptorBackend(&device);
+        DescriptorLayoutCache layouts = {};
+        initDescriptorLayoutCache(&backend, &layouts);
+
+        Texture storageFallback = {};
+        storageFallback.mDesc.mUsage = TEXTURE_USAGE_STORAGE;
+        BindlessTableDesc storageDesc = {};
+        storageDesc.mType = DESCRIPTOR_STORAGE_IMAGE;
+        storageDesc.pFallback = &storageFallback;
+        initBindlessTable(NULL, storageDesc, &table);
+        allocateBindlessSet(&backend, &layouts, &table);
+
+        uint32 storageImages = getDescriptorPoolTypeIndex(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+        ASSERT(table.pSet == &table.mSet && table.mSet.mVkSet != VK_NULL_HANDLE);
+        ASSERT(device.mPoolCount == 1 && device.mPoolSets[0] == 1);
+        ASSERT(device.mPoolCounts[0].mCounts[storageImages] == storageDesc.mCapacity);
+        ASSERT(device.mPoolUsedCounts[0].mCounts[storageImages] == storageDesc.mCapacity);
+
+        freeBindlessSet(&backend, &table);
+        ASSERT(!table.pSet && device.mPoolsDestroyed == 1);
+        destroyBindlessTable(NULL, &table);
+        destroyDescriptorLayoutCache(&layouts);
+    }
+
+    // Handle slots aren't reused before the table lets go of them
+    Renderer renderer = {};     // Handles never use the device
+    ResourceManager<Texture> resMan = createResourceManager<Texture>(&renderer, &arena, 16, CONCURRENT_FRAMES);
+    HND a = acquireResourceHandle(&resMan, &textures[0], 0);
+    HND b = acquireResourceHandle(&resMan, &textures[1], 0);
+    releaseResourceHandle(&resMan, a, 5);
+    HND c = acquireResourceHandle(&resMan, &textures[2], 5 + CONCURRENT_FRAMES - 1);
+    ASSERT(HND_INDEX(c) == 2);
+    HND d = acquireResourceHandle(&resMan, &textures[3], 5 + CONCURRENT_FRAMES);
+    ASSERT(HND_INDEX(d) == HND_INDEX(a) && d != a);
+    ASSERT(!isResourceValid(&resMan, a) && isResourceValid(&resMan, b));
+
+    // Retired resources outlive the frames that may still use them, then go with their slot
+    ResourceManager<FakeResource> fakeResMan = createResourceManager<FakeResource>(&renderer, &arena, 16,
+            CONCURRENT_FRAMES);
+    FakeResource resources[2];
+    FakeResource* pResource = &resources[0];
+    resources[0].mHandle = acquireResourceHandle(&fakeResMan, &resources[0], 0);
+    resources[1].mHandle = acquireResourceHandle(&fakeResMan, &resources[1], 0);
+    retireResource(&fakeResMan, &pResource, 5);
+    ASSERT(!pResource && !resources[0].mRemoved);
+    ASSERT(!isResourceValid(&fakeResMan, resources[0].mHandle));
+    recycleResourceSlots(&fakeResMan, 5 + CONCURRENT_FRAMES - 1);
+    ASSERT(!resources[0].mRemoved);
+    recycleResourceSlots(&fakeResMan, 5 + CONCURRENT_FRAMES);
+    ASSERT(resources[0].mRemoved && !resources[1].mRemoved);
+
+    pResource = &resources[1];
+    retireResource(&fakeResMan, &pResource, 6);
+    recycleResourceSlots(&fakeResMan, MAX_UINT64);     // Shutdown, the device is idle
+    ASSERT(resources[1].mRemoved);
+
+    // Without retireFrames the resource goes right away
+    ResourceManager<FakeResource> immediateResMan = createResourceManager<FakeResource>(&renderer, &arena, 16);
+    resources[0] = {};
+    pResource = &resources[0];
+    resources[0].mHandle = acquireResourceHandle(&immediateResMan, &resources[0]);
+    retireResource(&immediateResMan, &pResource);
+    ASSERT(!pResource && resources[0].mRemoved);
+
+    destroyArena(&arena);
+    return true;
+}
+
+bool testRender()
+{
+    LOG("[TEST-RENDER] Testing pipeline keys...");
+    testPipelineKeys();
+
+    LOG("[TEST-RENDER] Testing pipeline cache headers...");
+    testPipelineCacheHeader();
+
+    LOG("[TEST-RENDER] Testing descriptor layout cache and allocators...");
+    testDescriptorCache();
+
+    LOG("[TEST-RENDER] Testing bindless texture table...");
+    testBindlessTable();
+
+    LOG("[TEST-RENDER] All render tests passed.");
+    return true;
+}
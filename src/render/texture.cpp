@@ -45,6 +45,7 @@ void addTexture(Renderer* pRenderer, TextureDesc desc, Texture** ppTexture,
     ASSERT(*ppTexture == NULL);
 
     *ppTexture = (Texture*)poolAlloc(&pRenderer->poolTextures);
+    ASSERT(*ppTexture);
 
     **ppTexture = {};
 
@@ -138,6 +139,7 @@ void addSampler(Renderer* pRenderer, SamplerDesc desc, Sampler** ppSampler)
     ASSERT(*ppSampler == NULL);
 
     *ppSampler = (Sampler*)poolAlloc(&pRenderer->poolSamplers);
+    ASSERT(*ppSampler);
 
     **ppSampler = {};
 
@@ -254,24 +256,24 @@ void cmdGenerateMipmap(CommandBuffer* pCmd, Texture* pTexture, SamplerFilter mip
     cmdTextureBarrier(pCmd, 1, &barrier);
 }
 
-void cmdCopyToTexture(CommandBuffer* pCmd, Texture* pDst, Buffer* pSrc)
+void cmdCopyToTexture(CommandBuffer* pCmd, Texture* pDst, Buffer* pSrc, uint64 srcOffset, uint32 mip)
 {
     ASSERT(pCmd && pDst && pSrc);
 
     VkBufferImageCopy region = {};
-    region.bufferOffset = 0;
+    region.bufferOffset = srcOffset;
     region.bufferRowLength = 0;
     region.bufferImageHeight = 0;
     region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;   // TODO_DW: Is there a case where I want to copy buffer contents to mips?
+    region.imageSubresource.mipLevel = mip;
     region.imageSubresource.baseArrayLayer = 0;     // TODO_DW: Texture arrays
     region.imageSubresource.layerCount = 1;
     region.imageOffset = {0, 0, 0};
     region.imageExtent =
     {
-        pDst->mDesc.mWidth,
-        pDst->mDesc.mHeight,
-        pDst->mDesc.mDepth
+        MAX(pDst->mDesc.mWidth >> mip, 1u),
+        MAX(pDst->mDesc.mHeight >> mip, 1u),
+        MAX(pDst->mDesc.mDepth >> mip, 1u)
     };
 
     vkCmdCopyBufferToImage(pCmd->mVkCmd, 
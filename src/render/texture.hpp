@@ -30,6 +30,13 @@ enum ImageFormat
     FORMAT_A2RGB10_SNORM        = VK_FORMAT_A2R10G10B10_SNORM_PACK32,
     FORMAT_D32_SFLOAT           = VK_FORMAT_D32_SFLOAT,
     FORMAT_D16_UNORM            = VK_FORMAT_D16_UNORM,
+    FORMAT_BC1_RGB_SRGB         = VK_FORMAT_BC1_RGB_SRGB_BLOCK,
+    FORMAT_BC1_RGB_UNORM        = VK_FORMAT_BC1_RGB_UNORM_BLOCK,
+    FORMAT_BC3_SRGB             = VK_FORMAT_BC3_SRGB_BLOCK,
+    FORMAT_BC3_UNORM            = VK_FORMAT_BC3_UNORM_BLOCK,
+    FORMAT_BC5_UNORM            = VK_FORMAT_BC5_UNORM_BLOCK,
+    FORMAT_BC7_SRGB             = VK_FORMAT_BC7_SRGB_BLOCK,
+    FORMAT_BC7_UNORM            = VK_FORMAT_BC7_UNORM_BLOCK,
 };
 
 enum ImageLayout
@@ -80,7 +87,7 @@ struct TextureDesc
 
 struct Texture
 {
-    HND mHandle = HND_INVALID;
+    HND mHandle = HND_INVALID;     // Resource manager handle, HND_INDEX(mHandle) is the bindless slot
     TextureDesc mDesc = {};
 
     VkImage         mVkImage        = VK_NULL_HANDLE;
@@ -141,4 +148,4 @@ void removeSampler(Renderer* pRenderer, Sampler** ppSampler);
 // --------------------------------------
 // Render Commands
 void cmdGenerateMipmap(CommandBuffer* pCmd, Texture* pTexture, SamplerFilter mipFilter);
-void cmdCopyToTexture(CommandBuffer* pCmd, Texture* pDst, Buffer* pSrc);
+void cmdCopyToTexture(CommandBuffer* pCmd, Texture* pDst, Buffer* pSrc, uint64 srcOffset = 0, uint32 mip = 0);